@@ -0,0 +1,72 @@
+#include <stdio.h>
+
+#include "host.hpp"
+#include "../src/Keyboard.hpp"
+#include "../src/LogSinks.hpp"
+#include "../src/SerialPort.hpp"
+#include "../src/Terminal.hpp"
+#include "../src/bench/BenchmarkRunner.hpp"
+#include "../src/bench/benchmarks.hpp"
+
+/// The base address of COM2, written by the serial port benchmark
+const uint16_t COM2_ADDRESS = 0x2F8;
+/// The data port of the keyboard controller
+const uint16_t KEYBOARD_DATA_PORT = 0x60;
+/// The scancodes decoded by the keyboard benchmark: shift, A, shift
+/// released, A released, then an extended key (right ctrl)
+const uint8_t SCANCODES[] = {0x2A, 0x1E, 0xAA, 0x9E, 0xE0, 0x1D, 0xE0, 0x9D};
+
+/**
+ * \brief Receive a scancode and decode it, like an IRQ1 and the main loop
+ *
+ * \param context The `Keyboard`
+ */
+static void decodeScancode(void* context)
+{
+    static size_t index = 0;
+    Keyboard* keyboard = static_cast<Keyboard*>(context);
+
+    InterruptFrame frame = {};
+    host::setPortValue(KEYBOARD_DATA_PORT, SCANCODES[index]);
+    index = (index + 1) % sizeof(SCANCODES);
+    Keyboard::handleInterrupt(frame, keyboard);
+
+    KeyboardEntry entry;
+    while (keyboard->readEntry(entry)) {
+        bench::doNotOptimize(entry);
+    }
+}
+
+/**
+ * \brief Write a line of the results to a stream (a `LogSinkFunction`)
+ *
+ * \param line The line
+ * \param length The number of characters of the line
+ * \param context The `FILE`
+ */
+static void writeToStream(const char* line, size_t length, void* context)
+{
+    fwrite(line, 1, length, static_cast<FILE*>(context));
+}
+
+/**
+ * \brief Run the benchmarks of the kernel on the host
+ *
+ * The results are written to the standard output, in the format of the
+ * benchmark image.
+ *
+ * \return 0
+ */
+int main()
+{
+    Terminal terminal;
+    SerialPort com2(COM2_ADDRESS);
+
+    bench::BenchmarkRunner& runner = bench::BenchmarkRunner::getInstance();
+    bench::registerBenchmarks(runner, terminal, &com2);
+    runner.add("keyboard-decode", decodeScancode, &Keyboard::getInstance(),
+               100);
+    runner.runAll(writeToStream, stdout);
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The host build of the portable subsystems.
+ *
+ * The terminal, the screen, the keyboard, the serial port, the logger and
+ * `util` are compiled from the kernel sources into a program of the host
+ * (with `BRAPOS_HOST` defined), so they can be measured and profiled without
+ * booting. The hardware is replaced by mocks:
+ * - `inb` and `outb` read and write an array of 65536 ports (io.cpp), where
+ *   the serial ports are always ready to transmit and the registers of the
+ *   VGA CRT controller are kept behind its index port;
+ * - the text memory of VGA is an array (vga.cpp);
+ * - the interrupts, the scheduler and the tick are stubs for a single
+ *   processor without threads (kernel.cpp), the tick following the clock of
+ *   the host until `setTicks` drives it.
+ *
+ * Example:
+ * \code
+ * host::setPortValue(0x60, 0x1E);
+ * Keyboard::handleInterrupt(frame, &Keyboard::getInstance());
+ * \endcode
+ */
+namespace host
+{
+    /// Set the value the next `inb` of a port returns
+    void setPortValue(uint16_t port, uint8_t value);
+    /// Get the last value written to a port
+    uint8_t getPortValue(uint16_t port);
+    /// Get the number of `outb` since the program started
+    uint64_t getPortWriteCount();
+    /// Get the last value written to a register of the VGA CRT controller
+    uint8_t getCrtcRegister(uint8_t index);
+    /// Set the ticks of every processor, from now on
+    void setTicks(uint64_t ticks);
+}
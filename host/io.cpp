@@ -0,0 +1,120 @@
+#include "host.hpp"
+#include "../src/io.hpp"
+
+namespace host
+{
+    /// The number of I/O ports
+    const size_t PORT_COUNT = 0x10000;
+    /// The line status register of the serial ports, from their base address
+    const uint16_t LINE_STATUS_OFFSET = 5;
+    /// The line status of an idle serial port: the transmitter holding
+    /// register and the transmitter are empty
+    const uint8_t LINE_STATUS_IDLE = 0x60;
+    /// The base addresses of COM1, COM2, COM3 and COM4
+    const uint16_t SERIAL_ADDRESSES[] = {0x3F8, 0x2F8, 0x3E8, 0x2E8};
+    /// The index port of the VGA CRT controller
+    const uint16_t CRTC_INDEX_PORT = 0x3D4;
+    /// The data port of the VGA CRT controller (the register of the index)
+    const uint16_t CRTC_DATA_PORT  = 0x3D5;
+    /// The number of registers of the VGA CRT controller
+    const size_t CRTC_REGISTER_COUNT = 0x19;
+
+    /**
+     * \brief The state of the mock ports
+     */
+    struct Ports
+    {
+        /// Make the serial ports ready to transmit
+        Ports()
+            : values(), writeCount(0), crtcRegisters()
+        {
+            for (uint16_t address : SERIAL_ADDRESSES) {
+                values[address + LINE_STATUS_OFFSET] = LINE_STATUS_IDLE;
+            }
+        }
+
+        /// The value of every port
+        uint8_t values[PORT_COUNT];
+        /// The number of `outb`
+        uint64_t writeCount;
+        /// The registers of the VGA CRT controller
+        uint8_t crtcRegisters[CRTC_REGISTER_COUNT];
+    };
+
+    /// The mock ports
+    static Ports ports;
+
+    /**
+     * \brief Set the value the next `inb` of a port returns
+     *
+     * \param port The port
+     * \param value The value
+     */
+    void setPortValue(uint16_t port, uint8_t value)
+    {
+        ports.values[port] = value;
+    }
+
+    /**
+     * \brief Get the last value written to a port
+     *
+     * \param port The port
+     * \return The value of the port
+     */
+    uint8_t getPortValue(uint16_t port)
+    {
+        return ports.values[port];
+    }
+
+    /**
+     * \brief Get the number of `outb` since the program started
+     *
+     * \return The number of writes to any port
+     */
+    uint64_t getPortWriteCount()
+    {
+        return ports.writeCount;
+    }
+
+    /**
+     * \brief Get the last value written to a register of the VGA CRT
+     * controller
+     *
+     * \param index The index of the register (12 and 13 for the start
+     * address, 14 and 15 for the cursor)
+     * \return The value of the register
+     */
+    uint8_t getCrtcRegister(uint8_t index)
+    {
+        return ports.crtcRegisters[index];
+    }
+}
+
+/**
+ * \brief Read a mock I/O port
+ *
+ * \param port The I/O port to read from
+ * \return The last value written to the port (or set by
+ * `host::setPortValue`)
+ */
+uint8_t inb(uint16_t port)
+{
+    return host::ports.values[port];
+}
+
+/**
+ * \brief Write a mock I/O port
+ *
+ * \param port The I/O port to write to
+ * \param data The byte to write to the I/O port
+ */
+void outb(uint16_t port, uint8_t data)
+{
+    ++host::ports.writeCount;
+    host::ports.values[port] = data;
+
+    const uint8_t index = host::ports.values[host::CRTC_INDEX_PORT];
+    if (port == host::CRTC_DATA_PORT && index < host::CRTC_REGISTER_COUNT) {
+        host::ports.crtcRegisters[index] = data;
+    }
+}
@@ -0,0 +1,174 @@
+#include <time.h>
+
+#include "host.hpp"
+#include "../src/interrupt.hpp"
+#include "../src/sched/Scheduler.hpp"
+#include "../src/smp/Cpu.hpp"
+#include "../src/timer/Timer.hpp"
+
+namespace host
+{
+    /// True once `setTicks` drives the tick
+    static bool isTickManual = false;
+    /// The ticks set by `setTicks`
+    static uint64_t manualTicks = 0;
+
+    /**
+     * \brief Set the ticks of every processor, from now on
+     *
+     * The tick stops following the clock of the host, and the scheduler
+     * reports it is initialized, so the code depending on the tick (the rate
+     * limits of the logger) can be tested.
+     *
+     * \param ticks The value returned by `timer::getTicks`
+     */
+    void setTicks(uint64_t ticks)
+    {
+        isTickManual = true;
+        manualTicks = ticks;
+    }
+}
+
+namespace smp
+{
+    /// The only processor of the host build
+    Cpu hostCpu = {};
+}
+
+/**
+ * \brief Register the handler of an interrupt line (nothing to do, the
+ * handlers are called directly by the host code)
+ *
+ * \param irq The interrupt line
+ * \param handler The handler
+ * \param context The context of the handler
+ */
+void registerIrqHandler(uint8_t irq, InterruptHandler handler, void* context)
+{
+    (void) irq;
+    (void) handler;
+    (void) context;
+}
+
+/**
+ * \brief Unregister the handler of an interrupt line (nothing to do)
+ *
+ * \param irq The interrupt line
+ */
+void unregisterIrqHandler(uint8_t irq)
+{
+    (void) irq;
+}
+
+/**
+ * \brief Disable interrupts (there are none on the host)
+ *
+ * \return 0
+ */
+uint32_t saveAndDisableInterrupts()
+{
+    return 0;
+}
+
+/**
+ * \brief Restore the state of the interrupts (nothing to do)
+ *
+ * \param flags The value returned by `saveAndDisableInterrupts`
+ */
+void restoreInterrupts(uint32_t flags)
+{
+    (void) flags;
+}
+
+namespace sched
+{
+    /// The `Scheduler` singleton instance, which never runs threads
+    Scheduler Scheduler::instance_;
+
+    /**
+     * \brief Initialize the scheduler with no thread
+     */
+    Scheduler::Scheduler()
+        : runQueues_(), isInitialized_(false)
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `Scheduler`
+     *
+     * \return the instance of the single object of the class `Scheduler`
+     */
+    Scheduler& Scheduler::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Return true once `initialize` was called
+     *
+     * \return true once `host::setTicks` drives the tick (the host build has
+     * no threads)
+     */
+    bool Scheduler::isInitialized() const
+    {
+        return isInitialized_ || host::isTickManual;
+    }
+
+    /**
+     * \brief Get the thread running on the calling processor
+     *
+     * \return nullptr, the host build has no threads
+     */
+    Thread* Scheduler::getCurrentThread()
+    {
+        return nullptr;
+    }
+
+    /**
+     * \brief Wait until another thread calls `wake` (nothing to do)
+     */
+    void Scheduler::block()
+    {
+    }
+
+    /**
+     * \brief Make a blocked thread ready (nothing to do)
+     *
+     * \param thread The thread
+     */
+    void Scheduler::wake(Thread* thread)
+    {
+        (void) thread;
+    }
+
+    /**
+     * \brief Wait for the next interrupt (returns at once)
+     */
+    void Scheduler::halt()
+    {
+    }
+}
+
+namespace timer
+{
+    /**
+     * \brief Get the number of ticks of a processor since its tick started
+     *
+     * \param cpuIndex The index of the processor (unused)
+     * \return The number of milliseconds of the monotonic clock of the host,
+     * or the ticks set by `host::setTicks`
+     */
+    uint64_t getTicks(size_t cpuIndex)
+    {
+        (void) cpuIndex;
+
+        if (host::isTickManual) {
+            return host::manualTicks;
+        }
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t) now.tv_sec * TICK_FREQUENCY
+               + now.tv_nsec / (1000000000 / TICK_FREQUENCY);
+    }
+}
@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "host.hpp"
+#include "../src/Keyboard.hpp"
+#include "../src/KernelLogger.hpp"
+#include "../src/LogSinks.hpp"
+#include "../src/Terminal.hpp"
+#include "../src/util/RingBuffer.hpp"
+#include "../src/util/format.hpp"
+#include "../src/vga/vga.hpp"
+
+/// Check a condition, the failures are printed with their line
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+/// The data port of the keyboard controller
+const uint16_t KEYBOARD_DATA_PORT = 0x60;
+/// The CRTC registers of the start address of the screen (high, low byte)
+const uint8_t START_HIGH_REGISTER = 12;
+const uint8_t START_LOW_REGISTER  = 13;
+/// The CRTC registers of the cursor position (high, low byte)
+const uint8_t CURSOR_HIGH_REGISTER = 14;
+const uint8_t CURSOR_LOW_REGISTER  = 15;
+
+/// The number of checks run
+static uint32_t checkCount = 0;
+/// The number of checks that failed
+static uint32_t failureCount = 0;
+
+/**
+ * \brief Count a check, and print it if it failed
+ *
+ * \param isPassed The result of the check
+ * \param expression The text of the condition
+ * \param file The source file of the check
+ * \param line The line of the check
+ */
+static void check(bool isPassed, const char* expression, const char* file,
+                  int line)
+{
+    ++checkCount;
+    if (!isPassed) {
+        ++failureCount;
+        printf("%s:%d: check failed: %s\n", file, line, expression);
+    }
+}
+
+/**
+ * \brief Get the row of the text memory displayed at the top of the screen
+ *
+ * \return The row of the start address of the CRT controller
+ */
+static size_t getStartRow()
+{
+    return (host::getCrtcRegister(START_HIGH_REGISTER) << 8 |
+            host::getCrtcRegister(START_LOW_REGISTER)) / vga::WIDTH;
+}
+
+/**
+ * \brief Get the position of the hardware cursor
+ *
+ * \return The index of the cursor in the text memory
+ */
+static size_t getCursorIndex()
+{
+    return host::getCrtcRegister(CURSOR_HIGH_REGISTER) << 8 |
+           host::getCrtcRegister(CURSOR_LOW_REGISTER);
+}
+
+/**
+ * \brief Check the characters of a row of the text memory
+ *
+ * \param row The row of the text memory
+ * \param text The characters expected at the start of the row
+ * \return true if the row holds the text followed by spaces only
+ */
+static bool isRow(size_t row, const char* text)
+{
+    const uint16_t* entries = vga::getTextMemory() + row * vga::WIDTH;
+    const size_t length = strlen(text);
+    for (size_t x = 0; x < vga::WIDTH; ++x) {
+        const char expected = x < length ? text[x] : ' ';
+        if ((char) (entries[x] & 0xFF) != expected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Check that long text wraps to the next row
+ */
+static void testTerminalWrap()
+{
+    Terminal terminal;
+    char row[vga::WIDTH + 1];
+    for (size_t i = 0; i < vga::WIDTH; ++i) {
+        row[i] = 'a' + i % 26;
+    }
+    row[vga::WIDTH] = '\0';
+
+    terminal.write(row);
+    terminal.write("wrap");
+
+    CHECK(getStartRow() == 0);
+    CHECK(isRow(0, row));
+    CHECK(isRow(1, "wrap"));
+    CHECK(isRow(2, ""));
+    CHECK(getCursorIndex() == vga::WIDTH + 4);
+}
+
+/**
+ * \brief Check the scrolling, up to the copy of the rows back to the start
+ * of the text memory
+ */
+static void testTerminalScroll()
+{
+    Terminal terminal;
+    char line[32];
+
+    // The newline of the last row scrolls the screen one row
+    for (uint32_t i = 0; i < vga::HEIGHT; ++i) {
+        util::format(line, sizeof(line), FORMAT("line {}\n"), i);
+        terminal.write(line);
+    }
+    CHECK(getStartRow() == 1);
+    CHECK(isRow(1, "line 1"));
+    CHECK(isRow(vga::HEIGHT - 1, "line 24"));
+    CHECK(isRow(vga::HEIGHT, ""));
+    CHECK(getCursorIndex() == vga::HEIGHT * vga::WIDTH);
+
+    // Go past the end of the text memory
+    const uint32_t lineCount = vga::MEMORY_HEIGHT + 100;
+    for (uint32_t i = vga::HEIGHT; i < lineCount; ++i) {
+        util::format(line, sizeof(line), FORMAT("line {}\n"), i);
+        terminal.write(line);
+    }
+    const size_t startRow = getStartRow();
+    CHECK(startRow + vga::HEIGHT <= vga::MEMORY_HEIGHT);
+    CHECK(startRow < lineCount - vga::HEIGHT);
+    for (uint32_t i = 0; i < vga::HEIGHT - 1; ++i) {
+        util::format(line, sizeof(line), FORMAT("line {}"),
+                     lineCount - (vga::HEIGHT - 1) + i);
+        CHECK(isRow(startRow + i, line));
+    }
+    CHECK(isRow(startRow + vga::HEIGHT - 1, ""));
+    CHECK(getCursorIndex() == (startRow + vga::HEIGHT - 1) * vga::WIDTH);
+}
+
+/**
+ * \brief Receive scancodes, like IRQ1 would
+ *
+ * \param scancodes The scancodes
+ * \param count The number of scancodes
+ */
+static void sendScancodes(const uint8_t* scancodes, size_t count)
+{
+    InterruptFrame frame = {};
+    for (size_t i = 0; i < count; ++i) {
+        host::setPortValue(KEYBOARD_DATA_PORT, scancodes[i]);
+        Keyboard::handleInterrupt(frame, &Keyboard::getInstance());
+    }
+}
+
+/**
+ * \brief Decode every scancode received
+ *
+ * \param entries Where to copy the entries
+ * \param size The largest number of entries
+ * \return The number of entries
+ */
+static size_t readEntries(KeyboardEntry* entries, size_t size)
+{
+    size_t count = 0;
+    KeyboardEntry entry;
+    while (Keyboard::getInstance().readEntry(entry)) {
+        if (count < size) {
+            entries[count] = entry;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * \brief Receive scancodes and keep the characters of the keys pressed
+ *
+ * \param scancodes The scancodes
+ * \param count The number of scancodes
+ * \param text Where to write the characters (null-terminated)
+ * \param size The size of `text`
+ */
+static void typeKeys(const uint8_t* scancodes, size_t count, char* text,
+                     size_t size)
+{
+    sendScancodes(scancodes, count);
+
+    size_t length = 0;
+    KeyboardEntry entry;
+    while (Keyboard::getInstance().readEntry(entry)) {
+        if (entry.isPressed() && entry.getCharacter() != 0 &&
+            length + 1 < size) {
+            text[length++] = entry.getCharacter();
+        }
+    }
+    text[length] = '\0';
+}
+
+/**
+ * \brief Check the shift keys
+ */
+static void testKeyboardShift()
+{
+    // Left shift, A, A released, left shift released, A, A released
+    const uint8_t scancodes[] = {0x2A, 0x1E, 0x9E, 0xAA, 0x1E, 0x9E};
+    KeyboardEntry entries[8];
+
+    sendScancodes(scancodes, sizeof(scancodes));
+    CHECK(readEntries(entries, 8) == 6);
+    CHECK(entries[0].getKey() == 0x2A && entries[0].isPressed());
+    CHECK(entries[0].isLeftShiftPressed());
+    CHECK(entries[1].getCharacter() == 'A' && entries[1].isPressed());
+    CHECK(entries[2].getCharacter() == 'A' && !entries[2].isPressed());
+    CHECK(entries[3].getKey() == 0x2A && !entries[3].isLeftShiftPressed());
+    CHECK(entries[4].getCharacter() == 'a' && !entries[4].isLeftShiftPressed());
+    CHECK(!entries[5].isPressed());
+}
+
+/**
+ * \brief Check that caps lock only changes the letters
+ */
+static void testKeyboardCapsLock()
+{
+    // Caps lock, A, 1, shift + A, caps lock, A
+    const uint8_t scancodes[] = {0x3A, 0xBA, 0x1E, 0x9E, 0x02, 0x82, 0x2A,
+                                 0x1E, 0x9E, 0xAA, 0x3A, 0xBA, 0x1E, 0x9E};
+    char text[16];
+
+    typeKeys(scancodes, sizeof(scancodes), text, sizeof(text));
+    CHECK(strcmp(text, "A1aa") == 0);
+
+    // The first entries after caps lock see it on
+    const uint8_t capsLock[] = {0x3A, 0xBA, 0x1E, 0x9E, 0x3A, 0xBA};
+    KeyboardEntry entries[8];
+    sendScancodes(capsLock, sizeof(capsLock));
+    CHECK(readEntries(entries, 8) == 6);
+    CHECK(entries[0].isCapsLockOn() && entries[2].isCapsLockOn());
+    CHECK(!entries[4].isCapsLockOn());
+}
+
+/**
+ * \brief Check the extended keys (0xE0 prefix) and the fake shifts
+ */
+static void testKeyboardExtended()
+{
+    KeyboardEntry entries[8];
+
+    // A prefix alone is not an entry, the key completes it later
+    const uint8_t prefix[] = {0xE0};
+    const uint8_t keypadEnter[] = {0x1C, 0xE0, 0x9C};
+    sendScancodes(prefix, sizeof(prefix));
+    CHECK(readEntries(entries, 8) == 0);
+    sendScancodes(keypadEnter, sizeof(keypadEnter));
+    CHECK(readEntries(entries, 8) == 2);
+    CHECK(entries[0].getKey() == (0x1C | KeyboardEntry::EXTENDED_KEY));
+    CHECK(entries[0].getCharacter() == '\n' && entries[0].isPressed());
+    CHECK(!entries[1].isPressed());
+
+    // Delete between fake shifts, then right ctrl + C
+    const uint8_t scancodes[] = {0xE0, 0x2A, 0xE0, 0x53, 0xE0, 0xD3,
+                                 0xE0, 0xAA, 0xE0, 0x1D, 0x2E, 0xAE,
+                                 0xE0, 0x9D};
+    sendScancodes(scancodes, sizeof(scancodes));
+    CHECK(readEntries(entries, 8) == 6);
+    CHECK(entries[0].getKey() == (0x53 | KeyboardEntry::EXTENDED_KEY));
+    CHECK(entries[0].getCharacter() == 127);
+    CHECK(!entries[0].isLeftShiftPressed());
+    CHECK(entries[2].getKey() == (0x1D | KeyboardEntry::EXTENDED_KEY));
+    CHECK(entries[3].getCharacter() == 'c' && entries[3].isCtrlPressed());
+    CHECK(!entries[4].isPressed() && entries[4].isCtrlPressed());
+    CHECK(!entries[5].isPressed() && !entries[5].isCtrlPressed());
+}
+
+/**
+ * \brief Check that the pause sequence makes no entry
+ */
+static void testKeyboardPause()
+{
+    const uint8_t scancodes[] = {0xE1, 0x1D, 0x45, 0xE1, 0x9D, 0xC5,
+                                 0x1E, 0x9E};
+    KeyboardEntry entries[8];
+
+    sendScancodes(scancodes, sizeof(scancodes));
+    CHECK(readEntries(entries, 8) == 2);
+    CHECK(entries[0].getCharacter() == 'a' && entries[0].isPressed());
+    CHECK(!entries[0].isCtrlPressed());
+}
+
+/**
+ * \brief Check AltGr and the change of layout
+ */
+static void testKeyboardLayouts()
+{
+    Keyboard& keyboard = Keyboard::getInstance();
+    char text[16];
+
+    const uint8_t yKey[] = {0x15, 0x95};
+    typeKeys(yKey, sizeof(yKey), text, sizeof(text));
+    CHECK(strcmp(text, "y") == 0);
+
+    keyboard.setLayout(GERMAN_LAYOUT);
+    CHECK(strcmp(keyboard.getLayout().name, "de") == 0);
+    typeKeys(yKey, sizeof(yKey), text, sizeof(text));
+    CHECK(strcmp(text, "z") == 0);
+
+    // AltGr + Q, AltGr + A (no AltGr character), Q
+    const uint8_t altGr[] = {0xE0, 0x38, 0x10, 0x90, 0x1E, 0x9E,
+                             0xE0, 0xB8, 0x10, 0x90};
+    typeKeys(altGr, sizeof(altGr), text, sizeof(text));
+    CHECK(strcmp(text, "@aq") == 0);
+
+    // Caps lock changes the umlauts but not the sharp s
+    const uint8_t capsLock[] = {0x3A, 0xBA, 0x1A, 0x9A, 0x0C, 0x8C,
+                                0x3A, 0xBA};
+    typeKeys(capsLock, sizeof(capsLock), text, sizeof(text));
+    CHECK(strcmp(text, "\x9A\xE1") == 0);
+
+    keyboard.setLayout(US_LAYOUT);
+    typeKeys(yKey, sizeof(yKey), text, sizeof(text));
+    CHECK(strcmp(text, "y") == 0);
+}
+
+/**
+ * \brief Check that the scancodes over the capacity are dropped and counted
+ */
+static void testKeyboardOverflow()
+{
+    Keyboard& keyboard = Keyboard::getInstance();
+    const uint32_t dropped = keyboard.getDroppedScancodes();
+    uint8_t scancodes[300];
+    for (size_t i = 0; i < sizeof(scancodes); ++i) {
+        scancodes[i] = i % 2 == 0 ? 0x1E : 0x9E;
+    }
+
+    sendScancodes(scancodes, sizeof(scancodes));
+    CHECK(keyboard.getDroppedScancodes() == dropped + 300 - 256);
+    CHECK(readEntries(nullptr, 0) == 256);
+    CHECK(keyboard.isEmpty());
+}
+
+/**
+ * \brief Check the field widths, the alignments and the truncation of
+ * `util::format`
+ */
+static void testFormat()
+{
+    char text[32];
+
+    CHECK(util::format(text, sizeof(text), FORMAT("[{:5}]"), 42) == 7);
+    CHECK(strcmp(text, "[   42]") == 0);
+    util::format(text, sizeof(text), FORMAT("[{:-5}]"), 42);
+    CHECK(strcmp(text, "[42   ]") == 0);
+    util::format(text, sizeof(text), FORMAT("[{:05}]"), -42);
+    CHECK(strcmp(text, "[-0042]") == 0);
+    util::format(text, sizeof(text), FORMAT("{:#06x} {:X}"), 255u, 0xABCu);
+    CHECK(strcmp(text, "0x00ff ABC") == 0);
+    util::format(text, sizeof(text), FORMAT("[{:6}|{:-4}|{}]"), "abc", "ab",
+                 true);
+    CHECK(strcmp(text, "[   abc|ab  |true]") == 0);
+    util::format(text, sizeof(text), FORMAT("{} {{}}"),
+                 18446744073709551615ull);
+    CHECK(strcmp(text, "18446744073709551615 {}") == 0);
+    util::format(text, sizeof(text), FORMAT("{:c}{:2}"), 'x', 'y');
+    CHECK(strcmp(text, "x y") == 0);
+
+    // The text is cut to the buffer and stays null-terminated
+    char small[8];
+    CHECK(util::format(small, sizeof(small), FORMAT("{} frames"), 12345) == 7);
+    CHECK(strcmp(small, "12345 f") == 0);
+    CHECK(util::format(small, 4, FORMAT("{:10}"), 1) == 3);
+    CHECK(strcmp(small, "   ") == 0);
+    CHECK(util::format(small, 1, FORMAT("{}"), 1) == 0 && small[0] == '\0');
+}
+
+/**
+ * \brief Check a full `util::RingBuffer`, its overflow counter, its
+ * high-water mark and the wrap of its indexes
+ */
+static void testRingBuffer()
+{
+    util::RingBuffer<uint32_t, 8> buffer;
+    const uint32_t values[] = {0, 1, 2, 3, 4, 5, 6, 7};
+    uint32_t output[8];
+    uint32_t value = 0;
+
+    CHECK(buffer.isEmpty() && !buffer.pop(value));
+    for (uint32_t i = 0; i < 8; ++i) {
+        CHECK(buffer.push(i));
+    }
+    CHECK(!buffer.push(8));
+    CHECK(buffer.getSize() == 8);
+    CHECK(buffer.getOverflowCount() == 1);
+    CHECK(buffer.pushN(values, 3) == 0);
+    CHECK(buffer.getOverflowCount() == 4);
+    CHECK(buffer.getHighWater() == 8);
+
+    CHECK(buffer.popN(output, 8) == 8);
+    CHECK(memcmp(output, values, sizeof(values)) == 0);
+    CHECK(buffer.isEmpty());
+
+    // The indexes wrap in the middle of the batches
+    CHECK(buffer.pushN(values, 6) == 6);
+    CHECK(buffer.popN(output, 4) == 4);
+    CHECK(buffer.pushN(values, 8) == 6);
+    CHECK(buffer.getOverflowCount() == 6);
+    CHECK(buffer.popN(output, 8) == 8);
+    const uint32_t expected[] = {4, 5, 0, 1, 2, 3, 4, 5};
+    CHECK(memcmp(output, expected, sizeof(expected)) == 0);
+    CHECK(buffer.getHighWater() == 8);
+}
+
+/**
+ * \brief Check a full `util::MpscRingBuffer`, its overflow counter and its
+ * high-water mark
+ */
+static void testMpscRingBuffer()
+{
+    util::MpscRingBuffer<uint32_t, 4> buffer;
+    const uint32_t values[] = {10, 11, 12};
+    uint32_t value = 0;
+
+    CHECK(buffer.isEmpty() && !buffer.pop(value));
+    CHECK(buffer.push(1) && buffer.push(2));
+    CHECK(buffer.getHighWater() == 2);
+    CHECK(buffer.pushN(values, 3) == 2);
+    CHECK(buffer.getOverflowCount() == 1);
+    CHECK(!buffer.push(13));
+    CHECK(buffer.getOverflowCount() == 2);
+    CHECK(buffer.getHighWater() == 4);
+
+    uint32_t output[4];
+    CHECK(buffer.popN(output, 4) == 4);
+    CHECK(output[0] == 1 && output[1] == 2 && output[2] == 10 &&
+          output[3] == 11);
+    CHECK(buffer.isEmpty());
+
+    // The slots are reused once read
+    CHECK(buffer.push(20) && buffer.pop(value) && value == 20);
+    CHECK(buffer.getHighWater() == 4);
+}
+
+/**
+ * \brief Read every line of a `LogMemoryRing`
+ *
+ * \param ring The ring
+ * \param text Where to copy the lines (null-terminated)
+ * \param size The size of `text`
+ * \return `text`
+ */
+static const char* readLog(const LogMemoryRing& ring, char* text, size_t size)
+{
+    text[ring.read(text, size - 1)] = '\0';
+    return text;
+}
+
+/**
+ * \brief Check the level filtering, the rate limit and the report of the
+ * records dropped of `KernelLogger`
+ *
+ * The sinks cannot be removed, so each check adds its own sink.
+ */
+static void testKernelLogger()
+{
+    static LogMemoryRing levelRing;
+    static LogMemoryRing rateRing;
+    static LogMemoryRing overrunRing;
+    static char text[LogMemoryRing::CAPACITY + 1];
+    KernelLogger& logger = KernelLogger::getInstance();
+
+    // Level filtering
+    CHECK(logger.addSink(LogMemoryRing::writeLog, &levelRing, LogLevel::INFO));
+    klog(LogLevel::DEBUG, "Hidden {}", 1);
+    klog(LogLevel::INFO, "Shown {}", 2);
+    CHECK(strcmp(readLog(levelRing, text, sizeof(text)),
+                 "[KERNEL] Shown 2\n") == 0);
+    logger.setSinkLevel(0, LogLevel::WARNING);
+    klog(LogLevel::INFO, "Hidden {}", 3);
+    klog(LogLevel::WARNING, "Warning {}", 4);
+    CHECK(strcmp(readLog(levelRing, text, sizeof(text)),
+                 "[KERNEL] Shown 2\n[KERNEL] Warning 4\n") == 0);
+    logger.setSinkLevel(0, LogLevel::ERROR);
+
+    // Two lines per second: the others are reported in the next second
+    CHECK(logger.addSink(LogMemoryRing::writeLog, &rateRing, LogLevel::DEBUG,
+                         2));
+    host::setTicks(1000);
+    for (uint32_t i = 0; i < 5; ++i) {
+        klog(LogLevel::INFO, "Line {}", i);
+    }
+    CHECK(strcmp(readLog(rateRing, text, sizeof(text)),
+                 "[KERNEL] Line 0\n[KERNEL] Line 1\n") == 0);
+    CHECK(logger.getSinkDroppedLines(1) == 3);
+    host::setTicks(2000);
+    klog(LogLevel::INFO, "Line {}", 5);
+    CHECK(strcmp(readLog(rateRing, text, sizeof(text)),
+                 "[KERNEL] Line 0\n[KERNEL] Line 1\n"
+                 "[KERNEL] Lines dropped by the rate limit: 3\n"
+                 "[KERNEL] Line 5\n") == 0);
+
+    // The records that do not fit in the ring are reported by the drain
+    CHECK(logger.addSink(LogMemoryRing::writeLog, &overrunRing,
+                         LogLevel::DEBUG));
+    const uint32_t overruns = logger.getOverrunCount();
+    logger.setDeferredDrain(true);
+    for (uint32_t i = 0; i < KernelLogger::RING_CAPACITY + 2; ++i) {
+        klog(LogLevel::INFO, "Record {}", i);
+    }
+    CHECK(logger.getOverrunCount() == overruns + 2);
+    CHECK(logger.getDrainEvent().isSet());
+    logger.drain();
+    logger.setDeferredDrain(false);
+
+    readLog(overrunRing, text, sizeof(text));
+    CHECK(strncmp(text, "[KERNEL] Record 0\n", 18) == 0);
+    const char end[] = "[KERNEL] Record 127\n[KERNEL] Log records dropped: 2\n";
+    const size_t length = strlen(text);
+    CHECK(length > sizeof(end) &&
+          strcmp(text + length - (sizeof(end) - 1), end) == 0);
+}
+
+/**
+ * \brief Test the portable subsystems of the kernel on the host
+ *
+ * \return 0 if every check passed, 1 otherwise
+ */
+int main()
+{
+    testTerminalWrap();
+    testTerminalScroll();
+    testKeyboardShift();
+    testKeyboardCapsLock();
+    testKeyboardExtended();
+    testKeyboardPause();
+    testKeyboardLayouts();
+    testKeyboardOverflow();
+    testFormat();
+    testRingBuffer();
+    testMpscRingBuffer();
+    testKernelLogger();
+
+    printf("%u checks, %u failed\n", checkCount, failureCount);
+    return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+#include "../src/vga/vga.hpp"
+
+namespace vga
+{
+    /// The mock text memory
+    static uint16_t textMemory[MEMORY_HEIGHT * WIDTH];
+
+    /**
+     * \brief Get the text memory (`MEMORY_HEIGHT` rows of `WIDTH` characters)
+     *
+     * \return An array of the host
+     */
+    uint16_t* getTextMemory()
+    {
+        return textMemory;
+    }
+}
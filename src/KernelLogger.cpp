@@ -1,35 +1,393 @@
 #include "KernelLogger.hpp"
+#include "cpu/cpu.hpp"
+#include "sched/Scheduler.hpp"
+#include "smp/Cpu.hpp"
+#include "timer/Timer.hpp"
+
+/// The largest line written to the outputs (longer messages are cut)
+const size_t LINE_SIZE = 160;
+/// The number of words of `LogRecord::arguments` taken by a 64-bit value
+const size_t WORDS_PER_64_BIT_VALUE = sizeof(uint64_t) / sizeof(uintptr_t);
+
+/// The `KernelLogger` singleton instance
+KernelLogger KernelLogger::instance_;
+
+/**
+ * \brief Initialize the logger without sinks
+ *
+ * The records are kept in the rings until the first sink is added.
+ */
+KernelLogger::KernelLogger()
+    : pending_(), hasPending_(), reportedOverruns_(0),
+      isDrainDeferred_(false), sinks_(), sinkCount_(0)
+{
+}
+
+/**
+ * \brief Get the instance of the singleton object `KernelLogger`
+ *
+ * \return the instance of the single object of the class `KernelLogger`
+ */
+KernelLogger& KernelLogger::getInstance()
+{
+    return instance_;
+}
+
+/**
+ * \brief Add an output to the logger
+ *
+ * \param function The function writing a line to the output
+ * \param context The value given to `function` (the output object)
+ * \param minimumLevel The records of a lower level are not written to the
+ * sink
+ * \param maxLinesPerSecond The largest number of lines written to the sink
+ * per second, 0 for no limit (the limit only applies once the scheduler
+ * ticks)
+ * \return false if there are already `MAX_SINKS` sinks
+ */
+bool KernelLogger::addSink(LogSinkFunction function, void* context,
+                           LogLevel minimumLevel, uint32_t maxLinesPerSecond)
+{
+    if (sinkCount_ == MAX_SINKS) {
+        return false;
+    }
+
+    Sink& sink = sinks_[sinkCount_];
+    sink.function = function;
+    sink.context = context;
+    sink.minimumLevel = minimumLevel;
+    sink.maxLinesPerSecond = maxLinesPerSecond;
+    sink.windowStart = 0;
+    sink.windowLines = 0;
+    sink.windowDroppedLines = 0;
+    sink.droppedLines = 0;
+    // Release: the sink is complete before `drain` can see it
+    __atomic_store_n(&sinkCount_, sinkCount_ + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * \brief Change the minimum level of the records written to a sink
+ *
+ * \param index The index of the sink (in the order they were added)
+ * \param minimumLevel The records of a lower level are not written to the
+ * sink
+ */
+void KernelLogger::setSinkLevel(size_t index, LogLevel minimumLevel)
+{
+    sinks_[index].minimumLevel = minimumLevel;
+}
+
+/**
+ * \brief Get the number of lines a sink dropped because of its rate limit
+ *
+ * \param index The index of the sink (in the order they were added)
+ * \return The number of lines dropped since the sink was added
+ */
+uint32_t KernelLogger::getSinkDroppedLines(size_t index) const
+{
+    return sinks_[index].droppedLines;
+}
+
+/**
+ * \brief Store a record with a format string already checked
+ *
+ * This can be called by interrupt handlers. The record is dropped (and
+ * counted) if the ring of the processor is full. The `log` template and
+ * `klog` check the format string and call this.
+ *
+ * \param level The importance of the record
+ * \param format A format string of `util::format` that stays valid until it
+ * is drained, which must pass `util::checkFormat` with the arguments
+ * \param arguments The values of the fields (the strings must stay valid
+ * until the record is drained)
+ * \param count The number of values (the values that do not fit in
+ * `LOG_ARGUMENT_COUNT` words are ignored)
+ */
+void KernelLogger::log(LogLevel level, const char* format,
+                       const util::FormatArgument* arguments, size_t count)
+{
+    LogRecord record;
+    fillRecord(record, level, format, arguments, count);
+
+    rings_[record.cpuIndex].push(record);
+
+    if (!isDrainDeferred_) {
+        drain();
+    }
+    else {
+        drainEvent_.signal();
+    }
+}
+
+/**
+ * \brief Write the stored records to the sinks
+ *
+ * The oldest record of every ring is taken out, then the one with the
+ * smallest timestamp is written, until all the rings are empty. If another
+ * processor (or the code this one interrupted) is draining, this returns at
+ * once: that drain writes the new records too. Nothing is drained before
+ * the first sink is added.
+ */
+void KernelLogger::drain()
+{
+    if (__atomic_load_n(&sinkCount_, __ATOMIC_ACQUIRE) == 0 ||
+        !drainLock_.tryLock()) {
+        return;
+    }
+
+    while (true) {
+        size_t oldest = acpi::MAX_CPUS;
+        for (size_t i = 0; i < acpi::MAX_CPUS; ++i) {
+            if (!hasPending_[i]) {
+                hasPending_[i] = rings_[i].pop(pending_[i]);
+            }
+            if (hasPending_[i] &&
+                (oldest == acpi::MAX_CPUS ||
+                 pending_[i].timestamp < pending_[oldest].timestamp)) {
+                oldest = i;
+            }
+        }
+
+        if (oldest == acpi::MAX_CPUS) {
+            break;
+        }
+
+        write(pending_[oldest]);
+        hasPending_[oldest] = false;
+    }
+
+    const uint32_t overruns = getOverrunCount();
+    if (overruns != reportedOverruns_) {
+        const util::FormatArgument dropped =
+            util::makeFormatArgument(overruns - reportedOverruns_);
+        LogRecord record;
+        fillRecord(record, LogLevel::WARNING, "Log records dropped: {}",
+                   &dropped, 1);
+        write(record);
+        reportedOverruns_ = overruns;
+    }
+
+    drainLock_.unlock();
+}
 
 /**
- * \brief Configure the kernel logger with a terminal and a serial port
+ * \brief Choose between draining in `log` and waiting for `drain`
  *
- * \param terminal The terminal used for output
- * \param serialPort The serial port used for output
+ * \param isDeferred true to only store the records in `log`
  */
-KernelLogger::KernelLogger(Terminal* terminal, SerialPort* serialPort)
-    : terminal_(terminal),
-      serialPort_(serialPort)
+void KernelLogger::setDeferredDrain(bool isDeferred)
 {
+    isDrainDeferred_ = isDeferred;
 }
 
 /**
- * \brief Print text on devices specified
+ * \brief Get the event signaled when records wait for `drain`
  *
- * The text will be outputted on the devices, prefixed with "[KERNEL]".
+ * Once the drain is deferred, every `log` signals the event.
  *
- * \param data A pointer to a null-terminated string. It should not end with
- * '\n'.
+ * \return The drain event of the logger
  */
-void KernelLogger::log(const char* data)
+sync::Event& KernelLogger::getDrainEvent()
 {
-    const char* prefix = "[KERNEL] ";
-    const char* endLine = "\n";
+    return drainEvent_;
+}
+
+/**
+ * \brief Get the number of records dropped because a ring was full
+ *
+ * \return The number of records dropped by every processor since the boot
+ */
+uint32_t KernelLogger::getOverrunCount() const
+{
+    uint32_t overruns = 0;
+    for (size_t i = 0; i < acpi::MAX_CPUS; ++i) {
+        overruns += rings_[i].getOverflowCount();
+    }
+
+    return overruns;
+}
 
-    terminal_->write(prefix);
-    terminal_->write(data);
-    terminal_->write(endLine);
+/**
+ * \brief Fill a record for the current processor
+ *
+ * \param record The record
+ * \param level The importance of the record
+ * \param format The format string
+ * \param arguments The values of the fields
+ * \param count The number of values (the values that do not fit in
+ * `LOG_ARGUMENT_COUNT` words are ignored)
+ */
+void KernelLogger::fillRecord(LogRecord& record, LogLevel level,
+                              const char* format,
+                              const util::FormatArgument* arguments,
+                              size_t count)
+{
+    record.timestamp = cpu::readTsc();
+    record.message = format;
+    record.level = (uint8_t) level;
+    record.cpuIndex = smp::getCurrentCpu()->index;
+    record.argumentTypes = 0;
+
+    size_t words = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const util::FormatArgument& argument = arguments[i];
+        switch (argument.type) {
+            case util::FormatType::SIGNED_64:
+            case util::FormatType::UNSIGNED_64:
+                if (words + WORDS_PER_64_BIT_VALUE > LOG_ARGUMENT_COUNT) {
+                    return;
+                }
+                for (size_t j = 0; j < WORDS_PER_64_BIT_VALUE; ++j) {
+                    record.arguments[words++] = argument.value64 >> (32 * j);
+                }
+                break;
+            case util::FormatType::STRING:
+            case util::FormatType::POINTER:
+                if (words == LOG_ARGUMENT_COUNT) {
+                    return;
+                }
+                record.arguments[words++] = (uintptr_t) argument.pointer;
+                break;
+            default:
+                if (words == LOG_ARGUMENT_COUNT) {
+                    return;
+                }
+                record.arguments[words++] = argument.value;
+                break;
+        }
+        record.argumentTypes |= (uint16_t) argument.type << (4 * i);
+    }
+}
+
+/**
+ * \brief Write the line of a record to the sinks
+ *
+ * The line is only built if a sink takes the level of the record.
+ *
+ * \param record The record
+ */
+void KernelLogger::write(const LogRecord& record)
+{
+    char line[LINE_SIZE];
+    size_t length = 0;
 
-    serialPort_->write(prefix);
-    serialPort_->write(data);
-    serialPort_->write(endLine);
-}
\ No newline at end of file
+    const size_t sinkCount = __atomic_load_n(&sinkCount_, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < sinkCount; ++i) {
+        Sink& sink = sinks_[i];
+        if (record.level < (uint8_t) sink.minimumLevel ||
+            !isUnderRateLimit(sink)) {
+            continue;
+        }
+
+        if (length == 0) {
+            length = formatLine(record, line);
+        }
+        sink.function(line, length, sink.context);
+    }
+}
+
+/**
+ * \brief Build the line of a record
+ *
+ * The line is the message, formatted with the values of the record, prefixed
+ * with "[KERNEL] ".
+ *
+ * \param record The record
+ * \param line Where to build the null-terminated line (`LINE_SIZE`
+ * characters)
+ * \return The number of characters of the line
+ */
+size_t KernelLogger::formatLine(const LogRecord& record, char* line)
+{
+    util::FormatArgument arguments[LOG_ARGUMENT_COUNT];
+    size_t count = 0;
+    size_t words = 0;
+    for (; count < LOG_ARGUMENT_COUNT; ++count) {
+        util::FormatArgument& argument = arguments[count];
+        argument.type =
+            (util::FormatType) ((record.argumentTypes >> (4 * count)) & 0xF);
+        if (argument.type == util::FormatType::NONE) {
+            break;
+        }
+
+        switch (argument.type) {
+            case util::FormatType::SIGNED_64:
+            case util::FormatType::UNSIGNED_64:
+                argument.value64 = 0;
+                for (size_t j = 0; j < WORDS_PER_64_BIT_VALUE; ++j) {
+                    argument.value64 |=
+                        (uint64_t) record.arguments[words++] << (32 * j);
+                }
+                break;
+            case util::FormatType::STRING:
+                argument.string = (const char*) record.arguments[words++];
+                break;
+            case util::FormatType::POINTER:
+                argument.pointer = (const void*) record.arguments[words++];
+                break;
+            default:
+                argument.value = record.arguments[words++];
+                break;
+        }
+    }
+
+    const char prefix[] = "[KERNEL] ";
+    size_t length = sizeof(prefix) - 1;
+    for (size_t i = 0; i < length; ++i) {
+        line[i] = prefix[i];
+    }
+
+    // Keep room for the end of the line
+    length += util::formatArguments(&line[length], LINE_SIZE - length - 1,
+                                    record.message, arguments, count);
+    line[length++] = '\n';
+    line[length] = '\0';
+
+    return length;
+}
+
+/**
+ * \brief Check the rate limit of a sink before a line is written
+ *
+ * The seconds are counted in ticks of the bootstrap processor. When a new
+ * second starts, the number of lines dropped in the previous one is written
+ * to the sink first.
+ *
+ * \param sink The sink
+ * \return false if the line must be dropped
+ */
+bool KernelLogger::isUnderRateLimit(Sink& sink)
+{
+    sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+    if (sink.maxLinesPerSecond == 0 || !scheduler.isInitialized()) {
+        return true;
+    }
+
+    const uint64_t ticks = timer::getTicks(0);
+    if (ticks - sink.windowStart >= timer::TICK_FREQUENCY) {
+        if (sink.windowDroppedLines > 0) {
+            const util::FormatArgument dropped =
+                util::makeFormatArgument(sink.windowDroppedLines);
+            LogRecord record;
+            fillRecord(record, LogLevel::WARNING,
+                       "Lines dropped by the rate limit: {}", &dropped, 1);
+            char line[LINE_SIZE];
+            sink.function(line, formatLine(record, line), sink.context);
+        }
+
+        sink.windowStart = ticks;
+        sink.windowLines = 0;
+        sink.windowDroppedLines = 0;
+    }
+
+    if (sink.windowLines == sink.maxLinesPerSecond) {
+        ++sink.windowDroppedLines;
+        ++sink.droppedLines;
+        return false;
+    }
+
+    ++sink.windowLines;
+    return true;
+}
@@ -1,26 +1,232 @@
 #pragma once
 
-#include "Terminal.hpp"
-#include "SerialPort.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LogSinks.hpp"
+#include "acpi/Acpi.hpp"
+#include "sync/Event.hpp"
+#include "sync/Spinlock.hpp"
+#include "util/RingBuffer.hpp"
+#include "util/format.hpp"
+
+/**
+ * \brief Log a message with a format string checked at compile time
+ *
+ * Example:
+ * \code
+ * klog(LogLevel::INFO, "Free frames: {} of {}", free, total);
+ * \endcode
+ */
+#define klog(level, string, ...)                                            \
+    KernelLogger::getInstance().log(level, FORMAT(string), ##__VA_ARGS__)
+
+/// The importance of a log record
+enum class LogLevel : uint8_t
+{
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR
+};
+
+/// The largest number of values of a log record, and of words to store them
+/// (a 64-bit value takes two words on i686)
+const size_t LOG_ARGUMENT_COUNT = 4;
+
+/**
+ * \brief Count the words of `LogRecord::arguments` taken by values
+ *
+ * \param types The type of each value
+ * \param count The number of values
+ * \return The number of words
+ */
+constexpr size_t countLogWords(const util::FormatType* types, size_t count)
+{
+    size_t words = 0;
+    for (size_t i = 0; i < count; ++i) {
+        words += types[i] == util::FormatType::SIGNED_64 ||
+                         types[i] == util::FormatType::UNSIGNED_64
+                     ? sizeof(uint64_t) / sizeof(uintptr_t)
+                     : 1;
+    }
+
+    return words;
+}
+
+/**
+ * \brief A log call, as stored in the log ring of a processor
+ *
+ * The message is not copied: the record keeps the address of its format
+ * string, which identifies the message, and the raw values. The text is only
+ * built when the record is drained, so the strings given as values must
+ * outlive the record too.
+ */
+struct LogRecord
+{
+    /// The time stamp counter when `log` was called
+    uint64_t timestamp;
+    /// The format string of the message (usually a literal)
+    const char* message;
+    /// The `LogLevel`
+    uint8_t level;
+    /// The index of the processor that called `log`
+    uint8_t cpuIndex;
+    /// The `util::FormatType` of each value, 4 bits per value from the lowest
+    /// bits, `util::FormatType::NONE` after the last one
+    uint16_t argumentTypes;
+    /// The values of the fields of the message, a word each (two for a
+    /// 64-bit value on i686, the low word first)
+    uintptr_t arguments[LOG_ARGUMENT_COUNT];
+};
 
 /**
  * \brief Log kernel actions
  *
  * This object is used when the kernel wants to log information. This
- * information can be sent to the terminal and over the serial port.
+ * information is sent to the sinks added with `addSink` (the terminal, a
+ * serial port, the debug console, a `LogMemoryRing`...). Each sink only gets
+ * the records of its minimum level and above, and can be limited to a number
+ * of lines per second: the lines over the limit are dropped, and counted in
+ * a line written to the sink when the next second starts.
+ *
+ * The messages are format strings of `util::format`, usually given with the
+ * `klog` macro so the values are checked against them at compile time.
+ *
+ * `log` only stores a `LogRecord` in the ring of the calling processor (a
+ * lock-free `util::MpscRingBuffer`, so threads and interrupt handlers of the
+ * processor can log at the same time), which costs tens of cycles. `drain`
+ * later builds the lines of the records, oldest first across the processors,
+ * and writes them to the sinks. When a ring is full, the new records are
+ * dropped and counted: the next `drain` reports them.
+ *
+ * During the boot, `log` drains the rings itself, so every line is written
+ * before `log` returns. Once `setDeferredDrain(true)` is called, the records
+ * wait for a `drain` from the main loop, which waits for `getDrainEvent`.
  */
 class KernelLogger
 {
 public:
-    /// Configure the kernel logger with a terminal and a serial port
-    KernelLogger(Terminal* terminal, SerialPort* serialPort);
+    /// The number of records the ring of a processor can hold
+    static const uint32_t RING_CAPACITY = 128;
+    /// The largest number of sinks
+    static const size_t MAX_SINKS = 8;
+
+    /// Get the instance of the singleton object `KernelLogger`
+    static KernelLogger& getInstance();
+
+    /// Add an output to the logger
+    bool addSink(LogSinkFunction function, void* context,
+                 LogLevel minimumLevel, uint32_t maxLinesPerSecond = 0);
+    /// Change the minimum level of the records written to a sink
+    void setSinkLevel(size_t index, LogLevel minimumLevel);
+    /// Get the number of lines a sink dropped because of its rate limit
+    uint32_t getSinkDroppedLines(size_t index) const;
+
+    /**
+     * \brief Store a record with a format string checked at compile time
+     *
+     * \param level The importance of the record
+     * \param format The format string, wrapped in `FORMAT` (see `klog`)
+     * \param arguments The values of the fields, which must fit in
+     * `LOG_ARGUMENT_COUNT` words
+     */
+    template <typename Format, typename... Args>
+    void log(LogLevel level, Format format, const Args&... arguments)
+    {
+        (void) format;
+        static_assert(util::assertFormat<Format, Args...>(),
+                      "Invalid format string");
+        constexpr util::FormatType types[] = {
+            util::getFormatType(static_cast<const Args*>(nullptr))...,
+            util::FormatType::NONE
+        };
+        static_assert(countLogWords(types, sizeof...(Args)) <=
+                      LOG_ARGUMENT_COUNT,
+                      "Too many values for a log record");
 
-    /// Print text on devices specified
-    void log(const char* data);
+        const util::FormatArgument values[] = {
+            util::makeFormatArgument(arguments)..., util::FormatArgument()
+        };
+        log(level, Format::get(), values, sizeof...(Args));
+    }
+    /// Store a record with a format string already checked
+    void log(LogLevel level, const char* format,
+             const util::FormatArgument* arguments, size_t count);
+
+    /// Write the stored records to the sinks
+    void drain();
+    /// Choose between draining in `log` and waiting for `drain`
+    void setDeferredDrain(bool isDeferred);
+    /// Get the event signaled when records wait for `drain`
+    sync::Event& getDrainEvent();
+    /// Get the number of records dropped because a ring was full
+    uint32_t getOverrunCount() const;
+
+    /// The copy constructor and copy assignment operator are deleted
+    /// since it is a singleton
+    KernelLogger(KernelLogger const&) = delete;
+    void operator=(KernelLogger const&) = delete;
 
 private:
-    /// The terminal used for output
-    Terminal* terminal_;
-    /// The serial port used for output
-    SerialPort* serialPort_;
-};
\ No newline at end of file
+    /// An output of the logger
+    struct Sink
+    {
+        /// The function writing a line
+        LogSinkFunction function;
+        /// The context given to `function`
+        void* context;
+        /// The records of a lower level are not written to the sink
+        LogLevel minimumLevel;
+        /// The largest number of lines per second (0 for no limit)
+        uint32_t maxLinesPerSecond;
+        /// The scheduler tick the current second started at
+        uint64_t windowStart;
+        /// The number of lines written in the current second
+        uint32_t windowLines;
+        /// The number of lines dropped in the current second
+        uint32_t windowDroppedLines;
+        /// The number of lines dropped since the sink was added
+        uint32_t droppedLines;
+    };
+
+    /// Initialize the logger without sinks
+    KernelLogger();
+
+    /// Fill a record for the current processor
+    static void fillRecord(LogRecord& record, LogLevel level,
+                           const char* format,
+                           const util::FormatArgument* arguments,
+                           size_t count);
+
+    /// Write the line of a record to the sinks
+    void write(const LogRecord& record);
+    /// Build the line of a record
+    static size_t formatLine(const LogRecord& record, char* line);
+    /// Check the rate limit of a sink before a line is written
+    bool isUnderRateLimit(Sink& sink);
+
+    /// The `KernelLogger` singleton instance
+    static KernelLogger instance_;
+
+    /// The records of each processor
+    util::MpscRingBuffer<LogRecord, RING_CAPACITY> rings_[acpi::MAX_CPUS];
+    /// The oldest record of each ring, taken out of the ring by `drain` to
+    /// compare the timestamps
+    LogRecord pending_[acpi::MAX_CPUS];
+    /// True if `pending_` holds a record of the processor
+    bool hasPending_[acpi::MAX_CPUS];
+    /// Only one processor drains at a time
+    sync::Spinlock drainLock_;
+    /// The number of dropped records already reported
+    uint32_t reportedOverruns_;
+    /// True once the records wait for `drain`
+    bool isDrainDeferred_;
+    /// Signaled by `log` when the drain is deferred
+    sync::Event drainEvent_;
+
+    /// The outputs
+    Sink sinks_[MAX_SINKS];
+    /// The number of sinks in `sinks_`
+    size_t sinkCount_;
+};
@@ -1,42 +1,58 @@
 #include "Keyboard.hpp"
+#include "io.hpp"
 
-/// The US keyboard mapping between scancode and ASCII representation
-const unsigned char KeyboardEntry::usMapping_[] = {
-    0,  27, '1', '2', '3', '4', '5', '6', '7', '8',
-    '9', '0', '-', '=', '\b', '\t', 'q', 'w', 'e', 'r',
-    't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n', 0,
-    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';',
-    '\'', '`',   0, '\\', 'z', 'x', 'c', 'v', 'b', 'n',
-    'm', ',', '.', '/',   0, '*', 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, '-', 0, 0, 0, '+', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-};
+/// The prefix of the extended scancodes
+const uint8_t EXTENDED_PREFIX = 0xE0;
+/// The prefix of the pause key sequence (E1 1D 45 E1 9D C5)
+const uint8_t PAUSE_PREFIX    = 0xE1;
+/// The bit set in the scancode when a key is released
+const uint8_t RELEASE_BIT     = 0x80;
+
+/// The scancode of the left shift key (and of the fake shift of the
+/// extended keys when it is prefixed with 0xE0)
+const uint8_t LEFT_SHIFT_SCANCODE  = 0x2A;
+/// The scancode of the right shift key (or fake shift when extended)
+const uint8_t RIGHT_SHIFT_SCANCODE = 0x36;
+/// The scancode of the left ctrl key (right ctrl when extended)
+const uint8_t CTRL_SCANCODE        = 0x1D;
+/// The scancode of the left alt key (AltGr when extended)
+const uint8_t ALT_SCANCODE         = 0x38;
+/// The scancode of the caps lock key
+const uint8_t CAPS_LOCK_SCANCODE   = 0x3A;
 
 /**
  * \brief Initialize the object
  *
- * \param scancode The scancode of the key that was used
+ * \param key The scancode of the key that was used, plus `EXTENDED_KEY` for
+ * an extended key
+ * \param character The character of the key in the current layout (0 if
+ * none)
  * \param isPressed true if the key was pressed
- * \param isLeftShiftPressed true if the left shift was pressed
- * \param isRightShiftPressed true if the right shift was pressed
- * \param isCtrlPressed true if the ctrl was pressed
- * \param isAltPressed true if the alt was pressed
+ * \param modifiers The modifiers pressed when the key was used
+ */
+KeyboardEntry::KeyboardEntry(uint8_t key, unsigned char character,
+                             bool isPressed, uint8_t modifiers)
+    : key_(key), character_(character), isPressed_(isPressed),
+      modifiers_(modifiers)
+{
+}
+
+/**
+ * \brief Get the key of the keyboard entry
+ *
+ * \return The scancode without the release bit, plus `EXTENDED_KEY` for an
+ * extended key (the same for every layout)
  */
-KeyboardEntry::KeyboardEntry(unsigned char scancode,  bool isPressed,
-                             bool isLeftShiftPressed, bool isRightShiftPressed,
-                             bool isCtrlPressed,      bool isAltPressed)
-    : isPressed_(isPressed),
-      isLeftShiftPressed_(isLeftShiftPressed),
-      isRightShiftPressed_(isRightShiftPressed),
-      isCtrlPressed_(isCtrlPressed), isAltPressed_(isAltPressed)
+uint8_t KeyboardEntry::getKey() const
 {
-    // Convert the scancode to ASCII charcter
-    character_ = usMapping_[scancode];
+    return key_;
 }
 
 /**
  * \brief Get the character of the keyboard entry
  *
- * \return The character of the keyboard entry
+ * \return The character of the keyboard entry in code page 437, or 0 if the
+ * key has none
  */
 unsigned char KeyboardEntry::getCharacter() const
 {
@@ -61,7 +77,7 @@ bool KeyboardEntry::isPressed() const
  */
 bool KeyboardEntry::isLeftShiftPressed() const
 {
-    return isLeftShiftPressed_;
+    return modifiers_ & LEFT_SHIFT;
 }
 
 /**
@@ -73,7 +89,7 @@ bool KeyboardEntry::isLeftShiftPressed() const
  */
 bool KeyboardEntry::isRightShiftPressed() const
 {
-    return isRightShiftPressed_;
+    return modifiers_ & RIGHT_SHIFT;
 }
 
 /**
@@ -83,7 +99,7 @@ bool KeyboardEntry::isRightShiftPressed() const
  */
 bool KeyboardEntry::isCtrlPressed() const
 {
-    return isCtrlPressed_;
+    return modifiers_ & (LEFT_CTRL | RIGHT_CTRL);
 }
 
 /**
@@ -93,18 +109,43 @@ bool KeyboardEntry::isCtrlPressed() const
  */
 bool KeyboardEntry::isAltPressed() const
 {
-    return isAltPressed_;
+    return modifiers_ & ALT;
+}
+
+/**
+ * \brief Return true if the keyboard entry was used while AltGr was pressed
+ *
+ * \return true if the keyboard entry was used while AltGr was pressed
+ */
+bool KeyboardEntry::isAltGrPressed() const
+{
+    return modifiers_ & ALT_GR;
+}
+
+/**
+ * \brief Return true if the keyboard entry was used while caps lock was on
+ *
+ * \return true if the keyboard entry was used while caps lock was on
+ */
+bool KeyboardEntry::isCapsLockOn() const
+{
+    return modifiers_ & CAPS_LOCK;
 }
 
 /// The `Keyboard` singleton instance
 Keyboard Keyboard::instance_;
 
 /**
- * \brief Initialize both indexes
+ * \brief Initialize the buffer and register the interrupt handler
+ *
+ * IRQ1 is unmasked: keys are received as soon as interrupts are enabled. The
+ * first layout of `KEYBOARD_LAYOUTS` is used.
  */
 Keyboard::Keyboard()
-    : readIndex_(0), writeIndex_(0)
+    : layout_(KEYBOARD_LAYOUTS[0]), modifiers_(0), isExtended_(false),
+      skippedScancodes_(0)
 {
+    registerIrqHandler(1, &Keyboard::handleInterrupt, this);
 }
 
 /**
@@ -118,42 +159,215 @@ Keyboard& Keyboard::getInstance()
 }
 
 /**
- * \brief Get the `KeyboardEntry` pointed by the `readIndex_`
+ * \brief Decode the scancodes until the oldest `KeyboardEntry` is complete
  *
- * This method returns the keyboard entry pointed by the reading index. It also
- * moves the reading index forward and makes it loop to the front of the buffer
- * if the end is reached.
+ * The prefixes are consumed without making an entry, so the buffer can be
+ * emptied without a complete entry: the rest of the key is decoded by the
+ * next call.
  *
- * \return the `KeyboardEntry` pointed by the `readIndex_`
+ * \param entry Set to the oldest `KeyboardEntry`
+ * \return false if no entry is complete
  */
-KeyboardEntry Keyboard::readEntry()
+bool Keyboard::readEntry(KeyboardEntry& entry)
 {
-    KeyboardEntry entry = buffer_[readIndex_];
-    readIndex_ = (readIndex_ + 1) % CAPACITY;
-    return entry;
+    uint8_t scancode;
+    while (scancodes_.pop(scancode)) {
+        if (decode(scancode, entry)) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 /**
- * \brief Put a `KeyboardEntry` at the `writeIndex_`
+ * \brief Return true if no scancode is waiting to be decoded
  *
- * This method adds a keyboard entry in the buffer at the writing index. It
- * also moves the writing index forward and makes it loop to the front of the
- * buffer if the end is reached.
+ * \return true if the buffer is empty
+ */
+bool Keyboard::isEmpty() const
+{
+    return scancodes_.isEmpty();
+}
+
+/**
+ * \brief Get the number of scancodes dropped because the buffer was full
  *
- * \param entry the `KeyboardEntry` to add to the buffer
+ * \return The number of scancodes dropped
  */
-void Keyboard::putEntry(const KeyboardEntry& entry)
+uint32_t Keyboard::getDroppedScancodes() const
 {
-    buffer_[writeIndex_] = entry;
-    writeIndex_ = (writeIndex_ + 1) % CAPACITY;
+    return scancodes_.getOverflowCount();
 }
 
 /**
- * \brief Return true if the buffer is empty
+ * \brief Get the event signaled when a scancode is received
  *
- * \return true if the buffer is empty
+ * The event is signaled after the scancode is in the buffer: once it is
+ * consumed, `readEntry` can be called until it returns false.
+ *
+ * \return The event of the keyboard
  */
-bool Keyboard::isEmpty() const
+sync::Event& Keyboard::getEvent()
+{
+    return event_;
+}
+
+/**
+ * \brief Change the layout used to decode the next keys
+ *
+ * Must be called by the thread reading the entries.
+ *
+ * \param layout The layout (one of `KEYBOARD_LAYOUTS` for example)
+ */
+void Keyboard::setLayout(const KeyboardLayout& layout)
+{
+    layout_ = &layout;
+}
+
+/**
+ * \brief Get the layout used to decode the keys
+ *
+ * \return The current layout
+ */
+const KeyboardLayout& Keyboard::getLayout() const
+{
+    return *layout_;
+}
+
+/**
+ * \brief Read a scancode and push it in the buffer (IRQ1 handler)
+ *
+ * Interrupt service routine that is called when a keyboard key is pressed or
+ * released. Reading the scancode acknowledges the controller, it is decoded
+ * by `readEntry`. The event of the keyboard wakes the reader up.
+ *
+ * \param frame The state of the processor (unused)
+ * \param context The `Keyboard` instance
+ */
+void Keyboard::handleInterrupt(InterruptFrame& frame, void* context)
+{
+    (void) frame;
+
+    // Read from the keyboard's data buffer
+    Keyboard* keyboard = static_cast<Keyboard*>(context);
+    keyboard->scancodes_.push(inb(0x60));
+    keyboard->event_.signal();
+}
+
+/**
+ * \brief Feed a scancode to the state machine
+ *
+ * The prefixes only change the state. The fake shifts sent around some
+ * extended keys (E0 2A, E0 36) are ignored. The modifiers are updated before
+ * the entry is made, so the entry of a modifier key has its new state.
+ *
+ * \param scancode The scancode read by the interrupt handler
+ * \param entry Set to the entry of the key, if the scancode completes one
+ * \return true if `entry` was set
+ */
+bool Keyboard::decode(uint8_t scancode, KeyboardEntry& entry)
 {
-    return readIndex_ == writeIndex_;
+    if (skippedScancodes_ > 0) {
+        --skippedScancodes_;
+        return false;
+    }
+    if (scancode == EXTENDED_PREFIX) {
+        isExtended_ = true;
+        return false;
+    }
+    if (scancode == PAUSE_PREFIX) {
+        // E1 1D 45 (press) and E1 9D C5 (release), the pause key has no entry
+        skippedScancodes_ = 2;
+        return false;
+    }
+
+    const bool isExtended = isExtended_;
+    isExtended_ = false;
+    const bool isPressed = !(scancode & RELEASE_BIT);
+    scancode &= ~RELEASE_BIT;
+
+    uint8_t modifier = 0;
+    switch (scancode) {
+        case LEFT_SHIFT_SCANCODE:
+            modifier = KeyboardEntry::LEFT_SHIFT;
+            break;
+        case RIGHT_SHIFT_SCANCODE:
+            modifier = KeyboardEntry::RIGHT_SHIFT;
+            break;
+        case CTRL_SCANCODE:
+            modifier = isExtended ? KeyboardEntry::RIGHT_CTRL
+                                  : KeyboardEntry::LEFT_CTRL;
+            break;
+        case ALT_SCANCODE:
+            modifier = isExtended ? KeyboardEntry::ALT_GR
+                                  : KeyboardEntry::ALT;
+            break;
+        case CAPS_LOCK_SCANCODE:
+            if (isPressed && !isExtended) {
+                modifiers_ ^= KeyboardEntry::CAPS_LOCK;
+            }
+            break;
+    }
+
+    if (modifier & (KeyboardEntry::LEFT_SHIFT | KeyboardEntry::RIGHT_SHIFT)
+        && isExtended) {
+        return false;
+    }
+    if (isPressed) {
+        modifiers_ |= modifier;
+    }
+    else {
+        modifiers_ &= ~modifier;
+    }
+
+    entry = KeyboardEntry(
+        isExtended ? scancode | KeyboardEntry::EXTENDED_KEY : scancode,
+        translate(scancode, isExtended),
+        isPressed,
+        modifiers_
+    );
+    return true;
+}
+
+/**
+ * \brief Return true if caps lock applies to a character
+ *
+ * \param character A character of a base table (code page 437)
+ * \return true for the lower case letters, with or without accent
+ */
+static bool isLetter(unsigned char character)
+{
+    return (character >= 'a' && character <= 'z') ||
+           character == 0x81 || character == 0x84 || character == 0x94;
+}
+
+/**
+ * \brief Get the character of a key with the current modifiers
+ *
+ * AltGr takes precedence when the layout has a character for it. Caps lock
+ * inverts shift for the letters only.
+ *
+ * \param scancode The scancode without the release bit
+ * \param isExtended true if the scancode was prefixed with 0xE0
+ * \return The character, or 0 if the key has none
+ */
+unsigned char Keyboard::translate(uint8_t scancode, bool isExtended) const
+{
+    if (isExtended) {
+        return layout_->extended[scancode];
+    }
+    if ((modifiers_ & KeyboardEntry::ALT_GR) &&
+        layout_->altGr[scancode] != 0) {
+        return layout_->altGr[scancode];
+    }
+
+    const unsigned char character = layout_->base[scancode];
+    bool isShifted = modifiers_ & (KeyboardEntry::LEFT_SHIFT |
+                                   KeyboardEntry::RIGHT_SHIFT);
+    if ((modifiers_ & KeyboardEntry::CAPS_LOCK) && isLetter(character)) {
+        isShifted = !isShifted;
+    }
+
+    return isShifted ? layout_->shift[scancode] : character;
 }
@@ -3,6 +3,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "interrupt.hpp"
+#include "KeyboardLayout.hpp"
+#include "sync/Event.hpp"
+#include "util/RingBuffer.hpp"
+
 /**
  * \brief Encapsulate the information related to a keyboard entry
  *
@@ -11,12 +16,31 @@
 class KeyboardEntry
 {
 public:
+    /// Added to the key of the extended scancodes (prefixed with 0xE0)
+    static const uint8_t EXTENDED_KEY = 0x80;
+
+    /// The left shift modifier
+    static const uint8_t LEFT_SHIFT  = 1 << 0;
+    /// The right shift modifier
+    static const uint8_t RIGHT_SHIFT = 1 << 1;
+    /// The left ctrl modifier
+    static const uint8_t LEFT_CTRL   = 1 << 2;
+    /// The right ctrl modifier
+    static const uint8_t RIGHT_CTRL  = 1 << 3;
+    /// The left alt modifier
+    static const uint8_t ALT         = 1 << 4;
+    /// The AltGr (right alt) modifier
+    static const uint8_t ALT_GR      = 1 << 5;
+    /// Set while caps lock is on
+    static const uint8_t CAPS_LOCK   = 1 << 6;
+
     KeyboardEntry() {};
     /// Initialize the object
-    KeyboardEntry(unsigned char scancode,  bool isPressed,
-                  bool isLeftShiftPressed, bool isRightShiftPressed,
-                  bool isCtrlPressed,      bool isAltPressed);
+    KeyboardEntry(uint8_t key, unsigned char character, bool isPressed,
+                  uint8_t modifiers);
 
+    /// Get the key of the keyboard entry
+    uint8_t getKey() const;
     /// Get the character of the keyboard entry
     unsigned char getCharacter() const;
     /// Return true if the keyboard entry was pressed
@@ -31,33 +55,36 @@ public:
     bool isCtrlPressed() const;
     /// Return true if the keyboard entry was used while the alt was pressed
     bool isAltPressed() const;
+    /// Return true if the keyboard entry was used while AltGr was pressed
+    bool isAltGrPressed() const;
+    /// Return true if the keyboard entry was used while caps lock was on
+    bool isCapsLockOn() const;
 
 private:
+    /// The scancode without the release bit, plus `EXTENDED_KEY` for the
+    /// extended scancodes
+    uint8_t key_;
     /// The character
     unsigned char character_;
     /// Boolean representing if the keyboard entry was pressed
     bool isPressed_;
-    /// Boolean representing if the left shift was pressed
-    bool isLeftShiftPressed_;
-    /// Boolean representing if the right shift was pressed
-    bool isRightShiftPressed_;
-    /// Boolean representing if the ctrl was pressed
-    bool isCtrlPressed_;
-    /// Boolean representing if the alt was pressed
-    bool isAltPressed_;
-
-    /// The US keyboard mapping between scancode and ASCII representation
-    static const unsigned char usMapping_[128];
+    /// The modifiers (`LEFT_SHIFT`, `LEFT_CTRL`...)
+    uint8_t modifiers_;
 };
 
 /**
  * \brief Contains the the keyboard entry recently used
  *
- * This singleton object saves all the keys that were pressed and released in a
- * `KeyboardEntry` buffer. The buffer has a fixed size and is looping on itself
- * once the end is reached. There are two indexes, one indicating where to
- * start reading from and the other one representing where to add the new
- * keyboard entries.
+ * The interrupt handler only reads the scancode and pushes it in a lock-free
+ * `util::RingBuffer` of bytes, so the keyboard keeps interrupts disabled for
+ * a few dozen cycles. When the buffer is full, the new scancodes are dropped
+ * (and counted) instead of overwriting the scancodes not read yet.
+ *
+ * The scancodes are decoded by the consumer in `readEntry`: a state machine
+ * follows the 0xE0 prefix of the extended keys, skips the 0xE1 sequence of
+ * the pause key and tracks the modifiers, then the character is looked up in
+ * the tables of the current layout. The layout can be changed at any time.
+ * Only one thread reads the entries, it waits for them with `getEvent`.
  */
 class Keyboard
 {
@@ -65,12 +92,22 @@ public:
     /// Get the instance of the singleton object `Keyboard`
     static Keyboard& getInstance();
 
-    /// Get the `KeyboardEntry` pointed by the `readIndex_`
-    KeyboardEntry readEntry();
-    /// Put a `KeyboardEntry` at the `writeIndex_`
-    void putEntry(const KeyboardEntry& entry);
-    /// Return true if the buffer is empty
+    /// Decode the scancodes until the oldest `KeyboardEntry` is complete
+    bool readEntry(KeyboardEntry& entry);
+    /// Return true if no scancode is waiting to be decoded
     bool isEmpty() const;
+    /// Get the number of scancodes dropped because the buffer was full
+    uint32_t getDroppedScancodes() const;
+    /// Get the event signaled when a scancode is received
+    sync::Event& getEvent();
+
+    /// Change the layout used to decode the next keys
+    void setLayout(const KeyboardLayout& layout);
+    /// Get the layout used to decode the keys
+    const KeyboardLayout& getLayout() const;
+
+    /// Read a scancode and push it in the buffer (IRQ1 handler)
+    static void handleInterrupt(InterruptFrame& frame, void* context);
 
     /// The copy constructor and copy assignment operator are deleted
     /// since the is a singleton
@@ -78,18 +115,30 @@ public:
     void operator=(Keyboard const&) = delete;
 
 private:
-    /// Initialize both indexes
+    /// Initialize the buffer and register the interrupt handler
     Keyboard();
 
+    /// Feed a scancode to the state machine
+    bool decode(uint8_t scancode, KeyboardEntry& entry);
+    /// Get the character of a key with the current modifiers
+    unsigned char translate(uint8_t scancode, bool isExtended) const;
+
     /// The `Keyboard` singleton instance
     static Keyboard instance_;
 
-    /// The read index
-    uint32_t readIndex_;
-    /// The write index
-    uint32_t writeIndex_;
     /// The capacity of the buffer
-    static const uint32_t CAPACITY = 1024;
-    /// The `KeyboardEntry` buffer
-    KeyboardEntry buffer_[CAPACITY];
+    static const uint32_t CAPACITY = 256;
+    /// The scancodes not decoded yet
+    util::RingBuffer<uint8_t, CAPACITY> scancodes_;
+    /// Signaled by the interrupt handler after each scancode
+    sync::Event event_;
+
+    /// The layout used to decode the keys
+    const KeyboardLayout* layout_;
+    /// The modifiers pressed (`KeyboardEntry::LEFT_SHIFT`...)
+    uint8_t modifiers_;
+    /// True if the previous scancode was the 0xE0 prefix
+    bool isExtended_;
+    /// The number of scancodes of the pause sequence left to skip
+    uint8_t skippedScancodes_;
 };
@@ -0,0 +1,193 @@
+#include "KeyboardLayout.hpp"
+
+/**
+ * \brief The characters of the keys that differ between layouts, row by row
+ *
+ * Every string holds one character per key, a space for a key without
+ * character (the space bar is not in the rows).
+ */
+struct KeyboardRows
+{
+    /// The keys from 1 to the left of backspace (scancodes 0x02 to 0x0D)
+    const char* numbers;
+    /// The keys from Q to the left of enter (scancodes 0x10 to 0x1B)
+    const char* top;
+    /// The keys from A to the left of 1 (scancodes 0x1E to 0x29)
+    const char* home;
+    /// The keys from the one above enter to the left of right shift
+    /// (scancodes 0x2B to 0x35)
+    const char* bottom;
+    /// The key between left shift and Z of ISO keyboards (scancode 0x56)
+    char iso;
+};
+
+/// The number of keys of `KeyboardRows::numbers`
+const size_t NUMBERS_LENGTH = 12;
+/// The number of keys of `KeyboardRows::top`
+const size_t TOP_LENGTH = 12;
+/// The number of keys of `KeyboardRows::home`
+const size_t HOME_LENGTH = 12;
+/// The number of keys of `KeyboardRows::bottom`
+const size_t BOTTOM_LENGTH = 11;
+
+/**
+ * \brief Get the length of a row
+ *
+ * \param row A null-terminated string
+ * \return The number of characters of `row`
+ */
+static constexpr size_t getRowLength(const char* row)
+{
+    size_t length = 0;
+    while (row[length] != '\0') {
+        ++length;
+    }
+
+    return length;
+}
+
+/**
+ * \brief Return true if every row has one character per key
+ *
+ * \param rows The rows
+ * \return true if the rows have the right lengths
+ */
+static constexpr bool hasRowLengths(const KeyboardRows& rows)
+{
+    return getRowLength(rows.numbers) == NUMBERS_LENGTH &&
+           getRowLength(rows.top) == TOP_LENGTH &&
+           getRowLength(rows.home) == HOME_LENGTH &&
+           getRowLength(rows.bottom) == BOTTOM_LENGTH;
+}
+
+/**
+ * \brief Copy a row to consecutive scancodes of a table
+ *
+ * \param table The table
+ * \param first The scancode of the first key of the row
+ * \param row The characters of the row (a space for no character)
+ */
+static constexpr void addRow(unsigned char* table, uint8_t first,
+                             const char* row)
+{
+    for (size_t i = 0; row[i] != '\0'; ++i) {
+        table[first + i] = row[i] != ' ' ? row[i] : 0;
+    }
+}
+
+/**
+ * \brief Copy the rows of a layout to a table
+ *
+ * \param table The table
+ * \param rows The rows
+ */
+static constexpr void addRows(unsigned char* table, const KeyboardRows& rows)
+{
+    addRow(table, 0x02, rows.numbers);
+    addRow(table, 0x10, rows.top);
+    addRow(table, 0x1E, rows.home);
+    addRow(table, 0x2B, rows.bottom);
+    table[0x56] = rows.iso != ' ' ? rows.iso : 0;
+}
+
+/**
+ * \brief Add the keys that are the same in every layout, with or without
+ * shift
+ *
+ * \param table The table
+ */
+static constexpr void addCommonKeys(unsigned char* table)
+{
+    table[0x01] = 27;   // Escape
+    table[0x0E] = '\b';
+    table[0x0F] = '\t';
+    table[0x1C] = '\n';
+    table[0x37] = '*';  // Keypad
+    table[0x39] = ' ';
+    table[0x4A] = '-';  // Keypad
+    table[0x4E] = '+';  // Keypad
+}
+
+/**
+ * \brief Generate the tables of a layout
+ *
+ * \param name The name of the layout
+ * \param base The rows without modifier
+ * \param shift The rows with shift
+ * \param altGr The rows with AltGr
+ * \return The layout
+ */
+static constexpr KeyboardLayout makeLayout(const char* name,
+                                           const KeyboardRows& base,
+                                           const KeyboardRows& shift,
+                                           const KeyboardRows& altGr)
+{
+    KeyboardLayout layout = {name, {}, {}, {}, {}};
+
+    addRows(layout.base, base);
+    addCommonKeys(layout.base);
+    addRows(layout.shift, shift);
+    addCommonKeys(layout.shift);
+    addRows(layout.altGr, altGr);
+
+    layout.extended[0x1C] = '\n'; // Keypad enter
+    layout.extended[0x35] = '/';  // Keypad slash
+    layout.extended[0x53] = 127;  // Delete
+
+    return layout;
+}
+
+/// The US rows without modifier
+static constexpr KeyboardRows US_BASE = {
+    "1234567890-=", "qwertyuiop[]", "asdfghjkl;'`", "\\zxcvbnm,./", '\\'
+};
+/// The US rows with shift
+static constexpr KeyboardRows US_SHIFT = {
+    "!@#$%^&*()_+", "QWERTYUIOP{}", "ASDFGHJKL:\"~", "|ZXCVBNM<>?", '|'
+};
+/// The US rows with AltGr (the right alt key has no character)
+static constexpr KeyboardRows US_ALT_GR = {
+    "            ", "            ", "            ", "           ", ' '
+};
+
+static_assert(hasRowLengths(US_BASE) && hasRowLengths(US_SHIFT) &&
+              hasRowLengths(US_ALT_GR), "A US row has the wrong length");
+
+/// The German rows without modifier (the dead keys are plain characters)
+static constexpr KeyboardRows GERMAN_BASE = {
+    "1234567890\xE1'", "qwertzuiop\x81+", "asdfghjkl\x94\x84^",
+    "#yxcvbnm,.-", '<'
+};
+/// The German rows with shift
+static constexpr KeyboardRows GERMAN_SHIFT = {
+    "!\"\x15$%&/()=?`", "QWERTZUIOP\x9A*", "ASDFGHJKL\x99\x8E\xF8",
+    "'YXCVBNM;:_", '>'
+};
+/// The German rows with AltGr (the characters missing from code page 437,
+/// like the euro sign, are left out)
+static constexpr KeyboardRows GERMAN_ALT_GR = {
+    " \xFD    {[]}\\ ", "@          ~", "            ", "       \xE6   ", '|'
+};
+
+static_assert(hasRowLengths(GERMAN_BASE) && hasRowLengths(GERMAN_SHIFT) &&
+              hasRowLengths(GERMAN_ALT_GR),
+              "A German row has the wrong length");
+
+/// The US QWERTY layout
+constexpr KeyboardLayout US_LAYOUT = makeLayout("us", US_BASE, US_SHIFT,
+                                                US_ALT_GR);
+/// The German QWERTZ layout
+constexpr KeyboardLayout GERMAN_LAYOUT = makeLayout("de", GERMAN_BASE,
+                                                    GERMAN_SHIFT,
+                                                    GERMAN_ALT_GR);
+
+static_assert(US_LAYOUT.shift[0x02] == '!' && US_LAYOUT.base[0x35] == '/',
+              "The US tables are not generated at compile time");
+static_assert(GERMAN_LAYOUT.base[0x15] == 'z' &&
+              GERMAN_LAYOUT.altGr[0x10] == '@',
+              "The German tables are not generated at compile time");
+
+/// Every layout, the default one first
+const KeyboardLayout* const KEYBOARD_LAYOUTS[KEYBOARD_LAYOUT_COUNT] = {
+    &US_LAYOUT, &GERMAN_LAYOUT
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// The number of scancodes of a table (scancode set 1, release bit cleared)
+const size_t KEYBOARD_TABLE_SIZE = 128;
+
+/**
+ * \brief The characters of the keys of a keyboard, by scancode
+ *
+ * Every table maps a scancode of set 1 (without the release bit) to a
+ * character of code page 437, the character set of the VGA text mode, or 0
+ * when the key has no character. `extended` is used for the scancodes that
+ * follow a 0xE0 prefix (keypad enter, keypad slash, delete...).
+ *
+ * The tables are generated at compile time from the rows of the keyboard
+ * (see KeyboardLayout.cpp), so adding a layout only takes its rows.
+ */
+struct KeyboardLayout
+{
+    /// The name of the layout
+    const char* name;
+    /// The characters without modifier
+    unsigned char base[KEYBOARD_TABLE_SIZE];
+    /// The characters with shift (or caps lock for the letters)
+    unsigned char shift[KEYBOARD_TABLE_SIZE];
+    /// The characters with AltGr (0 to use `base` or `shift` instead)
+    unsigned char altGr[KEYBOARD_TABLE_SIZE];
+    /// The characters of the extended scancodes
+    unsigned char extended[KEYBOARD_TABLE_SIZE];
+};
+
+/// The US QWERTY layout
+extern const KeyboardLayout US_LAYOUT;
+/// The German QWERTZ layout
+extern const KeyboardLayout GERMAN_LAYOUT;
+
+/// The number of layouts in `KEYBOARD_LAYOUTS`
+const size_t KEYBOARD_LAYOUT_COUNT = 2;
+/// Every layout, the default one first
+extern const KeyboardLayout* const KEYBOARD_LAYOUTS[KEYBOARD_LAYOUT_COUNT];
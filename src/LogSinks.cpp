@@ -0,0 +1,124 @@
+#include "LogSinks.hpp"
+#include "io.hpp"
+#include "SerialPort.hpp"
+#include "Terminal.hpp"
+
+/**
+ * \brief Write a line to a `Terminal`
+ *
+ * \param line The null-terminated line
+ * \param length The number of characters of the line (unused)
+ * \param context The `Terminal`
+ */
+void writeLogToTerminal(const char* line, size_t length, void* context)
+{
+    (void) length;
+
+    static_cast<Terminal*>(context)->write(line);
+}
+
+/**
+ * \brief Write a line to a `SerialPort`
+ *
+ * \param line The line
+ * \param length The number of characters of the line
+ * \param context The `SerialPort`
+ */
+void writeLogToSerialPort(const char* line, size_t length, void* context)
+{
+    static_cast<SerialPort*>(context)->write(line, length);
+}
+
+/**
+ * \brief Write a line to the debug console
+ *
+ * The debug console of QEMU (`-debugcon`) and Bochs (port_e9_hack) takes a
+ * character per write to the port, without a status register to poll, so
+ * the whole line is a single `rep outsb`.
+ *
+ * \param line The line
+ * \param length The number of characters of the line
+ * \param context Unused
+ */
+void writeLogToDebugcon(const char* line, size_t length, void* context)
+{
+    (void) context;
+
+    __asm__ volatile (
+        "rep outsb"
+        : "+S"(line), "+c"(length)
+        : "d"(DEBUGCON_PORT)
+        : "memory"
+    );
+}
+
+/**
+ * \brief Return true if the emulator has a debug console on `DEBUGCON_PORT`
+ *
+ * The debug console of QEMU and Bochs returns the number of the port when it
+ * is read, a port without device returns 0xFF.
+ *
+ * \return true if the debug console is present
+ */
+bool isDebugconPresent()
+{
+    return inb(DEBUGCON_PORT) == DEBUGCON_PORT;
+}
+
+/**
+ * \brief Initialize an empty ring
+ */
+LogMemoryRing::LogMemoryRing()
+    : writeIndex_(0)
+{
+}
+
+/**
+ * \brief Add characters at the end of the ring
+ *
+ * The oldest characters are overwritten when the ring is full. Only one
+ * writer may call it at a time (the drain of `KernelLogger`).
+ *
+ * \param data The characters
+ * \param size The number of characters
+ */
+void LogMemoryRing::write(const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        buffer_[(writeIndex_ + i) % CAPACITY] = data[i];
+    }
+
+    writeIndex_ += size;
+}
+
+/**
+ * \brief Copy the last characters of the ring
+ *
+ * \param output Where to copy the characters (not null-terminated)
+ * \param size The largest number of characters to copy
+ * \return The number of characters copied, the oldest first
+ */
+size_t LogMemoryRing::read(char* output, size_t size) const
+{
+    const uint32_t stored = writeIndex_ < CAPACITY ? writeIndex_ : CAPACITY;
+    const uint32_t count = size < stored ? size : stored;
+    const uint32_t start = writeIndex_ - count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        output[i] = buffer_[(start + i) % CAPACITY];
+    }
+
+    return count;
+}
+
+/**
+ * \brief Write a line to a `LogMemoryRing` (a `LogSinkFunction`)
+ *
+ * \param line The line
+ * \param length The number of characters of the line
+ * \param context The `LogMemoryRing`
+ */
+void LogMemoryRing::writeLog(const char* line, size_t length, void* context)
+{
+    static_cast<LogMemoryRing*>(context)->write(line, length);
+}
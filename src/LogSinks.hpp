@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The outputs `KernelLogger` can write its lines to. Each one is a
+ * `LogSinkFunction` registered with `KernelLogger::addSink`, with the object
+ * it writes to as context.
+ *
+ * Example:
+ * \code
+ * KernelLogger& logger = KernelLogger::getInstance();
+ * logger.addSink(writeLogToSerialPort, &com1, LogLevel::INFO);
+ * if (isDebugconPresent()) {
+ *     logger.addSink(writeLogToDebugcon, nullptr, LogLevel::DEBUG);
+ * }
+ * \endcode
+ */
+
+/// A function writing a line of the log to an output, with the context given
+/// when it was added to the logger
+typedef void (*LogSinkFunction)(const char* line, size_t length,
+                                void* context);
+
+/// The I/O port of the QEMU and Bochs debug console
+const uint16_t DEBUGCON_PORT = 0xE9;
+
+/// Write a line to a `Terminal`
+void writeLogToTerminal(const char* line, size_t length, void* context);
+/// Write a line to a `SerialPort`
+void writeLogToSerialPort(const char* line, size_t length, void* context);
+/// Write a line to the debug console
+void writeLogToDebugcon(const char* line, size_t length, void* context);
+/// Return true if the emulator has a debug console on `DEBUGCON_PORT`
+bool isDebugconPresent();
+
+/**
+ * \brief Keep the last lines of the log in memory
+ *
+ * The lines are copied in a circular buffer of characters, the oldest
+ * characters being overwritten. The buffer can be read with a debugger after
+ * a crash, or copied with `read`.
+ */
+class LogMemoryRing
+{
+public:
+    /// The number of characters kept
+    static const uint32_t CAPACITY = 4096;
+
+    /// Initialize an empty ring
+    LogMemoryRing();
+
+    /// Add characters at the end of the ring
+    void write(const char* data, size_t size);
+    /// Copy the last characters of the ring
+    size_t read(char* output, size_t size) const;
+
+    /// Write a line to a `LogMemoryRing` (a `LogSinkFunction`)
+    static void writeLog(const char* line, size_t length, void* context);
+
+private:
+    /// The characters
+    char buffer_[CAPACITY];
+    /// The number of characters written since the initialization
+    uint32_t writeIndex_;
+};
@@ -1,27 +1,44 @@
 #include "SerialPort.hpp"
+#include "memory/memory.hpp"
 
-const uint16_t* SerialPort::biosDataAreaAddress_ = (uint16_t*) 0x400;
+const uintptr_t SerialPort::biosDataAreaAddress_ = 0x400;
+
+/// The serial ports serviced by the interrupt handler
+SerialPort* SerialPort::ports_[SerialPort::MAX_PORTS] = {};
 
 /**
  * \brief Configure the serial port at address `address`
  *
  * \param address : The base address of the serial port
+ * \param policy : What `write` does when the transmit buffer is full
  */
-SerialPort::SerialPort(uint16_t address)
+SerialPort::SerialPort(uint16_t address, OverflowPolicy policy)
     : dataPort_(address),
+      interruptEnablePort_(address + 1),
       fifoCommandPort_(address + 2),
       lineCommandPort_(address + 3),
       modemCommandPort_(address + 4),
-      lineStatusPort_(address + 5)
+      lineStatusPort_(address + 5),
+      // COM1 (0x3F8) and COM3 (0x3E8) share IRQ4, COM2 (0x2F8) and COM4
+      // (0x2E8) share IRQ3
+      irq_((address & 0x100) ? 4 : 3),
+      policy_(policy),
+      droppedBytes_(0),
+      isTransmitInterruptEnabled_(false),
+      txReadIndex_(0),
+      txWriteIndex_(0)
 {
     uint32_t divisor = 1;
     uint8_t divisorLowByte  = divisor & 0xFF,
             divisorHighByte = (divisor >> 8) & 0xFF;
 
+    // No interrupt until the port is configured
+    outb(interruptEnablePort_, 0x00);
+
     // Configure the baud rate
     outb(lineCommandPort_, 0x80); // Enable DLAB
-    outb(dataPort_, divisorHighByte);
     outb(dataPort_, divisorLowByte);
+    outb(interruptEnablePort_, divisorHighByte);
 
     // Configure the line
     outb(lineCommandPort_, 0x03);
@@ -29,28 +46,170 @@ SerialPort::SerialPort(uint16_t address)
     // Configure the buffer
     outb(fifoCommandPort_, 0xC7);
 
-    // Configure the modem
-    outb(modemCommandPort_, 0x03);
+    // Configure the modem (OUT2 routes the interrupts of the port to the PIC)
+    outb(modemCommandPort_, 0x0B);
+
+    // Register the port so the interrupt handler can drain its buffer (the
+    // handler services every port of the line, the line number is its
+    // context)
+    uint32_t flags = saveAndDisableInterrupts();
+    for (uint8_t i = 0; i < MAX_PORTS; ++i) {
+        if (ports_[i] == nullptr) {
+            ports_[i] = this;
+            break;
+        }
+    }
+    registerIrqHandler(irq_, &SerialPort::handleInterrupt,
+                       (void*) (uintptr_t) irq_);
+    // Receive with interrupts from now on (the transmit interrupt is only
+    // enabled while characters are queued)
+    outb(interruptEnablePort_, 0x01);
+    restoreInterrupts(flags);
+}
+
+/**
+ * \brief Unregister the serial port from the interrupt handler
+ *
+ * The characters still in the transmit buffer are sent before.
+ */
+SerialPort::~SerialPort()
+{
+    flush();
+
+    uint32_t flags = saveAndDisableInterrupts();
+    outb(interruptEnablePort_, 0x00);
+    bool isLineUsed = false;
+    for (uint8_t i = 0; i < MAX_PORTS; ++i) {
+        if (ports_[i] == this) {
+            ports_[i] = nullptr;
+        }
+        else if (ports_[i] != nullptr && ports_[i]->irq_ == irq_) {
+            isLineUsed = true;
+        }
+    }
+    // Release the line if no other port uses it
+    if (!isLineUsed) {
+        unregisterIrqHandler(irq_);
+    }
+    restoreInterrupts(flags);
 }
 
 /**
  * \brief Send a string of characters to the serial port
  *
- * This method takes a pointer to a null-terminated string and will send each
+ * This method takes a pointer to a null-terminated string and will queue each
  * character until it meets the null character '\0'.
  *
  * \param data A pointer to a null-terminated string
+ * \return The number of characters queued
  */
-void SerialPort::write(const char* data)
+size_t SerialPort::write(const char* data)
 {
-    // Send each character over the serial line
-    for (size_t i = 0; data[i] != '\0'; ++i) {
-        // Wait for the queue to be empty before sending it
+    size_t size = 0;
+    while (data[size] != '\0') {
+        ++size;
+    }
+
+    return write(data, size);
+}
+
+/**
+ * \brief Send `size` characters to the serial port
+ *
+ * The characters are copied in the transmit buffer and sent by the interrupt
+ * handler. If the buffer is full, the behavior depends on the overflow
+ * policy: wait for room, return early or discard the remaining characters.
+ *
+ * \param data A pointer to the characters to send
+ * \param size The number of characters to send
+ * \return The number of characters queued
+ */
+size_t SerialPort::write(const char* data, size_t size)
+{
+    size_t written = 0;
+
+    while (true) {
+        uint32_t flags = saveAndDisableInterrupts();
+        written += enqueue(data + written, size - written);
+        // Hand the characters to the hardware right away if it is idle (this
+        // also makes progress when interrupts are disabled)
+        transmit();
+        restoreInterrupts(flags);
+
+        if (written == size || policy_ != OVERFLOW_BLOCK) {
+            break;
+        }
+
+        // Wait for the transmitter to make room in the buffer
         while (!isTransmitFifoEmpty())
             ;
+    }
 
-        outb(dataPort_, data[i]);
+    if (policy_ == OVERFLOW_DROP) {
+        droppedBytes_ += size - written;
     }
+
+    return written;
+}
+
+/**
+ * \brief Wait until every queued character has been handed to the hardware
+ */
+void SerialPort::flush()
+{
+    while (txReadIndex_ != txWriteIndex_) {
+        while (!isTransmitFifoEmpty())
+            ;
+
+        uint32_t flags = saveAndDisableInterrupts();
+        transmit();
+        restoreInterrupts(flags);
+    }
+}
+
+/**
+ * \brief Take up to `size` received characters
+ *
+ * Only one thread reads a port. It waits for characters with
+ * `getReceiveEvent`.
+ *
+ * \param data Where to copy the characters
+ * \param size The largest number of characters to copy
+ * \return The number of characters copied, 0 if none was received
+ */
+size_t SerialPort::read(char* data, size_t size)
+{
+    return rxBuffer_.popN(data, size);
+}
+
+/**
+ * \brief Get the event signaled when characters are received
+ *
+ * \return The receive event of the port
+ */
+sync::Event& SerialPort::getReceiveEvent()
+{
+    return rxEvent_;
+}
+
+/**
+ * \brief Change what `write` does when the transmit buffer is full
+ *
+ * \param policy The new overflow policy
+ */
+void SerialPort::setOverflowPolicy(OverflowPolicy policy)
+{
+    policy_ = policy;
+}
+
+/**
+ * \brief Get the number of characters discarded because the buffer was full
+ *
+ * \return The number of characters discarded with the `OVERFLOW_DROP` policy
+ */
+uint32_t SerialPort::getDroppedBytes() const
+{
+    return droppedBytes_;
 }
 
 /**
@@ -61,7 +220,37 @@ void SerialPort::write(const char* data)
  */
 uint16_t SerialPort::getAddress(uint8_t comPort)
 {
-    return biosDataAreaAddress_[comPort - 1];
+    const uint16_t* biosDataArea =
+        (const uint16_t*) memory::physicalToVirtual(biosDataAreaAddress_);
+
+    return biosDataArea[comPort - 1];
+}
+
+/**
+ * \brief Service the serial ports wired to an interrupt line
+ *
+ * Called by the interrupt handler with interrupts disabled. Several ports can
+ * share the same line so every registered port on that line is serviced.
+ *
+ * \param frame The state of the processor (unused)
+ * \param context The interrupt line that was raised
+ */
+void SerialPort::handleInterrupt(InterruptFrame& frame, void* context)
+{
+    (void) frame;
+    const uint8_t irq = (uintptr_t) context;
+
+    for (uint8_t i = 0; i < MAX_PORTS; ++i) {
+        SerialPort* port = ports_[i];
+        if (port != nullptr && port->irq_ == irq) {
+            // Reading the interrupt identification register acknowledges the
+            // "transmitter holding register empty" interrupt, reading the
+            // data register the "received data available" one
+            inb(port->fifoCommandPort_);
+            port->receive();
+            port->transmit();
+        }
+    }
 }
 
 /**
@@ -72,4 +261,77 @@ uint16_t SerialPort::getAddress(uint8_t comPort)
 uint8_t SerialPort::isTransmitFifoEmpty()
 {
     return inb(lineStatusPort_) & 0x20;
-}
\ No newline at end of file
+}
+
+/**
+ * \brief Move characters from the ring buffer to the hardware FIFO
+ *
+ * If the hardware FIFO is empty, up to `FIFO_SIZE` characters are written to
+ * it. The "transmitter holding register empty" interrupt is then enabled only
+ * while characters remain in the ring buffer. Interrupts must be disabled.
+ */
+void SerialPort::transmit()
+{
+    uint32_t readIndex = txReadIndex_;
+    const uint32_t writeIndex = txWriteIndex_;
+
+    if (readIndex != writeIndex && isTransmitFifoEmpty()) {
+        for (uint32_t i = 0; i < FIFO_SIZE && readIndex != writeIndex; ++i) {
+            outb(dataPort_, txBuffer_[readIndex & (TX_CAPACITY - 1)]);
+            ++readIndex;
+        }
+        txReadIndex_ = readIndex;
+    }
+
+    bool isPending = readIndex != writeIndex;
+    if (isPending != isTransmitInterruptEnabled_) {
+        outb(interruptEnablePort_, isPending ? 0x03 : 0x01);
+        isTransmitInterruptEnabled_ = isPending;
+    }
+}
+
+/**
+ * \brief Move the received characters to the receive buffer
+ *
+ * The data register is read while the line status reports data ready, which
+ * empties the hardware FIFO. The characters that do not fit in the receive
+ * buffer are dropped. Interrupts must be disabled.
+ */
+void SerialPort::receive()
+{
+    bool isReceived = false;
+    while (inb(lineStatusPort_) & 0x01) {
+        rxBuffer_.push(inb(dataPort_));
+        isReceived = true;
+    }
+
+    if (isReceived) {
+        rxEvent_.signal();
+    }
+}
+
+/**
+ * \brief Copy characters into the ring buffer
+ *
+ * The indexes grow freely and are masked when accessing the buffer, so the
+ * whole capacity can be used. Interrupts must be disabled.
+ *
+ * \param data A pointer to the characters to queue
+ * \param size The number of characters to queue
+ * \return The number of characters that fitted in the buffer
+ */
+size_t SerialPort::enqueue(const char* data, size_t size)
+{
+    uint32_t writeIndex = txWriteIndex_;
+    uint32_t available = TX_CAPACITY - (writeIndex - txReadIndex_);
+    if (size > available) {
+        size = available;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        txBuffer_[(writeIndex + i) & (TX_CAPACITY - 1)] = data[i];
+    }
+    txWriteIndex_ = writeIndex + size;
+
+    return size;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "io.hpp"
+#include "interrupt.hpp"
+#include "sync/Event.hpp"
+#include "util/RingBuffer.hpp"
 
 /**
  * \brief Send strings of characters to a serial port
@@ -8,10 +11,24 @@
  * This object configures a serial port to allow output. It can be used for
  * debugging purposes and display on the host machine.
  *
+ * Characters are not sent synchronously: `write` copies them into a transmit
+ * ring buffer and returns. The buffer is drained 16 bytes at a time (the size
+ * of the 16550 FIFO) by the "transmitter holding register empty" interrupt
+ * (IRQ4 for COM1/COM3, IRQ3 for COM2/COM4), registered with
+ * `registerIrqHandler`. When the ring buffer is full, the
+ * `OverflowPolicy` of the port decides what happens to the remaining
+ * characters.
+ *
+ * The received characters are moved by the same interrupt ("received data
+ * available", or the timeout of the FIFO) to a receive ring buffer, whose
+ * event is signaled for the reader (`read`). When that buffer is full, the
+ * new characters are dropped.
+ *
  * Example:
  * \code
  * // Find the address of first the serial port
  * uint32_t com1Address = SerialPort::getAddress(1);
+ * SerialPort com1(com1Address);
  * // Send a string to the serial port
  * com1.write("Hello!\n");
  * \endcode
@@ -19,21 +36,66 @@
 class SerialPort
 {
 public:
+    /// What `write` does when the transmit buffer is full
+    enum OverflowPolicy
+    {
+        /// Wait for the transmitter to make room (polling the line if needed)
+        OVERFLOW_BLOCK,
+        /// Queue what fits and return, the caller handles the remaining
+        /// characters
+        OVERFLOW_NON_BLOCKING,
+        /// Queue what fits and discard the remaining characters (they are
+        /// counted in the dropped bytes)
+        OVERFLOW_DROP
+    };
+
     /// Configure the serial port at address `address`
-    SerialPort(uint16_t address);
+    SerialPort(uint16_t address, OverflowPolicy policy = OVERFLOW_BLOCK);
+    /// Unregister the serial port from the interrupt handler
+    ~SerialPort();
+
     /// Send a string of characters to the serial port
-    void write(const char* data);
+    size_t write(const char* data);
+    /// Send `size` characters to the serial port
+    size_t write(const char* data, size_t size);
+    /// Wait until every queued character has been handed to the hardware
+    void flush();
+    /// Take up to `size` received characters
+    size_t read(char* data, size_t size);
+    /// Get the event signaled when characters are received
+    sync::Event& getReceiveEvent();
+
+    /// Change what `write` does when the transmit buffer is full
+    void setOverflowPolicy(OverflowPolicy policy);
+    /// Get the number of characters discarded because the buffer was full
+    uint32_t getDroppedBytes() const;
 
     /// Get the address of a serial port (COM port)
     static uint16_t getAddress(uint8_t comPort);
+    /// Service the serial ports wired to an interrupt line
+    static void handleInterrupt(InterruptFrame& frame, void* context);
+
+    /// The copy constructor and copy assignment operator are deleted since
+    /// the object is registered by address for interrupts
+    SerialPort(SerialPort const&) = delete;
+    void operator=(SerialPort const&) = delete;
 
 private:
     /// Check if the queue is empty
     uint8_t isTransmitFifoEmpty();
+    /// Move characters from the ring buffer to the hardware FIFO
+    void transmit();
+    /// Move the received characters to the receive buffer
+    void receive();
+    /// Copy characters into the ring buffer (interrupts must be disabled)
+    size_t enqueue(const char* data, size_t size);
 
     /// The base address for serial ports registers
     const uint16_t dataPort_;
-    /// The register for the queue
+    /// The register to enable interrupts
+    const uint16_t interruptEnablePort_;
+    /// The register for the queue (write) and the interrupt identification
+    /// (read)
     const uint16_t fifoCommandPort_;
     /// The register for the line
     const uint16_t lineCommandPort_;
@@ -41,8 +103,40 @@ private:
     const uint16_t modemCommandPort_;
     /// The register for the line status
     const uint16_t lineStatusPort_;
+    /// The interrupt line of the serial port
+    const uint8_t irq_;
+
+    /// What `write` does when the transmit buffer is full
+    OverflowPolicy policy_;
+    /// The number of characters discarded because the buffer was full
+    uint32_t droppedBytes_;
+    /// True if the "transmitter holding register empty" interrupt is enabled
+    bool isTransmitInterruptEnabled_;
+
+    /// The capacity of the transmit buffer (must be a power of two)
+    static const uint32_t TX_CAPACITY = 4096;
+    /// The number of bytes the hardware FIFO can take at once
+    static const uint32_t FIFO_SIZE = 16;
+    /// The index of the next character to send (only moved by `transmit`)
+    volatile uint32_t txReadIndex_;
+    /// The index where the next character is queued (only moved by `write`)
+    volatile uint32_t txWriteIndex_;
+    /// The transmit buffer
+    char txBuffer_[TX_CAPACITY];
+
+    /// The capacity of the receive buffer
+    static const uint32_t RX_CAPACITY = 256;
+    /// The characters received and not read yet
+    util::RingBuffer<char, RX_CAPACITY> rxBuffer_;
+    /// Signaled by the interrupt handler when characters are received
+    sync::Event rxEvent_;
+
+    /// The maximum number of serial ports serviced by the interrupt handler
+    static const uint8_t MAX_PORTS = 4;
+    /// The serial ports serviced by the interrupt handler
+    static SerialPort* ports_[MAX_PORTS];
 
-    /// The base address of the BIOS data area (to access the addresses of the
-    /// serial ports)
-    static const uint16_t* biosDataAreaAddress_;
-};
\ No newline at end of file
+    /// The physical address of the BIOS data area (to access the addresses
+    /// of the serial ports)
+    static const uintptr_t biosDataAreaAddress_;
+};
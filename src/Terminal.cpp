@@ -8,19 +8,20 @@
  * clears the screen.
  */
 Terminal::Terminal()
-    : row_(0),
+    : startRow_(0),
+      row_(0),
       column_(0),
+      cursorIndex_(0),
       foregroundColor_(vga::COLOR_LIGHT_GREY),
       backgroundColor_(vga::COLOR_BLACK)
 {
-    // Clear the terminal by putting spaces at every position of the screen
-    // buffer
+    // Clear the terminal by putting spaces on every row of the screen (the
+    // other rows of the text memory are cleared when they are displayed)
     for (size_t row = 0; row < vga::HEIGHT; ++row) {
-        for (size_t column = 0; column < vga::WIDTH; ++column) {
-            screenBuffer_[row][column] = screen_.putEntryAt(
-                ' ', foregroundColor_, backgroundColor_, column, row);
-        }
+        screen_.fillRow(' ', foregroundColor_, backgroundColor_, row);
     }
+    screen_.setStartRow(startRow_);
+    screen_.putCursorAt(column_, row_);
 }
 
 /**
@@ -28,23 +29,46 @@ Terminal::Terminal()
  *
  * This method takes a pointer to a null-terminated string and will print each
  * character until it meets the null character '\0'. Text will automatically
- * wrap at column 80 and scroll at the end of the screen.
+ * wrap at column 80 and scroll at the end of the screen. The cursor is then
+ * placed after the last character.
  *
  * \param data A pointer to a null-terminated string
  */
 void Terminal::write(const char* data)
 {
-    // Write each character of the string until the null character '\0' is
-    // encountered
-    for (size_t i = 0; data[i] != '\0'; ++i) {
-        putChar(data[i]);
+    size_t i = 0;
+
+    while (data[i] != '\0') {
+        // Treat the newline character by adding a line
+        if (data[i] == '\n') {
+            addLine();
+            ++i;
+            continue;
+        }
+
+        // Find the run of characters up to the next newline character, the end
+        // of the string or the end of the row, and put it on the screen at once
+        size_t size = 0;
+        while (column_ + size <= LAST_COLUMN && data[i + size] != '\0' &&
+               data[i + size] != '\n') {
+            ++size;
+        }
+        screen_.putRow(data + i, size, foregroundColor_, backgroundColor_,
+                       column_, startRow_ + row_);
+        i += size;
+
+        // Add a line if the cursor is past the end of the line
+        column_ += size;
+        if (column_ > LAST_COLUMN) {
+            addLine();
+        }
     }
+
+    updateCursor();
 }
 
 void Terminal::write(const unsigned char* data) {
-    for (size_t i = 0; data[i] != '\0'; ++i) {
-        putChar(data[i]);
-    }
+    write(reinterpret_cast<const char*>(data));
 }
 
 /**
@@ -52,7 +76,9 @@ void Terminal::write(const unsigned char* data) {
  * left)
  *
  * This method moves the cursor down one line if there is enough space. If not,
- * the content is scrolled up one line to make room.
+ * the screen is moved one row down in the text memory to make room. When the
+ * end of the text memory is reached, the rows still displayed are copied to its
+ * beginning and the screen starts there again.
  */
 void Terminal::addLine()
 {
@@ -63,58 +89,37 @@ void Terminal::addLine()
     // Scroll the content of the screen one line up (and discard the very first
     // row) to make room for the new content
     else {
-      // Move all lines to the preceding line in the buffer and on the screen
-      for (size_t row = 1; row < vga::HEIGHT; ++row) {
-        for (size_t column = 0; column < vga::WIDTH; ++column) {
-          size_t precedingRow = row - 1;
-          uint16_t entry = screenBuffer_[precedingRow][column] =
-              screenBuffer_[row][column];
-          screen_.putEntryAt(entry, column, precedingRow);
+        if (startRow_ < LAST_START_ROW) {
+            ++startRow_;
+        }
+        else {
+            // Copy the rows that stay on the screen to the beginning of the
+            // text memory (they are still displayed at the old position while
+            // being copied)
+            screen_.copyRows(startRow_ + 1, 0, LAST_ROW);
+            startRow_ = 0;
         }
-      }
-      // Reinitialize the last row of the screen by putting spaces
-      for (size_t column = 0; column < vga::WIDTH; ++column) {
-        screenBuffer_[LAST_ROW][column] = screen_.putEntryAt(
-            ' ', foregroundColor_, backgroundColor_, column, LAST_ROW);
-      }
+
+        // Clear the new last row before displaying it
+        screen_.fillRow(' ', foregroundColor_, backgroundColor_,
+                        startRow_ + LAST_ROW);
+        screen_.setStartRow(startRow_);
     }
 
     column_ = 0;
 }
 
 /**
- * \brief Put a character at the position of the cursor
- *
- * This method takes a character. If the character is the newline character
- * '\n', it adds a line. If the character is anything else, it adds that
- * character to the screen buffer. The cursor is then placed after the last
- * character (or at the beginning of the next line if the end of the row was
- * reached).
+ * \brief Move the hardware cursor to the position of the next character
  *
- * \param character The ASCII code of the character to be displayed
+ * The cursor registers are only written if the position changed.
  */
-void Terminal::putChar(char character)
+void Terminal::updateCursor()
 {
-    switch (character) {
-        // Treat the newline character by adding a line
-        case '\n' :
-            addLine();
-            break;
-
-        default :
-            // Put any other character on the screen and save the result for
-            // future use (when scrolling the content)
-            screenBuffer_[row_][column_] = screen_.putEntryAt(
-                character, foregroundColor_, backgroundColor_, column_, row_);
+    size_t index = (startRow_ + row_) * vga::WIDTH + column_;
 
-            // Increment the cursor position and add a line if it is past the
-            // end of the line
-            ++column_;
-            if (column_ > LAST_COLUMN) {
-                addLine();
-            }
+    if (index != cursorIndex_) {
+        screen_.putCursorAt(column_, startRow_ + row_);
+        cursorIndex_ = index;
     }
-
-    // Move the cursor
-    screen_.putCursorAt(column_, row_);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "util/format.hpp"
 #include "vga/Screen.hpp"
 
 /**
@@ -12,6 +13,17 @@
  * automatically when there is no space left on the screen. The cursor is
  * positionned after the last character each time something is written on the
  * screen.
+ *
+ * Writing is batched: the text is split in runs of characters that fit on the
+ * current row, each run is copied to the screen at once, and the cursor is
+ * moved once at the end of `write` (only if its position changed, since each
+ * move costs several port writes).
+ *
+ * Scrolling is done by the hardware: the screen is a window on the text memory
+ * of VGA, which holds `vga::MEMORY_HEIGHT` rows. Scrolling one row moves the
+ * window one row down and clears the new last row only. The rows are copied
+ * back to the beginning of the text memory only when the window reaches its
+ * end.
  */
 class Terminal
 {
@@ -22,17 +34,38 @@ public:
     void write(const char* data);
     void write(const unsigned char* data);
 
+    /// The largest text written by `print` (longer text is cut)
+    static const size_t PRINT_SIZE = 256;
+
+    /**
+     * \brief Write values with a format string checked at compile time
+     *
+     * \param format The format string, wrapped in `FORMAT`
+     * \param arguments The values of the fields
+     */
+    template <typename Format, typename... Args>
+    void print(Format format, const Args&... arguments)
+    {
+        char text[PRINT_SIZE];
+        util::format(text, PRINT_SIZE, format, arguments...);
+        write(text);
+    }
+
 private:
     /// Add an empty line (and scroll the screen one row if there is no space
     /// left)
     void addLine();
-    /// Put a character at the position of the cursor
-    void putChar(char character);
+    /// Move the hardware cursor to the position of the next character
+    void updateCursor();
 
-    /// The current row of the cursor
+    /// The row of the text memory displayed at the top of the screen
+    size_t      startRow_;
+    /// The current row of the cursor (on the screen)
     size_t      row_;
     /// The current column of the cursor
     size_t      column_;
+    /// The position (index in the text memory) of the hardware cursor
+    size_t      cursorIndex_;
     /// The foreground color of the terminal
     vga::Color  foregroundColor_;
     /// The background color of the terminal
@@ -40,11 +73,11 @@ private:
     /// The screen driver to actually put characters on the screen
     vga::Screen screen_;
 
-    /// Copy of the content of the screen (to allow scrolling)
-    uint16_t    screenBuffer_[vga::HEIGHT][vga::WIDTH];
-
     /// The last row index
     const size_t LAST_ROW    = vga::HEIGHT - 1;
     /// The last column index
     const size_t LAST_COLUMN = vga::WIDTH  - 1;
+    /// The last row of the text memory that can be displayed at the top of
+    /// the screen
+    const size_t LAST_START_ROW = vga::MEMORY_HEIGHT - vga::HEIGHT;
 };
@@ -0,0 +1,412 @@
+#include "Acpi.hpp"
+#include "../memory/AddressSpace.hpp"
+
+namespace acpi
+{
+    /// The root system description pointer (ACPI 1.0 part)
+    struct Rsdp
+    {
+        char signature[8];
+        uint8_t checksum;
+        char oemId[6];
+        uint8_t revision;
+        uint32_t rsdtAddress;
+    } __attribute__((packed));
+
+    /// The beginning of the multiple APIC description table
+    struct Madt
+    {
+        TableHeader header;
+        uint32_t localApicAddress;
+        uint32_t flags;
+    } __attribute__((packed));
+
+    /// The header of the entries following the MADT
+    struct MadtEntry
+    {
+        uint8_t type;
+        uint8_t length;
+    } __attribute__((packed));
+
+    /// A processor and its local APIC
+    struct MadtLocalApic
+    {
+        MadtEntry entry;
+        uint8_t acpiProcessorId;
+        uint8_t apicId;
+        uint32_t flags;
+    } __attribute__((packed));
+
+    /// An I/O APIC
+    struct MadtIoApic
+    {
+        MadtEntry entry;
+        uint8_t ioApicId;
+        uint8_t reserved;
+        uint32_t address;
+        uint32_t gsiBase;
+    } __attribute__((packed));
+
+    /// An ISA interrupt line not wired to the global system interrupt of the
+    /// same number
+    struct MadtInterruptOverride
+    {
+        MadtEntry entry;
+        uint8_t bus;
+        uint8_t source;
+        uint32_t gsi;
+        uint16_t flags;
+    } __attribute__((packed));
+
+    /// The 64-bit address of the local APIC registers
+    struct MadtLocalApicOverride
+    {
+        MadtEntry entry;
+        uint16_t reserved;
+        uint64_t address;
+    } __attribute__((packed));
+
+    /// A processor whose local APIC identifier does not fit in a byte
+    struct MadtLocalX2Apic
+    {
+        MadtEntry entry;
+        uint16_t reserved;
+        uint32_t x2ApicId;
+        uint32_t flags;
+        uint32_t acpiProcessorId;
+    } __attribute__((packed));
+
+    /// The address of registers in the ACPI tables
+    struct GenericAddress
+    {
+        uint8_t addressSpace;
+        uint8_t bitWidth;
+        uint8_t bitOffset;
+        uint8_t accessSize;
+        uint64_t address;
+    } __attribute__((packed));
+
+    /// The HPET description table
+    struct HpetTable
+    {
+        TableHeader header;
+        uint32_t eventTimerBlockId;
+        GenericAddress address;
+        uint8_t hpetNumber;
+        uint16_t minimumTick;
+        uint8_t pageProtection;
+    } __attribute__((packed));
+
+    /// Generic address space, the registers are in memory
+    const uint8_t ADDRESS_SPACE_MEMORY = 0;
+
+    /// The types of the MADT entries
+    const uint8_t MADT_LOCAL_APIC          = 0;
+    const uint8_t MADT_IO_APIC             = 1;
+    const uint8_t MADT_INTERRUPT_OVERRIDE  = 2;
+    const uint8_t MADT_LOCAL_APIC_OVERRIDE = 5;
+    const uint8_t MADT_LOCAL_X2APIC        = 9;
+
+    /// MADT flags, the machine has the two 8259 PICs
+    const uint32_t MADT_PCAT_COMPAT = 1 << 0;
+    /// MADT processor flags, the processor can be used
+    const uint32_t MADT_PROCESSOR_ENABLED = 1 << 0;
+
+    /// MPS INTI flags, the polarity of the line (bits 0-1)
+    const uint16_t INTI_POLARITY_MASK = 0x3;
+    const uint16_t INTI_ACTIVE_LOW    = 0x3;
+    /// MPS INTI flags, the trigger mode of the line (bits 2-3)
+    const uint16_t INTI_TRIGGER_MASK  = 0xC;
+    const uint16_t INTI_LEVEL         = 0xC;
+
+    /// The physical address of the pointer to the extended BIOS data area
+    /// (a segment) in the BIOS data area
+    const memory::PhysicalAddress EBDA_POINTER_ADDRESS = 0x40E;
+    /// The BIOS read-only memory searched for the RSDP
+    const memory::PhysicalAddress BIOS_AREA_START = 0xE0000;
+    const memory::PhysicalAddress BIOS_AREA_END   = 0x100000;
+
+    /// The root system description table (nullptr if not found)
+    static const TableHeader* rsdt = nullptr;
+    /// The interrupt configuration read from the MADT
+    static MadtInfo madtInfo = {};
+
+    /**
+     * \brief Check that the bytes of a structure add up to 0
+     *
+     * \param data A pointer to the structure
+     * \param size The size of the structure in bytes
+     * \return true if the checksum is valid
+     */
+    static bool isChecksumValid(const void* data, size_t size)
+    {
+        const uint8_t* bytes = (const uint8_t*) data;
+        uint8_t sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += bytes[i];
+        }
+
+        return sum == 0;
+    }
+
+    /**
+     * \brief Compare the signature of a structure
+     *
+     * \param signature The signature of the structure (not null-terminated)
+     * \param expected The expected signature
+     * \param size The size of the signature
+     * \return true if the signatures are the same
+     */
+    static bool isSignature(const char* signature, const char* expected,
+                            size_t size)
+    {
+        for (size_t i = 0; i < size; ++i) {
+            if (signature[i] != expected[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Search the RSDP between two physical addresses
+     *
+     * The RSDP is aligned on 16 bytes.
+     *
+     * \param start The first physical address to search
+     * \param end The physical address after the last one to search
+     * \return The RSDP, or nullptr if it is not in the range
+     */
+    static const Rsdp* findRsdp(memory::PhysicalAddress start,
+                                memory::PhysicalAddress end)
+    {
+        for (memory::PhysicalAddress address = start;
+             address + sizeof(Rsdp) <= end; address += 16) {
+            const Rsdp* rsdp = (const Rsdp*) memory::physicalToVirtual(address);
+            if (isSignature(rsdp->signature, "RSD PTR ", 8) &&
+                isChecksumValid(rsdp, sizeof(Rsdp))) {
+                return rsdp;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * \brief Get a pointer to a description table
+     *
+     * The tables are usually at the end of the physical memory, in the direct
+     * map. If they are above, they are mapped in the device region.
+     *
+     * \param address The physical address of the table
+     * \return A pointer to the whole table, or nullptr if it cannot be mapped
+     */
+    static const TableHeader* mapTable(memory::PhysicalAddress address)
+    {
+        if (address + sizeof(TableHeader) <= memory::DIRECT_MAP_SIZE) {
+            const TableHeader* header =
+                (const TableHeader*) memory::physicalToVirtual(address);
+            if (address + header->length <= memory::DIRECT_MAP_SIZE) {
+                return header;
+            }
+        }
+
+        const TableHeader* header = (const TableHeader*)
+            memory::AddressSpace::mapDevice(address, sizeof(TableHeader));
+        if (header == nullptr) {
+            return nullptr;
+        }
+
+        return (const TableHeader*)
+            memory::AddressSpace::mapDevice(address, header->length);
+    }
+
+    /**
+     * \brief Read the processors, the I/O APICs and the ISA interrupt lines
+     * from the MADT
+     *
+     * \param madt The MADT
+     */
+    static void parseMadt(const Madt* madt)
+    {
+        madtInfo.localApicAddress = madt->localApicAddress;
+        madtInfo.hasLegacyPics = madt->flags & MADT_PCAT_COMPAT;
+        for (size_t irq = 0; irq < ISA_IRQ_COUNT; ++irq) {
+            madtInfo.isaGsis[irq] = irq;
+            madtInfo.isaFlags[irq] = 0;
+        }
+
+        const uint8_t* entries = (const uint8_t*) (madt + 1);
+        const uint8_t* end = (const uint8_t*) madt + madt->header.length;
+        while (entries + sizeof(MadtEntry) <= end) {
+            const MadtEntry* entry = (const MadtEntry*) entries;
+            if (entry->length < sizeof(MadtEntry)) {
+                break;
+            }
+
+            switch (entry->type) {
+                case MADT_LOCAL_APIC: {
+                    const MadtLocalApic* localApic =
+                        (const MadtLocalApic*) entry;
+                    if ((localApic->flags & MADT_PROCESSOR_ENABLED) &&
+                        madtInfo.cpuCount < MAX_CPUS) {
+                        madtInfo.cpuApicIds[madtInfo.cpuCount++] =
+                            localApic->apicId;
+                    }
+                    break;
+                }
+                case MADT_LOCAL_X2APIC: {
+                    const MadtLocalX2Apic* localX2Apic =
+                        (const MadtLocalX2Apic*) entry;
+                    if ((localX2Apic->flags & MADT_PROCESSOR_ENABLED) &&
+                        madtInfo.cpuCount < MAX_CPUS) {
+                        madtInfo.cpuApicIds[madtInfo.cpuCount++] =
+                            localX2Apic->x2ApicId;
+                    }
+                    break;
+                }
+                case MADT_IO_APIC: {
+                    const MadtIoApic* ioApic = (const MadtIoApic*) entry;
+                    if (madtInfo.ioApicCount < MAX_IO_APICS) {
+                        IoApicInfo& info =
+                            madtInfo.ioApics[madtInfo.ioApicCount++];
+                        info.id = ioApic->ioApicId;
+                        info.address = ioApic->address;
+                        info.gsiBase = ioApic->gsiBase;
+                    }
+                    break;
+                }
+                case MADT_INTERRUPT_OVERRIDE: {
+                    const MadtInterruptOverride* override =
+                        (const MadtInterruptOverride*) entry;
+                    // Only the ISA bus (0) is described by overrides
+                    if (override->bus == 0 &&
+                        override->source < ISA_IRQ_COUNT) {
+                        uint16_t flags = 0;
+                        if ((override->flags & INTI_POLARITY_MASK) ==
+                            INTI_ACTIVE_LOW) {
+                            flags |= IRQ_ACTIVE_LOW;
+                        }
+                        if ((override->flags & INTI_TRIGGER_MASK) ==
+                            INTI_LEVEL) {
+                            flags |= IRQ_LEVEL_TRIGGERED;
+                        }
+                        madtInfo.isaGsis[override->source] = override->gsi;
+                        madtInfo.isaFlags[override->source] = flags;
+                    }
+                    break;
+                }
+                case MADT_LOCAL_APIC_OVERRIDE: {
+                    const MadtLocalApicOverride* override =
+                        (const MadtLocalApicOverride*) entry;
+                    // The registers must be reachable with 32-bit addresses
+                    if (override->address >> 32 == 0) {
+                        madtInfo.localApicAddress = override->address;
+                    }
+                    break;
+                }
+            }
+
+            entries += entry->length;
+        }
+    }
+
+    /**
+     * \brief Find the ACPI tables and read the MADT
+     *
+     * The RSDP is searched in the first KiB of the extended BIOS data area,
+     * then in the BIOS read-only memory.
+     *
+     * \return false if there are no ACPI tables or no MADT
+     */
+    bool initialize()
+    {
+        const uint16_t ebdaSegment = *(const uint16_t*)
+            memory::physicalToVirtual(EBDA_POINTER_ADDRESS);
+        const memory::PhysicalAddress ebda = (memory::PhysicalAddress)
+            ebdaSegment << 4;
+
+        const Rsdp* rsdp = nullptr;
+        if (ebda != 0) {
+            rsdp = findRsdp(ebda, ebda + 1024);
+        }
+        if (rsdp == nullptr) {
+            rsdp = findRsdp(BIOS_AREA_START, BIOS_AREA_END);
+        }
+        if (rsdp == nullptr) {
+            return false;
+        }
+
+        const TableHeader* table = mapTable(rsdp->rsdtAddress);
+        if (table == nullptr || !isSignature(table->signature, "RSDT", 4) ||
+            !isChecksumValid(table, table->length)) {
+            return false;
+        }
+        rsdt = table;
+
+        const Madt* madt = (const Madt*) findTable("APIC");
+        if (madt == nullptr) {
+            return false;
+        }
+        parseMadt(madt);
+
+        return true;
+    }
+
+    /**
+     * \brief Find a description table from its signature
+     *
+     * \param signature The four characters of the signature ("APIC" for the
+     * MADT for instance)
+     * \return The table, or nullptr if there is no valid table with this
+     * signature
+     */
+    const TableHeader* findTable(const char* signature)
+    {
+        if (rsdt == nullptr) {
+            return nullptr;
+        }
+
+        const uint32_t* addresses = (const uint32_t*) (rsdt + 1);
+        const size_t count = (rsdt->length - sizeof(TableHeader)) / 4;
+        for (size_t i = 0; i < count; ++i) {
+            const TableHeader* table = mapTable(addresses[i]);
+            if (table != nullptr && isSignature(table->signature, signature, 4)
+                && isChecksumValid(table, table->length)) {
+                return table;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * \brief Get the interrupt configuration read from the MADT
+     *
+     * \return The interrupt configuration (empty if `initialize` failed)
+     */
+    const MadtInfo& getMadtInfo()
+    {
+        return madtInfo;
+    }
+
+    /**
+     * \brief Get the physical address of the registers of the HPET
+     *
+     * \return The address of the registers of the first HPET, 0 if there is
+     * no HPET description table or if the registers are not in the 32-bit
+     * physical memory
+     */
+    memory::PhysicalAddress getHpetAddress()
+    {
+        const HpetTable* hpet = (const HpetTable*) findTable("HPET");
+        if (hpet == nullptr ||
+            hpet->address.addressSpace != ADDRESS_SPACE_MEMORY ||
+            hpet->address.address > UINTPTR_MAX) {
+            return 0;
+        }
+
+        return hpet->address.address;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../memory/memory.hpp"
+
+/**
+ * \brief Find the ACPI tables and read the interrupt configuration
+ *
+ * ACPI stands for _Advanced Configuration and Power Interface_. The firmware
+ * describes the machine in tables listed by the root system description table
+ * (RSDT), itself found through the root system description pointer (RSDP) in
+ * the BIOS memory. The multiple APIC description table (MADT) lists the
+ * processors, the I/O APICs and how the ISA interrupt lines are wired to them.
+ * The HPET description table gives the address of the high precision event
+ * timer, when the machine has one.
+ */
+namespace acpi
+{
+    /// The header common to all the description tables
+    struct TableHeader
+    {
+        char signature[4];
+        uint32_t length;
+        uint8_t revision;
+        uint8_t checksum;
+        char oemId[6];
+        char oemTableId[8];
+        uint32_t oemRevision;
+        uint32_t creatorId;
+        uint32_t creatorRevision;
+    } __attribute__((packed));
+
+    /// The maximum number of processors described
+    const size_t MAX_CPUS = 16;
+    /// The maximum number of I/O APICs described
+    const size_t MAX_IO_APICS = 4;
+    /// The number of ISA interrupt lines
+    const size_t ISA_IRQ_COUNT = 16;
+
+    /// The polarity of an interrupt line is active low (active high otherwise)
+    const uint16_t IRQ_ACTIVE_LOW = 1 << 0;
+    /// The interrupt line is level triggered (edge triggered otherwise)
+    const uint16_t IRQ_LEVEL_TRIGGERED = 1 << 1;
+
+    /// An I/O APIC described by the MADT
+    struct IoApicInfo
+    {
+        /// The APIC identifier of the I/O APIC
+        uint8_t id;
+        /// The physical address of its registers
+        memory::PhysicalAddress address;
+        /// The first global system interrupt it handles
+        uint32_t gsiBase;
+    };
+
+    /// The interrupt configuration read from the MADT
+    struct MadtInfo
+    {
+        /// The physical address of the local APIC registers
+        memory::PhysicalAddress localApicAddress;
+        /// True if the machine also has the two 8259 PICs
+        bool hasLegacyPics;
+        /// The number of enabled processors
+        size_t cpuCount;
+        /// The local APIC identifier of each enabled processor
+        uint32_t cpuApicIds[MAX_CPUS];
+        /// The number of I/O APICs
+        size_t ioApicCount;
+        /// The I/O APICs
+        IoApicInfo ioApics[MAX_IO_APICS];
+        /// The global system interrupt of each ISA interrupt line
+        uint32_t isaGsis[ISA_IRQ_COUNT];
+        /// The polarity and trigger mode (IRQ_* flags) of each ISA interrupt
+        /// line
+        uint16_t isaFlags[ISA_IRQ_COUNT];
+    };
+
+    /// Find the ACPI tables and read the MADT
+    bool initialize();
+    /// Find a description table from its signature
+    const TableHeader* findTable(const char* signature);
+    /// Get the interrupt configuration read from the MADT
+    const MadtInfo& getMadtInfo();
+    /// Get the physical address of the registers of the HPET
+    memory::PhysicalAddress getHpetAddress();
+}
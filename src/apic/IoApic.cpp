@@ -0,0 +1,180 @@
+#include "IoApic.hpp"
+#include "../memory/AddressSpace.hpp"
+
+namespace apic
+{
+    /// The offset of the register selection (in 32-bit words)
+    const size_t REGISTER_SELECT = 0;
+    /// The offset of the window on the selected register (in 32-bit words)
+    const size_t REGISTER_WINDOW = 4;
+
+    /// The version register (the maximum redirection entry is in bits 16-23)
+    const uint8_t REGISTER_VERSION = 0x01;
+    /// The first redirection entry (two registers per entry)
+    const uint8_t REGISTER_REDIRECTION = 0x10;
+
+    /// Redirection entry, the line is active low
+    const uint32_t REDIRECTION_ACTIVE_LOW = 1 << 13;
+    /// Redirection entry, the line is level triggered
+    const uint32_t REDIRECTION_LEVEL      = 1 << 15;
+    /// Redirection entry, the line is masked
+    const uint32_t REDIRECTION_MASKED     = 1 << 16;
+
+    /// The I/O APICs
+    IoApic IoApic::ioApics_[acpi::MAX_IO_APICS];
+    /// The number of I/O APICs
+    size_t IoApic::ioApicCount_ = 0;
+    /// The global system interrupt of each ISA interrupt line
+    uint32_t IoApic::isaGsis_[acpi::ISA_IRQ_COUNT] = {};
+    /// The polarity and trigger mode of each ISA interrupt line
+    uint16_t IoApic::isaFlags_[acpi::ISA_IRQ_COUNT] = {};
+
+    /**
+     * \brief Find the I/O APICs of the MADT and mask all their lines
+     *
+     * \param madtInfo The interrupt configuration read from the MADT
+     * \return false if there is no I/O APIC or if it cannot be mapped
+     */
+    bool IoApic::initialize(const acpi::MadtInfo& madtInfo)
+    {
+        for (size_t i = 0; i < madtInfo.ioApicCount; ++i) {
+            const acpi::IoApicInfo& info = madtInfo.ioApics[i];
+            IoApic& ioApic = ioApics_[ioApicCount_];
+
+            ioApic.registers_ = (volatile uint32_t*)
+                memory::AddressSpace::mapDevice(info.address,
+                                                memory::PAGE_SIZE);
+            if (ioApic.registers_ == nullptr) {
+                continue;
+            }
+            ioApic.gsiBase_ = info.gsiBase;
+            ioApic.gsiCount_ = ((ioApic.read(REGISTER_VERSION) >> 16) & 0xFF)
+                               + 1;
+
+            for (uint32_t line = 0; line < ioApic.gsiCount_; ++line) {
+                ioApic.write(REGISTER_REDIRECTION + 2 * line,
+                             REDIRECTION_MASKED);
+            }
+            ++ioApicCount_;
+        }
+
+        for (size_t irq = 0; irq < acpi::ISA_IRQ_COUNT; ++irq) {
+            isaGsis_[irq] = madtInfo.isaGsis[irq];
+            isaFlags_[irq] = madtInfo.isaFlags[irq];
+        }
+
+        return ioApicCount_ > 0;
+    }
+
+    /**
+     * \brief Send an ISA interrupt line to a vector of a processor
+     *
+     * The polarity and the trigger mode of the line come from the MADT
+     * (active high and edge triggered unless overridden).
+     *
+     * \param irq The ISA interrupt line (0 to 15)
+     * \param vector The vector of the interrupt
+     * \param destinationApicId The local APIC identifier of the processor
+     * receiving the interrupt
+     * \param isMasked true to keep the line masked
+     * \return false if no I/O APIC handles the line
+     */
+    bool IoApic::routeIsaIrq(uint8_t irq, uint8_t vector,
+                             uint32_t destinationApicId, bool isMasked)
+    {
+        const uint32_t gsi = isaGsis_[irq];
+        IoApic* ioApic = getForGsi(gsi);
+        if (ioApic == nullptr) {
+            return false;
+        }
+
+        uint32_t low = vector;
+        if (isaFlags_[irq] & acpi::IRQ_ACTIVE_LOW) {
+            low |= REDIRECTION_ACTIVE_LOW;
+        }
+        if (isaFlags_[irq] & acpi::IRQ_LEVEL_TRIGGERED) {
+            low |= REDIRECTION_LEVEL;
+        }
+        if (isMasked) {
+            low |= REDIRECTION_MASKED;
+        }
+
+        // Mask the line while the entry is half written
+        const uint8_t index = REGISTER_REDIRECTION
+                              + 2 * (gsi - ioApic->gsiBase_);
+        ioApic->write(index, REDIRECTION_MASKED);
+        ioApic->write(index + 1, destinationApicId << 24);
+        ioApic->write(index, low);
+
+        return true;
+    }
+
+    /**
+     * \brief Mask or unmask an ISA interrupt line
+     *
+     * \param irq The ISA interrupt line (0 to 15)
+     * \param isMasked true to mask the line, false to unmask it
+     */
+    void IoApic::setIsaIrqMasked(uint8_t irq, bool isMasked)
+    {
+        const uint32_t gsi = isaGsis_[irq];
+        IoApic* ioApic = getForGsi(gsi);
+        if (ioApic == nullptr) {
+            return;
+        }
+
+        const uint8_t index = REGISTER_REDIRECTION
+                              + 2 * (gsi - ioApic->gsiBase_);
+        uint32_t low = ioApic->read(index);
+        if (isMasked) {
+            low |= REDIRECTION_MASKED;
+        }
+        else {
+            low &= ~REDIRECTION_MASKED;
+        }
+        ioApic->write(index, low);
+    }
+
+    /**
+     * \brief Get the I/O APIC handling a global system interrupt
+     *
+     * \param gsi The global system interrupt
+     * \return The I/O APIC, or nullptr if none handles the interrupt
+     */
+    IoApic* IoApic::getForGsi(uint32_t gsi)
+    {
+        for (size_t i = 0; i < ioApicCount_; ++i) {
+            IoApic& ioApic = ioApics_[i];
+            if (gsi >= ioApic.gsiBase_ &&
+                gsi - ioApic.gsiBase_ < ioApic.gsiCount_) {
+                return &ioApic;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * \brief Read a register
+     *
+     * \param index The index of the register
+     * \return The value of the register
+     */
+    uint32_t IoApic::read(uint8_t index) const
+    {
+        registers_[REGISTER_SELECT] = index;
+        return registers_[REGISTER_WINDOW];
+    }
+
+    /**
+     * \brief Write a register
+     *
+     * \param index The index of the register
+     * \param value The value to write
+     */
+    void IoApic::write(uint8_t index, uint32_t value)
+    {
+        registers_[REGISTER_SELECT] = index;
+        registers_[REGISTER_WINDOW] = value;
+    }
+}
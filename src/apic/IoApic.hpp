@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../acpi/Acpi.hpp"
+
+namespace apic
+{
+    /**
+     * \brief Route the interrupt lines of the devices to the local APICs
+     *
+     * An I/O APIC handles a range of global system interrupts (GSI), starting
+     * at its GSI base. Each one has a redirection entry giving its vector, its
+     * destination processor, its polarity, its trigger mode and whether it is
+     * masked. The ISA interrupt lines (IRQ0-15 of the 8259 PICs) are wired to
+     * the GSIs described by the MADT.
+     *
+     * The I/O APICs are found in the MADT by `initialize`, which masks all
+     * their lines. `routeIsaIrq` then programs an ISA line and
+     * `setIsaIrqMasked` masks or unmasks it.
+     */
+    class IoApic
+    {
+    public:
+        /// Find the I/O APICs of the MADT and mask all their lines
+        static bool initialize(const acpi::MadtInfo& madtInfo);
+        /// Send an ISA interrupt line to a vector of a processor
+        static bool routeIsaIrq(uint8_t irq, uint8_t vector,
+                                uint32_t destinationApicId, bool isMasked);
+        /// Mask or unmask an ISA interrupt line
+        static void setIsaIrqMasked(uint8_t irq, bool isMasked);
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since an object drives a device
+        IoApic(IoApic const&) = delete;
+        void operator=(IoApic const&) = delete;
+
+    private:
+        /// Initialize an I/O APIC that is not mapped yet
+        constexpr IoApic()
+            : registers_(nullptr), gsiBase_(0), gsiCount_(0)
+        {
+        }
+
+        /// Get the I/O APIC handling a global system interrupt
+        static IoApic* getForGsi(uint32_t gsi);
+
+        /// Read a register
+        uint32_t read(uint8_t index) const;
+        /// Write a register
+        void write(uint8_t index, uint32_t value);
+
+        /// The register selection and the register window
+        volatile uint32_t* registers_;
+        /// The first global system interrupt handled
+        uint32_t gsiBase_;
+        /// The number of global system interrupts handled
+        uint32_t gsiCount_;
+
+        /// The I/O APICs
+        static IoApic ioApics_[acpi::MAX_IO_APICS];
+        /// The number of I/O APICs
+        static size_t ioApicCount_;
+        /// The global system interrupt of each ISA interrupt line
+        static uint32_t isaGsis_[acpi::ISA_IRQ_COUNT];
+        /// The polarity and trigger mode of each ISA interrupt line
+        static uint16_t isaFlags_[acpi::ISA_IRQ_COUNT];
+    };
+}
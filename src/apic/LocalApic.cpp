@@ -0,0 +1,290 @@
+#include "LocalApic.hpp"
+#include "../cpu/cpu.hpp"
+#include "../interrupt.hpp"
+#include "../timer/Pit.hpp"
+#include "../memory/AddressSpace.hpp"
+
+namespace apic
+{
+    /// APIC base MSR, the local APIC is enabled
+    const uint64_t APIC_BASE_ENABLE = 1 << 11;
+    /// APIC base MSR, the registers are accessed through MSRs (x2APIC mode)
+    const uint64_t APIC_BASE_X2APIC = 1 << 10;
+    /// The MSR of the first register in x2APIC mode (the MSR of a register is
+    /// this one plus its xAPIC offset divided by 16)
+    const uint32_t X2APIC_MSR_BASE = 0x800;
+
+    /// Spurious interrupt register, the local APIC is enabled
+    const uint32_t SPURIOUS_ENABLE = 1 << 8;
+    /// Local vector table, the interrupt is masked
+    const uint32_t LVT_MASKED = 1 << 16;
+    /// Local vector table, the interrupt is delivered as a NMI
+    const uint32_t LVT_DELIVERY_NMI = 4 << 8;
+    /// Local vector table, the timer restarts when it expires
+    const uint32_t LVT_TIMER_PERIODIC = 1 << 17;
+    /// Interrupt command, the previous interrupt is not delivered yet (xAPIC
+    /// mode only)
+    const uint32_t COMMAND_PENDING = 1 << 12;
+    /// Timer divide configuration, divide the bus frequency by 16
+    const uint32_t TIMER_DIVIDE_16 = 0x3;
+
+    /// The duration of the timer calibration in milliseconds
+    const uint32_t CALIBRATION_MILLISECONDS = 10;
+
+    /// The `LocalApic` singleton instance
+    LocalApic LocalApic::instance_;
+
+    /**
+     * \brief Initialize a disabled local APIC
+     */
+    LocalApic::LocalApic()
+        : registers_(nullptr), isX2Apic_(false), isEnabled_(false),
+          timerFrequency_(0)
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `LocalApic`
+     *
+     * \return the instance of the single object of the class `LocalApic`
+     */
+    LocalApic& LocalApic::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Enable the local APIC of the processor
+     *
+     * The x2APIC mode is used if the processor supports it, the registers are
+     * mapped otherwise (once, they are at the same address for every
+     * processor). The local interrupts are masked, except LINT1 which receives
+     * the NMIs: the 8259 PICs wired to LINT0 are not used. Finally, the local
+     * APIC is enabled with `SPURIOUS_VECTOR` as its spurious vector.
+     *
+     * \param address The physical address of the registers (from the MADT)
+     * \return false if the processor has no local APIC
+     */
+    bool LocalApic::initialize(memory::PhysicalAddress address)
+    {
+        const cpu::CpuidResult features = cpu::cpuid(1);
+        if (!(features.edx & cpu::CPUID_1_EDX_APIC) ||
+            !(features.edx & cpu::CPUID_1_EDX_MSR)) {
+            return false;
+        }
+
+        uint64_t base = cpu::readMsr(cpu::MSR_APIC_BASE) | APIC_BASE_ENABLE;
+        if (features.ecx & cpu::CPUID_1_ECX_X2APIC) {
+            // The x2APIC mode can only be entered from the xAPIC mode
+            cpu::writeMsr(cpu::MSR_APIC_BASE, base);
+            base |= APIC_BASE_X2APIC;
+            isX2Apic_ = true;
+        }
+        else if (registers_ == nullptr) {
+            registers_ = (volatile uint32_t*)
+                memory::AddressSpace::mapDevice(address, memory::PAGE_SIZE);
+            if (registers_ == nullptr) {
+                return false;
+            }
+        }
+        cpu::writeMsr(cpu::MSR_APIC_BASE, base);
+
+        // Accept all the interrupts
+        write(REGISTER_TASK_PRIORITY, 0);
+
+        // Mask the local interrupts
+        write(REGISTER_LVT_TIMER, LVT_MASKED);
+        write(REGISTER_LVT_LINT0, LVT_MASKED);
+        write(REGISTER_LVT_LINT1, LVT_DELIVERY_NMI);
+        write(REGISTER_LVT_ERROR, LVT_MASKED);
+
+        write(REGISTER_SPURIOUS, SPURIOUS_ENABLE | SPURIOUS_VECTOR);
+        isEnabled_ = true;
+
+        return true;
+    }
+
+    /**
+     * \brief Return true once the local APIC is enabled
+     *
+     * \return true once `initialize` succeeded
+     */
+    bool LocalApic::isEnabled() const
+    {
+        return isEnabled_;
+    }
+
+    /**
+     * \brief Return true if the registers are accessed in x2APIC mode
+     *
+     * \return true in x2APIC mode, false in xAPIC mode
+     */
+    bool LocalApic::isX2Apic() const
+    {
+        return isX2Apic_;
+    }
+
+    /**
+     * \brief Get the identifier of the local APIC of the processor
+     *
+     * \return The identifier of the local APIC of the calling processor
+     */
+    uint32_t LocalApic::getId() const
+    {
+        const uint32_t id = read(REGISTER_ID);
+        return isX2Apic_ ? id : id >> 24;
+    }
+
+    /**
+     * \brief Acknowledge the interrupt being handled
+     *
+     * This is a single write (MMIO or MSR). It must not be done for the
+     * spurious interrupts.
+     */
+    void LocalApic::sendEndOfInterrupt()
+    {
+        write(REGISTER_END_OF_INTERRUPT, 0);
+    }
+
+    /**
+     * \brief Send an interrupt to another processor
+     *
+     * In xAPIC mode, the destination is written first since writing the low
+     * half of the command register sends the interrupt, then the function
+     * waits for the delivery. In x2APIC mode, the command is a single MSR
+     * write.
+     *
+     * \param destinationApicId The local APIC identifier of the processor
+     * \param command The delivery mode and vector (`COMMAND_INIT`,
+     * `COMMAND_STARTUP | page` or `COMMAND_FIXED | vector`)
+     */
+    void LocalApic::sendInterProcessorInterrupt(uint32_t destinationApicId,
+                                                uint32_t command)
+    {
+        if (isX2Apic_) {
+            cpu::writeMsr(X2APIC_MSR_BASE + (REGISTER_INTERRUPT_COMMAND >> 4),
+                          (uint64_t) destinationApicId << 32 | command);
+            return;
+        }
+
+        // An interrupt handler sending an interrupt between the two writes
+        // would change the destination
+        uint32_t flags = saveAndDisableInterrupts();
+        write(REGISTER_INTERRUPT_COMMAND_HIGH, destinationApicId << 24);
+        write(REGISTER_INTERRUPT_COMMAND, command);
+        while (read(REGISTER_INTERRUPT_COMMAND) & COMMAND_PENDING) {
+            __asm__ volatile ("pause");
+        }
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Measure the frequency of the timer with the PIT
+     *
+     * The timer counts down from its maximum while the channel 2 of the PIT
+     * counts `CALIBRATION_MILLISECONDS` ms. Interrupts are disabled during the
+     * measure.
+     *
+     * \return The number of timer ticks per millisecond
+     */
+    uint32_t LocalApic::calibrateTimer()
+    {
+        const uint16_t pitCount = timer::PIT_FREQUENCY / 1000
+                                  * CALIBRATION_MILLISECONDS;
+
+        uint32_t flags = saveAndDisableInterrupts();
+
+        write(REGISTER_TIMER_DIVIDE, TIMER_DIVIDE_16);
+        write(REGISTER_LVT_TIMER, LVT_MASKED);
+        write(REGISTER_TIMER_INITIAL, 0xFFFFFFFF);
+        timer::startPitCountdown(pitCount);
+
+        while (!timer::isPitCountdownOver())
+            ;
+
+        const uint32_t elapsed = 0xFFFFFFFF - read(REGISTER_TIMER_CURRENT);
+        write(REGISTER_TIMER_INITIAL, 0);
+        timer::stopPitCountdown();
+
+        restoreInterrupts(flags);
+
+        timerFrequency_ = elapsed / CALIBRATION_MILLISECONDS;
+        return timerFrequency_;
+    }
+
+    /**
+     * \brief Get the number of timer ticks per millisecond
+     *
+     * \return The number of timer ticks per millisecond (0 if the timer is not
+     * calibrated)
+     */
+    uint32_t LocalApic::getTimerFrequency() const
+    {
+        return timerFrequency_;
+    }
+
+    /**
+     * \brief Start the timer
+     *
+     * \param vector The vector of the timer interrupt
+     * \param count The number of ticks before the interrupt
+     * \param isPeriodic true to restart the timer each time it expires
+     */
+    void LocalApic::startTimer(uint8_t vector, uint32_t count, bool isPeriodic)
+    {
+        write(REGISTER_TIMER_DIVIDE, TIMER_DIVIDE_16);
+        write(REGISTER_LVT_TIMER,
+              vector | (isPeriodic ? LVT_TIMER_PERIODIC : 0));
+        write(REGISTER_TIMER_INITIAL, count);
+    }
+
+    /**
+     * \brief Stop the timer
+     */
+    void LocalApic::stopTimer()
+    {
+        write(REGISTER_LVT_TIMER, LVT_MASKED);
+        write(REGISTER_TIMER_INITIAL, 0);
+    }
+
+    /**
+     * \brief Get the number of ticks before the timer expires
+     *
+     * \return The current count of the timer
+     */
+    uint32_t LocalApic::getTimerCount() const
+    {
+        return read(REGISTER_TIMER_CURRENT);
+    }
+
+    /**
+     * \brief Read a register
+     *
+     * \param offset The offset of the register in xAPIC mode
+     * \return The value of the register
+     */
+    uint32_t LocalApic::read(uint32_t offset) const
+    {
+        if (isX2Apic_) {
+            return cpu::readMsr(X2APIC_MSR_BASE + (offset >> 4));
+        }
+
+        return registers_[offset / 4];
+    }
+
+    /**
+     * \brief Write a register
+     *
+     * \param offset The offset of the register in xAPIC mode
+     * \param value The value to write
+     */
+    void LocalApic::write(uint32_t offset, uint32_t value)
+    {
+        if (isX2Apic_) {
+            cpu::writeMsr(X2APIC_MSR_BASE + (offset >> 4), value);
+        }
+        else {
+            registers_[offset / 4] = value;
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "../memory/memory.hpp"
+
+namespace apic
+{
+    /// The vector of the spurious interrupts of the local APIC (they must not
+    /// be acknowledged)
+    const uint8_t SPURIOUS_VECTOR = 0xFF;
+
+    /**
+     * \brief Drive the local APIC of the processor
+     *
+     * The local APIC receives the interrupts of the processor (from the I/O
+     * APICs, its timer and the other processors) and is told when they are
+     * handled. Its registers are accessed either through memory-mapped I/O
+     * (xAPIC mode) or through model specific registers (x2APIC mode, used
+     * when the processor supports it). Either way, acknowledging an interrupt
+     * is a single write.
+     *
+     * The timer counts down from an initial count at the bus frequency
+     * divided by 16. `calibrateTimer` measures its frequency with the PIT so
+     * it can be programmed in milliseconds.
+     *
+     * Example:
+     * \code
+     * apic::LocalApic& localApic = apic::LocalApic::getInstance();
+     * if (localApic.initialize(madtInfo.localApicAddress)) {
+     *     localApic.calibrateTimer();
+     *     // An interrupt on vector 0x40 every 10 ms
+     *     localApic.startTimer(0x40, 10 * localApic.getTimerFrequency(),
+     *                          true);
+     * }
+     * \endcode
+     */
+    class LocalApic
+    {
+    public:
+        /// Get the instance of the singleton object `LocalApic`
+        static LocalApic& getInstance();
+
+        /// Enable the local APIC of the processor
+        bool initialize(memory::PhysicalAddress address);
+        /// Return true once the local APIC is enabled
+        bool isEnabled() const;
+        /// Return true if the registers are accessed in x2APIC mode
+        bool isX2Apic() const;
+        /// Get the identifier of the local APIC of the processor
+        uint32_t getId() const;
+
+        /// Acknowledge the interrupt being handled
+        void sendEndOfInterrupt();
+
+        /// Send an interrupt to another processor
+        void sendInterProcessorInterrupt(uint32_t destinationApicId,
+                                         uint32_t command);
+
+        /// Measure the frequency of the timer with the PIT
+        uint32_t calibrateTimer();
+        /// Get the number of timer ticks per millisecond
+        uint32_t getTimerFrequency() const;
+        /// Start the timer
+        void startTimer(uint8_t vector, uint32_t count, bool isPeriodic);
+        /// Stop the timer
+        void stopTimer();
+        /// Get the number of ticks before the timer expires
+        uint32_t getTimerCount() const;
+
+        /// Read a register (offset of the register in xAPIC mode)
+        uint32_t read(uint32_t offset) const;
+        /// Write a register (offset of the register in xAPIC mode)
+        void write(uint32_t offset, uint32_t value);
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the is a singleton
+        LocalApic(LocalApic const&) = delete;
+        void operator=(LocalApic const&) = delete;
+
+        /// The register offsets (in xAPIC mode)
+        static const uint32_t REGISTER_ID                 = 0x020;
+        static const uint32_t REGISTER_VERSION            = 0x030;
+        static const uint32_t REGISTER_TASK_PRIORITY      = 0x080;
+        static const uint32_t REGISTER_END_OF_INTERRUPT   = 0x0B0;
+        static const uint32_t REGISTER_SPURIOUS           = 0x0F0;
+        static const uint32_t REGISTER_ERROR_STATUS       = 0x280;
+        static const uint32_t REGISTER_INTERRUPT_COMMAND  = 0x300;
+        static const uint32_t REGISTER_INTERRUPT_COMMAND_HIGH = 0x310;
+        static const uint32_t REGISTER_LVT_TIMER          = 0x320;
+        static const uint32_t REGISTER_LVT_LINT0          = 0x350;
+        static const uint32_t REGISTER_LVT_LINT1          = 0x360;
+        static const uint32_t REGISTER_LVT_ERROR          = 0x370;
+        static const uint32_t REGISTER_TIMER_INITIAL      = 0x380;
+        static const uint32_t REGISTER_TIMER_CURRENT      = 0x390;
+        static const uint32_t REGISTER_TIMER_DIVIDE       = 0x3E0;
+
+        /// Interrupt command, deliver an INIT (reset the processor)
+        static const uint32_t COMMAND_INIT    = 0x4500;
+        /// Interrupt command, deliver a startup IPI (the vector is the page
+        /// number of the real-mode entry point)
+        static const uint32_t COMMAND_STARTUP = 0x4600;
+        /// Interrupt command, deliver the vector in the low byte
+        static const uint32_t COMMAND_FIXED   = 0x4000;
+
+    private:
+        /// Initialize a disabled local APIC
+        LocalApic();
+
+        /// The `LocalApic` singleton instance
+        static LocalApic instance_;
+
+        /// The registers in xAPIC mode (nullptr in x2APIC mode)
+        volatile uint32_t* registers_;
+        /// True if the registers are accessed in x2APIC mode
+        bool isX2Apic_;
+        /// True once the local APIC is enabled
+        bool isEnabled_;
+        /// The number of timer ticks per millisecond (0 until calibrated)
+        uint32_t timerFrequency_;
+    };
+}
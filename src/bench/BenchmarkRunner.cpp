@@ -0,0 +1,169 @@
+#include "BenchmarkRunner.hpp"
+#include "../interrupt.hpp"
+#include "../cpu/cpu.hpp"
+#include "../util/format.hpp"
+
+namespace bench
+{
+    /// The `BenchmarkRunner` singleton instance
+    BenchmarkRunner BenchmarkRunner::instance_;
+
+    /**
+     * \brief Initialize the runner without benchmarks
+     */
+    BenchmarkRunner::BenchmarkRunner()
+        : benchmarks_(), benchmarkCount_(0), overhead_(0), samples_()
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `BenchmarkRunner`
+     *
+     * \return the instance of the single object of the class
+     * `BenchmarkRunner`
+     */
+    BenchmarkRunner& BenchmarkRunner::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Register a benchmark
+     *
+     * \param name The name of the benchmark in the results, without spaces
+     * \param function The function measured
+     * \param context The argument of `function`
+     * \param batch The number of calls per sample (cheap functions need
+     * enough calls to hide the cost of reading the time stamp counter)
+     * \return false if `MAX_BENCHMARKS` benchmarks are already registered
+     */
+    bool BenchmarkRunner::add(const char* name, BenchmarkFunction function,
+                              void* context, uint32_t batch)
+    {
+        if (benchmarkCount_ == MAX_BENCHMARKS) {
+            return false;
+        }
+
+        benchmarks_[benchmarkCount_++] = {name, function, context,
+                                          batch > 0 ? batch : 1};
+        return true;
+    }
+
+    /**
+     * \brief Measure a function
+     *
+     * \param function The function
+     * \param context The argument of `function`
+     * \param batch The number of calls per sample
+     * \return The statistics of the samples, in cycles per call
+     */
+    BenchmarkResult BenchmarkRunner::run(BenchmarkFunction function,
+                                         void* context, uint32_t batch)
+    {
+        const uint32_t flags = saveAndDisableInterrupts();
+        if (overhead_ == 0) {
+            measureOverhead();
+        }
+
+        for (uint32_t i = 0; i < WARMUP_SAMPLES; ++i) {
+            measure(function, context, batch);
+        }
+
+        for (uint32_t i = 0; i < SAMPLE_COUNT; ++i) {
+            const uint64_t cycles = measure(function, context, batch);
+            const uint32_t sample = cycles > overhead_
+                                        ? (cycles - overhead_) / batch
+                                        : 0;
+
+            // Insertion sort, the samples are mostly close to each other
+            uint32_t j = i;
+            for (; j > 0 && samples_[j - 1] > sample; --j) {
+                samples_[j] = samples_[j - 1];
+            }
+            samples_[j] = sample;
+        }
+        restoreInterrupts(flags);
+
+        return {samples_[0], samples_[SAMPLE_COUNT / 2],
+                samples_[(SAMPLE_COUNT - 1) * 99 / 100]};
+    }
+
+    /**
+     * \brief Measure every benchmark and write the results to an output
+     *
+     * \param output The function writing a line
+     * \param context The context of `output` (the `SerialPort` read by the
+     * host script for `writeLogToSerialPort`)
+     */
+    void BenchmarkRunner::runAll(LogSinkFunction output, void* context)
+    {
+        char line[160];
+
+        const uint32_t flags = saveAndDisableInterrupts();
+        measureOverhead();
+        restoreInterrupts(flags);
+
+        size_t length = util::format(
+            line, sizeof(line), FORMAT("bench-begin count={} overhead={}\n"),
+            benchmarkCount_, overhead_);
+        output(line, length, context);
+
+        for (size_t i = 0; i < benchmarkCount_; ++i) {
+            const Benchmark& benchmark = benchmarks_[i];
+            const BenchmarkResult result = run(benchmark.function,
+                                               benchmark.context,
+                                               benchmark.batch);
+
+            length = util::format(line, sizeof(line),
+                                  FORMAT("bench name={} batch={} samples={} "
+                                         "min={} median={} p99={}\n"),
+                                  benchmark.name, benchmark.batch,
+                                  SAMPLE_COUNT, result.min, result.median,
+                                  result.p99);
+            output(line, length, context);
+        }
+
+        const char end[] = "bench-end\n";
+        output(end, sizeof(end) - 1, context);
+    }
+
+    /**
+     * \brief Measure the cycles of a batch of calls
+     *
+     * \param function The function
+     * \param context The argument of `function`
+     * \param batch The number of calls
+     * \return The number of TSC cycles, with the cost of reading the time
+     * stamp counter
+     */
+    uint64_t BenchmarkRunner::measure(BenchmarkFunction function,
+                                      void* context, uint32_t batch)
+    {
+        const uint64_t start = cpu::readTsc();
+        for (uint32_t i = 0; i < batch; ++i) {
+            function(context);
+        }
+
+        return cpu::readTsc() - start;
+    }
+
+    /**
+     * \brief Measure the cost of reading the time stamp counter
+     *
+     * The fastest of `SAMPLE_COUNT` empty samples is kept. Interrupts must be
+     * disabled.
+     */
+    void BenchmarkRunner::measureOverhead()
+    {
+        uint64_t overhead = UINT64_MAX;
+        for (uint32_t i = 0; i < SAMPLE_COUNT; ++i) {
+            const uint64_t start = cpu::readTsc();
+            const uint64_t cycles = cpu::readTsc() - start;
+            if (cycles < overhead) {
+                overhead = cycles;
+            }
+        }
+
+        overhead_ = overhead;
+    }
+}
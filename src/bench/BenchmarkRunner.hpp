@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../LogSinks.hpp"
+
+/**
+ * The microbenchmarks of the kernel, run by the benchmark image
+ * (`make bench`).
+ *
+ * Example:
+ * \code
+ * bench::BenchmarkRunner& runner = bench::BenchmarkRunner::getInstance();
+ * runner.add("convert-hexa", convertNumber, &state, 100);
+ * runner.runAll(writeLogToSerialPort, &com1);
+ * \endcode
+ */
+namespace bench
+{
+    /// A function measured by a benchmark: one iteration, with the context
+    /// given to `BenchmarkRunner::add`
+    typedef void (*BenchmarkFunction)(void* context);
+
+    /// The number of samples run and discarded before the measure
+    const uint32_t WARMUP_SAMPLES = 100;
+    /// The number of samples measured per benchmark
+    const uint32_t SAMPLE_COUNT   = 1000;
+
+    /// The statistics of a benchmark, in TSC cycles per iteration
+    struct BenchmarkResult
+    {
+        /// The fastest sample
+        uint32_t min;
+        /// The median sample
+        uint32_t median;
+        /// The sample slower than 99% of the others
+        uint32_t p99;
+    };
+
+    /// Keep the compiler from removing the computation of a value
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+        __asm__ volatile ("" : : "g"(value) : "memory");
+    }
+
+    /**
+     * \brief Register the benchmarks and measure them
+     *
+     * A benchmark is a function run `batch` times per sample, the batch being
+     * timed with the time stamp counter. The benchmarks run with interrupts
+     * disabled: `WARMUP_SAMPLES` samples fill the caches and train the
+     * branch predictors, then `SAMPLE_COUNT` samples are measured. The cost
+     * of reading the time stamp counter (the fastest empty sample) is taken
+     * off every sample before it is divided by the batch.
+     *
+     * `runAll` writes one line per benchmark to an output (COM1 for the host
+     * script tools/bench.py, the standard output of the host build):
+     * \code
+     * bench-begin count=5 overhead=24
+     * bench name=convert-hexa batch=100 samples=1000 min=31 median=32 p99=40
+     * bench-end
+     * \endcode
+     */
+    class BenchmarkRunner
+    {
+    public:
+        /// The largest number of benchmarks
+        static const size_t MAX_BENCHMARKS = 32;
+
+        /// Get the instance of the singleton object `BenchmarkRunner`
+        static BenchmarkRunner& getInstance();
+
+        /// Register a benchmark
+        bool add(const char* name, BenchmarkFunction function, void* context,
+                 uint32_t batch = 1);
+        /// Measure a function
+        BenchmarkResult run(BenchmarkFunction function, void* context,
+                            uint32_t batch);
+        /// Measure every benchmark and write the results to an output
+        void runAll(LogSinkFunction output, void* context);
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since it is a singleton
+        BenchmarkRunner(BenchmarkRunner const&) = delete;
+        void operator=(BenchmarkRunner const&) = delete;
+
+    private:
+        /// A registered benchmark
+        struct Benchmark
+        {
+            /// The name in the results (no spaces)
+            const char* name;
+            /// The function measured
+            BenchmarkFunction function;
+            /// The argument of `function`
+            void* context;
+            /// The number of calls per sample
+            uint32_t batch;
+        };
+
+        /// Initialize the runner without benchmarks
+        BenchmarkRunner();
+
+        /// Measure the cycles of a batch of calls
+        static uint64_t measure(BenchmarkFunction function, void* context,
+                                uint32_t batch);
+        /// Measure the cost of reading the time stamp counter
+        void measureOverhead();
+
+        /// The `BenchmarkRunner` singleton instance
+        static BenchmarkRunner instance_;
+
+        /// The registered benchmarks
+        Benchmark benchmarks_[MAX_BENCHMARKS];
+        /// The number of benchmarks in `benchmarks_`
+        size_t benchmarkCount_;
+        /// The cycles of an empty sample
+        uint64_t overhead_;
+        /// The cycles per iteration of the samples, sorted once measured
+        uint32_t samples_[SAMPLE_COUNT];
+    };
+}
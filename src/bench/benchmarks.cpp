@@ -0,0 +1,124 @@
+#include "benchmarks.hpp"
+#include "../util/RingBuffer.hpp"
+#include "../util/util.hpp"
+
+namespace bench
+{
+    /// A line of text filling a row of the terminal, with its newline
+    static const char TERMINAL_LINE[] =
+        "The quick brown fox jumps over the lazy dog, then over the lazy "
+        "cat, then home.\n";
+    /// The text sent by the serial port benchmark
+    static const char SERIAL_TEXT[] = "0123456789abcdef0123456789abcdef";
+
+    /// The buffer of the ring buffer benchmark, the type of the scancode
+    /// buffer of `Keyboard`
+    static util::RingBuffer<uint8_t, 256> ringBuffer;
+    /// The number converted by the next iteration
+    static uint32_t hexaNumber = 0;
+
+    /**
+     * \brief Write a character to the terminal
+     *
+     * A batch of 80 calls writes a row, so the samples include the wraps and
+     * some scrolls.
+     *
+     * \param context The `Terminal`
+     */
+    static void writeTerminalCharacter(void* context)
+    {
+        static_cast<Terminal*>(context)->write("x");
+    }
+
+    /**
+     * \brief Write a full row to the terminal, which scrolls it once full
+     *
+     * \param context The `Terminal`
+     */
+    static void writeTerminalLine(void* context)
+    {
+        static_cast<Terminal*>(context)->write(TERMINAL_LINE);
+    }
+
+    /**
+     * \brief Scroll the terminal one row
+     *
+     * \param context The `Terminal`
+     */
+    static void scrollTerminal(void* context)
+    {
+        static_cast<Terminal*>(context)->write("\n");
+    }
+
+    /**
+     * \brief Queue text on the serial port
+     *
+     * With interrupts disabled the transmit buffer only empties as fast as
+     * the port takes the characters, so this measures the steady rate of
+     * the port.
+     *
+     * \param context The `SerialPort`
+     */
+    static void writeSerialPort(void* context)
+    {
+        static_cast<SerialPort*>(context)->write(SERIAL_TEXT,
+                                                 sizeof(SERIAL_TEXT) - 1);
+    }
+
+    /**
+     * \brief Push a byte in a ring buffer and pop it
+     *
+     * Only the buffer of the keyboard path is measured: the keyboard port
+     * cannot be fed here (the host build measures the whole path, see
+     * host/bench.cpp).
+     *
+     * \param context Unused
+     */
+    static void pushPopRingBuffer(void* context)
+    {
+        (void) context;
+
+        uint8_t value = 0;
+        ringBuffer.push(0x1E);
+        ringBuffer.pop(value);
+        doNotOptimize(value);
+    }
+
+    /**
+     * \brief Convert a number to hexadecimal
+     *
+     * \param context Unused
+     */
+    static void convertNumber(void* context)
+    {
+        (void) context;
+
+        char output[11];
+        util::convertToHexa(hexaNumber, output);
+        hexaNumber += 0x01234567;
+        doNotOptimize(output);
+    }
+
+    /**
+     * \brief Register the benchmarks of the terminal, the serial port, the
+     * ring buffer and the conversions
+     *
+     * \param runner The runner
+     * \param terminal The terminal written by the benchmarks (its content is
+     * lost)
+     * \param serialPort A serial port not read by the host script, nullptr to
+     * skip the serial port benchmark
+     */
+    void registerBenchmarks(BenchmarkRunner& runner, Terminal& terminal,
+                            SerialPort* serialPort)
+    {
+        runner.add("terminal-char", writeTerminalCharacter, &terminal, 80);
+        runner.add("terminal-line", writeTerminalLine, &terminal);
+        runner.add("terminal-scroll", scrollTerminal, &terminal);
+        if (serialPort != nullptr) {
+            runner.add("serial-write", writeSerialPort, serialPort);
+        }
+        runner.add("ring-buffer-push-pop", pushPopRingBuffer, nullptr, 100);
+        runner.add("convert-hexa", convertNumber, nullptr, 100);
+    }
+}
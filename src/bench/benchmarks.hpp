@@ -0,0 +1,13 @@
+#pragma once
+
+#include "BenchmarkRunner.hpp"
+#include "../SerialPort.hpp"
+#include "../Terminal.hpp"
+
+namespace bench
+{
+    /// Register the benchmarks of the terminal, the serial port, the
+    /// ring buffer and the conversions
+    void registerBenchmarks(BenchmarkRunner& runner, Terminal& terminal,
+                            SerialPort* serialPort);
+}
@@ -0,0 +1,74 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BenchmarkRunner.hpp"
+#include "benchmarks.hpp"
+#include "../LogSinks.hpp"
+#include "../SerialPort.hpp"
+#include "../Terminal.hpp"
+#include "../interrupt.hpp"
+#include "../io.hpp"
+#include "../cpu/Fpu.hpp"
+#include "../memory/AddressSpace.hpp"
+#include "../smp/smp.hpp"
+#include "../util/string.hpp"
+
+/// The port of the isa-debug-exit device of QEMU (writing to it ends QEMU)
+const uint16_t QEMU_EXIT_PORT = 0xF4;
+
+/**
+ * \brief Register the benchmarks and write their results to COM1
+ *
+ * \param terminal The terminal
+ * \param com1 The port read by the host script
+ * \param com2 The port of the serial port benchmark (nullptr if none)
+ */
+static void runBenchmarks(Terminal& terminal, SerialPort& com1,
+                          SerialPort* com2)
+{
+    bench::BenchmarkRunner& runner = bench::BenchmarkRunner::getInstance();
+    bench::registerBenchmarks(runner, terminal, com2);
+    runner.runAll(writeLogToSerialPort, &com1);
+    com1.flush();
+}
+
+/**
+ * \brief The entry point of the benchmark image
+ *
+ * The processor is set up like in the kernel, up to the interrupts, which
+ * stay disabled. The results are written to COM1, COM2 is the port written
+ * by the serial port benchmark. QEMU is stopped at the end if it has an
+ * isa-debug-exit device, otherwise the processor halts.
+ *
+ * \param magic The magic number of the bootloader (unused)
+ * \param infoAddress The physical address of the multiboot information
+ * (unused)
+ */
+extern "C" void kernel_main(uint32_t magic, memory::PhysicalAddress infoAddress)
+{
+    (void) magic;
+    (void) infoAddress;
+
+    memory::AddressSpace::initializeKernel();
+    smp::initializeBootProcessor();
+    cpu::initializeFpu();
+    util::initializeMemoryRoutines();
+    initializeIdt();
+    configPIC();
+
+    Terminal terminal;
+    SerialPort com1(SerialPort::getAddress(1));
+    const uint16_t com2Address = SerialPort::getAddress(2);
+    if (com2Address != 0) {
+        SerialPort com2(com2Address);
+        runBenchmarks(terminal, com1, &com2);
+    }
+    else {
+        runBenchmarks(terminal, com1, nullptr);
+    }
+
+    outb(QEMU_EXIT_PORT, 0);
+    while (true) {
+        __asm__ volatile ("cli\n\thlt");
+    }
+}
@@ -5,6 +5,14 @@
 .set MAGIC,    0x1BADB002       # 'magic number' lets bootloader find the header
 .set CHECKSUM, -(MAGIC + FLAGS) # checksum of above, to prove we are multiboot
 
+# Declare constants for the higher half kernel (see linker.ld).
+.set KERNEL_VIRTUAL_BASE,    0xC0000000
+.set KERNEL_DIRECTORY_INDEX, KERNEL_VIRTUAL_BASE >> 22
+.set BOOT_LARGE_PAGES, 4        # 16 MiB mapped by _start
+.set LARGE_PAGE_FLAGS, 0x83     # present, writable, 4 MiB page
+.set CR0_PG_WP, 0x80010000      # paging, write protection in the kernel
+.set CR4_PSE,   0x00000010      # 4 MiB pages
+
 # Declare a multiboot header that marks the program as a kernel. These are magic
 # values that are documented in the multiboot standard. The bootloader will
 # search for this signature in the first 8 KiB of the kernel file, aligned at a
@@ -30,8 +38,17 @@
 .align 16
 stack_bottom:
 .skip 16384 # 16 KiB
+.global stack_top
 stack_top:
 
+# The page directory of the kernel address space, aligned on a page. _start
+# fills the entries it needs to enable paging, the rest is done by
+# memory::AddressSpace::initializeKernel.
+.align 4096
+.global boot_page_directory
+boot_page_directory:
+.skip 4096
+
 .section .data
 .align 16
 gdt_start:
@@ -54,7 +71,9 @@ gdt_info:
 # The linker script specifies _start as the entry point to the kernel and the
 # bootloader will jump to this position once the kernel has been loaded. It
 # doesn't make sense to return from this function as the bootloader is gone.
-.section .text
+# _start runs before paging is enabled, so it is in a section linked at its
+# physical address and the higher half symbols it uses must be translated.
+.section .boot.text, "ax"
 .global _start
 .type _start, @function
 _start:
@@ -69,6 +88,45 @@ _start:
     # itself. It has absolute and complete power over the
     # machine.
 
+    # The bootloader put its magic number in EAX and the address of the
+    # multiboot information structure in EBX. Keep them in callee-saved
+    # registers so they survive the call to _init.
+    mov %eax, %edi
+    mov %ebx, %esi
+
+    # Map the first 16 MiB of physical memory twice with 4 MiB pages: at 0 so
+    # that the next instructions still work once paging is enabled, and at
+    # KERNEL_VIRTUAL_BASE where the kernel is linked.
+    mov $(boot_page_directory - KERNEL_VIRTUAL_BASE), %edx
+    mov $LARGE_PAGE_FLAGS, %eax
+    xor %ecx, %ecx
+1:  mov %eax, (%edx, %ecx, 4)
+    mov %eax, (KERNEL_DIRECTORY_INDEX * 4)(%edx, %ecx, 4)
+    add $0x400000, %eax
+    inc %ecx
+    cmp $BOOT_LARGE_PAGES, %ecx
+    jne 1b
+
+    # Enable 4 MiB pages, then paging
+    mov %cr4, %eax
+    or $CR4_PSE, %eax
+    mov %eax, %cr4
+    mov %edx, %cr3
+    mov %cr0, %eax
+    or $CR0_PG_WP, %eax
+    mov %eax, %cr0
+
+    # Jump to the higher half (an absolute jump: a relative one would stay in
+    # the identity mapping)
+    lea higher_half, %eax
+    jmp *%eax
+
+# Set the size of the _start symbol to the current location '.' minus its start.
+# This is useful when debugging or when you implement call tracing.
+.size _start, . - _start
+
+.section .text
+higher_half:
     # To set up a stack, we set the esp register to point to the top of our
     # stack (as it grows downwards on x86 systems). This is necessarily done
     # in assembly as languages such as C cannot function without a stack.
@@ -78,8 +136,9 @@ _start:
     # high-level kernel is entered. It's best to minimize the early
     # environment where crucial features are offline. Note that the
     # processor is not fully initialized yet: Features such as floating
-    # point instructions and instruction set extensions are not initialized
-    # yet. The GDT should be loaded here. Paging should be enabled here.
+    # point instructions and instruction set extensions are enabled later by
+    # cpu::initializeFpu. The GDT should be loaded here. Paging is enabled
+    # above.
     # C++ features such as global constructors and exceptions will require
     # runtime support to work as well.
     ## Load a basic GDT
@@ -93,14 +152,30 @@ reload:
     mov %ax, %gs
     mov %ax, %ss
 
-    # Enter the high-level kernel. The ABI requires the stack is 16-byte
+    # Run the global constructors. The ABI requires the stack is 16-byte
     # aligned at the time of the call instruction (which afterwards pushes
-    # the return pointer of size 4 bytes). The stack was originally 16-byte
-    # aligned above and we've since pushed a multiple of 16 bytes to the
-    # stack since (pushed 0 bytes so far) and the alignment is thus
-    # preserved and the call is well defined.
+    # the return pointer of size 4 bytes). Nothing was pushed since the stack
+    # was set to stack_top, which is 16-byte aligned, so these calls are well
+    # defined.
     call _init
+
+    # Call the constructors the compiler put in .init_array (_init only
+    # handles .ctors)
+    mov $__init_array_start, %ebx
+2:  cmp $__init_array_end, %ebx
+    jae 3f
+    call *(%ebx)
+    add $4, %ebx
+    jmp 2b
+3:
+    # Enter the high-level kernel. The stack is still 16-byte aligned and
+    # we push a multiple of 16 bytes (8 bytes of padding and the 2 arguments
+    # of kernel_main), so the alignment is preserved at the call.
+    sub $8, %esp
+    push %esi
+    push %edi
     call kernel_main
+    add $16, %esp
     call _fini
 
     # If the system has nothing more to do, put the computer into an
@@ -116,14 +191,3 @@ reload:
     cli
 1:  hlt
     jmp 1b
-
-.global handleInterruptKeyboard
-handleInterruptKeyboard:
-    pusha
-    call cHandleInterruptKeyboard
-    popa
-    iret
-
-# Set the size of the _start symbol to the current location '.' minus its start.
-# This is useful when debugging or when you implement call tracing.
-.size _start, . - _start
@@ -0,0 +1,430 @@
+#include "Fpu.hpp"
+#include "cpu.hpp"
+#include "../KernelLogger.hpp"
+#include "../interrupt.hpp"
+#include "../acpi/Acpi.hpp"
+#include "../sched/Scheduler.hpp"
+#include "../smp/Cpu.hpp"
+#include "../util/string.hpp"
+
+namespace cpu
+{
+    /// The vector of the device not available exception (#NM)
+    const uint8_t DEVICE_NOT_AVAILABLE_VECTOR = 7;
+    /// The alignment of the save areas (`xsave` needs 64 bytes)
+    const size_t FPU_STATE_ALIGNMENT = 64;
+    /// The largest save area (x87, SSE and AVX take 832 bytes with `xsave`)
+    const size_t MAX_FPU_STATE_SIZE = 1024;
+    /// The size of the `fnsave` area
+    const size_t FNSAVE_SIZE = 108;
+    /// The size of the `fxsave` area
+    const size_t FXSAVE_SIZE = 512;
+    /// The MXCSR after a reset (every SSE exception masked)
+    const uint32_t DEFAULT_MXCSR = 0x1F80;
+
+    /// The FPU of a processor
+    struct FpuCpu
+    {
+        /// The thread whose registers are in the FPU (nullptr if none)
+        FpuState* owner;
+        /// True if CR0.TS is set
+        bool isTrapArmed;
+        /// The number of `kernelFpuBegin` with interrupts disabled not ended
+        /// yet
+        uint32_t atomicNesting;
+        /// The flags register before the first of them
+        uint32_t atomicFlags;
+    };
+
+    /// The FPU of each processor
+    static FpuCpu fpuCpus[acpi::MAX_CPUS] = {};
+    /// The features enabled by `initializeFpu` (the same on every processor)
+    static uint32_t features = 0;
+    /// The size of the save areas
+    static size_t stateSize = 0;
+    /// The components saved by `xsave` (XCR0)
+    static uint64_t xsaveMask = 0;
+    /// The registers after `initializeFpu`, copied into the new save areas
+    static uint8_t initialState[MAX_FPU_STATE_SIZE]
+        __attribute__((aligned(FPU_STATE_ALIGNMENT)));
+
+    /**
+     * \brief Save the registers into a save area
+     *
+     * CR0.TS must be clear.
+     *
+     * \param area The save area
+     */
+    static void saveRegisters(uint8_t* area)
+    {
+        if (features & FPU_XSAVE) {
+            __asm__ volatile (
+                "xsave (%0)"
+                :
+                : "r"(area), "a"((uint32_t) xsaveMask),
+                  "d"((uint32_t) (xsaveMask >> 32))
+                : "memory"
+            );
+        }
+        else if (features & FPU_SSE) {
+            __asm__ volatile ("fxsave (%0)" : : "r"(area) : "memory");
+        }
+        else {
+            __asm__ volatile ("fnsave (%0)" : : "r"(area) : "memory");
+        }
+    }
+
+    /**
+     * \brief Load the registers from a save area
+     *
+     * CR0.TS must be clear.
+     *
+     * \param area The save area
+     */
+    static void restoreRegisters(const uint8_t* area)
+    {
+        if (features & FPU_XSAVE) {
+            __asm__ volatile (
+                "xrstor (%0)"
+                :
+                : "r"(area), "a"((uint32_t) xsaveMask),
+                  "d"((uint32_t) (xsaveMask >> 32))
+                : "memory"
+            );
+        }
+        else if (features & FPU_SSE) {
+            __asm__ volatile ("fxrstor (%0)" : : "r"(area) : "memory");
+        }
+        else {
+            __asm__ volatile ("frstor (%0)" : : "r"(area) : "memory");
+        }
+    }
+
+    /**
+     * \brief Set CR0.TS, so the next FPU or vector instruction traps
+     *
+     * \param fpuCpu The FPU of the calling processor
+     */
+    static void setTrap(FpuCpu& fpuCpu)
+    {
+        writeCr0(readCr0() | CR0_TS);
+        fpuCpu.isTrapArmed = true;
+    }
+
+    /**
+     * \brief Clear CR0.TS if it is set
+     *
+     * \param fpuCpu The FPU of the calling processor
+     */
+    static void clearTrap(FpuCpu& fpuCpu)
+    {
+        if (fpuCpu.isTrapArmed) {
+            clts();
+            fpuCpu.isTrapArmed = false;
+        }
+    }
+
+    /**
+     * \brief Get the save area of the running thread
+     *
+     * \return The save area, nullptr if there is no thread yet or the thread
+     * never called `kernelFpuBegin`
+     */
+    static FpuState* getCurrentState()
+    {
+        sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+        if (!scheduler.isInitialized()) {
+            return nullptr;
+        }
+
+        sched::Thread* thread = scheduler.getCurrentThread();
+        return thread != nullptr ? thread->getFpuState() : nullptr;
+    }
+
+    /**
+     * \brief Give the registers to the running thread (#NM handler)
+     *
+     * The registers of their owner are saved, then the ones of the running
+     * thread are loaded. If the running thread already owns them (nobody
+     * used them since it was switched out), clearing CR0.TS is enough.
+     * Vector instructions outside `kernelFpuBegin` are a bug of the kernel:
+     * the processor is halted.
+     *
+     * \param frame The state of the processor when the exception occurred
+     * \param context Unused
+     */
+    static void handleDeviceNotAvailable(InterruptFrame& frame, void* context)
+    {
+        (void) context;
+
+        FpuCpu& fpuCpu = fpuCpus[smp::getCurrentCpu()->index];
+        FpuState* state = getCurrentState();
+        if (state == nullptr || features == 0) {
+            const uint32_t address = frame.eip;
+            klog(LogLevel::ERROR,
+                 "FPU used outside kernelFpuBegin at {:#010x}", address);
+            KernelLogger::getInstance().drain();
+            while (true) {
+                __asm__ volatile ("cli; hlt");
+            }
+        }
+
+        clearTrap(fpuCpu);
+        if (fpuCpu.owner != state) {
+            if (fpuCpu.owner != nullptr) {
+                saveRegisters(fpuCpu.owner->area);
+            }
+            restoreRegisters(state->area);
+            fpuCpu.owner = state;
+        }
+    }
+
+    /**
+     * \brief Enable the FPU and the vector registers of the calling processor
+     *
+     * CR0.EM is cleared and CR0.MP and CR0.NE set, then SSE (CR4.OSFXSR and
+     * CR4.OSXMMEXCPT), XSAVE (CR4.OSXSAVE) and AVX (XCR0) are enabled if
+     * CPUID reports them. The registers are reset and CR0.TS is set.
+     *
+     * The bootstrap processor also records the features and the size of the
+     * save areas, keeps its reset registers for the new save areas and
+     * handles #NM. It must be called on every processor before it runs
+     * threads, and on the bootstrap processor before the other ones start.
+     */
+    void initializeFpu()
+    {
+        const CpuidResult leaf1 = cpuid(1);
+        const size_t cpuIndex = smp::getCurrentCpu()->index;
+        FpuCpu& fpuCpu = fpuCpus[cpuIndex];
+
+        uint32_t cr0 = readCr0() & ~(CR0_EM | CR0_TS);
+        if (!(leaf1.edx & CPUID_1_EDX_FPU)) {
+            writeCr0(cr0 | CR0_EM);
+            return;
+        }
+        writeCr0(cr0 | CR0_MP | CR0_NE);
+
+        uint32_t enabled = FPU_X87;
+        size_t size = FNSAVE_SIZE;
+        uint32_t cr4 = readCr4();
+        if ((leaf1.edx & CPUID_1_EDX_FXSR) && (leaf1.edx & CPUID_1_EDX_SSE)) {
+            cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+            enabled |= FPU_SSE;
+            size = FXSAVE_SIZE;
+            if (leaf1.edx & CPUID_1_EDX_SSE2) {
+                enabled |= FPU_SSE2;
+            }
+        }
+        if ((enabled & FPU_SSE) && (leaf1.ecx & CPUID_1_ECX_XSAVE)) {
+            cr4 |= CR4_OSXSAVE;
+        }
+        writeCr4(cr4);
+
+        uint64_t mask = 0;
+        if (cr4 & CR4_OSXSAVE) {
+            mask = XCR0_X87 | XCR0_SSE;
+            if (leaf1.ecx & CPUID_1_ECX_AVX) {
+                mask |= XCR0_AVX;
+            }
+            xsetbv(0, mask);
+
+            // The size of the area for the components of XCR0
+            const size_t xsaveSize = cpuid(0xD, 0).ebx;
+            if (xsaveSize <= MAX_FPU_STATE_SIZE) {
+                enabled |= FPU_XSAVE;
+                if (mask & XCR0_AVX) {
+                    enabled |= FPU_AVX;
+                }
+                size = xsaveSize;
+            }
+        }
+
+        __asm__ volatile ("fninit");
+        if (enabled & FPU_SSE) {
+            const uint32_t mxcsr = DEFAULT_MXCSR;
+            __asm__ volatile ("ldmxcsr %0" : : "m"(mxcsr));
+        }
+
+        if (cpuIndex == 0) {
+            features = enabled;
+            stateSize = size;
+            xsaveMask = mask;
+            saveRegisters(initialState);
+            if (!(enabled & FPU_XSAVE)) {
+                // fnsave reset the registers, load them back
+                restoreRegisters(initialState);
+            }
+            registerInterruptHandler(DEVICE_NOT_AVAILABLE_VECTOR,
+                                     handleDeviceNotAvailable, nullptr);
+        }
+
+        fpuCpu.owner = nullptr;
+        setTrap(fpuCpu);
+    }
+
+    /**
+     * \brief Get the features enabled by `initializeFpu`
+     *
+     * \return The `FPU_*` flags, 0 before `initializeFpu` or without FPU
+     */
+    uint32_t getFpuFeatures()
+    {
+        return features;
+    }
+
+    /**
+     * \brief Get the size of the saved registers
+     *
+     * \return The size of the `fnsave`, `fxsave` or `xsave` area
+     */
+    size_t getFpuStateSize()
+    {
+        return stateSize;
+    }
+
+    /**
+     * \brief Allocate the save area of a thread
+     *
+     * The area holds the registers as reset by `initializeFpu`.
+     *
+     * \return The area, nullptr if there is no memory left or no FPU
+     */
+    FpuState* createFpuState()
+    {
+        if (features == 0) {
+            return nullptr;
+        }
+
+        FpuState* state = new FpuState;
+        if (state == nullptr) {
+            return nullptr;
+        }
+
+        state->block = new uint8_t[stateSize + FPU_STATE_ALIGNMENT - 1];
+        if (state->block == nullptr) {
+            delete state;
+            return nullptr;
+        }
+
+        state->area = (uint8_t*) (((uintptr_t) state->block
+                                   + FPU_STATE_ALIGNMENT - 1)
+                                  & ~(FPU_STATE_ALIGNMENT - 1));
+        state->nesting = 0;
+        memcpy(state->area, initialState, stateSize);
+
+        return state;
+    }
+
+    /**
+     * \brief Free the save area of a thread
+     *
+     * Called on the processor of the thread, once it no longer runs. If the
+     * thread still owns the registers, they are simply forgotten.
+     *
+     * \param state The area returned by `createFpuState`
+     */
+    void destroyFpuState(FpuState* state)
+    {
+        const uint32_t flags = saveAndDisableInterrupts();
+        FpuCpu& fpuCpu = fpuCpus[smp::getCurrentCpu()->index];
+        if (fpuCpu.owner == state) {
+            fpuCpu.owner = nullptr;
+        }
+        restoreInterrupts(flags);
+
+        delete[] (uint8_t*) state->block;
+        delete state;
+    }
+
+    /**
+     * \brief Make the next vector instruction trap, on a context switch
+     *
+     * Called by the scheduler with interrupts disabled before it switches to
+     * another thread. CR0.TS is only written if it was cleared since the last
+     * switch, that is if a thread used the registers.
+     */
+    void armFpuTrap()
+    {
+        FpuCpu& fpuCpu = fpuCpus[smp::getCurrentCpu()->index];
+        if (!fpuCpu.isTrapArmed) {
+            setTrap(fpuCpu);
+        }
+    }
+
+    /**
+     * \brief Start using the FPU or the vector registers in kernel code
+     *
+     * With interrupts enabled in a thread, the thread gets a save area (on
+     * its first call) and keeps running with interrupts enabled: its
+     * registers are loaded by the #NM trap and saved when another thread
+     * takes them, so it can be preempted.
+     *
+     * With interrupts disabled, or before the processor runs threads, or if
+     * the save area cannot be allocated, the registers of their owner are
+     * saved at once and interrupts stay disabled until `kernelFpuEnd`. Such
+     * sections must be short.
+     *
+     * The calls can be nested. The registers hold garbage when this returns
+     * (MXCSR and the x87 control word are valid).
+     */
+    void kernelFpuBegin()
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+        FpuCpu& fpuCpu = fpuCpus[smp::getCurrentCpu()->index];
+
+        if ((flags & EFLAGS_IF) && fpuCpu.atomicNesting == 0) {
+            sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+            sched::Thread* thread = scheduler.isInitialized()
+                                        ? scheduler.getCurrentThread()
+                                        : nullptr;
+            if (thread != nullptr && thread->getFpuState() == nullptr) {
+                restoreInterrupts(flags);
+                thread->setFpuState(createFpuState());
+                flags = saveAndDisableInterrupts();
+            }
+
+            if (thread != nullptr && thread->getFpuState() != nullptr) {
+                ++thread->getFpuState()->nesting;
+                restoreInterrupts(flags);
+                return;
+            }
+        }
+
+        if (fpuCpu.atomicNesting++ == 0) {
+            fpuCpu.atomicFlags = flags;
+            clearTrap(fpuCpu);
+            if (fpuCpu.owner != nullptr) {
+                saveRegisters(fpuCpu.owner->area);
+                fpuCpu.owner = nullptr;
+            }
+        }
+    }
+
+    /**
+     * \brief Stop using the FPU or the vector registers in kernel code
+     *
+     * Ends the last `kernelFpuBegin`. After a section with interrupts
+     * disabled, CR0.TS is set (the registers belong to nobody) and the
+     * interrupts are restored. A thread keeps its registers loaded until
+     * another thread needs them.
+     */
+    void kernelFpuEnd()
+    {
+        const uint32_t flags = saveAndDisableInterrupts();
+        FpuCpu& fpuCpu = fpuCpus[smp::getCurrentCpu()->index];
+
+        if (fpuCpu.atomicNesting > 0) {
+            if (--fpuCpu.atomicNesting == 0) {
+                setTrap(fpuCpu);
+                restoreInterrupts(fpuCpu.atomicFlags);
+            }
+            return;
+        }
+
+        FpuState* state = getCurrentState();
+        if (state != nullptr && state->nesting > 0) {
+            --state->nesting;
+        }
+        restoreInterrupts(flags);
+    }
+}
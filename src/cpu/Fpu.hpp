@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The x87 FPU and the vector registers (SSE, AVX) in the kernel.
+ *
+ * `initializeFpu` enables what CPUID reports on each processor: CR0.EM is
+ * cleared, CR4.OSFXSR and CR4.OSXMMEXCPT are set with SSE, CR4.OSXSAVE and
+ * XCR0 with XSAVE (the AVX registers too if present). The kernel itself is
+ * built without SSE, so the compiler never uses the registers: kernel code
+ * only uses them between `kernelFpuBegin` and `kernelFpuEnd`.
+ *
+ * The registers are switched lazily. A thread that calls `kernelFpuBegin`
+ * gets a save area; its registers are only loaded when it executes a vector
+ * instruction while CR0.TS is set (the #NM trap), after the registers of
+ * their previous owner are saved. A context switch only sets CR0.TS, and
+ * only if the registers were given to a thread since: the threads that never
+ * touch them pay nothing. With interrupts disabled (an interrupt handler,
+ * `memcpy`), `kernelFpuBegin` saves the registers of their owner at once
+ * instead, and `kernelFpuEnd` sets CR0.TS so the owner reloads them.
+ *
+ * Example:
+ * \code
+ * cpu::kernelFpuBegin();
+ * __asm__ volatile ("pxor %%xmm0, %%xmm0" : : : "memory");
+ * cpu::kernelFpuEnd();
+ * \endcode
+ */
+namespace cpu
+{
+    /// The x87 FPU is present
+    const uint32_t FPU_X87   = 1 << 0;
+    /// SSE is enabled
+    const uint32_t FPU_SSE   = 1 << 1;
+    /// SSE2 is enabled
+    const uint32_t FPU_SSE2  = 1 << 2;
+    /// The registers are saved with `xsave`
+    const uint32_t FPU_XSAVE = 1 << 3;
+    /// AVX is enabled
+    const uint32_t FPU_AVX   = 1 << 4;
+
+    /// The registers of a thread, saved while another one owns the FPU
+    struct FpuState
+    {
+        /// The `fnsave`, `fxsave` or `xsave` area (aligned on 64 bytes)
+        uint8_t* area;
+        /// The block of the heap holding `area`
+        void* block;
+        /// The number of `kernelFpuBegin` not ended yet
+        uint32_t nesting;
+    };
+
+    /// Enable the FPU and the vector registers of the calling processor
+    void initializeFpu();
+    /// Get the features enabled by `initializeFpu`
+    uint32_t getFpuFeatures();
+    /// Get the size of the saved registers
+    size_t getFpuStateSize();
+
+    /// Allocate the save area of a thread
+    FpuState* createFpuState();
+    /// Free the save area of a thread
+    void destroyFpuState(FpuState* state);
+    /// Make the next vector instruction trap, on a context switch
+    void armFpuTrap();
+
+    /// Start using the FPU or the vector registers in kernel code
+    void kernelFpuBegin();
+    /// Stop using the FPU or the vector registers in kernel code
+    void kernelFpuEnd();
+}
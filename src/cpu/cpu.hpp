@@ -0,0 +1,208 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Wrap the processor instructions that have no C++ equivalent
+ *
+ * These wrappers are a single instruction each, so they are defined inline to
+ * keep them out of the way of the code that uses them in hot paths.
+ */
+namespace cpu
+{
+    /// The registers returned by the `cpuid` instruction
+    struct CpuidResult
+    {
+        uint32_t eax;
+        uint32_t ebx;
+        uint32_t ecx;
+        uint32_t edx;
+    };
+
+    /// CPUID.1:EDX, x87 FPU on chip
+    const uint32_t CPUID_1_EDX_FPU = 1 << 0;
+    /// CPUID.1:EDX, time stamp counter (`rdtsc`)
+    const uint32_t CPUID_1_EDX_TSC = 1 << 4;
+    /// CPUID.1:EDX, page size extension (4 MiB pages)
+    const uint32_t CPUID_1_EDX_PSE = 1 << 3;
+    /// CPUID.1:EDX, model specific registers (`rdmsr` and `wrmsr`)
+    const uint32_t CPUID_1_EDX_MSR  = 1 << 5;
+    /// CPUID.1:EDX, on-chip local APIC
+    const uint32_t CPUID_1_EDX_APIC = 1 << 9;
+    /// CPUID.1:EDX, global pages
+    const uint32_t CPUID_1_EDX_PGE = 1 << 13;
+    /// CPUID.1:EDX, `fxsave` and `fxrstor`
+    const uint32_t CPUID_1_EDX_FXSR = 1 << 24;
+    /// CPUID.1:EDX, SSE instructions
+    const uint32_t CPUID_1_EDX_SSE = 1 << 25;
+    /// CPUID.1:EDX, SSE2 instructions
+    const uint32_t CPUID_1_EDX_SSE2 = 1 << 26;
+    /// CPUID.1:ECX, x2APIC mode of the local APIC
+    const uint32_t CPUID_1_ECX_X2APIC = 1 << 21;
+    /// CPUID.1:ECX, `xsave`, `xrstor` and XCR0
+    const uint32_t CPUID_1_ECX_XSAVE = 1 << 26;
+    /// CPUID.1:ECX, AVX instructions
+    const uint32_t CPUID_1_ECX_AVX = 1 << 28;
+    /// CPUID.7.0:EBX, enhanced `rep movsb` and `rep stosb`
+    const uint32_t CPUID_7_EBX_ERMS = 1 << 9;
+    /// The first extended CPUID leaf, EAX is the last extended leaf
+    const uint32_t CPUID_EXTENDED = 0x80000000;
+    /// The extended leaf of the power management features
+    const uint32_t CPUID_POWER_MANAGEMENT = 0x80000007;
+    /// CPUID.80000007H:EDX, the time stamp counter runs at a constant rate in
+    /// every power state (invariant TSC)
+    const uint32_t CPUID_80000007_EDX_INVARIANT_TSC = 1 << 8;
+
+    /// The MSR with the physical address and the mode of the local APIC
+    const uint32_t MSR_APIC_BASE = 0x1B;
+
+    /// CR0, monitor coprocessor (`wait` traps when CR0.TS is set)
+    const uint32_t CR0_MP  = 1 << 1;
+    /// CR0, emulation (every FPU instruction traps)
+    const uint32_t CR0_EM  = 1 << 2;
+    /// CR0, task switched (the next FPU or vector instruction traps)
+    const uint32_t CR0_TS  = 1 << 3;
+    /// CR0, numeric error (FPU errors are reported with #MF)
+    const uint32_t CR0_NE  = 1 << 5;
+    /// CR0, write protect (read-only pages are enforced in the kernel)
+    const uint32_t CR0_WP  = 1 << 16;
+    /// CR0, paging
+    const uint32_t CR0_PG  = 1u << 31;
+    /// CR4, page size extension (4 MiB pages)
+    const uint32_t CR4_PSE = 1 << 4;
+    /// CR4, global pages
+    const uint32_t CR4_PGE = 1 << 7;
+    /// CR4, the operating system saves the SSE state (SSE is enabled)
+    const uint32_t CR4_OSFXSR = 1 << 9;
+    /// CR4, the SSE floating point errors are reported with #XM
+    const uint32_t CR4_OSXMMEXCPT = 1 << 10;
+    /// CR4, `xsave` and XCR0 are enabled
+    const uint32_t CR4_OSXSAVE = 1 << 18;
+
+    /// XCR0, the x87 state
+    const uint64_t XCR0_X87 = 1 << 0;
+    /// XCR0, the SSE state (the XMM registers and MXCSR)
+    const uint64_t XCR0_SSE = 1 << 1;
+    /// XCR0, the AVX state (the upper halves of the YMM registers)
+    const uint64_t XCR0_AVX = 1 << 2;
+
+    /// EFLAGS, interrupts enabled
+    const uint32_t EFLAGS_IF = 1 << 9;
+
+    /// Execute `cpuid` for the leaf `leaf` and the sub-leaf `subLeaf`
+    inline CpuidResult cpuid(uint32_t leaf, uint32_t subLeaf = 0)
+    {
+        CpuidResult result;
+
+        __asm__ volatile (
+            "cpuid"
+            : "=a"(result.eax), "=b"(result.ebx),
+              "=c"(result.ecx), "=d"(result.edx)
+            : "a"(leaf), "c"(subLeaf)
+        );
+
+        return result;
+    }
+
+    /// Read the control register CR0
+    inline uint32_t readCr0()
+    {
+        uint32_t value;
+        __asm__ volatile ("mov %%cr0, %0" : "=r"(value));
+        return value;
+    }
+
+    /// Write the control register CR0
+    inline void writeCr0(uint32_t value)
+    {
+        __asm__ volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+    }
+
+    /// Read the control register CR2 (the address of the last page fault)
+    inline uint32_t readCr2()
+    {
+        uint32_t value;
+        __asm__ volatile ("mov %%cr2, %0" : "=r"(value));
+        return value;
+    }
+
+    /// Read the control register CR3 (the physical address of the page
+    /// directory)
+    inline uint32_t readCr3()
+    {
+        uint32_t value;
+        __asm__ volatile ("mov %%cr3, %0" : "=r"(value));
+        return value;
+    }
+
+    /// Write the control register CR3 (flushes the non-global TLB entries)
+    inline void writeCr3(uint32_t value)
+    {
+        __asm__ volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+    }
+
+    /// Read the control register CR4
+    inline uint32_t readCr4()
+    {
+        uint32_t value;
+        __asm__ volatile ("mov %%cr4, %0" : "=r"(value));
+        return value;
+    }
+
+    /// Write the control register CR4
+    inline void writeCr4(uint32_t value)
+    {
+        __asm__ volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+    }
+
+    /// Clear CR0.TS (the FPU and vector instructions no longer trap)
+    inline void clts()
+    {
+        __asm__ volatile ("clts" : : : "memory");
+    }
+
+    /// Write the extended control register `xcr` (XCR0 is 0)
+    inline void xsetbv(uint32_t xcr, uint64_t value)
+    {
+        __asm__ volatile (
+            "xsetbv"
+            :
+            : "c"(xcr), "a"((uint32_t) value), "d"((uint32_t) (value >> 32))
+            : "memory"
+        );
+    }
+
+    /// Read the model specific register `msr`
+    inline uint64_t readMsr(uint32_t msr)
+    {
+        uint32_t low, high;
+        __asm__ volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+        return (uint64_t) high << 32 | low;
+    }
+
+    /// Write the model specific register `msr`
+    inline void writeMsr(uint32_t msr, uint64_t value)
+    {
+        __asm__ volatile (
+            "wrmsr"
+            :
+            : "c"(msr), "a"((uint32_t) value), "d"((uint32_t) (value >> 32))
+            : "memory"
+        );
+    }
+
+    /// Read the time stamp counter
+    inline uint64_t readTsc()
+    {
+        uint32_t low, high;
+        __asm__ volatile ("rdtsc" : "=a"(low), "=d"(high));
+        return (uint64_t) high << 32 | low;
+    }
+
+    /// Invalidate the TLB entry of the page containing `address`
+    inline void invlpg(uintptr_t address)
+    {
+        __asm__ volatile ("invlpg (%0)" : : "r"(address) : "memory");
+    }
+}
@@ -1,15 +1,95 @@
-#include "Terminal.hpp"
 #include "io.hpp"
-#include "SerialPort.hpp"
 #include "interrupt.hpp"
-#include "Keyboard.hpp"
+#include "acpi/Acpi.hpp"
+#include "apic/IoApic.hpp"
+#include "apic/LocalApic.hpp"
+#include "cpu/cpu.hpp"
+#include "smp/Cpu.hpp"
+#include "sched/Scheduler.hpp"
+#include "timer/Timer.hpp"
 
-/// The assembly function called by a keyboard interruption
-extern "C" void handleInterruptKeyboard();
+/// The entry points of the interrupt vectors (see isr.s)
+extern "C" char interrupt_stubs[];
+/// The distance between two entry points in `interrupt_stubs`
+const uint32_t INTERRUPT_STUB_SIZE = 16;
+
+/// The number of vectors reserved for the processor exceptions
+const uint8_t EXCEPTION_COUNT = 32;
+
+/// The command port of the master PIC
+const uint16_t MASTER_COMMAND_PORT = 0x20;
+/// The data port (interrupt mask register) of the master PIC
+const uint16_t MASTER_DATA_PORT    = 0x21;
+/// The command port of the slave PIC
+const uint16_t SLAVE_COMMAND_PORT  = 0xA0;
+/// The data port (interrupt mask register) of the slave PIC
+const uint16_t SLAVE_DATA_PORT     = 0xA1;
+/// The vector of IRQ0 (master PIC)
+const uint8_t MASTER_VECTOR_BASE   = 0x20;
+/// The vector of IRQ8 (slave PIC)
+const uint8_t SLAVE_VECTOR_BASE    = 0x70;
+/// The line of the master PIC the slave PIC is wired to
+const uint8_t CASCADE_IRQ          = 2;
+/// The command to end an interrupt
+const uint8_t END_OF_INTERRUPT     = 0x20;
+/// The command to read the in-service register at the next read of the
+/// command port
+const uint8_t READ_IN_SERVICE      = 0x0B;
+
+/// A registered interrupt handler
+struct InterruptHandlerEntry
+{
+    /// The function to call (nullptr if none is registered)
+    InterruptHandler handler;
+    /// The context given to the function
+    void* context;
+};
 
 /// The interrupt descriptor table (initialized with zeros)
 uint64_t idt[256] = {};
 
+/// The handler of each interrupt vector
+static InterruptHandlerEntry handlers[256] = {};
+/// The interrupt mask of both PICs (bit n masks IRQn), everything is masked
+/// until a handler is registered
+static uint16_t irqMask = 0xFFFF;
+/// True once `configPIC` initialized the PICs (the mask is only written to
+/// them from then on)
+static bool isPicConfigured = false;
+/// True once `enableApic` replaced the PICs with the APICs
+static bool isApicEnabled = false;
+/// The number of spurious interrupts received on IRQ7 and IRQ15
+static uint32_t spuriousIrqCount = 0;
+/// The longest time each processor spent in `cHandleInterrupt` before the
+/// preemption, in cycles
+static uint32_t maxInterruptCycles[acpi::MAX_CPUS] = {};
+
+/// The statistics of a vector on a processor, only written by that processor
+struct VectorStatistics
+{
+    /// Odd while the processor updates the statistics (read with retries
+    /// by `getInterruptStatistics`)
+    uint32_t sequence;
+    /// The number of interrupts, the sum and the longest of their times
+    uint32_t maxCycles;
+    uint64_t count;
+    uint64_t totalCycles;
+    /// The histogram of the times (see `InterruptStatistics`)
+    uint32_t histogram[INTERRUPT_HISTOGRAM_BUCKETS];
+};
+
+/// The largest number of vectors with statistics (the first vectors given a
+/// handler)
+const uint32_t MAX_STATISTICS_VECTORS = 16;
+
+/// The statistics slot of each vector plus one (0 if the vector has none)
+static uint8_t statisticsSlots[256] = {};
+/// The number of statistics slots given to vectors
+static uint32_t statisticsSlotCount = 0;
+/// The statistics of the vectors with a handler on each processor
+static VectorStatistics
+    vectorStatistics[acpi::MAX_CPUS][MAX_STATISTICS_VECTORS] = {};
+
 /**
  * \brief Load interrupt descriptor table
  *
@@ -28,112 +108,545 @@ void lidt(void *base, unsigned int limit)
 /**
  * \brief Initialize the interrupt descriptor talbe
  * 
- * This function creates the interrupt descriptor table entries for the
- * supported interruption (currently only the keyboard interruptions are
- * supported). Finally, it loads the interrupt descriptor table.
+ * This function points every entry of the interrupt descriptor table to its
+ * stub in isr.s (an interrupt gate in the kernel code segment). The stubs all
+ * go to `cHandleInterrupt`, which calls the registered handlers. Finally, it
+ * loads the interrupt descriptor table.
  */
 void initializeIdt()
 {
-    // Keyboard IDT entry
-    uint64_t addressKeyboard = (uint32_t) &handleInterruptKeyboard;
-    idt[33] = 0x00008E0000080000;
-    idt[33] |= addressKeyboard & 0xFFFF;
-    idt[33] |= (addressKeyboard & 0xFFFF0000) << 32;
+    for (uint32_t vector = 0; vector < 256; ++vector) {
+        uint64_t address = (uint32_t) interrupt_stubs
+                           + vector * INTERRUPT_STUB_SIZE;
+        idt[vector] = 0x00008E0000080000;
+        idt[vector] |= address & 0xFFFF;
+        idt[vector] |= (address & 0xFFFF0000) << 32;
+    }
 
-    // Load the IDT
+    loadIdt();
+}
+
+/**
+ * \brief Load the interrupt descriptor table on the calling processor
+ *
+ * The table is shared by all the processors, each one loads it once.
+ */
+void loadIdt()
+{
     lidt(idt, 256*8);
 }
 
+/**
+ * \brief Write the interrupt mask to the PICs
+ *
+ * The cascade line of the master is unmasked as long as a line of the slave
+ * is.
+ */
+static void writeIrqMask()
+{
+    uint16_t mask = irqMask;
+    if ((mask & 0xFF00) != 0xFF00) {
+        mask &= ~(1 << CASCADE_IRQ);
+    }
+
+    outb(MASTER_DATA_PORT, mask & 0xFF);
+    outb(SLAVE_DATA_PORT, (mask >> 8) & 0xFF);
+}
+
 /**
  * \brief Initialize the PIC
+ *
+ * The master PIC sends IRQ0-7 to vectors 0x20-0x27 and the slave PIC IRQ8-15
+ * to vectors 0x70-0x77. Only the lines with a registered handler are
+ * unmasked.
  */
 void configPIC()
 {
     // Initialize the ICW1
-    outb(0x20, 0x11);
-    outb(0xA0, 0x11);
+    outb(MASTER_COMMAND_PORT, 0x11);
+    outb(SLAVE_COMMAND_PORT, 0x11);
 
     // Initialize the ICW2
-    outb(0x21, 0x20);
-    outb(0xA1, 0x70);
+    outb(MASTER_DATA_PORT, MASTER_VECTOR_BASE);
+    outb(SLAVE_DATA_PORT, SLAVE_VECTOR_BASE);
 
     // Initialize the ICW3
-    outb(0x21, 0x04);
-    outb(0xA1, 0x02);
+    outb(MASTER_DATA_PORT, 1 << CASCADE_IRQ);
+    outb(SLAVE_DATA_PORT, CASCADE_IRQ);
 
     // Initialize the ICW4
-    outb(0x21, 0x01);
-    outb(0xA1, 0x01);
+    outb(MASTER_DATA_PORT, 0x01);
+    outb(SLAVE_DATA_PORT, 0x01);
 
-    // Only listen to irqs 0, 1, and 2
-    outb(0x21,0xfd);
-    outb(0xa1,0xff);
+    uint32_t flags = saveAndDisableInterrupts();
+    isPicConfigured = true;
+    writeIrqMask();
+    restoreInterrupts(flags);
 }
 
 /**
- * \brief Keyboard interrupt handler
+ * \brief Replace the PICs with the local APIC and the I/O APICs
+ *
+ * `acpi::initialize` must have read the MADT and `configPIC` must have been
+ * called before. The ISA interrupt lines are routed to the local APIC of the
+ * processor with the same vectors as with the PICs, so the registered handlers
+ * keep working, and the masked lines stay masked. The PICs are then masked
+ * entirely: the end of interrupt is now a single write to the local APIC.
  *
- * Interrupt service routine that is called when a keyboard key is pressed or
- * released.
+ * \return false if the machine has no APIC (the PICs are still used)
  */
-extern "C" void cHandleInterruptKeyboard()
+bool enableApic()
 {
-    // Static bool to know if modifier keys are pressed or released
-    static bool leftShiftPressed  = false;
-    static bool rightShiftPressed = false;
-    static bool controlPressed    = false;
-    static bool altPressed        = false;
+    const acpi::MadtInfo& madtInfo = acpi::getMadtInfo();
+    apic::LocalApic& localApic = apic::LocalApic::getInstance();
 
-    // Read from the keyboard's data buffer
-    unsigned char scancode = inb(0x60);
-
-    bool isPressed = !(scancode & 0x80);
+    // The I/O APICs are initialized first: their lines are masked so nothing
+    // changes if the local APIC cannot be enabled
+    if (!apic::IoApic::initialize(madtInfo) ||
+        !localApic.initialize(madtInfo.localApicAddress)) {
+        return false;
+    }
 
-    if (!isPressed) {
-        scancode -= 0x80;
-        switch (scancode) {
-            case 0x2A:
-                leftShiftPressed = false;
-                break;
-            case 0x36:
-                rightShiftPressed = false;
-                break;
-            case 0x38:
-                altPressed = false;
-                break;
-            case 0x1D:
-                controlPressed = false;
-                break;
+    uint32_t flags = saveAndDisableInterrupts();
+    const uint32_t apicId = localApic.getId();
+    for (uint8_t irq = 0; irq < IRQ_COUNT; ++irq) {
+        if (irq != CASCADE_IRQ) {
+            apic::IoApic::routeIsaIrq(irq, getIrqVector(irq), apicId,
+                                      irqMask & (1 << irq));
         }
     }
+
+    outb(MASTER_DATA_PORT, 0xFF);
+    outb(SLAVE_DATA_PORT, 0xFF);
+    isApicEnabled = true;
+    restoreInterrupts(flags);
+
+    return true;
+}
+
+/**
+ * \brief Register the handler of an interrupt vector
+ *
+ * The handler is called with interrupts disabled. It replaces the handler
+ * previously registered for the vector, if any. The first handler of a
+ * vector gives it a statistics slot (see `getInterruptStatistics`).
+ *
+ * \param vector The interrupt vector
+ * \param handler The function to call (nullptr to remove the handler)
+ * \param context The value given to the function
+ */
+void registerInterruptHandler(uint8_t vector, InterruptHandler handler,
+                              void* context)
+{
+    uint32_t flags = saveAndDisableInterrupts();
+    // Keep the slot of the vector if its handler is replaced
+    if (handler != nullptr && statisticsSlots[vector] == 0 &&
+        statisticsSlotCount < MAX_STATISTICS_VECTORS) {
+        __atomic_store_n(&statisticsSlots[vector], ++statisticsSlotCount,
+                         __ATOMIC_RELAXED);
+    }
+    handlers[vector].handler = handler;
+    handlers[vector].context = context;
+    restoreInterrupts(flags);
+}
+
+/**
+ * \brief Register the handler of an interrupt line and unmask the line
+ *
+ * The handler does not have to acknowledge the PIC: the end of interrupt is
+ * sent once it returns.
+ *
+ * \param irq The interrupt line (0 to 15)
+ * \param handler The function to call
+ * \param context The value given to the function
+ */
+void registerIrqHandler(uint8_t irq, InterruptHandler handler, void* context)
+{
+    registerInterruptHandler(getIrqVector(irq), handler, context);
+    unmaskIrq(irq);
+}
+
+/**
+ * \brief Mask an interrupt line and unregister its handler
+ *
+ * \param irq The interrupt line (0 to 15)
+ */
+void unregisterIrqHandler(uint8_t irq)
+{
+    maskIrq(irq);
+    registerInterruptHandler(getIrqVector(irq), nullptr, nullptr);
+}
+
+/**
+ * \brief Mask or unmask an interrupt line
+ *
+ * The line is masked in the I/O APIC once the APICs are enabled, in the PICs
+ * otherwise.
+ *
+ * \param irq The interrupt line (0 to 15)
+ * \param isMasked true to mask the line, false to unmask it
+ */
+static void setIrqMasked(uint8_t irq, bool isMasked)
+{
+    uint32_t flags = saveAndDisableInterrupts();
+    if (isMasked) {
+        irqMask |= 1 << irq;
+    }
     else {
-        switch (scancode) {
-            case 0x2A:
-                leftShiftPressed = true;
-                break;
-            case 0x36:
-                rightShiftPressed = true;
-                break;
-            case 0x38:
-                altPressed = true;
-                break;
-            case 0x1D:
-                controlPressed = true;
-                break;
+        irqMask &= ~(1 << irq);
+    }
+
+    if (isApicEnabled) {
+        apic::IoApic::setIsaIrqMasked(irq, isMasked);
+    }
+    else if (isPicConfigured) {
+        writeIrqMask();
+    }
+    restoreInterrupts(flags);
+}
+
+/**
+ * \brief Stop receiving the interrupts of a line
+ *
+ * \param irq The interrupt line (0 to 15)
+ */
+void maskIrq(uint8_t irq)
+{
+    setIrqMasked(irq, true);
+}
+
+/**
+ * \brief Receive the interrupts of a line again
+ *
+ * \param irq The interrupt line (0 to 15)
+ */
+void unmaskIrq(uint8_t irq)
+{
+    setIrqMasked(irq, false);
+}
+
+/**
+ * \brief Get the interrupt vector of an interrupt line
+ *
+ * \param irq The interrupt line (0 to 15)
+ * \return The vector the PICs send for the line
+ */
+uint8_t getIrqVector(uint8_t irq)
+{
+    return irq < 8 ? MASTER_VECTOR_BASE + irq : SLAVE_VECTOR_BASE + irq - 8;
+}
+
+/**
+ * \brief Get the number of spurious interrupts received on IRQ7 and IRQ15
+ *
+ * With the APICs, the spurious interrupts of the local APIC are counted
+ * instead.
+ *
+ * \return The number of spurious interrupts
+ */
+uint32_t getSpuriousIrqCount()
+{
+    return spuriousIrqCount;
+}
+
+/**
+ * \brief Get the longest time a processor spent in an interrupt handler
+ *
+ * The time runs from the call of `cHandleInterrupt` to the end of interrupt,
+ * so it is the longest time the handlers kept interrupts disabled (the stubs
+ * and the context switches are not included).
+ *
+ * \param cpuIndex The index of the processor
+ * \return The longest time, in cycles of the time stamp counter
+ */
+uint32_t getMaxInterruptCycles(size_t cpuIndex)
+{
+    return __atomic_load_n(&maxInterruptCycles[cpuIndex], __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Forget the longest interrupt handler times of every processor
+ *
+ * The next interrupts measure the worst case from now on, for example once
+ * the boot is over.
+ */
+void resetMaxInterruptCycles()
+{
+    for (size_t i = 0; i < acpi::MAX_CPUS; ++i) {
+        __atomic_store_n(&maxInterruptCycles[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * \brief Get the statistics of an interrupt vector on a processor
+ *
+ * The statistics are copied while the processor does not update them, so
+ * the copy is consistent even if an interrupt arrives meanwhile.
+ *
+ * \param vector The interrupt vector
+ * \param cpuIndex The index of the processor
+ * \return A copy of the statistics (zeros if the vector never had a handler)
+ */
+InterruptStatistics getInterruptStatistics(uint8_t vector, size_t cpuIndex)
+{
+    InterruptStatistics statistics = {};
+    const uint8_t slot = __atomic_load_n(&statisticsSlots[vector],
+                                         __ATOMIC_RELAXED);
+    if (slot == 0) {
+        return statistics;
+    }
+
+    const VectorStatistics& source = vectorStatistics[cpuIndex][slot - 1];
+
+    uint32_t sequence;
+    do {
+        sequence = __atomic_load_n(&source.sequence, __ATOMIC_ACQUIRE);
+        statistics.count = source.count;
+        statistics.totalCycles = source.totalCycles;
+        statistics.maxCycles = source.maxCycles;
+        for (uint32_t i = 0; i < INTERRUPT_HISTOGRAM_BUCKETS; ++i) {
+            statistics.histogram[i] = source.histogram[i];
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((sequence & 1) ||
+             sequence != __atomic_load_n(&source.sequence, __ATOMIC_RELAXED));
+
+    return statistics;
+}
+
+/**
+ * \brief Get the statistics of an interrupt vector on every processor
+ *
+ * \param vector The interrupt vector
+ * \return The sums of the statistics of the processors (the longest time
+ * of all of them)
+ */
+InterruptStatistics getInterruptStatistics(uint8_t vector)
+{
+    InterruptStatistics total = {};
+    for (size_t i = 0; i < acpi::MAX_CPUS; ++i) {
+        const InterruptStatistics statistics =
+            getInterruptStatistics(vector, i);
+        total.count += statistics.count;
+        total.totalCycles += statistics.totalCycles;
+        if (statistics.maxCycles > total.maxCycles) {
+            total.maxCycles = statistics.maxCycles;
+        }
+        for (uint32_t j = 0; j < INTERRUPT_HISTOGRAM_BUCKETS; ++j) {
+            total.histogram[j] += statistics.histogram[j];
         }
     }
 
-    // Create the keyboard entry and put it in the keyboard
-    Keyboard::getInstance().putEntry(KeyboardEntry(
-        scancode,
-        isPressed,
-        leftShiftPressed,
-        rightShiftPressed,
-        controlPressed,
-        altPressed
-    ));
+    return total;
+}
 
-    // Send EOI to both master and slave
-    outb(0x20,0x20);
-    outb(0xa0,0x20);
+/**
+ * \brief Count an interrupt in the statistics of its vector
+ *
+ * Called by `cHandleInterrupt` with interrupts disabled: the statistics of
+ * the processor are only written here, so they need no lock. The vectors
+ * without a statistics slot are not counted.
+ *
+ * \param cpuIndex The index of the calling processor
+ * \param vector The interrupt vector
+ * \param cycles The time of the interrupt
+ */
+static void recordInterrupt(size_t cpuIndex, uint32_t vector,
+                            uint32_t cycles)
+{
+    const uint8_t slot = statisticsSlots[vector];
+    if (slot == 0) {
+        return;
+    }
+
+    VectorStatistics& statistics = vectorStatistics[cpuIndex][slot - 1];
+
+    uint32_t bucket = 0;
+    if (cycles >= 1u << INTERRUPT_HISTOGRAM_SHIFT) {
+        bucket = 32 - __builtin_clz(cycles) - INTERRUPT_HISTOGRAM_SHIFT;
+        if (bucket >= INTERRUPT_HISTOGRAM_BUCKETS) {
+            bucket = INTERRUPT_HISTOGRAM_BUCKETS - 1;
+        }
+    }
+
+    const uint32_t sequence = statistics.sequence;
+    __atomic_store_n(&statistics.sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ++statistics.count;
+    statistics.totalCycles += cycles;
+    if (cycles > statistics.maxCycles) {
+        statistics.maxCycles = cycles;
+    }
+    ++statistics.histogram[bucket];
+
+    __atomic_store_n(&statistics.sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Read the in-service register of a PIC
+ *
+ * \param commandPort The command port of the PIC
+ * \return The lines being serviced (bit n for the line n of the PIC)
+ */
+static uint8_t readInService(uint16_t commandPort)
+{
+    outb(commandPort, READ_IN_SERVICE);
+    return inb(commandPort);
+}
+
+/**
+ * \brief Get the interrupt line of a vector
+ *
+ * \param vector The interrupt vector
+ * \return The interrupt line, or IRQ_COUNT if the vector is not sent by the
+ * PICs
+ */
+static uint8_t getVectorIrq(uint32_t vector)
+{
+    if (vector >= MASTER_VECTOR_BASE && vector < MASTER_VECTOR_BASE + 8u) {
+        return vector - MASTER_VECTOR_BASE;
+    }
+    if (vector >= SLAVE_VECTOR_BASE && vector < SLAVE_VECTOR_BASE + 8u) {
+        return vector - SLAVE_VECTOR_BASE + 8;
+    }
+    return IRQ_COUNT;
+}
+
+/**
+ * \brief Stop the processor after an exception nobody handles
+ *
+ * Returning would execute the faulting instruction again. The processor is
+ * halted with interrupts disabled instead so its state can be inspected with
+ * a debugger (the frame is still on the stack).
+ *
+ * \param frame The state of the processor when the exception occurred
+ */
+static void haltOnException(InterruptFrame& frame)
+{
+    (void) frame;
+
+    while (true) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+/**
+ * \brief Dispatch an interrupt to its registered handler
+ *
+ * Called by the common entry of isr.s with interrupts disabled. The interrupts
+ * are acknowledged after the handler returns.
+ *
+ * With the APICs, every interrupt but the exceptions and the spurious
+ * interrupts is acknowledged to the local APIC.
+ *
+ * With the PICs, only the interrupts they sent are acknowledged: the slave PIC
+ * only receives an end of interrupt for its own lines. A spurious IRQ7 or
+ * IRQ15 (the line is not in service) is not acknowledged to the PIC that sent
+ * it.
+ *
+ * If the tick of the processor is stopped (it was idle), it is restarted
+ * before the handler is called.
+ *
+ * Once the interrupt is acknowledged, the time spent since the call is
+ * counted in the statistics of the vector, and recorded if it is the
+ * longest one of the processor. Then the interrupted thread is switched out
+ * if the handler made a thread of a higher priority ready or ended its
+ * quantum.
+ *
+ * \param frame The state of the processor saved by the stub
+ */
+extern "C" void cHandleInterrupt(InterruptFrame* frame)
+{
+    const uint64_t start = cpu::readTsc();
+    const uint32_t vector = frame->vector;
+    const uint8_t irq = getVectorIrq(vector);
+
+    if (isApicEnabled) {
+        if (vector == apic::SPURIOUS_VECTOR) {
+            ++spuriousIrqCount;
+            return;
+        }
+    }
+    else if (irq == 7 && !(readInService(MASTER_COMMAND_PORT) & 0x80)) {
+        ++spuriousIrqCount;
+        return;
+    }
+    else if (irq == 15 && !(readInService(SLAVE_COMMAND_PORT) & 0x80)) {
+        // The master did see an interrupt on the cascade line
+        ++spuriousIrqCount;
+        outb(MASTER_COMMAND_PORT, END_OF_INTERRUPT);
+        return;
+    }
+
+    // The handlers see the current tick, even if the processor was idle
+    timer::restartTick();
+
+    const InterruptHandlerEntry& entry = handlers[vector];
+    if (entry.handler != nullptr) {
+        entry.handler(*frame, entry.context);
+    }
+    else if (vector < EXCEPTION_COUNT) {
+        haltOnException(*frame);
+    }
+
+    if (isApicEnabled) {
+        if (vector >= EXCEPTION_COUNT) {
+            apic::LocalApic::getInstance().sendEndOfInterrupt();
+        }
+    }
+    else if (irq < IRQ_COUNT) {
+        if (irq >= 8) {
+            outb(SLAVE_COMMAND_PORT, END_OF_INTERRUPT);
+        }
+        outb(MASTER_COMMAND_PORT, END_OF_INTERRUPT);
+    }
+
+    const uint32_t cycles = cpu::readTsc() - start;
+    const size_t cpuIndex = smp::getCurrentCpu()->index;
+    recordInterrupt(cpuIndex, vector, cycles);
+    uint32_t& maxCycles = maxInterruptCycles[cpuIndex];
+    if (cycles > maxCycles) {
+        __atomic_store_n(&maxCycles, cycles, __ATOMIC_RELAXED);
+    }
+
+    sched::Scheduler::getInstance().preemptIfNeeded();
+}
+
+/**
+ * \brief Disable interrupts and return the previous state of the flags
+ * register
+ *
+ * \return The flags register before interrupts were disabled
+ */
+uint32_t saveAndDisableInterrupts()
+{
+    uint32_t flags;
+
+    __asm__ volatile (
+        "pushf\n"
+        "pop %0\n"
+        "cli"
+        : "=r"(flags)
+        :
+        : "memory"
+    );
+
+    return flags;
+}
+
+/**
+ * \brief Restore the state of the interrupts saved by
+ * `saveAndDisableInterrupts`
+ *
+ * Interrupts are enabled again only if they were enabled when
+ * `saveAndDisableInterrupts` was called.
+ *
+ * \param flags The flags register returned by `saveAndDisableInterrupts`
+ */
+void restoreInterrupts(uint32_t flags)
+{
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
 }
@@ -1,8 +1,109 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief The state of the processor saved when an interrupt is received
+ *
+ * The stubs of isr.s push the error code and the vector number, then the
+ * general purpose registers (with `pusha`). The processor pushed the return
+ * address and the flags before.
+ */
+struct InterruptFrame
+{
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebp;
+    /// The stack pointer before `pusha` (ignored by `popa`)
+    uint32_t esp;
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t ecx;
+    uint32_t eax;
+    /// The interrupt vector (0 to 255)
+    uint32_t vector;
+    /// The error code pushed by the processor for some exceptions (0 for the
+    /// other vectors)
+    uint32_t errorCode;
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+} __attribute__((packed));
+
+/// A function called when an interrupt is received, with the context given
+/// when it was registered
+typedef void (*InterruptHandler)(InterruptFrame& frame, void* context);
+
+/// The number of interrupt lines of the two PICs
+const uint8_t IRQ_COUNT = 16;
+
+/// The number of buckets of the histogram of the interrupt handler times
+const uint32_t INTERRUPT_HISTOGRAM_BUCKETS = 16;
+/// The first bucket of the histogram counts the times under
+/// 2^`INTERRUPT_HISTOGRAM_SHIFT` cycles
+const uint32_t INTERRUPT_HISTOGRAM_SHIFT   = 6;
+
+/**
+ * \brief The statistics of an interrupt vector
+ *
+ * The time of an interrupt runs from the call of `cHandleInterrupt` to the
+ * end of interrupt (see `getMaxInterruptCycles`), in cycles of the time stamp
+ * counter. Only the vectors given a handler are counted, from the
+ * registration of their first handler (up to 16 vectors).
+ */
+struct InterruptStatistics
+{
+    /// The number of interrupts handled
+    uint64_t count;
+    /// The sum of the times of the interrupts
+    uint64_t totalCycles;
+    /// The longest time
+    uint32_t maxCycles;
+    /// The number of times in each power of two: bucket 0 counts the times
+    /// under 2^`INTERRUPT_HISTOGRAM_SHIFT` cycles, bucket `n` the times from
+    /// 2^(`INTERRUPT_HISTOGRAM_SHIFT` + `n` - 1) cycles to twice that, and
+    /// the last bucket every longer time too
+    uint32_t histogram[INTERRUPT_HISTOGRAM_BUCKETS];
+};
+
 /// Load the interrupt descriptor table
 void lidt(void *base, unsigned int limit);
 /// Initialize the interrupt descriptor table
 void initializeIdt();
+/// Load the interrupt descriptor table on the calling processor
+void loadIdt();
 /// Initialize the PIC
 void configPIC();
+/// Replace the PICs with the local APIC and the I/O APICs
+bool enableApic();
+
+/// Register the handler of an interrupt vector
+void registerInterruptHandler(uint8_t vector, InterruptHandler handler,
+                              void* context);
+/// Register the handler of an interrupt line and unmask the line
+void registerIrqHandler(uint8_t irq, InterruptHandler handler, void* context);
+/// Mask an interrupt line and unregister its handler
+void unregisterIrqHandler(uint8_t irq);
+/// Stop receiving the interrupts of a line
+void maskIrq(uint8_t irq);
+/// Receive the interrupts of a line again
+void unmaskIrq(uint8_t irq);
+/// Get the interrupt vector of an interrupt line
+uint8_t getIrqVector(uint8_t irq);
+/// Get the number of spurious interrupts received on IRQ7 and IRQ15 (or by
+/// the local APIC)
+uint32_t getSpuriousIrqCount();
+/// Get the longest time a processor spent in an interrupt handler
+uint32_t getMaxInterruptCycles(size_t cpuIndex);
+/// Forget the longest interrupt handler times of every processor
+void resetMaxInterruptCycles();
+/// Get the statistics of an interrupt vector on a processor
+InterruptStatistics getInterruptStatistics(uint8_t vector, size_t cpuIndex);
+/// Get the statistics of an interrupt vector on every processor
+InterruptStatistics getInterruptStatistics(uint8_t vector);
+
+/// Disable interrupts and return the previous state of the flags register
+uint32_t saveAndDisableInterrupts();
+/// Restore the state of the interrupts saved by `saveAndDisableInterrupts`
+void restoreInterrupts(uint32_t flags);
@@ -0,0 +1,41 @@
+# The entry points of the 256 interrupt vectors. Each stub pushes the same
+# frame: an error code (the one pushed by the processor for the exceptions that
+# have one, 0 otherwise) and the vector number, then jumps to the common entry.
+# The stubs are INTERRUPT_STUB_SIZE bytes apart so initializeIdt can compute
+# their address from the vector number.
+.set INTERRUPT_STUB_SIZE, 16
+
+.section .text
+.balign INTERRUPT_STUB_SIZE
+.global interrupt_stubs
+interrupt_stubs:
+.set vector, 0
+.rept 256
+    .balign INTERRUPT_STUB_SIZE
+    # Double fault, invalid TSS, segment not present, stack fault, general
+    # protection, page fault, alignment check, control protection, VMM
+    # communication and security exceptions push an error code
+    .set has_error_code, vector == 8 || (vector >= 10 && vector <= 14)
+    .set has_error_code, has_error_code || vector == 17 || vector == 21
+    .set has_error_code, has_error_code || vector == 29 || vector == 30
+    .if !has_error_code
+    push $0
+    .endif
+    push $vector
+    jmp interrupt_common
+    .set vector, vector + 1
+.endr
+
+# Save the general purpose registers to complete the InterruptFrame (see
+# interrupt.hpp) and give its address to the C++ dispatcher.
+interrupt_common:
+    pusha
+    cld
+    mov %esp, %eax
+    push %eax
+    call cHandleInterrupt
+    add $4, %esp
+    popa
+    # Remove the vector number and the error code
+    add $8, %esp
+    iret
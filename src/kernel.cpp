@@ -1,54 +1,392 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#include "util/util.hpp"
 #include "Terminal.hpp"
 #include "SerialPort.hpp"
 #include "interrupt.hpp"
 #include "Keyboard.hpp"
 #include "KernelLogger.hpp"
+#include "multiboot.hpp"
+#include "memory/FrameAllocator.hpp"
+#include "memory/Heap.hpp"
+#include "memory/AddressSpace.hpp"
+#include "acpi/Acpi.hpp"
+#include "apic/LocalApic.hpp"
+#include "smp/smp.hpp"
+#include "sched/Scheduler.hpp"
+#include "sched/SwitchBenchmark.hpp"
+#include "sched/TaskPool.hpp"
+#include "sync/Event.hpp"
+#include "cpu/cpu.hpp"
+#include "cpu/Fpu.hpp"
+#include "timer/Clock.hpp"
+#include "timer/Timer.hpp"
+#include "util/MemoryBenchmark.hpp"
 
-size_t strlen(const char* str)
+/// The last lines of the log, for a debugger
+static LogMemoryRing logMemory;
+
+/// The bit of the keyboard event in the result of `sync::waitAny`
+const uint32_t KEYBOARD_READY = 1 << 0;
+/// The bit of the receive event of COM1
+const uint32_t SERIAL_READY   = 1 << 1;
+/// The bit of the event of the status timer
+const uint32_t STATUS_READY   = 1 << 2;
+/// The bit of the drain event of the logger
+const uint32_t LOG_READY      = 1 << 3;
+
+/// The key of ctrl+alt+I, which dumps the interrupt statistics
+const uint8_t INTERRUPT_STATISTICS_KEY = 0x17;
+/// The line received on COM1 which dumps the interrupt statistics
+static const char INTERRUPT_STATISTICS_COMMAND[] = "irqstat";
+
+/**
+ * \brief Zero the pages [begin, end) of a block (a `parallelFor` function)
+ *
+ * \param begin The first page to zero
+ * \param end The page after the last page to zero
+ * \param argument The address of the block
+ */
+static void zeroPages(size_t begin, size_t end, void* argument)
 {
-    size_t length = 0;
-    while (str[length] != 0) {
-        ++length;
+    uint32_t* page = (uint32_t*) ((uintptr_t) argument
+                                  + begin * memory::PAGE_SIZE);
+    const size_t count = (end - begin) * memory::PAGE_SIZE / sizeof(uint32_t);
+    for (size_t i = 0; i < count; ++i) {
+        page[i] = 0;
     }
+}
 
-    return length;
+/**
+ * \brief Check if a line received on the serial port is a command
+ *
+ * \param line The line, without its newline
+ * \param length The length of the line
+ * \param command The command
+ * \return true if the line is the command
+ */
+static bool isCommand(const char* line, size_t length, const char* command)
+{
+    size_t i = 0;
+    for (; i < length && command[i] != '\0'; ++i) {
+        if (line[i] != command[i]) {
+            return false;
+        }
+    }
+
+    return i == length && command[i] == '\0';
 }
 
-extern "C" void kernel_main()
+/**
+ * \brief Log the statistics of the interrupt vectors used
+ *
+ * The rate of each vector is the one since the previous dump (since the
+ * boot for the first one), to spot the interrupt storms.
+ */
+static void logInterruptStatistics()
 {
+    static uint64_t previousCounts[256] = {};
+    static uint64_t previousTicks = 0;
+
+    const uint64_t ticks = timer::getTicks();
+    const uint64_t elapsedTicks = ticks > previousTicks
+                                      ? ticks - previousTicks
+                                      : 1;
+    previousTicks = ticks;
+
+    for (uint32_t vector = 0; vector < 256; ++vector) {
+        const InterruptStatistics statistics =
+            getInterruptStatistics(vector);
+        if (statistics.count == 0) {
+            continue;
+        }
+
+        const uint64_t count = statistics.count - previousCounts[vector];
+        previousCounts[vector] = statistics.count;
+        klog(LogLevel::INFO, "Interrupt {:#04x}: {} times, {} per second",
+             vector, statistics.count,
+             (uint32_t) (count * timer::TICK_FREQUENCY / elapsedTicks));
+        klog(LogLevel::INFO, "  {} cycles on average, {} at most",
+             (uint32_t) (statistics.totalCycles / statistics.count),
+             statistics.maxCycles);
+
+        for (uint32_t i = 0; i < INTERRUPT_HISTOGRAM_BUCKETS; ++i) {
+            const uint32_t bound = 1u << (INTERRUPT_HISTOGRAM_SHIFT + i);
+            if (statistics.histogram[i] == 0) {
+                continue;
+            }
+            if (i + 1 < INTERRUPT_HISTOGRAM_BUCKETS) {
+                klog(LogLevel::INFO, "  under {} cycles: {}", bound,
+                     statistics.histogram[i]);
+            }
+            else {
+                klog(LogLevel::INFO, "  {} cycles or more: {}", bound / 2,
+                     statistics.histogram[i]);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Log the bytes per cycle of the memory routines for every size class
+ *
+ * The routines used by `memcpy` and `memset` are logged as information, the
+ * others as debug traces.
+ *
+ * \param buffer A buffer of twice the largest `util::MEMORY_BENCHMARK_SIZES`
+ */
+static void benchmarkMemoryRoutines(void* buffer)
+{
+    for (size_t i = 0; i < util::MEMORY_BENCHMARK_SIZE_COUNT; ++i) {
+        const size_t size = util::MEMORY_BENCHMARK_SIZES[i];
+        const util::MemorySizeClass sizeClass =
+            size < util::MEDIUM_MEMORY_SIZE  ? util::MemorySizeClass::SMALL
+            : size < util::LARGE_MEMORY_SIZE ? util::MemorySizeClass::MEDIUM
+                                             : util::MemorySizeClass::LARGE;
+
+        for (size_t j = 0; j < util::MEMORY_ROUTINE_COUNT; ++j) {
+            const util::MemoryRoutine routine = (util::MemoryRoutine) j;
+            if (!util::isMemoryRoutineSupported(routine)) {
+                continue;
+            }
+
+            const util::MemoryBenchmarkResult result =
+                util::benchmarkMemoryRoutine(routine, buffer, size);
+            const LogLevel level = routine == util::getMemoryRoutine(sizeClass)
+                                       ? LogLevel::INFO
+                                       : LogLevel::DEBUG;
+            const char* name = util::getMemoryRoutineName(routine);
+            klog(level, "memcpy {} of {} bytes: {}.{:02} bytes/cycle", name,
+                 size, result.copyRate / 100, result.copyRate % 100);
+            klog(level, "memset {} of {} bytes: {}.{:02} bytes/cycle", name,
+                 size, result.fillRate / 100, result.fillRate % 100);
+        }
+    }
+}
+
+extern "C" void kernel_main(uint32_t magic, memory::PhysicalAddress infoAddress)
+{
+    // Map the physical memory in the higher half before anything uses it
+    memory::AddressSpace::initializeKernel();
+    // Load the GDT and the TSS of this processor
+    smp::initializeBootProcessor();
+    // Enable the FPU and the vector registers, then choose the memcpy and
+    // memset routines for this processor
+    cpu::initializeFpu();
+    util::initializeMemoryRoutines();
+
     // Initialize the terminal and COM1 serial port
     Terminal terminal;
     SerialPort com1(SerialPort::getAddress(1));
 
-    // Create the kernel logger
-    KernelLogger logger(&terminal, &com1);
+    // Send the kernel logs to the terminal and COM1, and the debug traces
+    // to the cheap outputs only
+    KernelLogger& logger = KernelLogger::getInstance();
+    logger.addSink(writeLogToTerminal, &terminal, LogLevel::INFO);
+    logger.addSink(writeLogToSerialPort, &com1, LogLevel::INFO);
+    logger.addSink(LogMemoryRing::writeLog, &logMemory, LogLevel::DEBUG);
+    if (isDebugconPresent()) {
+        logger.addSink(writeLogToDebugcon, nullptr, LogLevel::DEBUG);
+    }
 
-    logger.log("Serial port COM1 enabled");
+    klog(LogLevel::INFO, "Serial port COM1 enabled");
+    klog(LogLevel::INFO, "FPU features: {:#x}, registers saved in {} bytes",
+         cpu::getFpuFeatures(), cpu::getFpuStateSize());
+
+    // Build the physical frame allocator from the bootloader memory map
+    memory::FrameAllocator& frames = memory::FrameAllocator::getInstance();
+    const multiboot::Info* info =
+        (const multiboot::Info*) memory::physicalToVirtual(infoAddress);
+    if (magic != multiboot::BOOTLOADER_MAGIC) {
+        klog(LogLevel::ERROR,
+             "Not loaded by a multiboot bootloader, magic: {:#010x}", magic);
+    }
+    else if (!frames.initialize(info)) {
+        klog(LogLevel::ERROR, "No usable memory map, flags: {:#x}",
+             info->flags);
+    }
+    else {
+        klog(LogLevel::INFO, "Free frames: {} of {}", frames.getFreeFrames(),
+             frames.getTotalFrames());
+        memory::Heap::getInstance().dumpStatistics(com1);
+    }
 
     // Inialize interruptions and PIC
     initializeIdt();
-    logger.log("IDT loaded");
+    klog(LogLevel::INFO, "IDT loaded");
     configPIC();
-    logger.log("PIC configured");
+    klog(LogLevel::INFO, "PIC configured");
+    if (acpi::initialize() && enableApic()) {
+        apic::LocalApic& localApic = apic::LocalApic::getInstance();
+        klog(LogLevel::INFO, "{} enabled, PIC masked",
+             localApic.isX2Apic() ? "x2APIC" : "xAPIC");
+        klog(LogLevel::INFO, "Local APIC timer ticks per ms: {}",
+             localApic.calibrateTimer());
+    }
+
+    // Turn this context into the first thread, then start the other
+    // processors, which wait for threads
+    sched::Scheduler::getInstance().initialize();
+    klog(LogLevel::INFO, "Scheduler started");
+    klog(LogLevel::INFO, "Processors running: {}",
+         smp::startApplicationProcessors());
+
+    // Calibrate the clock once the other processors no longer need the PIT
+    const timer::ClockCalibration& clock = timer::initializeClock();
+    if (clock.source == timer::ClockSource::TSC) {
+        klog(LogLevel::INFO, "Clock: TSC at {} kHz, calibrated with the {}",
+             (uint32_t) (clock.frequency / 1000), clock.reference);
+        klog(LogLevel::INFO, "Clock calibration error: {} ppm",
+             clock.errorPpm);
+    }
+    else {
+        klog(LogLevel::WARNING, "Clock: the TSC is not invariant, using the {}",
+             timer::getClockSourceName(clock.source));
+    }
     __asm__ ("sti");
 
+    sched::SwitchBenchmarkResult switchBenchmark =
+        sched::benchmarkContextSwitch(10000);
+    klog(LogLevel::INFO, "Context switch: {} cycles, {} per second",
+         switchBenchmark.cyclesPerSwitch, switchBenchmark.switchesPerSecond);
+
+    // Spread the zeroing of 1 MiB of frames over the processors
+    sched::TaskPool& pool = sched::TaskPool::getInstance();
+    const uint8_t zeroOrder = memory::FrameAllocator::getOrder(1 << 20);
+    const memory::PhysicalAddress zeroBlock = frames.allocate(zeroOrder);
+    if (pool.initialize() && zeroBlock != 0) {
+        const uint64_t start = cpu::readTsc();
+        pool.parallelFor(0, (size_t) 1 << zeroOrder, 16, zeroPages,
+                         memory::physicalToVirtual(zeroBlock));
+        klog(LogLevel::INFO, "Parallel page zeroing cycles: {}",
+             cpu::readTsc() - start);
+        klog(LogLevel::INFO, "Task pool imbalance: {}%",
+             pool.getImbalancePercent());
+        for (size_t i = 0; i < smp::getCpuCount(); ++i) {
+            klog(LogLevel::DEBUG, "Tasks stolen by processor {}: {}", i,
+                 pool.getStatistics(i).stolenTasks);
+        }
+        frames.free(zeroBlock, zeroOrder);
+
+        // The workers are blocked now: while this thread sleeps, every
+        // processor must go idle and stop its tick (or still have it stopped)
+        uint32_t tickStops[acpi::MAX_CPUS];
+        for (size_t i = 0; i < smp::getCpuCount(); ++i) {
+            tickStops[i] = timer::getTickStops(i);
+        }
+        sched::Scheduler::getInstance().sleep(10);
+        for (size_t i = 0; i < smp::getCpuCount(); ++i) {
+            if (timer::getTickStops(i) == tickStops[i] &&
+                !timer::isTickStopped(i)) {
+                klog(LogLevel::WARNING, "Processor {} did not stop its tick "
+                     "after the task pool job", i);
+            }
+        }
+    }
+
+    // Measure the memory routines once the caches only hold the kernel
+    const uint8_t benchmarkOrder =
+        memory::FrameAllocator::getOrder(2 * util::MEMORY_BENCHMARK_SIZES[
+            util::MEMORY_BENCHMARK_SIZE_COUNT - 1]);
+    const memory::PhysicalAddress benchmarkBlock =
+        frames.allocate(benchmarkOrder);
+    if (benchmarkBlock != 0) {
+        benchmarkMemoryRoutines(memory::physicalToVirtual(benchmarkBlock));
+        frames.free(benchmarkBlock, benchmarkOrder);
+    }
+
+    // Measure the interrupt handlers of the interactive use from now on
+    klog(LogLevel::INFO, "Longest interrupt handler during boot: {} cycles",
+         getMaxInterruptCycles(0));
+    resetMaxInterruptCycles();
+    uint32_t maxInterruptCycles = 0;
+
     // Greet the user
     terminal.write("Welcome to BrapOS!\n");
 
-    // Write what the user types on the terminal
+    // From now on, the logs are written by the main loop
+    logger.setDeferredDrain(true);
+
+    // Check the longest interrupt handler every second
+    sync::Event statusEvent;
+    timer::Timer statusTimer = {};
+    timer::addTimer(statusTimer, timer::TICK_FREQUENCY, sync::signalEvent,
+                    &statusEvent);
+
+    // Write what the user types on the terminal or sends to COM1,
+    // ctrl+alt+K changes the keyboard layout, ctrl+alt+I or the line
+    // "irqstat" on COM1 dumps the interrupt statistics. The loop only wakes
+    // up when one of its sources has something ready.
+    Keyboard& keyboard = Keyboard::getInstance();
+    size_t layoutIndex = 0;
+    char command[16];
+    size_t commandLength = 0;
     while (true) {
-        while (!Keyboard::getInstance().isEmpty()) {
-            KeyboardEntry entry = Keyboard::getInstance().readEntry();
-            if (entry.isPressed()) {
+        const uint32_t ready = sync::waitAny(keyboard.getEvent(),
+                                             com1.getReceiveEvent(),
+                                             statusEvent,
+                                             logger.getDrainEvent());
+
+        KeyboardEntry entry;
+        while ((ready & KEYBOARD_READY) && keyboard.readEntry(entry)) {
+            if (entry.isPressed() && entry.isCtrlPressed() &&
+                entry.isAltPressed() && entry.getKey() == 0x25) {
+                layoutIndex = (layoutIndex + 1) % KEYBOARD_LAYOUT_COUNT;
+                keyboard.setLayout(*KEYBOARD_LAYOUTS[layoutIndex]);
+                klog(LogLevel::INFO, "Keyboard layout: {}",
+                     keyboard.getLayout().name);
+            }
+            else if (entry.isPressed() && entry.isCtrlPressed() &&
+                     entry.isAltPressed() &&
+                     entry.getKey() == INTERRUPT_STATISTICS_KEY) {
+                logInterruptStatistics();
+            }
+            else if (entry.isPressed() && entry.getCharacter() != 0) {
                 unsigned char data[2] = {entry.getCharacter(), '\0'};
                 terminal.write(data);
             }
         }
 
-        __asm__ ("hlt");
+        char received[64];
+        size_t size;
+        while ((ready & SERIAL_READY) &&
+               (size = com1.read(received, sizeof(received) - 1)) != 0) {
+            for (size_t i = 0; i < size; ++i) {
+                if (received[i] == '\r') {
+                    received[i] = '\n';
+                }
+
+                // Keep the start of the line, long lines are no command
+                if (received[i] != '\n') {
+                    if (commandLength < sizeof(command)) {
+                        command[commandLength] = received[i];
+                    }
+                    ++commandLength;
+                    continue;
+                }
+                if (isCommand(command, commandLength,
+                              INTERRUPT_STATISTICS_COMMAND)) {
+                    logInterruptStatistics();
+                }
+                commandLength = 0;
+            }
+            received[size] = '\0';
+            terminal.write(received);
+        }
+
+        if (ready & STATUS_READY) {
+            if (getMaxInterruptCycles(0) > maxInterruptCycles) {
+                maxInterruptCycles = getMaxInterruptCycles(0);
+                klog(LogLevel::INFO, "Longest interrupt handler: {} cycles",
+                     maxInterruptCycles);
+            }
+            timer::addTimer(statusTimer, timer::TICK_FREQUENCY,
+                            sync::signalEvent, &statusEvent);
+        }
+
+        // The records logged meanwhile signal the event again
+        if (ready & LOG_READY) {
+            logger.drain();
+        }
     }
-}
\ No newline at end of file
+}
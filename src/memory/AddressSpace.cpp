@@ -0,0 +1,406 @@
+#include "AddressSpace.hpp"
+#include "FrameAllocator.hpp"
+#include "../cpu/cpu.hpp"
+
+/// The page directory used to enable paging (defined in boot.s)
+extern "C" uint32_t boot_page_directory[1024];
+
+namespace memory
+{
+    /// The kernel address space, built on the page directory of boot.s
+    AddressSpace AddressSpace::kernel_(boot_page_directory);
+    /// `PAGE_GLOBAL` if the processor supports global pages, 0 otherwise
+    uint32_t AddressSpace::globalFlag_ = 0;
+    /// True once the page tables of the dynamic region exist
+    bool AddressSpace::areKernelTablesAllocated_ = false;
+    /// The next free virtual address of the dynamic region
+    uintptr_t AddressSpace::nextDeviceAddress_ = DYNAMIC_REGION_START;
+
+    /// The bits of a page directory entry mapping a 4 MiB page that are kept
+    /// in the page table entries when it is split (PAT bit excluded)
+    static const uint32_t SPLIT_FLAGS_MASK = 0x17F;
+
+    /**
+     * \brief Get the kernel address space
+     *
+     * \return The kernel address space
+     */
+    AddressSpace& AddressSpace::getKernel()
+    {
+        return kernel_;
+    }
+
+    /**
+     * \brief Build the direct map of the kernel address space
+     *
+     * `_start` enabled paging with the first 16 MiB mapped both at 0 and at
+     * `KERNEL_VIRTUAL_BASE`. This function maps the whole direct map with
+     * global 4 MiB pages (when the processor supports them) and drops the
+     * identity mapping, so that null pointers fault from now on.
+     */
+    void AddressSpace::initializeKernel()
+    {
+        if (cpu::cpuid(1).edx & cpu::CPUID_1_EDX_PGE) {
+            cpu::writeCr4(cpu::readCr4() | cpu::CR4_PGE);
+            globalFlag_ = PAGE_GLOBAL;
+        }
+
+        uint32_t* directory = kernel_.directory_;
+        for (size_t i = 0; i < DIRECT_MAP_SIZE / LARGE_PAGE_SIZE; ++i) {
+            directory[KERNEL_DIRECTORY_INDEX + i] =
+                (i * LARGE_PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITABLE |
+                PAGE_LARGE | globalFlag_;
+        }
+        for (size_t i = 0; i < KERNEL_DIRECTORY_INDEX; ++i) {
+            directory[i] = 0;
+        }
+
+        // The only full flush: it drops the identity mapping and the
+        // non-global entries of the kernel
+        cpu::writeCr3(cpu::readCr3());
+    }
+
+    /**
+     * \brief Create an address space sharing the kernel mappings
+     *
+     * The kernel page directory entries are copied, so the page tables of the
+     * dynamic region are all allocated the first time an address space is
+     * created: the kernel entries never change afterwards.
+     *
+     * \return The new address space, or nullptr if there is no memory left
+     */
+    AddressSpace* AddressSpace::create()
+    {
+        FrameAllocator& frames = FrameAllocator::getInstance();
+
+        if (!areKernelTablesAllocated_) {
+            for (size_t i = DYNAMIC_REGION_START >> LARGE_PAGE_SHIFT;
+                 i < ENTRY_COUNT; ++i) {
+                if (kernel_.getTable(i, 0) == nullptr) {
+                    return nullptr;
+                }
+            }
+            areKernelTablesAllocated_ = true;
+        }
+
+        PhysicalAddress address = frames.allocate();
+        if (address == 0) {
+            return nullptr;
+        }
+
+        uint32_t* directory = (uint32_t*) physicalToVirtual(address);
+        for (size_t i = 0; i < KERNEL_DIRECTORY_INDEX; ++i) {
+            directory[i] = 0;
+        }
+        for (size_t i = KERNEL_DIRECTORY_INDEX; i < ENTRY_COUNT; ++i) {
+            directory[i] = kernel_.directory_[i];
+        }
+
+        AddressSpace* addressSpace = new AddressSpace(directory);
+        if (addressSpace == nullptr) {
+            frames.free(address);
+        }
+
+        return addressSpace;
+    }
+
+    /**
+     * \brief Map device memory in the kernel address space
+     *
+     * The memory is mapped uncached with 4 KiB pages in the dynamic region.
+     * Mappings are never removed: devices are mapped once at boot.
+     *
+     * \param physicalAddress The physical address of the device memory
+     * \param size The size of the device memory in bytes
+     * \return The virtual address of the device memory, or nullptr if the
+     * dynamic region is full
+     */
+    void* AddressSpace::mapDevice(PhysicalAddress physicalAddress, size_t size)
+    {
+        const uintptr_t offset = physicalAddress & (PAGE_SIZE - 1);
+        const size_t mappedSize = alignUp(size + offset, PAGE_SIZE);
+        const uintptr_t virtualAddress = nextDeviceAddress_;
+
+        if (virtualAddress + mappedSize < virtualAddress ||
+            virtualAddress + mappedSize > 0 - PAGE_SIZE) {
+            return nullptr;
+        }
+
+        if (!kernel_.map(virtualAddress, physicalAddress - offset, mappedSize,
+                         PAGE_WRITABLE | PAGE_WRITE_THROUGH |
+                         PAGE_CACHE_DISABLE)) {
+            return nullptr;
+        }
+        nextDeviceAddress_ += mappedSize;
+
+        return (void*) (virtualAddress + offset);
+    }
+
+    /**
+     * \brief Free an address space returned by `create`
+     *
+     * The frames mapped in the address space are not freed, only the page
+     * tables of the user part and the page directory. The address space must
+     * not be the current one. The kernel address space is never destroyed.
+     *
+     * \param addressSpace The address space to free
+     */
+    void AddressSpace::destroy(AddressSpace* addressSpace)
+    {
+        FrameAllocator& frames = FrameAllocator::getInstance();
+        uint32_t* directory = addressSpace->directory_;
+
+        for (size_t i = 0; i < KERNEL_DIRECTORY_INDEX; ++i) {
+            const uint32_t entry = directory[i];
+            if ((entry & PAGE_PRESENT) && !(entry & PAGE_LARGE)) {
+                frames.free(alignDown(entry, PAGE_SIZE));
+            }
+        }
+        frames.free(virtualToPhysical(directory));
+
+        delete addressSpace;
+    }
+
+    /**
+     * \brief Map `size` bytes at `virtualAddress` to `physicalAddress`
+     *
+     * 4 MiB pages are used wherever both addresses are aligned on 4 MiB and at
+     * least 4 MiB remain to map, 4 KiB pages otherwise. Mappings in the kernel
+     * part of the address space are global.
+     *
+     * \param virtualAddress The first virtual address to map
+     * \param physicalAddress The physical address to map it to
+     * \param size The number of bytes to map (rounded up to whole pages)
+     * \param flags The `PAGE_*` flags of the mapping (`PAGE_PRESENT` is
+     * implied)
+     * \return false if a page table could not be allocated
+     */
+    bool AddressSpace::map(uintptr_t virtualAddress,
+                           PhysicalAddress physicalAddress, size_t size,
+                           uint32_t flags)
+    {
+        const uintptr_t offset = virtualAddress & (PAGE_SIZE - 1);
+        size = alignUp(size + offset, PAGE_SIZE);
+        virtualAddress  -= offset;
+        physicalAddress  = alignDown(physicalAddress, PAGE_SIZE);
+
+        uint32_t pageFlags = (flags & (PAGE_SIZE - 1) & ~PAGE_LARGE) |
+                             PAGE_PRESENT;
+        if (virtualAddress >= KERNEL_VIRTUAL_BASE) {
+            pageFlags |= globalFlag_;
+        }
+
+        while (size > 0) {
+            const size_t directoryIndex = virtualAddress >> LARGE_PAGE_SHIFT;
+            const uint32_t entry = directory_[directoryIndex];
+            const bool isTable = (entry & PAGE_PRESENT) &&
+                                 !(entry & PAGE_LARGE);
+
+            const bool isAligned = ((virtualAddress | physicalAddress) &
+                                    (LARGE_PAGE_SIZE - 1)) == 0;
+            if (isAligned && size >= LARGE_PAGE_SIZE && !isTable) {
+                directory_[directoryIndex] = physicalAddress | pageFlags |
+                                             PAGE_LARGE;
+                cpu::invlpg(virtualAddress);
+
+                virtualAddress  += LARGE_PAGE_SIZE;
+                physicalAddress += LARGE_PAGE_SIZE;
+                size            -= LARGE_PAGE_SIZE;
+                continue;
+            }
+
+            uint32_t* table = getTable(directoryIndex, pageFlags);
+            if (table == nullptr) {
+                return false;
+            }
+            table[(virtualAddress >> PAGE_SHIFT) & (ENTRY_COUNT - 1)] =
+                physicalAddress | pageFlags;
+            cpu::invlpg(virtualAddress);
+
+            virtualAddress  += PAGE_SIZE;
+            physicalAddress += PAGE_SIZE;
+            size            -= PAGE_SIZE;
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Unmap `size` bytes at `virtualAddress`
+     *
+     * A 4 MiB page only partially unmapped is split first. Empty page tables
+     * are kept for later mappings.
+     *
+     * \param virtualAddress The first virtual address to unmap
+     * \param size The number of bytes to unmap (rounded up to whole pages)
+     */
+    void AddressSpace::unmap(uintptr_t virtualAddress, size_t size)
+    {
+        const uintptr_t offset = virtualAddress & (PAGE_SIZE - 1);
+        size = alignUp(size + offset, PAGE_SIZE);
+        virtualAddress -= offset;
+
+        while (size > 0) {
+            const size_t directoryIndex = virtualAddress >> LARGE_PAGE_SHIFT;
+            const uint32_t entry = directory_[directoryIndex];
+
+            if (!(entry & PAGE_PRESENT)) {
+                // Nothing is mapped up to the next page directory entry
+                size_t skipped = LARGE_PAGE_SIZE -
+                                 (virtualAddress & (LARGE_PAGE_SIZE - 1));
+                if (skipped >= size) {
+                    break;
+                }
+                virtualAddress += skipped;
+                size           -= skipped;
+                continue;
+            }
+
+            if (entry & PAGE_LARGE) {
+                if ((virtualAddress & (LARGE_PAGE_SIZE - 1)) == 0 &&
+                    size >= LARGE_PAGE_SIZE) {
+                    directory_[directoryIndex] = 0;
+                    cpu::invlpg(virtualAddress);
+
+                    virtualAddress += LARGE_PAGE_SIZE;
+                    size           -= LARGE_PAGE_SIZE;
+                    continue;
+                }
+
+                if (!splitLargePage(directoryIndex)) {
+                    return;
+                }
+            }
+
+            uint32_t* table = (uint32_t*) physicalToVirtual(
+                alignDown(directory_[directoryIndex], PAGE_SIZE));
+            table[(virtualAddress >> PAGE_SHIFT) & (ENTRY_COUNT - 1)] = 0;
+            cpu::invlpg(virtualAddress);
+
+            virtualAddress += PAGE_SIZE;
+            size           -= PAGE_SIZE;
+        }
+    }
+
+    /**
+     * \brief Get the physical address mapped at `virtualAddress`
+     *
+     * \param virtualAddress The virtual address to translate
+     * \param physicalAddress The physical address, if it is mapped
+     * \return false if nothing is mapped at `virtualAddress`
+     */
+    bool AddressSpace::translate(uintptr_t virtualAddress,
+                                 PhysicalAddress& physicalAddress) const
+    {
+        const uint32_t entry = directory_[virtualAddress >> LARGE_PAGE_SHIFT];
+        if (!(entry & PAGE_PRESENT)) {
+            return false;
+        }
+
+        if (entry & PAGE_LARGE) {
+            physicalAddress = alignDown(entry, LARGE_PAGE_SIZE) +
+                              (virtualAddress & (LARGE_PAGE_SIZE - 1));
+            return true;
+        }
+
+        const uint32_t* table = (const uint32_t*) physicalToVirtual(
+            alignDown(entry, PAGE_SIZE));
+        const uint32_t tableEntry =
+            table[(virtualAddress >> PAGE_SHIFT) & (ENTRY_COUNT - 1)];
+        if (!(tableEntry & PAGE_PRESENT)) {
+            return false;
+        }
+
+        physicalAddress = alignDown(tableEntry, PAGE_SIZE) +
+                          (virtualAddress & (PAGE_SIZE - 1));
+        return true;
+    }
+
+    /**
+     * \brief Make the address space the current one
+     *
+     * Only the TLB entries of the non-global pages (the user part) are
+     * flushed.
+     */
+    void AddressSpace::activate()
+    {
+        cpu::writeCr3(getDirectoryAddress());
+    }
+
+    /**
+     * \brief Get the physical address of the page directory
+     *
+     * \return The value of CR3 when the address space is the current one
+     */
+    PhysicalAddress AddressSpace::getDirectoryAddress() const
+    {
+        return virtualToPhysical(directory_);
+    }
+
+    /**
+     * \brief Get the page table of a directory entry, creating it if needed
+     *
+     * \param directoryIndex The index of the page directory entry
+     * \param flags The flags of the mapping that needs the table (only
+     * `PAGE_USER` matters)
+     * \return The page table, or nullptr if it could not be allocated
+     */
+    uint32_t* AddressSpace::getTable(size_t directoryIndex, uint32_t flags)
+    {
+        uint32_t entry = directory_[directoryIndex];
+
+        if ((entry & PAGE_PRESENT) && (entry & PAGE_LARGE)) {
+            if (!splitLargePage(directoryIndex)) {
+                return nullptr;
+            }
+            entry = directory_[directoryIndex];
+        }
+
+        if (!(entry & PAGE_PRESENT)) {
+            PhysicalAddress address = FrameAllocator::getInstance().allocate();
+            if (address == 0) {
+                return nullptr;
+            }
+
+            uint32_t* table = (uint32_t*) physicalToVirtual(address);
+            for (size_t i = 0; i < ENTRY_COUNT; ++i) {
+                table[i] = 0;
+            }
+            entry = address | PAGE_PRESENT | PAGE_WRITABLE;
+        }
+
+        // The directory entry must allow what any of its pages allows
+        directory_[directoryIndex] = entry | (flags & PAGE_USER);
+
+        return (uint32_t*) physicalToVirtual(alignDown(entry, PAGE_SIZE));
+    }
+
+    /**
+     * \brief Replace a 4 MiB page by a page table with the same mappings
+     *
+     * \param directoryIndex The index of the page directory entry
+     * \return false if the page table could not be allocated
+     */
+    bool AddressSpace::splitLargePage(size_t directoryIndex)
+    {
+        PhysicalAddress address = FrameAllocator::getInstance().allocate();
+        if (address == 0) {
+            return false;
+        }
+
+        const uint32_t entry = directory_[directoryIndex];
+        const PhysicalAddress base = alignDown(entry, LARGE_PAGE_SIZE);
+        const uint32_t flags = entry & SPLIT_FLAGS_MASK & ~PAGE_LARGE;
+
+        uint32_t* table = (uint32_t*) physicalToVirtual(address);
+        for (size_t i = 0; i < ENTRY_COUNT; ++i) {
+            table[i] = (base + i * PAGE_SIZE) | flags;
+        }
+
+        directory_[directoryIndex] = address | PAGE_PRESENT | PAGE_WRITABLE |
+                                     (entry & PAGE_USER);
+        cpu::invlpg(directoryIndex << LARGE_PAGE_SHIFT);
+
+        return true;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "memory.hpp"
+
+namespace memory
+{
+    /// The page is present
+    const uint32_t PAGE_PRESENT       = 1 << 0;
+    /// The page can be written
+    const uint32_t PAGE_WRITABLE      = 1 << 1;
+    /// The page can be accessed from user mode
+    const uint32_t PAGE_USER          = 1 << 2;
+    /// Writes to the page go through the cache to memory
+    const uint32_t PAGE_WRITE_THROUGH = 1 << 3;
+    /// The page is not cached (device memory)
+    const uint32_t PAGE_CACHE_DISABLE = 1 << 4;
+    /// The page directory entry maps a 4 MiB page
+    const uint32_t PAGE_LARGE         = 1 << 7;
+    /// The TLB entry of the page survives a reload of CR3
+    const uint32_t PAGE_GLOBAL        = 1 << 8;
+
+    /**
+     * \brief Map virtual addresses to physical addresses
+     *
+     * An address space is a two-level x86 page directory. The upper quarter
+     * of every address space is the kernel: its page directory entries are
+     * shared by all the address spaces and its pages are global, so their TLB
+     * entries survive the switches between address spaces.
+     *
+     * The kernel address space maps the first `DIRECT_MAP_SIZE` bytes of
+     * physical memory at `KERNEL_VIRTUAL_BASE` with 4 MiB pages. 4 KiB pages
+     * are only used where a finer granularity is needed (device memory for
+     * instance); a 4 MiB page is split in a page table when a part of it is
+     * remapped. Changing a mapping invalidates the TLB entries of the pages
+     * concerned only, with `invlpg`.
+     *
+     * Example:
+     * \code
+     * // Map the local APIC registers, uncached
+     * volatile uint32_t* lapic = (volatile uint32_t*)
+     *     AddressSpace::mapDevice(0xFEE00000, PAGE_SIZE);
+     * \endcode
+     */
+    class AddressSpace
+    {
+    public:
+        /// Get the kernel address space
+        static AddressSpace& getKernel();
+        /// Build the direct map of the kernel address space
+        static void initializeKernel();
+        /// Create an address space sharing the kernel mappings
+        static AddressSpace* create();
+        /// Map device memory in the kernel address space
+        static void* mapDevice(PhysicalAddress physicalAddress, size_t size);
+
+        /// Free an address space returned by `create`
+        static void destroy(AddressSpace* addressSpace);
+
+        /// Map `size` bytes at `virtualAddress` to `physicalAddress`
+        bool map(uintptr_t virtualAddress, PhysicalAddress physicalAddress,
+                 size_t size, uint32_t flags);
+        /// Unmap `size` bytes at `virtualAddress`
+        void unmap(uintptr_t virtualAddress, size_t size);
+        /// Get the physical address mapped at `virtualAddress`
+        bool translate(uintptr_t virtualAddress,
+                       PhysicalAddress& physicalAddress) const;
+
+        /// Make the address space the current one
+        void activate();
+        /// Get the physical address of the page directory (the value of CR3)
+        PhysicalAddress getDirectoryAddress() const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since an address space owns its page tables
+        AddressSpace(AddressSpace const&) = delete;
+        void operator=(AddressSpace const&) = delete;
+
+    private:
+        /// Wrap a page directory
+        constexpr AddressSpace(uint32_t* directory)
+            : directory_(directory)
+        {
+        }
+
+        /// Get the page table of a directory entry, creating it if needed
+        uint32_t* getTable(size_t directoryIndex, uint32_t flags);
+        /// Replace a 4 MiB page by a page table with the same mappings
+        bool splitLargePage(size_t directoryIndex);
+
+        /// The page directory (in the direct map)
+        uint32_t* directory_;
+
+        /// The index of the first page directory entry of the kernel
+        static const size_t KERNEL_DIRECTORY_INDEX =
+            KERNEL_VIRTUAL_BASE >> LARGE_PAGE_SHIFT;
+        /// The number of entries in a page directory or a page table
+        static const size_t ENTRY_COUNT = 1024;
+
+        /// The kernel address space
+        static AddressSpace kernel_;
+        /// `PAGE_GLOBAL` if the processor supports global pages, 0 otherwise
+        static uint32_t globalFlag_;
+        /// True once the page tables of the dynamic region exist
+        static bool areKernelTablesAllocated_;
+        /// The next free virtual address of the dynamic region
+        static uintptr_t nextDeviceAddress_;
+    };
+}
@@ -0,0 +1,568 @@
+#include "FrameAllocator.hpp"
+
+/// The first byte of the kernel image (defined in the linker script)
+extern "C" char kernel_start[];
+/// The byte after the end of the kernel image (defined in the linker script)
+extern "C" char kernel_end[];
+
+namespace memory
+{
+    /// The physical memory above this address is ignored (it is not in the
+    /// direct map)
+    static const uint64_t MAX_PHYSICAL_ADDRESS = DIRECT_MAP_SIZE;
+
+    /// The `FrameAllocator` singleton instance
+    FrameAllocator FrameAllocator::instance_;
+
+    /**
+     * \brief Initialize an empty allocator
+     */
+    FrameAllocator::FrameAllocator()
+        : frames_(nullptr), frameCount_(0), freeFrames_(0),
+          reservedBitmap_(nullptr), freeListMask_(0), hotCount_(0),
+          reservedRangeCount_(0)
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `FrameAllocator`
+     *
+     * \return the instance of the single object of the class `FrameAllocator`
+     */
+    FrameAllocator& FrameAllocator::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Build the free lists from the multiboot memory map
+     *
+     * The highest available address of the memory map gives the number of
+     * frames to describe. The descriptors and the reserved bitmap are then
+     * placed in the first available region that does not overlap the kernel
+     * or the bootloader structures. Finally, every frame that is not reserved
+     * is put in the free lists, in blocks as large as their alignment allows.
+     *
+     * \param info The multiboot information structure given by the bootloader
+     * \return false if the bootloader did not give a memory map or if there is
+     * no room for the metadata
+     */
+    bool FrameAllocator::initialize(const multiboot::Info* info)
+    {
+        if (!(info->flags & multiboot::INFO_MEMORY_MAP)) {
+            return false;
+        }
+
+        // Find the end of the usable physical memory
+        uint64_t memoryEnd = 0;
+        const uintptr_t mapEnd = info->memoryMapAddress + info->memoryMapLength;
+        for (uintptr_t address = info->memoryMapAddress; address < mapEnd;) {
+            const multiboot::MemoryMapEntry* entry =
+                (const multiboot::MemoryMapEntry*) physicalToVirtual(address);
+            uint64_t end = entry->baseAddress + entry->length;
+            if (entry->type == multiboot::MEMORY_AVAILABLE && end > memoryEnd) {
+                memoryEnd = end;
+            }
+            address += entry->size + sizeof(entry->size);
+        }
+        if (memoryEnd > MAX_PHYSICAL_ADDRESS) {
+            memoryEnd = MAX_PHYSICAL_ADDRESS;
+        }
+        frameCount_ = memoryEnd >> PAGE_SHIFT;
+
+        // Collect what must never be allocated: the real mode IVT and BIOS
+        // data area, the startup code of the processors, VGA memory and the
+        // BIOS, the kernel image and the structures given by the bootloader
+        addReservedRange(0, PAGE_SIZE);
+        addReservedRange(TRAMPOLINE_ADDRESS, TRAMPOLINE_ADDRESS + PAGE_SIZE);
+        addReservedRange(0xA0000, 0x100000);
+        addReservedRange(virtualToPhysical(kernel_start),
+                         virtualToPhysical(kernel_end));
+        addReservedRange(virtualToPhysical(info),
+                         virtualToPhysical(info) + sizeof(*info));
+        addReservedRange(info->memoryMapAddress, mapEnd);
+        if (info->flags & multiboot::INFO_COMMAND_LINE) {
+            const char* commandLine =
+                (const char*) physicalToVirtual(info->commandLine);
+            size_t length = 0;
+            while (commandLine[length] != '\0') {
+                ++length;
+            }
+            addReservedRange(info->commandLine, info->commandLine + length + 1);
+        }
+        if (info->flags & multiboot::INFO_MODULES) {
+            const multiboot::Module* modules =
+                (const multiboot::Module*) physicalToVirtual(
+                    info->modulesAddress);
+            addReservedRange(info->modulesAddress, info->modulesAddress +
+                             info->modulesCount * sizeof(multiboot::Module));
+            for (uint32_t i = 0; i < info->modulesCount; ++i) {
+                addReservedRange(modules[i].start, modules[i].end);
+            }
+        }
+
+        // Place the frame descriptors followed by the reserved bitmap
+        const size_t bitmapWords = (frameCount_ + 31) / 32;
+        const size_t descriptorsSize =
+            alignUp(frameCount_ * sizeof(Frame), sizeof(uint32_t));
+        const size_t metadataSize = descriptorsSize +
+                                    bitmapWords * sizeof(uint32_t);
+        PhysicalAddress metadata = findMetadataRoom(info, metadataSize);
+        if (metadata == 0) {
+            frameCount_ = 0;
+            return false;
+        }
+        addReservedRange(metadata, metadata + metadataSize);
+
+        frames_ = (Frame*) physicalToVirtual(metadata);
+        reservedBitmap_ = (uint32_t*) physicalToVirtual(metadata +
+                                                        descriptorsSize);
+        for (size_t i = 0; i < frameCount_; ++i) {
+            frames_[i] = Frame();
+        }
+
+        // Everything is reserved but the available regions of the memory map,
+        // minus the reserved ranges
+        for (size_t i = 0; i < bitmapWords; ++i) {
+            reservedBitmap_[i] = 0xFFFFFFFF;
+        }
+        for (uintptr_t address = info->memoryMapAddress; address < mapEnd;) {
+            const multiboot::MemoryMapEntry* entry =
+                (const multiboot::MemoryMapEntry*) physicalToVirtual(address);
+            if (entry->type == multiboot::MEMORY_AVAILABLE) {
+                markAvailable(entry->baseAddress,
+                              entry->baseAddress + entry->length);
+            }
+            address += entry->size + sizeof(entry->size);
+        }
+        for (size_t i = 0; i < reservedRangeCount_; ++i) {
+            markReserved(reservedRanges_[i].start, reservedRanges_[i].end);
+        }
+
+        buildFreeLists();
+
+        return true;
+    }
+
+    /**
+     * \brief Allocate a block of `2^order` contiguous frames
+     *
+     * A single frame comes from the hot cache when it is not empty. Otherwise
+     * the smallest free block big enough is split until it has the requested
+     * order. The block is aligned on its size.
+     *
+     * \param order The order of the block
+     * \return The physical address of the block, or 0 if there is no free
+     * block big enough
+     */
+    PhysicalAddress FrameAllocator::allocate(uint8_t order)
+    {
+        if (order > MAX_ORDER) {
+            return 0;
+        }
+
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+
+        PhysicalAddress address;
+        if (order == 0 && hotCount_ > 0) {
+            uint32_t index = hotFrames_[--hotCount_];
+            frames_[index].order = 0;
+            frames_[index].flags = 0;
+            --freeFrames_;
+            address = (PhysicalAddress) index << PAGE_SHIFT;
+        }
+        else {
+            address = allocateBlock(order);
+            if (address == 0 && hotCount_ > 0) {
+                // The cached frames might complete a block of the requested
+                // order
+                drainHotFrames(hotCount_);
+                address = allocateBlock(order);
+            }
+        }
+
+        lock_.unlockAndRestoreInterrupts(flags);
+        return address;
+    }
+
+    /**
+     * \brief Free a block of `2^order` contiguous frames
+     *
+     * \param address The physical address of the block, as returned by
+     * `allocate`
+     * \param order The order given to `allocate`
+     */
+    void FrameAllocator::free(PhysicalAddress address, uint8_t order)
+    {
+        size_t index = address >> PAGE_SHIFT;
+        if (index >= frameCount_ || order > MAX_ORDER || isReserved(address)) {
+            return;
+        }
+
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+
+        if (order == 0) {
+            if (hotCount_ == HOT_CAPACITY) {
+                drainHotFrames(HOT_CAPACITY / 2);
+            }
+            hotFrames_[hotCount_++] = index;
+            frames_[index].flags = FRAME_CACHED;
+            ++freeFrames_;
+        }
+        else {
+            freeBlock(index, order);
+        }
+
+        lock_.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Get the smallest order of a block holding `size` bytes
+     *
+     * \param size The size in bytes
+     * \return The order of the block
+     */
+    uint8_t FrameAllocator::getOrder(size_t size)
+    {
+        size_t frameCount = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint8_t order = 0;
+        while (((size_t) 1 << order) < frameCount) {
+            ++order;
+        }
+
+        return order;
+    }
+
+    /**
+     * \brief Return true if the frame at `address` can never be allocated
+     *
+     * \param address A physical address inside the frame
+     * \return true if the frame is reserved or outside of the physical memory
+     */
+    bool FrameAllocator::isReserved(PhysicalAddress address) const
+    {
+        size_t index = address >> PAGE_SHIFT;
+        if (index >= frameCount_) {
+            return true;
+        }
+
+        return reservedBitmap_[index / 32] & (1u << (index % 32));
+    }
+
+    /**
+     * \brief Get the descriptor of the frame at `address`
+     *
+     * \param address A physical address inside the frame
+     * \return The descriptor of the frame, or nullptr if the address is
+     * outside of the physical memory
+     */
+    Frame* FrameAllocator::getFrame(PhysicalAddress address) const
+    {
+        size_t index = address >> PAGE_SHIFT;
+        if (index >= frameCount_) {
+            return nullptr;
+        }
+
+        return &frames_[index];
+    }
+
+    /**
+     * \brief Get the number of frames described by the allocator
+     *
+     * \return The number of frames, reserved ones included
+     */
+    size_t FrameAllocator::getTotalFrames() const
+    {
+        return frameCount_;
+    }
+
+    /**
+     * \brief Get the number of free frames
+     *
+     * \return The number of frames that can be allocated
+     */
+    size_t FrameAllocator::getFreeFrames() const
+    {
+        return freeFrames_;
+    }
+
+    /**
+     * \brief Add a range to the reserved ranges used during initialization
+     *
+     * \param start The first byte of the range
+     * \param end The byte after the last byte of the range
+     */
+    void FrameAllocator::addReservedRange(uint64_t start, uint64_t end)
+    {
+        if (reservedRangeCount_ < MAX_RESERVED_RANGES && start < end) {
+            reservedRanges_[reservedRangeCount_].start = start;
+            reservedRanges_[reservedRangeCount_].end   = end;
+            ++reservedRangeCount_;
+        }
+    }
+
+    /**
+     * \brief Find room for the descriptors and the bitmap in available memory
+     *
+     * \param info The multiboot information structure given by the bootloader
+     * \param size The size of the metadata in bytes
+     * \return The page aligned physical address of the room, or 0 if there is
+     * none
+     */
+    PhysicalAddress FrameAllocator::findMetadataRoom(
+        const multiboot::Info* info, size_t size) const
+    {
+        const uintptr_t mapEnd = info->memoryMapAddress + info->memoryMapLength;
+        for (uintptr_t address = info->memoryMapAddress; address < mapEnd;) {
+            const multiboot::MemoryMapEntry* entry =
+                (const multiboot::MemoryMapEntry*) physicalToVirtual(address);
+            address += entry->size + sizeof(entry->size);
+
+            if (entry->type != multiboot::MEMORY_AVAILABLE ||
+                entry->baseAddress >= MAX_PHYSICAL_ADDRESS) {
+                continue;
+            }
+
+            uint64_t regionEnd = entry->baseAddress + entry->length;
+            if (regionEnd > MAX_PHYSICAL_ADDRESS) {
+                regionEnd = MAX_PHYSICAL_ADDRESS;
+            }
+
+            // Move the candidate after every reserved range it overlaps until
+            // it overlaps none
+            uint64_t candidate = alignUp(entry->baseAddress, PAGE_SIZE);
+            bool isOverlapping = true;
+            while (isOverlapping && candidate + size <= regionEnd) {
+                isOverlapping = false;
+                for (size_t i = 0; i < reservedRangeCount_; ++i) {
+                    const Range& range = reservedRanges_[i];
+                    if (candidate < range.end &&
+                        range.start < candidate + size) {
+                        candidate = alignUp(range.end, PAGE_SIZE);
+                        isOverlapping = true;
+                    }
+                }
+            }
+
+            if (!isOverlapping && candidate != 0 &&
+                candidate + size <= regionEnd) {
+                return candidate;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * \brief Set the reserved bit of the frames overlapping [start, end)
+     *
+     * \param start The first byte of the range
+     * \param end The byte after the last byte of the range
+     */
+    void FrameAllocator::markReserved(uint64_t start, uint64_t end)
+    {
+        uint64_t first = start >> PAGE_SHIFT;
+        uint64_t last  = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        for (uint64_t index = first; index < last && index < frameCount_;
+             ++index) {
+            reservedBitmap_[index / 32] |= 1u << (index % 32);
+        }
+    }
+
+    /**
+     * \brief Clear the reserved bit of the frames inside [start, end)
+     *
+     * Frames only partially inside the range stay reserved.
+     *
+     * \param start The first byte of the range
+     * \param end The byte after the last byte of the range
+     */
+    void FrameAllocator::markAvailable(uint64_t start, uint64_t end)
+    {
+        uint64_t first = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint64_t last  = end >> PAGE_SHIFT;
+        for (uint64_t index = first; index < last && index < frameCount_;
+             ++index) {
+            reservedBitmap_[index / 32] &= ~(1u << (index % 32));
+        }
+    }
+
+    /**
+     * \brief Put the blocks of the unreserved frames in the free lists
+     *
+     * Each run of unreserved frames is cut in the largest blocks that are
+     * aligned on their size and fit in the run.
+     */
+    void FrameAllocator::buildFreeLists()
+    {
+        for (uint8_t order = 0; order <= MAX_ORDER; ++order) {
+            freeLists_[order].next = &freeLists_[order];
+            freeLists_[order].prev = &freeLists_[order];
+        }
+        freeListMask_ = 0;
+        freeFrames_   = 0;
+        hotCount_     = 0;
+
+        size_t index = 0;
+        while (index < frameCount_) {
+            // Skip fully reserved words of the bitmap at once
+            if (index % 32 == 0 && reservedBitmap_[index / 32] == 0xFFFFFFFF) {
+                index += 32;
+                continue;
+            }
+            if (isReserved(index << PAGE_SHIFT)) {
+                ++index;
+                continue;
+            }
+
+            size_t end = index;
+            while (end < frameCount_ && !isReserved(end << PAGE_SHIFT)) {
+                ++end;
+            }
+
+            while (index < end) {
+                uint8_t order = MAX_ORDER;
+                while (order > 0 && ((index & ((1u << order) - 1)) != 0 ||
+                                     index + (1u << order) > end)) {
+                    --order;
+                }
+                pushBlock(index, order);
+                freeFrames_ += 1u << order;
+                index += 1u << order;
+            }
+        }
+    }
+
+    /**
+     * \brief Add a free block to the list of its order
+     *
+     * \param index The index of the first frame of the block
+     * \param order The order of the block
+     */
+    void FrameAllocator::pushBlock(size_t index, uint8_t order)
+    {
+        Frame* frame = &frames_[index];
+        Frame* head  = &freeLists_[order];
+
+        frame->order = order;
+        frame->flags = FRAME_FREE;
+        frame->prev  = head;
+        frame->next  = head->next;
+        head->next->prev = frame;
+        head->next = frame;
+
+        freeListMask_ |= 1u << order;
+    }
+
+    /**
+     * \brief Remove a free block from the list of its order
+     *
+     * \param frame The descriptor of the first frame of the block
+     */
+    void FrameAllocator::removeBlock(Frame* frame)
+    {
+        frame->prev->next = frame->next;
+        frame->next->prev = frame->prev;
+        frame->flags = 0;
+
+        const Frame* head = &freeLists_[frame->order];
+        if (head->next == head) {
+            freeListMask_ &= ~(1u << frame->order);
+        }
+    }
+
+    /**
+     * \brief Take a block from the buddy free lists
+     *
+     * \param order The order of the block
+     * \return The physical address of the block, or 0 if there is no free
+     * block big enough
+     */
+    PhysicalAddress FrameAllocator::allocateBlock(uint8_t order)
+    {
+        // The lowest non-empty list of an order high enough
+        uint32_t candidates = freeListMask_ & ~((1u << order) - 1);
+        if (candidates == 0) {
+            return 0;
+        }
+        uint8_t current = __builtin_ctz(candidates);
+
+        Frame* frame = freeLists_[current].next;
+        removeBlock(frame);
+        size_t index = getIndex(frame);
+
+        // Give the upper halves back until the block has the right order
+        while (current > order) {
+            --current;
+            pushBlock(index + (1u << current), current);
+        }
+        frame->order = order;
+        freeFrames_ -= 1u << order;
+
+        return (PhysicalAddress) index << PAGE_SHIFT;
+    }
+
+    /**
+     * \brief Give a block back to the buddy free lists
+     *
+     * The block is merged with its buddy as long as the buddy is a free block
+     * of the same order.
+     *
+     * \param index The index of the first frame of the block
+     * \param order The order of the block
+     */
+    void FrameAllocator::freeBlock(size_t index, uint8_t order)
+    {
+        freeFrames_ += 1u << order;
+
+        while (order < MAX_ORDER) {
+            size_t buddyIndex = index ^ (1u << order);
+            if (buddyIndex >= frameCount_) {
+                break;
+            }
+
+            Frame* buddy = &frames_[buddyIndex];
+            if (!(buddy->flags & FRAME_FREE) || buddy->order != order) {
+                break;
+            }
+
+            removeBlock(buddy);
+            index &= ~(1u << order);
+            ++order;
+        }
+
+        pushBlock(index, order);
+    }
+
+    /**
+     * \brief Give the frames of the hot cache back to the buddy free lists
+     *
+     * The oldest frames are given back first: the most recently freed ones are
+     * the most likely to still be in the processor caches.
+     *
+     * \param count The number of frames to give back
+     */
+    void FrameAllocator::drainHotFrames(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            --freeFrames_;
+            freeBlock(hotFrames_[i], 0);
+        }
+
+        hotCount_ -= count;
+        for (size_t i = 0; i < hotCount_; ++i) {
+            hotFrames_[i] = hotFrames_[i + count];
+        }
+    }
+
+    /**
+     * \brief Get the index of a frame descriptor
+     *
+     * \param frame The descriptor
+     * \return The index of the frame it describes
+     */
+    size_t FrameAllocator::getIndex(const Frame* frame) const
+    {
+        return frame - frames_;
+    }
+}
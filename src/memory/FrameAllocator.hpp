@@ -0,0 +1,176 @@
+#pragma once
+
+#include "memory.hpp"
+#include "../multiboot.hpp"
+#include "../sync/Spinlock.hpp"
+
+namespace memory
+{
+    /**
+     * \brief Description of a physical page frame
+     *
+     * One descriptor exists for every frame of the physical memory. The free
+     * lists of the allocator link the descriptors and not the frames
+     * themselves, so free memory is never touched (nor needs to be mapped).
+     */
+    struct Frame
+    {
+        /// The next free block of the same order
+        Frame*  next;
+        /// The previous free block of the same order
+        Frame*  prev;
+        /// The object owning the frame once allocated (the slab of the heap
+        /// for instance)
+        void*   owner;
+        /// The order of the block starting at this frame
+        uint8_t order;
+        /// The state of the frame (`FRAME_FREE`, `FRAME_CACHED`, ...)
+        uint8_t flags;
+    };
+
+    /// The frame is the first frame of a block in a free list
+    const uint8_t FRAME_FREE   = 1 << 0;
+    /// The frame is a single free frame kept in the hot frames cache
+    const uint8_t FRAME_CACHED = 1 << 1;
+    /// The frame belongs to a slab of the heap (`Frame::owner` is the slab)
+    const uint8_t FRAME_SLAB   = 1 << 2;
+    /// The frame is the first frame of a large object of the heap
+    const uint8_t FRAME_LARGE  = 1 << 3;
+
+    /**
+     * \brief Allocate physical page frames
+     *
+     * This singleton object is a buddy allocator built from the memory map
+     * given by the bootloader. Blocks of `2^order` contiguous frames, aligned
+     * on their size, are kept in one free list per order. A bitmask of the
+     * non-empty lists finds the smallest block big enough with a single bit
+     * scan. Freed blocks are merged with their buddy when it is free too.
+     *
+     * Single frames are the most common request, so a small stack of free
+     * frames sits in front of the buddy lists: allocating or freeing one frame
+     * is a push or a pop when the stack can serve it.
+     *
+     * A bitmap (one bit per frame) records the frames that can never be
+     * allocated: memory holes, the first frame (real mode IVT and BIOS data
+     * area), the startup code of the other processors, VGA memory and the
+     * BIOS, the kernel image, the structures given by the bootloader and the
+     * allocator's own metadata.
+     *
+     * `allocate` and `free` can be called by any processor, and by interrupt
+     * handlers.
+     *
+     * Example:
+     * \code
+     * FrameAllocator& frames = FrameAllocator::getInstance();
+     * // A contiguous 4 MiB buffer
+     * const uint8_t order = FrameAllocator::getOrder(4 << 20);
+     * PhysicalAddress buffer = frames.allocate(order);
+     * frames.free(buffer, order);
+     * \endcode
+     */
+    class FrameAllocator
+    {
+    public:
+        /// The highest order of a block (2^12 frames = 16 MiB)
+        static const uint8_t MAX_ORDER = 12;
+
+        /// Get the instance of the singleton object `FrameAllocator`
+        static FrameAllocator& getInstance();
+
+        /// Build the free lists from the multiboot memory map
+        bool initialize(const multiboot::Info* info);
+
+        /// Allocate a block of `2^order` contiguous frames
+        PhysicalAddress allocate(uint8_t order = 0);
+        /// Free a block of `2^order` contiguous frames
+        void free(PhysicalAddress address, uint8_t order = 0);
+
+        /// Get the smallest order of a block holding `size` bytes
+        static uint8_t getOrder(size_t size);
+        /// Return true if the frame at `address` can never be allocated
+        bool isReserved(PhysicalAddress address) const;
+        /// Get the descriptor of the frame at `address`
+        Frame* getFrame(PhysicalAddress address) const;
+
+        /// Get the number of frames described by the allocator
+        size_t getTotalFrames() const;
+        /// Get the number of free frames
+        size_t getFreeFrames() const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the is a singleton
+        FrameAllocator(FrameAllocator const&) = delete;
+        void operator=(FrameAllocator const&) = delete;
+
+    private:
+        /// A range of physical memory [start, end)
+        struct Range
+        {
+            uint64_t start;
+            uint64_t end;
+        };
+
+        /// Initialize an empty allocator
+        FrameAllocator();
+
+        /// Add a range to the reserved ranges used during initialization
+        void addReservedRange(uint64_t start, uint64_t end);
+        /// Find room for the descriptors and the bitmap in available memory
+        PhysicalAddress findMetadataRoom(const multiboot::Info* info,
+                                         size_t size) const;
+        /// Set the reserved bit of the frames overlapping [start, end)
+        void markReserved(uint64_t start, uint64_t end);
+        /// Clear the reserved bit of the frames inside [start, end)
+        void markAvailable(uint64_t start, uint64_t end);
+        /// Put the blocks of the unreserved frames in the free lists
+        void buildFreeLists();
+
+        /// Add a free block to the list of its order
+        void pushBlock(size_t index, uint8_t order);
+        /// Remove a free block from the list of its order
+        void removeBlock(Frame* frame);
+        /// Take a block from the buddy free lists
+        PhysicalAddress allocateBlock(uint8_t order);
+        /// Give a block back to the buddy free lists
+        void freeBlock(size_t index, uint8_t order);
+        /// Give the frames of the hot cache back to the buddy free lists
+        void drainHotFrames(size_t count);
+
+        /// Get the index of a frame descriptor
+        size_t getIndex(const Frame* frame) const;
+
+        /// The `FrameAllocator` singleton instance
+        static FrameAllocator instance_;
+
+        /// Protect the free lists and the hot cache
+        sync::Spinlock lock_;
+
+        /// The descriptors of every frame
+        Frame*    frames_;
+        /// The number of frames described
+        size_t    frameCount_;
+        /// The number of free frames (in the lists and in the hot cache)
+        size_t    freeFrames_;
+        /// The bitmap of the reserved frames (one bit per frame)
+        uint32_t* reservedBitmap_;
+
+        /// Sentinel heads of the circular free lists, one per order
+        Frame     freeLists_[MAX_ORDER + 1];
+        /// Bit `n` is set when the free list of order `n` is not empty
+        uint32_t  freeListMask_;
+
+        /// The capacity of the hot frames cache
+        static const size_t HOT_CAPACITY = 64;
+        /// The indexes of the single frames in the hot cache
+        uint32_t  hotFrames_[HOT_CAPACITY];
+        /// The number of frames in the hot cache
+        size_t    hotCount_;
+
+        /// The maximum number of reserved ranges used during initialization
+        static const size_t MAX_RESERVED_RANGES = 16;
+        /// The ranges reserved during initialization
+        Range     reservedRanges_[MAX_RESERVED_RANGES];
+        /// The number of reserved ranges
+        size_t    reservedRangeCount_;
+    };
+}
@@ -0,0 +1,428 @@
+#include "Heap.hpp"
+#include "FrameAllocator.hpp"
+#include "../util/format.hpp"
+
+namespace memory
+{
+    /// The alignment of the first object of a slab
+    static const size_t SLAB_OBJECT_ALIGNMENT = 16;
+    /// A slab is made bigger (up to `MAX_SLAB_ORDER`) until it holds at least
+    /// this number of objects
+    static const size_t MIN_OBJECTS_PER_SLAB = 8;
+    /// The highest order of the blocks of frames used as slabs
+    static const uint8_t MAX_SLAB_ORDER = 3;
+
+    /**
+     * \brief Initialize an empty cache for objects of `2^sizeShift` bytes
+     *
+     * The size of the slabs is chosen so that they hold at least
+     * `MIN_OBJECTS_PER_SLAB` objects once the header and the free stack are
+     * taken into account.
+     *
+     * \param sizeShift The log2 of the size of the objects
+     */
+    void SlabCache::initialize(uint8_t sizeShift)
+    {
+        const size_t objectSize = (size_t) 1 << sizeShift;
+
+        sizeShift_    = sizeShift;
+        partialSlabs_ = nullptr;
+        emptySlabs_   = 0;
+        slabCount_    = 0;
+        liveObjects_  = 0;
+
+        for (slabOrder_ = 0; ; ++slabOrder_) {
+            const size_t slabSize = PAGE_SIZE << slabOrder_;
+            size_t count = (slabSize - sizeof(Slab)) /
+                           (objectSize + sizeof(uint16_t));
+            while (alignUp(sizeof(Slab) + count * sizeof(uint16_t),
+                           SLAB_OBJECT_ALIGNMENT) + count * objectSize >
+                   slabSize) {
+                --count;
+            }
+            objectsPerSlab_ = count;
+
+            if (count >= MIN_OBJECTS_PER_SLAB || slabOrder_ == MAX_SLAB_ORDER) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * \brief Allocate an object
+     *
+     * The object comes from the first slab with a free object, a new slab is
+     * created only if there is none.
+     *
+     * \return The address of the object, or nullptr if there is no memory
+     * left
+     */
+    void* SlabCache::allocate()
+    {
+        Slab* slab = partialSlabs_;
+        if (slab == nullptr) {
+            slab = createSlab();
+            if (slab == nullptr) {
+                return nullptr;
+            }
+        }
+
+        if (slab->freeCount == objectsPerSlab_) {
+            --emptySlabs_;
+        }
+        uint16_t index = slab->getFreeIndexes()[--slab->freeCount];
+        if (slab->freeCount == 0) {
+            unlinkSlab(slab);
+        }
+        ++liveObjects_;
+
+        return slab->objects + ((size_t) index << sizeShift_);
+    }
+
+    /**
+     * \brief Free an object of `slab`
+     *
+     * The index of the object is pushed on the free stack of its slab. A slab
+     * that becomes empty is given back to the frame allocator if the cache
+     * already keeps an empty slab.
+     *
+     * \param slab The slab the object belongs to
+     * \param object The address of the object
+     */
+    void SlabCache::free(Slab* slab, void* object)
+    {
+        uint16_t index = ((uint8_t*) object - slab->objects) >> sizeShift_;
+        slab->getFreeIndexes()[slab->freeCount++] = index;
+        --liveObjects_;
+
+        if (slab->freeCount == 1) {
+            // The slab was full, it has a free object again
+            linkSlab(slab);
+        }
+
+        if (slab->freeCount == objectsPerSlab_) {
+            if (emptySlabs_ > 0) {
+                unlinkSlab(slab);
+                destroySlab(slab);
+            }
+            else {
+                ++emptySlabs_;
+            }
+        }
+    }
+
+    /**
+     * \brief Get the statistics of the cache
+     *
+     * \param statistics The structure to fill
+     */
+    void SlabCache::getStatistics(SlabCacheStatistics& statistics) const
+    {
+        const size_t slabsSize = slabCount_ * (PAGE_SIZE << slabOrder_);
+
+        statistics.objectSize     = (size_t) 1 << sizeShift_;
+        statistics.liveObjects    = liveObjects_;
+        statistics.slabs          = slabCount_;
+        statistics.objectsPerSlab = objectsPerSlab_;
+        statistics.fragmentation  = 0;
+        if (slabsSize != 0) {
+            statistics.fragmentation =
+                100 - (liveObjects_ << sizeShift_) * 100 / slabsSize;
+        }
+    }
+
+    /**
+     * \brief Get a new slab from the frame allocator
+     *
+     * Every frame of the slab points to its header so that the slab of an
+     * object is found from the object address. The new slab is linked in the
+     * list of the slabs with free objects.
+     *
+     * \return The new slab, or nullptr if there is no memory left
+     */
+    Slab* SlabCache::createSlab()
+    {
+        FrameAllocator& frames = FrameAllocator::getInstance();
+        PhysicalAddress address = frames.allocate(slabOrder_);
+        if (address == 0) {
+            return nullptr;
+        }
+
+        Slab* slab = (Slab*) physicalToVirtual(address);
+        slab->cache     = this;
+        slab->objects   = (uint8_t*) slab +
+                          alignUp(sizeof(Slab) +
+                                  objectsPerSlab_ * sizeof(uint16_t),
+                                  SLAB_OBJECT_ALIGNMENT);
+        slab->freeCount = objectsPerSlab_;
+
+        // The lowest addresses are allocated first
+        uint16_t* freeIndexes = slab->getFreeIndexes();
+        for (uint16_t i = 0; i < objectsPerSlab_; ++i) {
+            freeIndexes[i] = objectsPerSlab_ - 1 - i;
+        }
+
+        for (size_t i = 0; i < ((size_t) 1 << slabOrder_); ++i) {
+            Frame* frame = frames.getFrame(address + i * PAGE_SIZE);
+            frame->owner = slab;
+            frame->flags = FRAME_SLAB;
+        }
+
+        ++slabCount_;
+        ++emptySlabs_;
+        linkSlab(slab);
+
+        return slab;
+    }
+
+    /**
+     * \brief Give a slab back to the frame allocator
+     *
+     * \param slab The slab, already unlinked
+     */
+    void SlabCache::destroySlab(Slab* slab)
+    {
+        FrameAllocator& frames = FrameAllocator::getInstance();
+        PhysicalAddress address = virtualToPhysical(slab);
+
+        for (size_t i = 0; i < ((size_t) 1 << slabOrder_); ++i) {
+            Frame* frame = frames.getFrame(address + i * PAGE_SIZE);
+            frame->owner = nullptr;
+            frame->flags = 0;
+        }
+        frames.free(address, slabOrder_);
+
+        --slabCount_;
+    }
+
+    /**
+     * \brief Add a slab to the list of the slabs with free objects
+     *
+     * \param slab The slab to add at the head of the list
+     */
+    void SlabCache::linkSlab(Slab* slab)
+    {
+        slab->prev = nullptr;
+        slab->next = partialSlabs_;
+        if (partialSlabs_ != nullptr) {
+            partialSlabs_->prev = slab;
+        }
+        partialSlabs_ = slab;
+    }
+
+    /**
+     * \brief Remove a slab from the list of the slabs with free objects
+     *
+     * \param slab The slab to remove
+     */
+    void SlabCache::unlinkSlab(Slab* slab)
+    {
+        if (slab->prev != nullptr) {
+            slab->prev->next = slab->next;
+        }
+        else {
+            partialSlabs_ = slab->next;
+        }
+        if (slab->next != nullptr) {
+            slab->next->prev = slab->prev;
+        }
+    }
+
+    /// The `Heap` singleton instance
+    Heap Heap::instance_;
+
+    /**
+     * \brief Initialize the slab caches
+     *
+     * No memory is taken from the frame allocator until the first allocation.
+     */
+    Heap::Heap()
+        : largeObjects_(0), largeFrames_(0)
+    {
+        // The first size class holds objects of 2^4 = 16 bytes
+        for (size_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            caches_[i].initialize(4 + i);
+        }
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `Heap`
+     *
+     * \return the instance of the single object of the class `Heap`
+     */
+    Heap& Heap::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Allocate `size` bytes
+     *
+     * \param size The number of bytes to allocate
+     * \return The address of the memory (aligned on 16 bytes), or nullptr if
+     * there is no memory left
+     */
+    void* Heap::allocate(size_t size)
+    {
+        void* address;
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+
+        if (size <= MAX_SLAB_OBJECT_SIZE) {
+            // The size class is the log2 of the size rounded up to a power of
+            // two, minus the log2 of the smallest size class
+            size_t sizeClass = 0;
+            if (size > MIN_SLAB_OBJECT_SIZE) {
+                sizeClass = 32 - __builtin_clz(size - 1) - 4;
+            }
+            address = caches_[sizeClass].allocate();
+        }
+        else {
+            address = allocateLarge(size);
+        }
+
+        lock_.unlockAndRestoreInterrupts(flags);
+
+        return address;
+    }
+
+    /**
+     * \brief Free memory returned by `allocate`
+     *
+     * \param address The address returned by `allocate` (nullptr is ignored)
+     */
+    void Heap::free(void* address)
+    {
+        if (address == nullptr) {
+            return;
+        }
+
+        FrameAllocator& frames = FrameAllocator::getInstance();
+        PhysicalAddress physicalAddress = virtualToPhysical(address);
+        Frame* frame = frames.getFrame(physicalAddress);
+        if (frame == nullptr) {
+            return;
+        }
+
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+
+        if (frame->flags & FRAME_SLAB) {
+            Slab* slab = (Slab*) frame->owner;
+            slab->cache->free(slab, address);
+        }
+        else if (frame->flags & FRAME_LARGE) {
+            uint8_t order = frame->order;
+            frame->flags = 0;
+            frames.free(physicalAddress, order);
+            --largeObjects_;
+            largeFrames_ -= (size_t) 1 << order;
+        }
+
+        lock_.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Get the statistics of a size class
+     *
+     * \param sizeClass The index of the size class (0 for 16 bytes)
+     * \param statistics The structure to fill
+     */
+    void Heap::getStatistics(size_t sizeClass,
+                             SlabCacheStatistics& statistics) const
+    {
+        caches_[sizeClass].getStatistics(statistics);
+    }
+
+    /**
+     * \brief Send the statistics of every size class to a serial port
+     *
+     * One line is sent per size class, followed by a line for the large
+     * objects.
+     *
+     * \param serialPort The serial port to send the statistics to
+     */
+    void Heap::dumpStatistics(SerialPort& serialPort) const
+    {
+        char line[96];
+
+        for (size_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            SlabCacheStatistics statistics;
+            getStatistics(i, statistics);
+
+            serialPort.write(line, util::format(
+                line, sizeof(line),
+                FORMAT("[HEAP] size {}: live {}, slabs {} ({} objects each), "
+                       "fragmentation {}%\n"),
+                statistics.objectSize, statistics.liveObjects,
+                statistics.slabs, statistics.objectsPerSlab,
+                statistics.fragmentation));
+        }
+
+        serialPort.write(line, util::format(
+            line, sizeof(line), FORMAT("[HEAP] large: live {}, frames {}\n"),
+            largeObjects_, largeFrames_));
+    }
+
+    /**
+     * \brief Allocate a large object directly from the frame allocator
+     *
+     * The object gets its own block of frames. The descriptor of its first
+     * frame records the order of the block for `free`.
+     *
+     * \param size The number of bytes to allocate
+     * \return The address of the object (aligned on a page), or nullptr if
+     * there is no memory left
+     */
+    void* Heap::allocateLarge(size_t size)
+    {
+        FrameAllocator& frames = FrameAllocator::getInstance();
+        uint8_t order = FrameAllocator::getOrder(size);
+        PhysicalAddress address = frames.allocate(order);
+        if (address == 0) {
+            return nullptr;
+        }
+
+        Frame* frame = frames.getFrame(address);
+        frame->order = order;
+        frame->flags = FRAME_LARGE;
+        ++largeObjects_;
+        largeFrames_ += (size_t) 1 << order;
+
+        return physicalToVirtual(address);
+    }
+}
+
+/// Allocate an object on the kernel heap
+void* operator new(size_t size)
+{
+    return memory::Heap::getInstance().allocate(size);
+}
+
+/// Allocate an array on the kernel heap
+void* operator new[](size_t size)
+{
+    return memory::Heap::getInstance().allocate(size);
+}
+
+/// Free an object allocated on the kernel heap
+void operator delete(void* address)
+{
+    memory::Heap::getInstance().free(address);
+}
+
+/// Free an array allocated on the kernel heap
+void operator delete[](void* address)
+{
+    memory::Heap::getInstance().free(address);
+}
+
+/// Free an object of known size allocated on the kernel heap
+void operator delete(void* address, size_t)
+{
+    memory::Heap::getInstance().free(address);
+}
+
+/// Free an array of known size allocated on the kernel heap
+void operator delete[](void* address, size_t)
+{
+    memory::Heap::getInstance().free(address);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "memory.hpp"
+#include "../SerialPort.hpp"
+#include "../sync/Spinlock.hpp"
+
+namespace memory
+{
+    class SlabCache;
+
+    /**
+     * \brief Header at the beginning of every slab
+     *
+     * A slab is a block of contiguous frames cut in objects of the same size.
+     * The indexes of the free objects are kept on a stack right after this
+     * header, so allocating and freeing never read or write the objects
+     * themselves.
+     */
+    struct Slab
+    {
+        /// The cache the slab belongs to
+        SlabCache* cache;
+        /// The next slab in the list of the cache
+        Slab*      next;
+        /// The previous slab in the list of the cache
+        Slab*      prev;
+        /// The address of the first object
+        uint8_t*   objects;
+        /// The number of indexes on the free stack
+        uint16_t   freeCount;
+
+        /// Get the stack of the indexes of the free objects
+        uint16_t* getFreeIndexes()
+        {
+            return (uint16_t*) (this + 1);
+        }
+    };
+
+    /**
+     * \brief Statistics of a slab cache
+     */
+    struct SlabCacheStatistics
+    {
+        /// The size of the objects of the cache
+        size_t objectSize;
+        /// The number of allocated objects
+        size_t liveObjects;
+        /// The number of slabs
+        size_t slabs;
+        /// The number of objects a slab can hold
+        size_t objectsPerSlab;
+        /// The percentage of the slabs memory not holding a live object
+        size_t fragmentation;
+    };
+
+    /**
+     * \brief Allocate objects of one size from slabs
+     *
+     * The slabs with at least one free object are kept in a list, the full
+     * ones are unlinked until an object is freed. At most one empty slab is
+     * kept to avoid going back and forth to the frame allocator.
+     */
+    class SlabCache
+    {
+    public:
+        /// Initialize an empty cache for objects of `2^sizeShift` bytes
+        void initialize(uint8_t sizeShift);
+
+        /// Allocate an object
+        void* allocate();
+        /// Free an object of `slab`
+        void free(Slab* slab, void* object);
+
+        /// Get the statistics of the cache
+        void getStatistics(SlabCacheStatistics& statistics) const;
+
+    private:
+        /// Get a new slab from the frame allocator
+        Slab* createSlab();
+        /// Give a slab back to the frame allocator
+        void destroySlab(Slab* slab);
+        /// Add a slab to the list of the slabs with free objects
+        void linkSlab(Slab* slab);
+        /// Remove a slab from the list of the slabs with free objects
+        void unlinkSlab(Slab* slab);
+
+        /// The log2 of the size of the objects
+        uint8_t  sizeShift_;
+        /// The order of the blocks of frames used as slabs
+        uint8_t  slabOrder_;
+        /// The number of objects in a slab
+        uint16_t objectsPerSlab_;
+        /// The slabs with at least one free object
+        Slab*    partialSlabs_;
+        /// The number of slabs with no allocated object
+        size_t   emptySlabs_;
+        /// The number of slabs
+        size_t   slabCount_;
+        /// The number of allocated objects
+        size_t   liveObjects_;
+    };
+
+    /**
+     * \brief Allocate memory for kernel objects
+     *
+     * This singleton object serves the global `new` and `delete` operators.
+     * Requests up to `MAX_SLAB_OBJECT_SIZE` bytes are rounded up to a power of
+     * two size class (16 to 2048 bytes) and served by the slab cache of that
+     * class. Larger requests get their own block of frames. Both paths are
+     * O(1): the descriptor of the first frame of an object tells which slab or
+     * block it belongs to.
+     *
+     * A single lock protects the heap, interrupts are disabled while it is
+     * taken.
+     */
+    class Heap
+    {
+    public:
+        /// The size of the smallest size class
+        static const size_t MIN_SLAB_OBJECT_SIZE = 16;
+        /// The size of the largest size class
+        static const size_t MAX_SLAB_OBJECT_SIZE = 2048;
+        /// The number of size classes
+        static const size_t SIZE_CLASS_COUNT = 8;
+
+        /// Get the instance of the singleton object `Heap`
+        static Heap& getInstance();
+
+        /// Allocate `size` bytes
+        void* allocate(size_t size);
+        /// Free memory returned by `allocate`
+        void free(void* address);
+
+        /// Get the statistics of a size class
+        void getStatistics(size_t sizeClass,
+                           SlabCacheStatistics& statistics) const;
+        /// Send the statistics of every size class to a serial port
+        void dumpStatistics(SerialPort& serialPort) const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the is a singleton
+        Heap(Heap const&) = delete;
+        void operator=(Heap const&) = delete;
+
+    private:
+        /// Initialize the slab caches
+        Heap();
+
+        /// Allocate a large object directly from the frame allocator
+        void* allocateLarge(size_t size);
+
+        /// The `Heap` singleton instance
+        static Heap instance_;
+
+        /// Protect the caches and the statistics (taken before the lock of
+        /// the frame allocator)
+        sync::Spinlock lock_;
+
+        /// One slab cache per size class
+        SlabCache caches_[SIZE_CLASS_COUNT];
+        /// The number of allocated large objects
+        size_t    largeObjects_;
+        /// The number of frames used by large objects
+        size_t    largeFrames_;
+    };
+}
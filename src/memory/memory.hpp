@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Wrap the constants and the helpers shared by the memory management
+ * code
+ */
+namespace memory
+{
+    /// An address in the physical address space
+    typedef uintptr_t PhysicalAddress;
+
+    /// The size of a page frame
+    const size_t PAGE_SIZE  = 4096;
+    /// The number of bits to shift an address by to get its frame number
+    const size_t PAGE_SHIFT = 12;
+
+    /// The size of a large page (a page directory entry with PSE)
+    const size_t LARGE_PAGE_SIZE  = 4 * 1024 * 1024;
+    /// The number of bits to shift an address by to get its page directory
+    /// index
+    const size_t LARGE_PAGE_SHIFT = 22;
+
+    /// The virtual address at which the physical memory is mapped (the
+    /// kernel image is at KERNEL_VIRTUAL_BASE + 1 MiB)
+    const uintptr_t KERNEL_VIRTUAL_BASE = 0xC0000000;
+    /// The size of the physical memory mapped at `KERNEL_VIRTUAL_BASE`, the
+    /// physical memory above is not used by the kernel
+    const size_t    DIRECT_MAP_SIZE     = 0x30000000;
+    /// The start of the virtual memory mapped on demand by the kernel (device
+    /// memory for instance), right after the direct map
+    const uintptr_t DYNAMIC_REGION_START = KERNEL_VIRTUAL_BASE +
+                                           DIRECT_MAP_SIZE;
+
+    /// The physical address of the real-mode code started by the other
+    /// processors (below 1 MiB and aligned on a page, the page is reserved)
+    const PhysicalAddress TRAMPOLINE_ADDRESS = 0x8000;
+
+    /// Round `value` down to a multiple of `alignment` (a power of two)
+    inline uintptr_t alignDown(uintptr_t value, uintptr_t alignment)
+    {
+        return value & ~(alignment - 1);
+    }
+
+    /// Round `value` up to a multiple of `alignment` (a power of two)
+    inline uintptr_t alignUp(uintptr_t value, uintptr_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    /// Get the pointer through which the kernel accesses a physical address
+    inline void* physicalToVirtual(PhysicalAddress address)
+    {
+        return (void*) (address + KERNEL_VIRTUAL_BASE);
+    }
+
+    /// Get the physical address of a pointer to kernel memory
+    inline PhysicalAddress virtualToPhysical(const void* address)
+    {
+        return (uintptr_t) address - KERNEL_VIRTUAL_BASE;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Structures handed to the kernel by a multiboot compliant bootloader
+ *
+ * The bootloader puts the magic number `BOOTLOADER_MAGIC` in EAX and the
+ * physical address of an `Info` structure in EBX before jumping to `_start`.
+ * Only the fields the kernel uses are described in details, see the multiboot
+ * specification for the others.
+ */
+namespace multiboot
+{
+    /// The value put in EAX by a multiboot compliant bootloader
+    const uint32_t BOOTLOADER_MAGIC = 0x2BADB002;
+
+    /// `Info::memoryLower` and `Info::memoryUpper` are valid
+    const uint32_t INFO_MEMORY      = 1 << 0;
+    /// `Info::commandLine` is valid
+    const uint32_t INFO_COMMAND_LINE = 1 << 2;
+    /// `Info::modulesCount` and `Info::modulesAddress` are valid
+    const uint32_t INFO_MODULES     = 1 << 3;
+    /// `Info::memoryMapLength` and `Info::memoryMapAddress` are valid
+    const uint32_t INFO_MEMORY_MAP  = 1 << 6;
+
+    /// Type of a memory map entry describing RAM usable by the kernel
+    const uint32_t MEMORY_AVAILABLE = 1;
+
+    /**
+     * \brief The multiboot information structure
+     */
+    struct __attribute__((packed)) Info
+    {
+        /// Which of the following fields are valid
+        uint32_t flags;
+        /// Amount of lower memory in KiB (starting at address 0)
+        uint32_t memoryLower;
+        /// Amount of upper memory in KiB (starting at address 1 MiB)
+        uint32_t memoryUpper;
+        /// The BIOS disk device the image was loaded from
+        uint32_t bootDevice;
+        /// The physical address of the null-terminated command line
+        uint32_t commandLine;
+        /// The number of modules loaded
+        uint32_t modulesCount;
+        /// The physical address of the first `Module` structure
+        uint32_t modulesAddress;
+        /// Symbol table information (a.out or ELF)
+        uint32_t symbols[4];
+        /// The size in bytes of the memory map
+        uint32_t memoryMapLength;
+        /// The physical address of the first `MemoryMapEntry`
+        uint32_t memoryMapAddress;
+    };
+
+    /**
+     * \brief A module loaded by the bootloader alongside the kernel
+     */
+    struct __attribute__((packed)) Module
+    {
+        /// The physical address of the first byte of the module
+        uint32_t start;
+        /// The physical address after the last byte of the module
+        uint32_t end;
+        /// The physical address of the null-terminated module string
+        uint32_t string;
+        /// Reserved, must be 0
+        uint32_t reserved;
+    };
+
+    /**
+     * \brief A region of the physical memory map
+     *
+     * The `size` field does not include itself: the next entry is located
+     * `size + 4` bytes after the current one.
+     */
+    struct __attribute__((packed)) MemoryMapEntry
+    {
+        /// The size of the entry (not counting this field)
+        uint32_t size;
+        /// The physical address of the region
+        uint64_t baseAddress;
+        /// The size in bytes of the region
+        uint64_t length;
+        /// The type of the region (`MEMORY_AVAILABLE` for usable RAM)
+        uint32_t type;
+    };
+}
@@ -0,0 +1,556 @@
+#include "Scheduler.hpp"
+#include "../apic/LocalApic.hpp"
+#include "../cpu/Fpu.hpp"
+#include "../smp/smp.hpp"
+#include "../timer/Pit.hpp"
+#include "../timer/Timer.hpp"
+
+/// Save the callee-saved registers and the stack pointer of the running
+/// thread, then resume another thread (switch.s)
+extern "C" void switch_context(uintptr_t* oldStackPointer,
+                               uintptr_t newStackPointer);
+
+namespace sched
+{
+    /// The `Scheduler` singleton instance
+    Scheduler Scheduler::instance_;
+
+    /**
+     * \brief Initialize the scheduler with no thread
+     */
+    Scheduler::Scheduler()
+        : runQueues_(), isInitialized_(false)
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `Scheduler`
+     *
+     * \return the instance of the single object of the class `Scheduler`
+     */
+    Scheduler& Scheduler::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Turn the caller into a thread and start the tick of the
+     * bootstrap processor
+     *
+     * The caller (`kernel_main`) keeps running as a thread of the default
+     * priority. The idle thread of the bootstrap processor is created. This
+     * must be done before the application processors are started, and after
+     * the local APIC timer is calibrated.
+     */
+    void Scheduler::initialize()
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+
+        RunQueue& runQueue = getRunQueue();
+        adoptCurrentContext(runQueue, DEFAULT_PRIORITY);
+        runQueue.idle = Thread::create(idle, nullptr, LOWEST_PRIORITY);
+        runQueue.idle->state_ = ThreadState::READY;
+
+        registerInterruptHandler(RESCHEDULE_VECTOR, handleReschedule, nullptr);
+        isInitialized_ = true;
+        timer::startTick();
+        runQueue.isRunning = true;
+
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Turn the boot context of an application processor into its idle
+     * thread
+     *
+     * Called by the processor once it entered the kernel. The processor only
+     * waits for interrupts if the scheduler is not initialized.
+     */
+    void Scheduler::runIdle()
+    {
+        if (isInitialized_) {
+            __asm__ volatile ("cli");
+
+            RunQueue& runQueue = getRunQueue();
+            runQueue.idle = adoptCurrentContext(runQueue, LOWEST_PRIORITY);
+            timer::startTick();
+            runQueue.isRunning = true;
+        }
+
+        idle(nullptr);
+    }
+
+    /**
+     * \brief Return true once `initialize` was called
+     *
+     * \return true if the scheduler runs threads
+     */
+    bool Scheduler::isInitialized() const
+    {
+        return isInitialized_;
+    }
+
+    /**
+     * \brief Get the thread running on the calling processor
+     *
+     * \return The running thread, or nullptr before the processor runs
+     * threads
+     */
+    Thread* Scheduler::getCurrentThread()
+    {
+        return getRunQueue().current;
+    }
+
+    /**
+     * \brief Let the other ready threads of the same priority run
+     *
+     * The calling thread goes at the end of the list of its priority. It
+     * keeps running if no other thread of the same or a higher priority is
+     * ready.
+     */
+    void Scheduler::yield()
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+        RunQueue& runQueue = getRunQueue();
+        if (runQueue.isRunning) {
+            runQueue.lock.lock();
+            schedule(runQueue);
+        }
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Wait for `milliseconds` ms
+     *
+     * The thread sleeps until its timer expires on the tick of its processor,
+     * or until `wake` is called. Before the scheduler runs, the PIT is polled
+     * instead.
+     *
+     * \param milliseconds The duration of the wait
+     */
+    void Scheduler::sleep(uint32_t milliseconds)
+    {
+        if (milliseconds == 0) {
+            yield();
+            return;
+        }
+
+        uint32_t flags = saveAndDisableInterrupts();
+        RunQueue& runQueue = getRunQueue();
+        if (!runQueue.isRunning) {
+            restoreInterrupts(flags);
+            timer::waitMicroseconds(milliseconds * 1000);
+            return;
+        }
+
+        runQueue.lock.lock();
+        Thread* thread = runQueue.current;
+        thread->state_ = ThreadState::SLEEPING;
+        timer::addTimer(thread->sleepTimer_,
+                        milliseconds * (timer::TICK_FREQUENCY / 1000),
+                        wakeSleepingThread, thread);
+        schedule(runQueue);
+
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Wait until another thread or an interrupt handler calls `wake`
+     *
+     * A `wake` that happened since the last `block` is not lost: `block`
+     * returns at once, so the usual pattern needs no lock.
+     *
+     * Example:
+     * \code
+     * while (!hasData()) {
+     *     scheduler.block();
+     * }
+     * \endcode
+     */
+    void Scheduler::block()
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+        RunQueue& runQueue = getRunQueue();
+        runQueue.lock.lock();
+
+        Thread* thread = runQueue.current;
+        if (thread->isWakePending_) {
+            thread->isWakePending_ = false;
+            runQueue.lock.unlock();
+        }
+        else {
+            thread->state_ = ThreadState::BLOCKED;
+            schedule(runQueue);
+        }
+
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Make a blocked or sleeping thread ready
+     *
+     * The thread is added to the run queue of its processor. If it has a
+     * higher priority than the running thread, that one is preempted: at the
+     * end of the current interrupt on the calling processor, or with a
+     * `RESCHEDULE_VECTOR` interrupt on another one. Waking a ready or running
+     * thread makes its next `block` return at once.
+     *
+     * This can be called by interrupt handlers.
+     *
+     * \param thread The thread to wake up
+     */
+    void Scheduler::wake(Thread* thread)
+    {
+        RunQueue& runQueue = runQueues_[thread->cpuIndex_];
+        uint32_t flags = runQueue.lock.lockAndDisableInterrupts();
+
+        bool isReady = true;
+        switch (thread->state_) {
+        case ThreadState::SLEEPING:
+            timer::cancelTimer(thread->sleepTimer_);
+            enqueue(runQueue, thread);
+            break;
+        case ThreadState::BLOCKED:
+            enqueue(runQueue, thread);
+            break;
+        default:
+            thread->isWakePending_ = true;
+            isReady = false;
+            break;
+        }
+
+        bool isRemote = false;
+        if (isReady && runQueue.isRunning &&
+            (runQueue.current == runQueue.idle ||
+             thread->priority_ < runQueue.current->priority_)) {
+            runQueue.isRescheduleNeeded = true;
+            isRemote = thread->cpuIndex_ != smp::getCurrentCpu()->index;
+        }
+
+        runQueue.lock.unlock();
+
+        if (isRemote) {
+            apic::LocalApic::getInstance().sendInterProcessorInterrupt(
+                smp::getCpu(thread->cpuIndex_)->apicId,
+                apic::LocalApic::COMMAND_FIXED | RESCHEDULE_VECTOR);
+        }
+
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Terminate the calling thread
+     *
+     * The thread is freed by the next thread of its processor, once it no
+     * longer runs on its stack.
+     */
+    void Scheduler::exit()
+    {
+        __asm__ volatile ("cli");
+
+        RunQueue& runQueue = getRunQueue();
+        runQueue.lock.lock();
+        runQueue.current->state_ = ThreadState::DEAD;
+        schedule(runQueue);
+
+        // A dead thread is never resumed
+        __builtin_unreachable();
+    }
+
+    /**
+     * \brief Wait for the next interrupt, with the tick stopped if no other
+     * thread is ready
+     *
+     * The caller keeps running once the interrupt is handled, unless the
+     * handler made a thread of a higher priority ready. When no thread is
+     * ready, the tick has no quantum to end, so it is stopped until the first
+     * timer of the processor (`timer::stopTick`): an idle processor is only
+     * woken up by its timers and its devices. The interrupt restarts it.
+     *
+     * `sti` only takes effect after `hlt`, so an interrupt arriving before
+     * the halt is not lost: it ends the halt at once. The state of the
+     * interrupts is restored on return.
+     */
+    void Scheduler::halt()
+    {
+        const uint32_t flags = saveAndDisableInterrupts();
+
+        RunQueue& runQueue = getRunQueue();
+        runQueue.lock.lock();
+        const bool isAlone = runQueue.isRunning && runQueue.readyMask == 0
+                             && !runQueue.isRescheduleNeeded;
+        runQueue.lock.unlock();
+        if (isAlone) {
+            timer::stopTick();
+        }
+
+        __asm__ volatile ("sti\n\thlt\n\tcli");
+        restoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Switch to another thread if the running one was preempted
+     *
+     * Called by `cHandleInterrupt` once the interrupt is acknowledged, with
+     * interrupts disabled. The preempted thread returns from the interrupt
+     * when it is resumed.
+     */
+    void Scheduler::preemptIfNeeded()
+    {
+        if (!isInitialized_) {
+            return;
+        }
+
+        RunQueue& runQueue = getRunQueue();
+        if (!runQueue.isRunning || !runQueue.isRescheduleNeeded) {
+            return;
+        }
+
+        runQueue.lock.lock();
+        schedule(runQueue);
+    }
+
+    /**
+     * \brief Count a tick of the running thread
+     *
+     * Called by the tick interrupt of the calling processor, once the expired
+     * timers ran (the sleeping threads they woke up are ready). The running
+     * thread is preempted when a thread of a higher priority is ready, or at
+     * the end of its quantum when another thread of the same priority is
+     * ready.
+     */
+    void Scheduler::handleTick()
+    {
+        RunQueue& runQueue = getRunQueue();
+        if (!runQueue.isRunning) {
+            return;
+        }
+
+        runQueue.lock.lock();
+
+        if (runQueue.quantumLeft > 0) {
+            --runQueue.quantumLeft;
+        }
+
+        if (runQueue.readyMask != 0) {
+            const Thread* current = runQueue.current;
+            const uint8_t highestReady = __builtin_ctz(runQueue.readyMask);
+            if (current == runQueue.idle ||
+                highestReady < current->priority_ ||
+                (highestReady == current->priority_ &&
+                 runQueue.quantumLeft == 0)) {
+                runQueue.isRescheduleNeeded = true;
+            }
+        }
+
+        runQueue.lock.unlock();
+    }
+
+    /**
+     * \brief Get the number of context switches of a processor
+     *
+     * \param cpuIndex The index of the processor
+     * \return The number of switches from one thread to another
+     */
+    uint64_t Scheduler::getSwitchCount(size_t cpuIndex)
+    {
+        RunQueue& runQueue = runQueues_[cpuIndex];
+        uint32_t flags = runQueue.lock.lockAndDisableInterrupts();
+        const uint64_t switchCount = runQueue.switchCount;
+        runQueue.lock.unlockAndRestoreInterrupts(flags);
+        return switchCount;
+    }
+
+    /**
+     * \brief Get the run queue of the calling processor
+     *
+     * \return The run queue of the processor
+     */
+    Scheduler::RunQueue& Scheduler::getRunQueue()
+    {
+        return runQueues_[smp::getCurrentCpu()->index];
+    }
+
+    /**
+     * \brief Make the calling context the running thread of its processor
+     *
+     * The thread keeps the stack of the context, which is never freed.
+     *
+     * \param runQueue The run queue of the calling processor
+     * \param priority The priority of the thread
+     * \return The thread
+     */
+    Thread* Scheduler::adoptCurrentContext(RunQueue& runQueue,
+                                           uint8_t priority)
+    {
+        Thread* thread = new Thread(nullptr, nullptr, priority, 0);
+        thread->state_ = ThreadState::RUNNING;
+        runQueue.current = thread;
+        runQueue.quantumLeft = QUANTUM_TICKS;
+        return thread;
+    }
+
+    /**
+     * \brief Add a ready thread at the end of the list of its priority
+     *
+     * \param runQueue The run queue of the processor of the thread (locked)
+     * \param thread The thread
+     */
+    void Scheduler::enqueue(RunQueue& runQueue, Thread* thread)
+    {
+        const uint8_t priority = thread->priority_;
+
+        thread->state_ = ThreadState::READY;
+        thread->next_ = nullptr;
+        if (runQueue.tails[priority] == nullptr) {
+            runQueue.heads[priority] = thread;
+        }
+        else {
+            runQueue.tails[priority]->next_ = thread;
+        }
+        runQueue.tails[priority] = thread;
+        runQueue.readyMask |= 1 << priority;
+    }
+
+    /**
+     * \brief Remove the first thread of the highest priority
+     *
+     * \param runQueue The run queue (locked)
+     * \return The thread, or nullptr if no thread is ready
+     */
+    Thread* Scheduler::dequeue(RunQueue& runQueue)
+    {
+        if (runQueue.readyMask == 0) {
+            return nullptr;
+        }
+
+        const uint8_t priority = __builtin_ctz(runQueue.readyMask);
+        Thread* thread = runQueue.heads[priority];
+        runQueue.heads[priority] = thread->next_;
+        if (thread->next_ == nullptr) {
+            runQueue.tails[priority] = nullptr;
+            runQueue.readyMask &= ~(1 << priority);
+        }
+        thread->next_ = nullptr;
+
+        return thread;
+    }
+
+    /**
+     * \brief Switch to the next ready thread
+     *
+     * The running thread goes back to the run queue if it is still running
+     * (it was preempted or it yields). The run queue must be locked and
+     * interrupts disabled: the lock is released before the switch, the
+     * interrupts stay disabled until the resumed thread restores them. Only
+     * the calling processor takes threads from its run queue, so the
+     * switched out thread cannot be resumed before its registers are saved.
+     *
+     * \param runQueue The run queue of the calling processor (locked)
+     */
+    void Scheduler::schedule(RunQueue& runQueue)
+    {
+        Thread* previous = runQueue.current;
+        if (previous->state_ == ThreadState::RUNNING &&
+            previous != runQueue.idle) {
+            enqueue(runQueue, previous);
+        }
+
+        Thread* next = dequeue(runQueue);
+        if (next == nullptr) {
+            next = runQueue.idle;
+        }
+
+        runQueue.isRescheduleNeeded = false;
+        runQueue.quantumLeft = QUANTUM_TICKS;
+        next->state_ = ThreadState::RUNNING;
+
+        if (next == previous) {
+            runQueue.lock.unlock();
+            return;
+        }
+
+        runQueue.current = next;
+        runQueue.previous = previous;
+        ++runQueue.switchCount;
+        runQueue.lock.unlock();
+
+        // The registers of the FPU are switched lazily, by the #NM trap
+        cpu::armFpuTrap();
+        switch_context(&previous->stackPointer_, next->stackPointer_);
+
+        // Running `next` (this is now the previous thread of another switch)
+        finishSwitch();
+    }
+
+    /**
+     * \brief Free the previous thread if it exited
+     *
+     * Called by every thread right after it is resumed, once the stack of the
+     * previous thread is no longer used.
+     */
+    void Scheduler::finishSwitch()
+    {
+        RunQueue& runQueue = getRunQueue();
+        Thread* previous = runQueue.previous;
+        if (previous != nullptr && previous->state_ == ThreadState::DEAD) {
+            runQueue.previous = nullptr;
+            Thread::destroy(previous);
+        }
+    }
+
+    /**
+     * \brief Wake up a thread whose sleep is over
+     *
+     * The callback of the sleep timer of the thread.
+     *
+     * \param context The sleeping thread
+     */
+    void Scheduler::wakeSleepingThread(void* context)
+    {
+        instance_.wake((Thread*) context);
+    }
+
+    /**
+     * \brief Do nothing, the switch is done by `preemptIfNeeded`
+     *
+     * \param frame The state of the interrupted code (unused)
+     * \param context Unused
+     */
+    void Scheduler::handleReschedule(InterruptFrame& frame, void* context)
+    {
+        (void) frame;
+        (void) context;
+    }
+
+    /**
+     * \brief The first function run by a thread created with `Thread::create`
+     *
+     * `switch_context` returns here the first time the thread runs, with
+     * interrupts disabled. The thread exits when its entry function returns.
+     */
+    void Scheduler::startThread()
+    {
+        instance_.finishSwitch();
+
+        Thread* thread = instance_.getCurrentThread();
+        __asm__ volatile ("sti");
+        thread->entry_(thread->argument_);
+
+        instance_.exit();
+    }
+
+    /**
+     * \brief Wait for interrupts forever
+     *
+     * \param argument Unused
+     */
+    void Scheduler::idle(void* argument)
+    {
+        (void) argument;
+
+        while (true) {
+            instance_.halt();
+        }
+    }
+}
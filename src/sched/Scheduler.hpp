@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Thread.hpp"
+#include "../acpi/Acpi.hpp"
+#include "../interrupt.hpp"
+#include "../sync/Spinlock.hpp"
+
+namespace sched
+{
+    /// The number of ticks a thread runs before the threads of the same
+    /// priority get the processor
+    const uint32_t QUANTUM_TICKS  = 10;
+
+    /// The vector of the interrupt sent to a processor when a thread of a
+    /// higher priority than the running one is woken up in its run queue
+    const uint8_t RESCHEDULE_VECTOR = 0xF1;
+
+    /**
+     * \brief Share the processors between the kernel threads
+     *
+     * Every processor has its own run queue: one FIFO list of ready threads
+     * per priority and a bitmask of the non-empty lists, so picking the next
+     * thread is a single bit scan whatever the number of threads. A processor
+     * only ever takes threads from its own run queue, other processors only
+     * add threads to it (`wake`).
+     *
+     * The tick of the processor (`timer::startTick`) ends the quantum of the
+     * running thread, and a sleeping thread waits for a timer of the tick.
+     * The switch itself happens when the interrupt handlers are done
+     * (`preemptIfNeeded`), so a preempted thread is resumed in the middle of
+     * `cHandleInterrupt` and returns from the interrupt normally. A processor
+     * with nothing else to run halts with its tick stopped (`halt`).
+     *
+     * The context of `kernel_main` becomes the first thread of the bootstrap
+     * processor, the boot context of every other processor becomes its idle
+     * thread.
+     *
+     * Example:
+     * \code
+     * sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+     * scheduler.initialize();
+     * scheduler.wake(sched::Thread::create(worker, nullptr));
+     * scheduler.sleep(100);
+     * \endcode
+     */
+    class Scheduler
+    {
+    public:
+        /// Get the instance of the singleton object `Scheduler`
+        static Scheduler& getInstance();
+
+        /// Turn the caller into a thread and start the bootstrap processor
+        /// tick
+        void initialize();
+        /// Turn the boot context of an application processor into its idle
+        /// thread
+        [[noreturn]] void runIdle();
+        /// Return true once `initialize` was called
+        bool isInitialized() const;
+
+        /// Get the thread running on the calling processor
+        Thread* getCurrentThread();
+
+        /// Let the other ready threads of the same priority run
+        void yield();
+        /// Wait for `milliseconds` ms
+        void sleep(uint32_t milliseconds);
+        /// Wait until another thread or an interrupt handler calls `wake`
+        void block();
+        /// Make a blocked or sleeping thread ready
+        void wake(Thread* thread);
+        /// Terminate the calling thread
+        [[noreturn]] void exit();
+        /// Wait for the next interrupt, with the tick stopped if no other
+        /// thread is ready
+        void halt();
+
+        /// Switch to another thread if the running one was preempted
+        void preemptIfNeeded();
+        /// Count a tick of the running thread
+        void handleTick();
+
+        /// Get the number of context switches of a processor
+        uint64_t getSwitchCount(size_t cpuIndex);
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since it is a singleton
+        Scheduler(Scheduler const&) = delete;
+        void operator=(Scheduler const&) = delete;
+
+    private:
+        friend class Thread;
+
+        /**
+         * \brief The threads of a processor
+         */
+        struct RunQueue
+        {
+            /// Protect the run queue (interrupts are disabled while it is
+            /// taken)
+            sync::Spinlock lock;
+            /// Bit `n` is set when the list of priority `n` is not empty
+            uint32_t readyMask;
+            /// The first ready thread of each priority
+            Thread* heads[PRIORITY_COUNT];
+            /// The last ready thread of each priority
+            Thread* tails[PRIORITY_COUNT];
+
+            /// The running thread
+            Thread* current;
+            /// The thread run when no other is ready (never in the lists)
+            Thread* idle;
+            /// The thread switched out by the last switch
+            Thread* previous;
+
+            /// The number of context switches
+            uint64_t switchCount;
+            /// The number of ticks left in the quantum of the running thread
+            uint32_t quantumLeft;
+            /// True when the running thread must give the processor up
+            bool isRescheduleNeeded;
+            /// True once the processor runs threads
+            bool isRunning;
+        };
+
+        /// Initialize the scheduler with no thread
+        Scheduler();
+
+        /// Get the run queue of the calling processor
+        RunQueue& getRunQueue();
+        /// Make the calling context the running thread of its processor
+        Thread* adoptCurrentContext(RunQueue& runQueue, uint8_t priority);
+
+        /// Add a ready thread at the end of the list of its priority
+        static void enqueue(RunQueue& runQueue, Thread* thread);
+        /// Remove the first thread of the highest priority
+        static Thread* dequeue(RunQueue& runQueue);
+
+        /// Switch to the next ready thread (the run queue is locked)
+        void schedule(RunQueue& runQueue);
+        /// Free the previous thread if it exited
+        void finishSwitch();
+
+        /// Wake up a thread whose sleep is over
+        static void wakeSleepingThread(void* context);
+        /// Do nothing, the switch is done by `preemptIfNeeded`
+        static void handleReschedule(InterruptFrame& frame, void* context);
+        /// The first function run by a thread created with `Thread::create`
+        static void startThread();
+        /// Wait for interrupts forever
+        [[noreturn]] static void idle(void* argument);
+
+        /// The `Scheduler` singleton instance
+        static Scheduler instance_;
+
+        /// The run queue of each processor
+        RunQueue runQueues_[acpi::MAX_CPUS];
+        /// True once `initialize` was called
+        bool isInitialized_;
+    };
+}
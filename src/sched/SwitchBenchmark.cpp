@@ -0,0 +1,106 @@
+#include "SwitchBenchmark.hpp"
+#include "Scheduler.hpp"
+#include "../cpu/cpu.hpp"
+#include "../smp/Cpu.hpp"
+#include "../timer/Timer.hpp"
+
+namespace sched
+{
+    /**
+     * \brief The state shared by the threads of the benchmark
+     */
+    struct PingPong
+    {
+        /// The number of `yield` of each thread
+        uint32_t iterations;
+        /// The number of threads still running
+        uint32_t runningThreads;
+        /// The thread waiting for the end of the benchmark
+        Thread* waiter;
+    };
+
+    /**
+     * \brief Yield `iterations` times, then wake the waiter up if this is the
+     * last thread running
+     *
+     * \param argument The `PingPong` state
+     */
+    static void runPingPong(void* argument)
+    {
+        PingPong* pingPong = (PingPong*) argument;
+        Scheduler& scheduler = Scheduler::getInstance();
+
+        for (uint32_t i = 0; i < pingPong->iterations; ++i) {
+            scheduler.yield();
+        }
+
+        if (__atomic_sub_fetch(&pingPong->runningThreads, 1,
+                               __ATOMIC_ACQ_REL) == 0) {
+            scheduler.wake(pingPong->waiter);
+        }
+    }
+
+    /**
+     * \brief Measure the cost of a context switch between two threads
+     *
+     * Two threads of the highest priority yield to each other `iterations`
+     * times each on the calling processor, so every `yield` is a switch. The
+     * caller blocks meanwhile. The cycles are read with `rdtsc`, the
+     * duration in seconds comes from the ticks of the processor.
+     *
+     * \param iterations The number of `yield` of each thread
+     * \return The number of switches, the cycles per switch and the switches
+     * per second (all 0 if the threads could not be created)
+     */
+    SwitchBenchmarkResult benchmarkContextSwitch(uint32_t iterations)
+    {
+        SwitchBenchmarkResult result = {0, 0, 0};
+        Scheduler& scheduler = Scheduler::getInstance();
+        const size_t cpuIndex = smp::getCurrentCpu()->index;
+
+        PingPong pingPong = {iterations, 2, scheduler.getCurrentThread()};
+        Thread* ping = Thread::create(runPingPong, &pingPong,
+                                      HIGHEST_PRIORITY);
+        Thread* pong = Thread::create(runPingPong, &pingPong,
+                                      HIGHEST_PRIORITY);
+        if (ping == nullptr || pong == nullptr) {
+            // Let the created thread (if any) exit right away
+            pingPong.iterations = 0;
+            pingPong.runningThreads = 1;
+            if (ping != nullptr || pong != nullptr) {
+                scheduler.wake(ping != nullptr ? ping : pong);
+                while (__atomic_load_n(&pingPong.runningThreads,
+                                       __ATOMIC_ACQUIRE) != 0) {
+                    scheduler.block();
+                }
+            }
+            return result;
+        }
+
+        const uint64_t startSwitches = scheduler.getSwitchCount(cpuIndex);
+        const uint64_t startTicks = timer::getTicks(cpuIndex);
+        const uint64_t startCycles = cpu::readTsc();
+
+        scheduler.wake(ping);
+        scheduler.wake(pong);
+        while (__atomic_load_n(&pingPong.runningThreads, __ATOMIC_ACQUIRE)
+               != 0) {
+            scheduler.block();
+        }
+
+        const uint64_t cycles = cpu::readTsc() - startCycles;
+        const uint64_t ticks = timer::getTicks(cpuIndex) - startTicks;
+        const uint64_t switches = scheduler.getSwitchCount(cpuIndex)
+                                  - startSwitches;
+
+        result.switches = switches;
+        if (switches > 0) {
+            result.cyclesPerSwitch = cycles / switches;
+        }
+        if (ticks > 0) {
+            result.switchesPerSecond = switches * timer::TICK_FREQUENCY / ticks;
+        }
+
+        return result;
+    }
+}
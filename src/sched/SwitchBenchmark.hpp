@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace sched
+{
+    /// The result of `benchmarkContextSwitch`
+    struct SwitchBenchmarkResult
+    {
+        /// The number of context switches measured
+        uint32_t switches;
+        /// The average number of TSC cycles per switch
+        uint32_t cyclesPerSwitch;
+        /// The number of switches per second (0 if the measure took less than
+        /// a tick)
+        uint32_t switchesPerSecond;
+    };
+
+    /// Measure the cost of a context switch between two threads
+    SwitchBenchmarkResult benchmarkContextSwitch(uint32_t iterations);
+}
@@ -0,0 +1,369 @@
+#include "TaskPool.hpp"
+#include "Scheduler.hpp"
+#include "../smp/smp.hpp"
+
+namespace sched
+{
+    /// The priority of the workers, right above the idle threads
+    const uint8_t WORKER_PRIORITY = LOWEST_PRIORITY - 1;
+
+    /// The `TaskPool` singleton instance
+    TaskPool TaskPool::instance_;
+
+    /**
+     * \brief Count an event in a counter of a processor
+     *
+     * The threads of a processor can preempt each other, so the increment is
+     * atomic (without ordering).
+     *
+     * \param counter The counter
+     */
+    static inline void count(uint32_t& counter)
+    {
+        __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Initialize the pool without workers
+     *
+     * Tasks can be spawned before `initialize`, the thread calling `sync`
+     * then runs all of them.
+     */
+    TaskPool::TaskPool()
+        : workers_(), workerCount_(0), idleMask_(0)
+    {
+    }
+
+    /**
+     * \brief Get the instance of the singleton object `TaskPool`
+     *
+     * \return the instance of the single object of the class `TaskPool`
+     */
+    TaskPool& TaskPool::getInstance()
+    {
+        return instance_;
+    }
+
+    /**
+     * \brief Start a worker on every processor
+     *
+     * The scheduler must be initialized and the application processors
+     * started. Interrupts must be enabled (the workers are created through
+     * `smp::runOnCpu`).
+     *
+     * \return false if a worker could not be started
+     */
+    bool TaskPool::initialize()
+    {
+        workerCount_ = smp::getCpuCount();
+
+        bool isStarted = true;
+        for (size_t i = 0; i < workerCount_; ++i) {
+            isStarted = smp::runOnCpu(i, startWorker, &isStarted)
+                        && isStarted;
+        }
+
+        return isStarted;
+    }
+
+    /**
+     * \brief Add a task to a group
+     *
+     * The task is pushed on the deque of the calling processor, or run at
+     * once if the deque is full.
+     *
+     * \param group The group of the task
+     * \param function The function to run
+     * \param argument The argument of `function`
+     */
+    void TaskPool::spawn(TaskGroup& group, TaskFunction function,
+                         void* argument)
+    {
+        __atomic_add_fetch(&group.pendingTasks, 1, __ATOMIC_RELAXED);
+        push({function, argument, nullptr, 0, 0, &group});
+    }
+
+    /**
+     * \brief Run tasks until every task of the group is done
+     *
+     * The caller runs the tasks of its processor first, then steals from the
+     * others, so it helps instead of waiting. It only spins once there is no
+     * task left anywhere and the last tasks of the group run elsewhere.
+     *
+     * \param group The group to wait for
+     */
+    void TaskPool::sync(TaskGroup& group)
+    {
+        while (__atomic_load_n(&group.pendingTasks, __ATOMIC_ACQUIRE) != 0) {
+            Task task;
+            if (findTask(task)) {
+                run(task);
+            }
+            else {
+                __asm__ volatile ("pause");
+            }
+        }
+    }
+
+    /**
+     * \brief Call `function` on parts of [begin, end) of at most `grain`
+     * elements, in parallel
+     *
+     * The range is split in halves: the caller keeps the first half and
+     * pushes the second one, until its part fits in a grain. Thieves take the
+     * oldest, largest halves and split them the same way, so work spreads in
+     * a logarithmic number of steals. Returns once every part is done.
+     *
+     * \param begin The first index of the range
+     * \param end The index after the range
+     * \param grain The largest part given to a single call of `function`
+     * \param function The function called on each part
+     * \param argument The argument of `function`
+     */
+    void TaskPool::parallelFor(size_t begin, size_t end, size_t grain,
+                               RangeFunction function, void* argument)
+    {
+        if (begin >= end) {
+            return;
+        }
+
+        TaskGroup group = {0};
+        const RangeJob job = {function, argument, grain > 0 ? grain : 1};
+        runRange(job, begin, end, group);
+        sync(group);
+    }
+
+    /**
+     * \brief Get the counters of a processor
+     *
+     * \param cpuIndex The index of the processor
+     * \return A copy of the counters
+     */
+    TaskPoolStatistics TaskPool::getStatistics(size_t cpuIndex) const
+    {
+        return workers_[cpuIndex].statistics;
+    }
+
+    /**
+     * \brief Get the spread of the executed tasks between the processors
+     *
+     * \return The difference between the most and the least busy processors,
+     * in percent of the most busy one (0 when the work is evenly spread)
+     */
+    uint32_t TaskPool::getImbalancePercent() const
+    {
+        uint32_t most = 0;
+        uint32_t least = 0xFFFFFFFF;
+        for (size_t i = 0; i < workerCount_; ++i) {
+            const uint32_t executed = workers_[i].statistics.executedTasks;
+            most = executed > most ? executed : most;
+            least = executed < least ? executed : least;
+        }
+
+        return most > 0 ? (most - least) * 100 / most : 0;
+    }
+
+    /**
+     * \brief Reset the counters of every processor
+     */
+    void TaskPool::resetStatistics()
+    {
+        for (size_t i = 0; i < acpi::MAX_CPUS; ++i) {
+            workers_[i].statistics = TaskPoolStatistics();
+        }
+    }
+
+    /**
+     * \brief Push a task on the deque of the calling processor
+     *
+     * \param task The task (run at once if the deque is full)
+     */
+    void TaskPool::push(const Task& task)
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+        Worker& worker = workers_[smp::getCurrentCpu()->index];
+        const bool isPushed = worker.deque.push(task);
+        if (isPushed) {
+            ++worker.statistics.spawnedTasks;
+        }
+        restoreInterrupts(flags);
+
+        if (isPushed) {
+            notifyWorkers();
+        }
+        else {
+            run(task);
+        }
+    }
+
+    /**
+     * \brief Take a task from the calling processor's deque, or steal one
+     *
+     * The other processors are tried in turn, starting with the next one, so
+     * the thieves do not all go after the same deque.
+     *
+     * \param task Set to the task found
+     * \return false if no task was found
+     */
+    bool TaskPool::findTask(Task& task)
+    {
+        uint32_t flags = saveAndDisableInterrupts();
+        const size_t index = smp::getCurrentCpu()->index;
+        Worker& worker = workers_[index];
+        const bool isPopped = worker.deque.pop(task);
+        restoreInterrupts(flags);
+
+        if (isPopped) {
+            return true;
+        }
+
+        for (size_t i = 1; i < workerCount_; ++i) {
+            const size_t victim = (index + i) % workerCount_;
+            if (workers_[victim].deque.steal(task)) {
+                count(worker.statistics.stolenTasks);
+                return true;
+            }
+            count(worker.statistics.failedSteals);
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Run a task and mark it done in its group
+     *
+     * \param task The task
+     */
+    void TaskPool::run(const Task& task)
+    {
+        if (task.job != nullptr) {
+            runRange(*task.job, task.begin, task.end, *task.group);
+        }
+        else {
+            task.function(task.argument);
+        }
+
+        count(workers_[smp::getCurrentCpu()->index].statistics.executedTasks);
+        // Release: the work of the task is visible to the thread in `sync`
+        __atomic_sub_fetch(&task.group->pendingTasks, 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * \brief Split a part of a range until it fits in a grain, then run it
+     *
+     * \param job The `parallelFor`
+     * \param begin The first index of the part
+     * \param end The index after the part
+     * \param group The group of the `parallelFor`
+     */
+    void TaskPool::runRange(const RangeJob& job, size_t begin, size_t end,
+                            TaskGroup& group)
+    {
+        while (end - begin > job.grain) {
+            const size_t middle = begin + (end - begin) / 2;
+            __atomic_add_fetch(&group.pendingTasks, 1, __ATOMIC_RELAXED);
+            push({nullptr, nullptr, &job, middle, end, &group});
+            end = middle;
+        }
+
+        job.function(begin, end, job.argument);
+    }
+
+    /**
+     * \brief Wake idle workers up after a push
+     *
+     * Nothing is written to shared memory while no worker is idle. Otherwise
+     * the event of one idle worker of another processor is signaled: if it
+     * splits what it steals, its own pushes wake the next one.
+     */
+    void TaskPool::notifyWorkers()
+    {
+        // The push must be visible before the idle mask is read, `waitForWork`
+        // does the opposite (see there)
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        const uint32_t idleMask = __atomic_load_n(&idleMask_, __ATOMIC_RELAXED)
+                                  & ~(1u << smp::getCurrentCpu()->index);
+        if (idleMask == 0) {
+            return;
+        }
+
+        // Only the caller that clears the bit signals the worker
+        const uint32_t bit = 1u << __builtin_ctz(idleMask);
+        if (__atomic_fetch_and(&idleMask_, ~bit, __ATOMIC_RELAXED) & bit) {
+            workers_[__builtin_ctz(bit)].work.signal();
+        }
+    }
+
+    /**
+     * \brief Wait for a push on any processor
+     *
+     * The worker marks itself idle before looking for a task one last time,
+     * while `notifyWorkers` reads the idle mask after pushing: either the
+     * worker finds the task, or the pusher sees it idle and signals its
+     * event. The event stays set until the worker consumes it, so the wait
+     * ends at once even if the signal came first.
+     *
+     * The worker blocks in `sync::waitAny`, so its processor runs its idle
+     * thread meanwhile and stops its tick (`Scheduler::halt`).
+     *
+     * \param worker The worker of the calling processor
+     */
+    void TaskPool::waitForWork(Worker& worker)
+    {
+        const uint32_t bit = 1u << smp::getCurrentCpu()->index;
+        __atomic_fetch_or(&idleMask_, bit, __ATOMIC_SEQ_CST);
+
+        Task task;
+        if (findTask(task)) {
+            __atomic_fetch_and(&idleMask_, ~bit, __ATOMIC_RELAXED);
+            run(task);
+            return;
+        }
+
+        count(worker.statistics.idleWaits);
+        sync::waitAny(worker.work);
+        __atomic_fetch_and(&idleMask_, ~bit, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Create the worker thread of the calling processor
+     *
+     * Called through `smp::runOnCpu`, so the thread is bound to the
+     * processor.
+     *
+     * \param argument A pointer to a boolean cleared if the thread could not
+     * be created
+     */
+    void TaskPool::startWorker(void* argument)
+    {
+        Thread* thread = Thread::create(runWorker, nullptr, WORKER_PRIORITY);
+        if (thread == nullptr) {
+            *(bool*) argument = false;
+            return;
+        }
+
+        Scheduler::getInstance().wake(thread);
+    }
+
+    /**
+     * \brief Run the tasks of the pool forever
+     *
+     * \param argument Unused
+     */
+    void TaskPool::runWorker(void* argument)
+    {
+        (void) argument;
+
+        TaskPool& pool = instance_;
+        Worker& worker = pool.workers_[smp::getCurrentCpu()->index];
+        while (true) {
+            Task task;
+            if (pool.findTask(task)) {
+                pool.run(task);
+            }
+            else {
+                pool.waitForWork(worker);
+            }
+        }
+    }
+}
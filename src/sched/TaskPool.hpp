@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../acpi/Acpi.hpp"
+#include "../sync/Event.hpp"
+#include "../util/WorkStealingDeque.hpp"
+
+namespace sched
+{
+    /// A function spawned in a `TaskGroup`
+    typedef void (*TaskFunction)(void* argument);
+    /// A function called by `parallelFor` on a part [begin, end) of the range
+    typedef void (*RangeFunction)(size_t begin, size_t end, void* argument);
+
+    /**
+     * \brief The tasks a `TaskPool::sync` waits for
+     */
+    struct TaskGroup
+    {
+        /// The number of tasks spawned in the group and not finished
+        uint32_t pendingTasks;
+    };
+
+    /// The counters of the tasks of a processor
+    struct TaskPoolStatistics
+    {
+        /// The number of tasks pushed on the deque of the processor
+        uint32_t spawnedTasks;
+        /// The number of tasks the processor ran
+        uint32_t executedTasks;
+        /// The number of tasks the processor took from another deque
+        uint32_t stolenTasks;
+        /// The number of steals that found nothing or lost a race
+        uint32_t failedSteals;
+        /// The number of times the worker of the processor waited for work
+        uint32_t idleWaits;
+    };
+
+    /**
+     * \brief Spread CPU-bound kernel work over the processors
+     *
+     * Every processor has a Chase-Lev deque of tasks and a worker thread.
+     * `spawn` pushes a task on the deque of the calling processor; the worker
+     * of an idle processor steals the oldest tasks of the others, which are
+     * the largest parts of a `parallelFor`. The thread calling `sync` runs
+     * tasks too until its group is done, so nested fork-join works.
+     *
+     * An idle worker blocks on the event of its processor until a spawn
+     * signals it, so a processor without tasks runs its idle thread and stops
+     * its tick. Workers run just above the idle priority, so they never delay
+     * other threads.
+     *
+     * The owner side of a deque is the processor: `spawn` and the local pops
+     * run with interrupts disabled, so the threads of a processor do not
+     * race.
+     *
+     * Example:
+     * \code
+     * sched::TaskPool& pool = sched::TaskPool::getInstance();
+     * // Zero 1024 pages, 16 per task
+     * pool.parallelFor(0, 1024, 16, zeroPages, base);
+     * \endcode
+     */
+    class TaskPool
+    {
+    public:
+        /// The capacity of the deque of a processor
+        static const uint32_t DEQUE_CAPACITY = 256;
+
+        /// Get the instance of the singleton object `TaskPool`
+        static TaskPool& getInstance();
+
+        /// Start a worker on every processor
+        bool initialize();
+
+        /// Add a task to a group
+        void spawn(TaskGroup& group, TaskFunction function, void* argument);
+        /// Run tasks until every task of the group is done
+        void sync(TaskGroup& group);
+        /// Call `function` on parts of [begin, end) of at most `grain`
+        /// elements, in parallel
+        void parallelFor(size_t begin, size_t end, size_t grain,
+                         RangeFunction function, void* argument);
+
+        /// Get the counters of a processor
+        TaskPoolStatistics getStatistics(size_t cpuIndex) const;
+        /// Get the spread of the executed tasks between the processors
+        uint32_t getImbalancePercent() const;
+        /// Reset the counters of every processor
+        void resetStatistics();
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since it is a singleton
+        TaskPool(TaskPool const&) = delete;
+        void operator=(TaskPool const&) = delete;
+
+    private:
+        /// The description of a `parallelFor`, shared by its tasks
+        struct RangeJob
+        {
+            RangeFunction function;
+            void* argument;
+            size_t grain;
+        };
+
+        /// A task in a deque (either a spawned function or a part of a
+        /// `parallelFor`)
+        struct Task
+        {
+            /// The spawned function (nullptr for a part of a range)
+            TaskFunction function;
+            /// The argument of `function`
+            void* argument;
+            /// The `parallelFor` of the part (nullptr for a spawned function)
+            const RangeJob* job;
+            /// The first index of the part
+            size_t begin;
+            /// The index after the part
+            size_t end;
+            /// The group of the task
+            TaskGroup* group;
+        };
+
+        /// The tasks, the counters and the wake-up event of a processor, on
+        /// their own cache lines
+        struct Worker
+        {
+            util::WorkStealingDeque<Task, DEQUE_CAPACITY> deque;
+            TaskPoolStatistics statistics;
+            /// Signaled by `notifyWorkers` when the worker is idle
+            sync::Event work;
+        } __attribute__((aligned(64)));
+
+        /// Initialize the pool without workers
+        TaskPool();
+
+        /// Push a task on the deque of the calling processor
+        void push(const Task& task);
+        /// Take a task from the calling processor's deque, or steal one
+        bool findTask(Task& task);
+        /// Run a task and mark it done in its group
+        void run(const Task& task);
+        /// Split a part of a range until it fits in a grain, then run it
+        void runRange(const RangeJob& job, size_t begin, size_t end,
+                      TaskGroup& group);
+        /// Wake idle workers up after a push
+        void notifyWorkers();
+        /// Wait for a push on any processor
+        void waitForWork(Worker& worker);
+
+        /// Create the worker thread of the calling processor
+        static void startWorker(void* argument);
+        /// Run the tasks of the pool forever
+        static void runWorker(void* argument);
+
+        /// The `TaskPool` singleton instance
+        static TaskPool instance_;
+
+        /// The worker of each processor
+        Worker workers_[acpi::MAX_CPUS];
+        /// The number of processors with a worker
+        size_t workerCount_;
+        /// Bit `n` is set while the worker of processor `n` is idle
+        uint32_t idleMask_ __attribute__((aligned(64)));
+    };
+}
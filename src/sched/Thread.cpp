@@ -0,0 +1,146 @@
+#include "Thread.hpp"
+#include "Scheduler.hpp"
+#include "../memory/FrameAllocator.hpp"
+#include "../smp/Cpu.hpp"
+
+namespace sched
+{
+    /**
+     * \brief Wrap the context of a processor or a new stack
+     *
+     * \param entry The function run by the thread
+     * \param argument The argument of `entry`
+     * \param priority The priority of the thread
+     * \param stack The stack of the thread (0 for the boot context of a
+     * processor, which keeps its stack)
+     */
+    Thread::Thread(Entry entry, void* argument, uint8_t priority,
+                   memory::PhysicalAddress stack)
+        : stackPointer_(0), stack_(stack), fpuState_(nullptr), entry_(entry),
+          argument_(argument),
+          next_(nullptr), sleepTimer_(),
+          cpuIndex_(smp::getCurrentCpu()->index),
+          state_(ThreadState::BLOCKED), priority_(priority),
+          isWakePending_(false)
+    {
+    }
+
+    /**
+     * \brief Create a blocked thread
+     *
+     * The thread runs on the calling processor once it is woken up with
+     * `Scheduler::wake`. It exits when `entry` returns.
+     *
+     * The stack is prepared as if the thread had called `switch_context`
+     * from the start of `Scheduler::startThread`: the callee-saved registers
+     * (zeros) then the return address. The return address of
+     * `startThread` itself is never used.
+     *
+     * \param entry The function run by the thread
+     * \param argument The argument of `entry`
+     * \param priority The priority of the thread (`HIGHEST_PRIORITY` to
+     * `LOWEST_PRIORITY`)
+     * \return The thread, or nullptr if there is no memory left
+     */
+    Thread* Thread::create(Entry entry, void* argument, uint8_t priority)
+    {
+        if (priority > LOWEST_PRIORITY) {
+            priority = LOWEST_PRIORITY;
+        }
+
+        memory::FrameAllocator& frames = memory::FrameAllocator::getInstance();
+        const memory::PhysicalAddress stack = frames.allocate(STACK_ORDER);
+        if (stack == 0) {
+            return nullptr;
+        }
+
+        Thread* thread = new Thread(entry, argument, priority, stack);
+        if (thread == nullptr) {
+            frames.free(stack, STACK_ORDER);
+            return nullptr;
+        }
+
+        // The top of the stack is aligned on 16 bytes, as the ABI requires
+        // before the (fake) call of `startThread`
+        uint32_t* top = (uint32_t*)
+            ((uintptr_t) memory::physicalToVirtual(stack) + STACK_SIZE);
+        *--top = 0;
+        *--top = (uint32_t) Scheduler::startThread;
+        for (size_t i = 0; i < 4; ++i) {
+            *--top = 0;
+        }
+        thread->stackPointer_ = (uintptr_t) top;
+
+        return thread;
+    }
+
+    /**
+     * \brief Free a thread returned by `create`
+     *
+     * \param thread The thread, which must not be running
+     */
+    void Thread::destroy(Thread* thread)
+    {
+        if (thread->stack_ != 0) {
+            memory::FrameAllocator::getInstance().free(thread->stack_,
+                                                       STACK_ORDER);
+        }
+        if (thread->fpuState_ != nullptr) {
+            cpu::destroyFpuState(thread->fpuState_);
+        }
+        delete thread;
+    }
+
+    /**
+     * \brief Get the state of the thread
+     *
+     * \return The state of the thread
+     */
+    ThreadState Thread::getState() const
+    {
+        return state_;
+    }
+
+    /**
+     * \brief Get the priority of the thread
+     *
+     * \return The priority (`HIGHEST_PRIORITY` to `LOWEST_PRIORITY`)
+     */
+    uint8_t Thread::getPriority() const
+    {
+        return priority_;
+    }
+
+    /**
+     * \brief Get the index of the processor running the thread
+     *
+     * \return The index of the processor the thread is bound to
+     */
+    size_t Thread::getCpuIndex() const
+    {
+        return cpuIndex_;
+    }
+
+    /**
+     * \brief Get the save area of the FPU and vector registers of the thread
+     *
+     * \return The area, nullptr if the thread never used them
+     */
+    cpu::FpuState* Thread::getFpuState() const
+    {
+        return fpuState_;
+    }
+
+    /**
+     * \brief Give the thread a save area for its FPU and vector registers
+     *
+     * Called by `cpu::kernelFpuBegin` on the first use by the thread. The
+     * area is freed with the thread.
+     *
+     * \param state The area returned by `cpu::createFpuState`
+     */
+    void Thread::setFpuState(cpu::FpuState* state)
+    {
+        fpuState_ = state;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../cpu/Fpu.hpp"
+#include "../memory/memory.hpp"
+#include "../timer/Timer.hpp"
+
+namespace sched
+{
+    /// The number of priority levels
+    const uint8_t PRIORITY_COUNT   = 32;
+    /// The highest priority (scheduled first)
+    const uint8_t HIGHEST_PRIORITY = 0;
+    /// The lowest priority
+    const uint8_t LOWEST_PRIORITY  = PRIORITY_COUNT - 1;
+    /// The priority of the threads created without one
+    const uint8_t DEFAULT_PRIORITY = 16;
+
+    /// The state of a thread
+    enum class ThreadState : uint8_t
+    {
+        /// In the run queue of its processor
+        READY,
+        /// Running on its processor
+        RUNNING,
+        /// Waiting for `Scheduler::wake`
+        BLOCKED,
+        /// Waiting for a tick (and for `Scheduler::wake`)
+        SLEEPING,
+        /// Exited, freed by the next thread of its processor
+        DEAD
+    };
+
+    class Scheduler;
+
+    /**
+     * \brief A kernel thread
+     *
+     * A thread has its own kernel stack, where its callee-saved registers are
+     * pushed when it is switched out (the rest of its state is already on the
+     * stack by then). It is bound to the processor it is created on: it is
+     * only in the run queue of that processor.
+     *
+     * Example:
+     * \code
+     * sched::Thread* thread = sched::Thread::create(drainLogs, &logger);
+     * sched::Scheduler::getInstance().wake(thread);
+     * \endcode
+     */
+    class Thread
+    {
+    public:
+        /// The function run by a thread
+        typedef void (*Entry)(void* argument);
+
+        /// Create a blocked thread
+        static Thread* create(Entry entry, void* argument,
+                              uint8_t priority = DEFAULT_PRIORITY);
+
+        /// Get the state of the thread
+        ThreadState getState() const;
+        /// Get the priority of the thread
+        uint8_t getPriority() const;
+        /// Get the index of the processor running the thread
+        size_t getCpuIndex() const;
+        /// Get the save area of the FPU and vector registers of the thread
+        cpu::FpuState* getFpuState() const;
+        /// Give the thread a save area for its FPU and vector registers
+        void setFpuState(cpu::FpuState* state);
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since a thread owns its stack
+        Thread(Thread const&) = delete;
+        void operator=(Thread const&) = delete;
+
+    private:
+        friend class Scheduler;
+
+        /// The order of the block of frames of a stack
+        static const uint8_t STACK_ORDER = 2;
+        /// The size of a stack (16 KiB)
+        static const size_t STACK_SIZE = memory::PAGE_SIZE << STACK_ORDER;
+
+        /// Wrap the context of a processor or a new stack
+        Thread(Entry entry, void* argument, uint8_t priority,
+               memory::PhysicalAddress stack);
+
+        /// Free a thread returned by `create`
+        static void destroy(Thread* thread);
+
+        /// The saved stack pointer (valid while the thread is switched out)
+        uintptr_t stackPointer_;
+        /// The stack of the thread (0 for the boot context of a processor)
+        memory::PhysicalAddress stack_;
+        /// The saved FPU and vector registers (nullptr until the thread calls
+        /// `cpu::kernelFpuBegin`)
+        cpu::FpuState* fpuState_;
+        /// The function run by the thread
+        Entry entry_;
+        /// The argument of `entry_`
+        void* argument_;
+
+        /// The next thread in the same run queue list
+        Thread* next_;
+        /// The timer waking up the thread at the end of `Scheduler::sleep`
+        timer::Timer sleepTimer_;
+        /// The processor running the thread
+        size_t cpuIndex_;
+        /// The state of the thread
+        ThreadState state_;
+        /// The priority of the thread
+        uint8_t priority_;
+        /// `Scheduler::wake` was called while the thread was not blocked, so
+        /// its next `Scheduler::block` returns at once
+        bool isWakePending_;
+    };
+}
@@ -0,0 +1,33 @@
+# Switch the processor from one kernel thread to another.
+#
+# void switch_context(uintptr_t* oldStackPointer, uintptr_t newStackPointer)
+#
+# The caller-saved registers (eax, ecx, edx) are already saved by the compiler
+# around the call, so only the callee-saved registers are pushed on the stack
+# of the old thread before its stack pointer is stored. The flags are not
+# saved: the ABI does not preserve the arithmetic flags across a call, and
+# switch_context is always called with interrupts disabled, each thread
+# restoring its own interrupt flag once resumed (see Scheduler::schedule).
+# The new thread is resumed by popping them from its stack and returning to
+# where it called switch_context (or to its start function, see
+# sched::Thread::create).
+.section .text
+.global switch_context
+.type switch_context, @function
+switch_context:
+    mov 4(%esp), %eax
+    mov 8(%esp), %edx
+
+    push %ebp
+    push %ebx
+    push %esi
+    push %edi
+    mov %esp, (%eax)
+
+    mov %edx, %esp
+    pop %edi
+    pop %esi
+    pop %ebx
+    pop %ebp
+    ret
+.size switch_context, . - switch_context
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../sync/Spinlock.hpp"
+
+namespace smp
+{
+    /// The selector of the kernel code segment
+    const uint16_t CODE_SELECTOR     = 0x08;
+    /// The selector of the kernel data segment
+    const uint16_t DATA_SELECTOR     = 0x10;
+    /// The selector of the segment of the processor descriptor (loaded in gs)
+    const uint16_t CPU_DATA_SELECTOR = 0x18;
+    /// The selector of the task state segment of the processor
+    const uint16_t TSS_SELECTOR      = 0x20;
+    /// The number of entries of the GDT of a processor
+    const size_t   GDT_ENTRY_COUNT   = 5;
+
+    /**
+     * \brief The 32-bit task state segment
+     *
+     * Only `esp0` and `ss0` are used: they are the stack loaded by the
+     * processor when an interrupt comes from user mode. The I/O bitmap is
+     * beyond the limit of the segment, so every port is denied to user mode.
+     */
+    struct Tss
+    {
+        uint32_t previousTask;
+        uint32_t esp0;
+        uint32_t ss0;
+        /// The other stacks and the saved registers (unused, there is no
+        /// hardware task switching)
+        uint32_t unused[22];
+        uint16_t trap;
+        uint16_t ioMapBase;
+    } __attribute__((packed));
+
+    static_assert(sizeof(Tss) == 104, "The TSS is 104 bytes long");
+
+    /**
+     * \brief The descriptor of a processor
+     *
+     * Every processor has its own GDT, with the flat kernel segments, a
+     * segment whose base is its descriptor (loaded in gs) and its TSS. The
+     * first field of the descriptor points to the descriptor itself, so
+     * `getCurrentCpu` is a single `mov %gs:0`.
+     */
+    struct Cpu
+    {
+        /// The descriptor itself (read through gs)
+        Cpu*     self;
+        /// The index of the processor (0 for the bootstrap processor)
+        size_t   index;
+        /// The identifier of the local APIC of the processor
+        uint32_t apicId;
+        /// The top of the boot stack of the processor
+        uintptr_t stackTop;
+        /// True once the processor runs the kernel
+        volatile bool isOnline;
+
+        /// The GDT of the processor
+        uint64_t gdt[GDT_ENTRY_COUNT];
+        /// The TSS of the processor
+        Tss      tss;
+
+        /// Serialize the callers of `runOnCpu` targeting the processor
+        sync::Spinlock callLock;
+        /// The function to call on the processor
+        void     (*callFunction)(void* argument);
+        /// The argument of `callFunction`
+        void*    callArgument;
+        /// Set by the processor once `callFunction` returned
+        volatile bool isCallDone;
+    };
+
+#ifdef BRAPOS_HOST
+    /// The only processor of the host build (host/kernel.cpp)
+    extern Cpu hostCpu;
+#endif
+
+    /**
+     * \brief Get the descriptor of the calling processor
+     *
+     * The descriptor is only valid after `initializeBootProcessor` on the
+     * bootstrap processor (gs is the flat data segment before). The host
+     * build has a single processor, `hostCpu`.
+     *
+     * \return The descriptor of the processor running the caller
+     */
+    inline Cpu* getCurrentCpu()
+    {
+#ifdef BRAPOS_HOST
+        return &hostCpu;
+#else
+        Cpu* cpu;
+        __asm__ volatile ("mov %%gs:0, %0" : "=r"(cpu));
+        return cpu;
+#endif
+    }
+}
@@ -0,0 +1,371 @@
+#include "smp.hpp"
+#include "../acpi/Acpi.hpp"
+#include "../apic/LocalApic.hpp"
+#include "../cpu/Fpu.hpp"
+#include "../cpu/cpu.hpp"
+#include "../interrupt.hpp"
+#include "../memory/AddressSpace.hpp"
+#include "../memory/FrameAllocator.hpp"
+#include "../sched/Scheduler.hpp"
+#include "../timer/Pit.hpp"
+
+/// The start of the code copied at `TRAMPOLINE_ADDRESS` (trampoline.s)
+extern "C" char trampoline_start[];
+/// The data block of the trampoline (trampoline.s)
+extern "C" char trampoline_data[];
+/// The end of the code copied at `TRAMPOLINE_ADDRESS` (trampoline.s)
+extern "C" char trampoline_end[];
+/// The top of the stack of the bootstrap processor (boot.s)
+extern "C" char stack_top[];
+
+namespace smp
+{
+    /**
+     * \brief The data block read by the trampoline (see trampoline.s)
+     */
+    struct TrampolineData
+    {
+        /// The page directory enabled by the trampoline
+        uint32_t cr3;
+        /// The value of CR4 (the paging features)
+        uint32_t cr4;
+        /// The stack of the processor
+        uintptr_t stackTop;
+        /// The descriptor of the processor, given to `entry`
+        Cpu* cpu;
+        /// The function called once paging is enabled
+        void (*entry)(Cpu* cpu);
+    } __attribute__((packed));
+
+    /// The order of the block of frames of the boot stack of a processor
+    const uint8_t STACK_ORDER = 2;
+    /// The size of the boot stack of a processor (16 KiB, like the stack of
+    /// the bootstrap processor)
+    const size_t STACK_SIZE = memory::PAGE_SIZE << STACK_ORDER;
+
+    /// The wait between the INIT and the first startup IPI
+    const uint32_t INIT_DELAY_MICROSECONDS = 10000;
+    /// The wait between the two startup IPIs
+    const uint32_t STARTUP_DELAY_MICROSECONDS = 200;
+    /// The time given to a processor to enter the kernel
+    const uint32_t ONLINE_TIMEOUT_MILLISECONDS = 100;
+
+    /// The descriptors of the processors
+    static Cpu cpus[acpi::MAX_CPUS];
+    /// The number of processors running the kernel
+    static size_t cpuCount = 1;
+
+    /**
+     * \brief Build a segment descriptor
+     *
+     * \param base The address of the segment
+     * \param limit The last offset of the segment (in 4 KiB units when the
+     * granularity flag is set)
+     * \param access The access byte (type, privilege level and present bit)
+     * \param flags The granularity and size flags
+     * \return The descriptor
+     */
+    static uint64_t makeDescriptor(uint32_t base, uint32_t limit,
+                                   uint8_t access, uint8_t flags)
+    {
+        uint64_t descriptor = limit & 0xFFFF;
+        descriptor |= (uint64_t) (base & 0xFFFFFF) << 16;
+        descriptor |= (uint64_t) access << 40;
+        descriptor |= (uint64_t) ((limit >> 16) & 0xF) << 48;
+        descriptor |= (uint64_t) (flags & 0xF) << 52;
+        descriptor |= (uint64_t) (base >> 24) << 56;
+        return descriptor;
+    }
+
+    /**
+     * \brief Fill the descriptor of a processor
+     *
+     * \param cpu The descriptor
+     * \param index The index of the processor
+     * \param apicId The identifier of its local APIC
+     * \param stackTop The top of its boot stack
+     */
+    static void initializeCpu(Cpu& cpu, size_t index, uint32_t apicId,
+                              uintptr_t stackTop)
+    {
+        cpu.self = &cpu;
+        cpu.index = index;
+        cpu.apicId = apicId;
+        cpu.stackTop = stackTop;
+        cpu.isOnline = false;
+
+        cpu.tss.ss0 = DATA_SELECTOR;
+        cpu.tss.esp0 = stackTop;
+        cpu.tss.ioMapBase = sizeof(Tss);
+
+        // Flat 4 GiB code and data (page granularity, 32-bit), the descriptor
+        // of the processor (byte granularity) and the TSS (available 32-bit
+        // TSS)
+        cpu.gdt[0] = 0;
+        cpu.gdt[CODE_SELECTOR / 8] = makeDescriptor(0, 0xFFFFF, 0x9A, 0xC);
+        cpu.gdt[DATA_SELECTOR / 8] = makeDescriptor(0, 0xFFFFF, 0x92, 0xC);
+        cpu.gdt[CPU_DATA_SELECTOR / 8] = makeDescriptor((uintptr_t) &cpu,
+                                                        sizeof(Cpu) - 1,
+                                                        0x92, 0x4);
+        cpu.gdt[TSS_SELECTOR / 8] = makeDescriptor((uintptr_t) &cpu.tss,
+                                                   sizeof(Tss) - 1, 0x89, 0);
+    }
+
+    /**
+     * \brief Load the GDT and the TSS of the calling processor
+     *
+     * The segment registers are reloaded so that none of them refers to the
+     * previous GDT, and gs is set to the segment of the descriptor.
+     *
+     * \param cpu The descriptor of the calling processor
+     */
+    static void loadGdt(Cpu& cpu)
+    {
+        struct {
+            uint16_t limit;
+            uint32_t base;
+        } __attribute__((packed)) pointer = {
+            sizeof(cpu.gdt) - 1, (uint32_t) cpu.gdt
+        };
+
+        __asm__ volatile ("lgdt %0\n\t"
+                          "ljmp %1, $1f\n"
+                          "1:\n\t"
+                          "mov %w2, %%ds\n\t"
+                          "mov %w2, %%es\n\t"
+                          "mov %w2, %%fs\n\t"
+                          "mov %w2, %%ss\n\t"
+                          "mov %w3, %%gs\n\t"
+                          "ltr %w4"
+                          :
+                          : "m"(pointer), "i"(CODE_SELECTOR),
+                            "r"((uint32_t) DATA_SELECTOR),
+                            "r"((uint32_t) CPU_DATA_SELECTOR),
+                            "r"((uint32_t) TSS_SELECTOR)
+                          : "memory");
+    }
+
+    /**
+     * \brief Run the function sent by `runOnCpu`
+     *
+     * \param frame The state of the interrupted code (unused)
+     * \param context Unused
+     */
+    static void handleCall(InterruptFrame& frame, void* context)
+    {
+        (void) frame;
+        (void) context;
+
+        Cpu* cpu = getCurrentCpu();
+        cpu->callFunction(cpu->callArgument);
+        __atomic_store_n(&cpu->isCallDone, true, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * \brief Enter the kernel on an application processor
+     *
+     * Called by the trampoline, on the boot stack of the processor, with the
+     * address space of the trampoline. The processor switches to its own GDT
+     * and to the kernel address space, loads the IDT, enables its FPU and its
+     * local APIC, then becomes the idle thread of the scheduler.
+     *
+     * \param cpu The descriptor of the processor
+     */
+    static void enterApplicationProcessor(Cpu* cpu)
+    {
+        loadGdt(*cpu);
+        memory::AddressSpace::getKernel().activate();
+        loadIdt();
+        cpu::initializeFpu();
+        apic::LocalApic::getInstance().initialize(
+            acpi::getMadtInfo().localApicAddress);
+
+        __atomic_store_n(&cpu->isOnline, true, __ATOMIC_RELEASE);
+
+        sched::Scheduler::getInstance().runIdle();
+    }
+
+    /**
+     * \brief Load the GDT and the TSS of the bootstrap processor
+     *
+     * This must be the first thing done by `kernel_main`: `getCurrentCpu`
+     * reads the descriptor loaded here. The identifier of the local APIC is
+     * read later, by `startApplicationProcessors`.
+     */
+    void initializeBootProcessor()
+    {
+        Cpu& cpu = cpus[0];
+        initializeCpu(cpu, 0, 0, (uintptr_t) stack_top);
+        loadGdt(cpu);
+        cpu.isOnline = true;
+    }
+
+    /**
+     * \brief Start the application processors listed in the MADT
+     *
+     * The trampoline is copied at `TRAMPOLINE_ADDRESS`, which a temporary
+     * address space maps both at its physical address (for the instructions
+     * enabling paging) and in the higher half. Then each processor is sent
+     * an INIT and up to two startup IPIs, and has
+     * `ONLINE_TIMEOUT_MILLISECONDS` ms to enter the kernel. The processors are
+     * started one at a time since they share the data block of the
+     * trampoline. A processor that times out is sent an INIT again, so it
+     * cannot use its stack after it is freed.
+     *
+     * The local APIC must be enabled and interrupts disabled.
+     *
+     * \return The number of processors running the kernel
+     */
+    size_t startApplicationProcessors()
+    {
+        apic::LocalApic& localApic = apic::LocalApic::getInstance();
+        if (!localApic.isEnabled()) {
+            return cpuCount;
+        }
+
+        Cpu& bootCpu = cpus[0];
+        bootCpu.apicId = localApic.getId();
+        registerInterruptHandler(CALL_VECTOR, handleCall, nullptr);
+
+        memory::AddressSpace* addressSpace = memory::AddressSpace::create();
+        if (addressSpace == nullptr) {
+            return cpuCount;
+        }
+        if (!addressSpace->map(memory::TRAMPOLINE_ADDRESS,
+                               memory::TRAMPOLINE_ADDRESS, memory::PAGE_SIZE,
+                               memory::PAGE_WRITABLE)) {
+            memory::AddressSpace::destroy(addressSpace);
+            return cpuCount;
+        }
+
+        char* trampoline = (char*)
+            memory::physicalToVirtual(memory::TRAMPOLINE_ADDRESS);
+        for (size_t i = 0; i < (size_t) (trampoline_end - trampoline_start);
+             ++i) {
+            trampoline[i] = trampoline_start[i];
+        }
+        TrampolineData* data = (TrampolineData*)
+            (trampoline + (trampoline_data - trampoline_start));
+        data->cr3 = addressSpace->getDirectoryAddress();
+        data->cr4 = cpu::readCr4();
+        data->entry = enterApplicationProcessor;
+
+        memory::FrameAllocator& frames = memory::FrameAllocator::getInstance();
+        const acpi::MadtInfo& madtInfo = acpi::getMadtInfo();
+        const uint32_t startupCommand = apic::LocalApic::COMMAND_STARTUP
+            | (memory::TRAMPOLINE_ADDRESS >> memory::PAGE_SHIFT);
+
+        for (size_t i = 0; i < madtInfo.cpuCount; ++i) {
+            const uint32_t apicId = madtInfo.cpuApicIds[i];
+            if (apicId == bootCpu.apicId) {
+                continue;
+            }
+            if (cpuCount == acpi::MAX_CPUS) {
+                break;
+            }
+
+            const memory::PhysicalAddress stack = frames.allocate(STACK_ORDER);
+            if (stack == 0) {
+                break;
+            }
+
+            Cpu& cpu = cpus[cpuCount];
+            initializeCpu(cpu, cpuCount, apicId,
+                          (uintptr_t) memory::physicalToVirtual(stack)
+                          + STACK_SIZE);
+            data->stackTop = cpu.stackTop;
+            data->cpu = &cpu;
+
+            localApic.sendInterProcessorInterrupt(
+                apicId, apic::LocalApic::COMMAND_INIT);
+            timer::waitMicroseconds(INIT_DELAY_MICROSECONDS);
+            localApic.sendInterProcessorInterrupt(apicId, startupCommand);
+            timer::waitMicroseconds(STARTUP_DELAY_MICROSECONDS);
+            if (!__atomic_load_n(&cpu.isOnline, __ATOMIC_ACQUIRE)) {
+                localApic.sendInterProcessorInterrupt(apicId, startupCommand);
+            }
+
+            for (uint32_t ms = 0; ms < ONLINE_TIMEOUT_MILLISECONDS &&
+                 !__atomic_load_n(&cpu.isOnline, __ATOMIC_ACQUIRE); ++ms) {
+                timer::waitMicroseconds(1000);
+            }
+
+            if (__atomic_load_n(&cpu.isOnline, __ATOMIC_ACQUIRE)) {
+                ++cpuCount;
+            }
+            else {
+                localApic.sendInterProcessorInterrupt(
+                    apicId, apic::LocalApic::COMMAND_INIT);
+                frames.free(stack, STACK_ORDER);
+            }
+        }
+
+        // Every processor started runs in the kernel address space
+        memory::AddressSpace::destroy(addressSpace);
+
+        return cpuCount;
+    }
+
+    /**
+     * \brief Get the number of processors running the kernel
+     *
+     * \return The number of processors (1 until `startApplicationProcessors`)
+     */
+    size_t getCpuCount()
+    {
+        return cpuCount;
+    }
+
+    /**
+     * \brief Get the descriptor of a processor
+     *
+     * \param index The index of the processor
+     * \return The descriptor, or nullptr if the index is not below
+     * `getCpuCount()`
+     */
+    Cpu* getCpu(size_t index)
+    {
+        return index < cpuCount ? &cpus[index] : nullptr;
+    }
+
+    /**
+     * \brief Call a function on a processor and wait until it returns
+     *
+     * The function is called directly if the processor is the calling one.
+     * Otherwise it is sent with an IPI on `CALL_VECTOR` and runs in the
+     * interrupt handler of the target. The caller must have interrupts
+     * enabled: two processors calling each other with interrupts disabled
+     * would wait forever.
+     *
+     * \param index The index of the processor
+     * \param function The function to call
+     * \param argument The argument of the function
+     * \return false if there is no such processor
+     */
+    bool runOnCpu(size_t index, void (*function)(void*), void* argument)
+    {
+        if (index >= cpuCount) {
+            return false;
+        }
+
+        Cpu& cpu = cpus[index];
+        if (&cpu == getCurrentCpu()) {
+            function(argument);
+            return true;
+        }
+
+        cpu.callLock.lock();
+        cpu.callFunction = function;
+        cpu.callArgument = argument;
+        __atomic_store_n(&cpu.isCallDone, false, __ATOMIC_RELAXED);
+
+        apic::LocalApic::getInstance().sendInterProcessorInterrupt(
+            cpu.apicId, apic::LocalApic::COMMAND_FIXED | CALL_VECTOR);
+        while (!__atomic_load_n(&cpu.isCallDone, __ATOMIC_ACQUIRE)) {
+            __asm__ volatile ("pause");
+        }
+
+        cpu.callLock.unlock();
+        return true;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Cpu.hpp"
+
+/**
+ * \brief Start the other processors and run code on them
+ *
+ * The bootstrap processor (the one running `kernel_main`) wakes the
+ * application processors listed in the MADT with the INIT-SIPI-SIPI sequence.
+ * Each one runs the real-mode trampoline of trampoline.s, then enters the
+ * kernel on its own stack, with its own GDT and TSS, and waits for
+ * interrupts.
+ *
+ * Example:
+ * \code
+ * smp::initializeBootProcessor();
+ * // ... once the local APIC is enabled
+ * smp::startApplicationProcessors();
+ * for (size_t i = 0; i < smp::getCpuCount(); ++i) {
+ *     smp::runOnCpu(i, flushCaches, nullptr);
+ * }
+ * \endcode
+ */
+namespace smp
+{
+    /// The vector of the interrupts sent by `runOnCpu`
+    const uint8_t CALL_VECTOR = 0xF0;
+
+    /// Load the GDT and the TSS of the bootstrap processor
+    void initializeBootProcessor();
+    /// Start the application processors listed in the MADT
+    size_t startApplicationProcessors();
+
+    /// Get the number of processors running the kernel
+    size_t getCpuCount();
+    /// Get the descriptor of a processor
+    Cpu* getCpu(size_t index);
+
+    /// Call a function on a processor and wait until it returns
+    bool runOnCpu(size_t index, void (*function)(void*), void* argument);
+}
@@ -0,0 +1,100 @@
+# The code started by the application processors. A startup IPI starts a
+# processor in real mode at the physical address TRAMPOLINE_ADDRESS (the IPI
+# gives the page number), where smp::startApplicationProcessors copies the
+# code between trampoline_start and trampoline_end. The code is linked in the
+# kernel, so every address it uses is computed relatively to trampoline_start.
+#
+# The trampoline enables protected mode with a flat GDT, then paging with the
+# CR3 and CR4 written in the data block by the bootstrap processor (an
+# address space mapping both the trampoline page and the kernel). Finally it
+# loads the stack of the processor and calls the entry point with the
+# processor descriptor, in the higher half.
+
+.set TRAMPOLINE_ADDRESS, 0x8000
+.set CR0_PE,        0x00000001  # protected mode
+.set CR0_CD_NW,     0x60000000  # caches disabled (set by INIT)
+.set CR0_PG_WP,     0x80010000  # paging, write protection in the kernel
+.set CODE_SELECTOR, 0x08
+.set DATA_SELECTOR, 0x10
+
+.section .rodata
+.align 16
+.global trampoline_start
+trampoline_start:
+.code16
+    cli
+    cld
+
+    # The code segment is TRAMPOLINE_ADDRESS >> 4, use absolute addresses
+    xor %ax, %ax
+    mov %ax, %ds
+
+    lgdtl (trampoline_gdt_info - trampoline_start + TRAMPOLINE_ADDRESS)
+
+    # Enable protected mode and the caches
+    mov %cr0, %eax
+    and $~CR0_CD_NW, %eax
+    or $CR0_PE, %eax
+    mov %eax, %cr0
+    ljmpl $CODE_SELECTOR, $(PROTECTED_OFFSET + TRAMPOLINE_ADDRESS)
+
+.code32
+trampoline_protected:
+.set PROTECTED_OFFSET, trampoline_protected - trampoline_start
+    mov $DATA_SELECTOR, %ax
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %ss
+
+    # Enable paging with the features of the bootstrap processor (4 MiB and
+    # global pages)
+    mov (trampoline_cr4 - trampoline_start + TRAMPOLINE_ADDRESS), %eax
+    mov %eax, %cr4
+    mov (trampoline_cr3 - trampoline_start + TRAMPOLINE_ADDRESS), %eax
+    mov %eax, %cr3
+    mov %cr0, %eax
+    or $CR0_PG_WP, %eax
+    mov %eax, %cr0
+
+    # Call the entry point with the processor descriptor, the stack stays
+    # aligned on 16 bytes at the call
+    mov (trampoline_stack_top - trampoline_start + TRAMPOLINE_ADDRESS), %esp
+    sub $12, %esp
+    push (trampoline_cpu - trampoline_start + TRAMPOLINE_ADDRESS)
+    mov (trampoline_entry - trampoline_start + TRAMPOLINE_ADDRESS), %eax
+    call *%eax
+
+    # The entry point never returns
+    cli
+1:  hlt
+    jmp 1b
+
+# A flat GDT with the selectors of the kernel, until the entry point loads the
+# GDT of the processor
+.align 8
+trampoline_gdt:
+    .quad 0x0000000000000000
+    .quad 0x00CF9A000000FFFF    # 0x08: code
+    .quad 0x00CF92000000FFFF    # 0x10: data
+trampoline_gdt_info:
+    .short trampoline_gdt_info - trampoline_gdt - 1
+    .long trampoline_gdt - trampoline_start + TRAMPOLINE_ADDRESS
+
+# The data block, filled by the bootstrap processor for each processor it
+# starts (smp::TrampolineData)
+.align 4
+.global trampoline_data
+trampoline_data:
+trampoline_cr3:
+    .long 0
+trampoline_cr4:
+    .long 0
+trampoline_stack_top:
+    .long 0
+trampoline_cpu:
+    .long 0
+trampoline_entry:
+    .long 0
+
+.global trampoline_end
+trampoline_end:
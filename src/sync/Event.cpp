@@ -0,0 +1,206 @@
+#include "Event.hpp"
+#include "../sched/Scheduler.hpp"
+
+namespace sync
+{
+    /**
+     * \brief Add a waiter to the queue
+     *
+     * \param waiter The waiter, which must stay valid until it is removed
+     */
+    void WaitQueue::add(Waiter& waiter)
+    {
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+        waiter.next = head_;
+        head_ = &waiter;
+        lock_.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Remove a waiter from the queue
+     *
+     * \param waiter A waiter added with `add`
+     */
+    void WaitQueue::remove(Waiter& waiter)
+    {
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+        Waiter** link = &head_;
+        while (*link != nullptr && *link != &waiter) {
+            link = &(*link)->next;
+        }
+        if (*link != nullptr) {
+            *link = waiter.next;
+        }
+        lock_.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Wake up the thread of every waiter
+     *
+     * This can be called by interrupt handlers.
+     */
+    void WaitQueue::wakeAll()
+    {
+        sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+
+        uint32_t flags = lock_.lockAndDisableInterrupts();
+        for (Waiter* waiter = head_; waiter != nullptr; waiter = waiter->next) {
+            scheduler.wake(waiter->thread);
+        }
+        lock_.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Set the event and wake up the threads waiting for it
+     *
+     * Only the call that sets the event wakes the waiters up: while it stays
+     * set, a waiter sees it before blocking. This can be called by interrupt
+     * handlers.
+     *
+     * The fence orders what the caller wrote to the source before the check
+     * of the event: otherwise the check could see the event still set while
+     * the data sits in the store buffer, the consumer could clear the event
+     * and find its source empty, and the data would wait for the next signal.
+     */
+    void Event::signal()
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&isSet_, __ATOMIC_RELAXED) ||
+            __atomic_exchange_n(&isSet_, true, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+
+        waiters_.wakeAll();
+    }
+
+    /**
+     * \brief Return true if the event is set
+     *
+     * \return true if the event was signaled and not consumed yet
+     */
+    bool Event::isSet() const
+    {
+        return __atomic_load_n(&isSet_, __ATOMIC_SEQ_CST);
+    }
+
+    /**
+     * \brief Clear the event and return true if it was set
+     *
+     * The event is cleared before the consumer reads its source, so what the
+     * source gets meanwhile signals the event again.
+     *
+     * \return true if the event was set
+     */
+    bool Event::consume()
+    {
+        return __atomic_load_n(&isSet_, __ATOMIC_RELAXED) &&
+               __atomic_exchange_n(&isSet_, false, __ATOMIC_SEQ_CST);
+    }
+
+    /**
+     * \brief Signal the event given as context
+     *
+     * The callback of a timer signaling an event when it expires.
+     *
+     * \param context The `Event`
+     */
+    void signalEvent(void* context)
+    {
+        static_cast<Event*>(context)->signal();
+    }
+
+    /**
+     * \brief Consume a list of events
+     *
+     * \param events The events
+     * \param count The number of events
+     * \return The mask of the events that were set
+     */
+    static uint32_t consumeEvents(Event* const* events, size_t count)
+    {
+        uint32_t ready = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (events[i]->consume()) {
+                ready |= 1 << i;
+            }
+        }
+
+        return ready;
+    }
+
+    /**
+     * \brief Return true if one of a list of events is set
+     *
+     * \param events The events
+     * \param count The number of events
+     * \return true if an event is set
+     */
+    static bool isAnySet(Event* const* events, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (events[i]->isSet()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Wait until at least one of `count` events is set
+     *
+     * The calling thread is added to the wait queue of every event, then it
+     * checks the events one last time and blocks. A signal between the check
+     * and the block is not lost: `sched::Scheduler::block` returns at once
+     * after a `wake`. Before the scheduler runs on the processor, the check
+     * is done with interrupts disabled and followed by `sti; hlt`, which
+     * cannot miss an interrupt: only the interrupts of the calling processor
+     * end that wait.
+     *
+     * \param events The events
+     * \param count The number of events (at most `MAX_WAIT_EVENTS`)
+     * \return The mask of the events that were set (bit `i` for
+     * `events[i]`), now cleared
+     */
+    uint32_t waitAny(Event* const* events, size_t count)
+    {
+        sched::Scheduler& scheduler = sched::Scheduler::getInstance();
+        if (count > MAX_WAIT_EVENTS) {
+            count = MAX_WAIT_EVENTS;
+        }
+
+        uint32_t ready;
+        while ((ready = consumeEvents(events, count)) == 0) {
+            sched::Thread* thread = scheduler.isInitialized()
+                                        ? scheduler.getCurrentThread()
+                                        : nullptr;
+            if (thread == nullptr) {
+                const uint32_t flags = saveAndDisableInterrupts();
+                if (!isAnySet(events, count)) {
+                    scheduler.halt();
+                }
+                restoreInterrupts(flags);
+                continue;
+            }
+
+            Waiter waiters[MAX_WAIT_EVENTS];
+            for (size_t i = 0; i < count; ++i) {
+                waiters[i].thread = thread;
+                events[i]->waiters_.add(waiters[i]);
+            }
+
+            // The waiters are visible before the events are read, so a
+            // signal either is seen here or wakes the thread up
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!isAnySet(events, count)) {
+                scheduler.block();
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                events[i]->waiters_.remove(waiters[i]);
+            }
+        }
+
+        return ready;
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Spinlock.hpp"
+
+namespace sched
+{
+    class Thread;
+}
+
+/**
+ * Wait queues and events.
+ *
+ * A source of work (a device, a timer, the logger...) owns an `Event` and
+ * signals it when it has something ready, typically from its interrupt
+ * handler. A consumer waits for several events at once with `waitAny`, which
+ * returns the batch of events signaled meanwhile and clears them: the
+ * consumer then empties every source of the batch before it waits again, so
+ * a burst of signals costs a single wake-up.
+ *
+ * The waiting thread blocks (`sched::Scheduler::block`) until one of the
+ * events wakes it up, so the processor only halts in its idle thread, with
+ * its tick stopped. Before the scheduler runs, `waitAny` halts the processor
+ * itself. Either way a signal cannot be lost between the last check of the
+ * events and the wait.
+ *
+ * Example:
+ * \code
+ * while (true) {
+ *     const uint32_t ready = sync::waitAny(keyboardEvent, serialEvent);
+ *     if (ready & 1) {
+ *         readKeys();
+ *     }
+ *     if (ready & 2) {
+ *         readSerialPort();
+ *     }
+ * }
+ * \endcode
+ */
+namespace sync
+{
+    /// The largest number of events `waitAny` waits for at once
+    const size_t MAX_WAIT_EVENTS = 32;
+
+    /// A thread in a `WaitQueue`, owned by the waiting thread (usually on its
+    /// stack)
+    struct Waiter
+    {
+        /// The waiting thread
+        sched::Thread* thread;
+        /// The next waiter of the queue
+        Waiter* next;
+    };
+
+    /**
+     * \brief The threads waiting for the same thing
+     *
+     * The waiters stay in the queue when they are woken up: each thread
+     * removes its own waiter once it is done waiting.
+     */
+    class WaitQueue
+    {
+    public:
+        /// Initialize an empty queue
+        constexpr WaitQueue()
+            : lock_(), head_(nullptr)
+        {
+        }
+
+        /// Add a waiter to the queue
+        void add(Waiter& waiter);
+        /// Remove a waiter from the queue
+        void remove(Waiter& waiter);
+        /// Wake up the thread of every waiter
+        void wakeAll();
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the waiters point to the queue
+        WaitQueue(WaitQueue const&) = delete;
+        void operator=(WaitQueue const&) = delete;
+
+    private:
+        /// Protect the list (taken with interrupts disabled)
+        Spinlock lock_;
+        /// The first waiter
+        Waiter* head_;
+    };
+
+    /**
+     * \brief A flag set by a source and cleared by the consumer that saw it
+     *
+     * Signaling an event already set costs a single read, so a source can
+     * signal every time it has something ready.
+     */
+    class Event
+    {
+    public:
+        /// Initialize a cleared event
+        constexpr Event()
+            : isSet_(false), waiters_()
+        {
+        }
+
+        /// Set the event and wake up the threads waiting for it
+        void signal();
+        /// Return true if the event is set
+        bool isSet() const;
+        /// Clear the event and return true if it was set
+        bool consume();
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the waiters point to the event
+        Event(Event const&) = delete;
+        void operator=(Event const&) = delete;
+
+    private:
+        friend uint32_t waitAny(Event* const* events, size_t count);
+
+        /// True from `signal` to `consume`
+        bool isSet_;
+        /// The threads in `waitAny`
+        WaitQueue waiters_;
+    };
+
+    /// Signal the event given as context (a `timer::TimerCallback`)
+    void signalEvent(void* context);
+
+    /// Wait until at least one of `count` events is set
+    uint32_t waitAny(Event* const* events, size_t count);
+
+    /**
+     * \brief Wait until at least one of the events is set
+     *
+     * \param first The first event (bit 0 of the result)
+     * \param others The other events (the following bits)
+     * \return The mask of the events that were set, now cleared
+     */
+    template <typename... Events>
+    uint32_t waitAny(Event& first, Events&... others)
+    {
+        static_assert(1 + sizeof...(Events) <= MAX_WAIT_EVENTS,
+                      "Too many events");
+
+        Event* const events[] = {&first, &others...};
+        return waitAny(events, 1 + sizeof...(Events));
+    }
+}
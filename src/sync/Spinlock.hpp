@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../interrupt.hpp"
+
+namespace sync
+{
+    /**
+     * \brief Protect data shared between processors
+     *
+     * The lock is a single word taken with an atomic exchange (acquire) and
+     * released with a store (release). While the lock is taken by another
+     * processor, it is only read (with `pause`), so the waiting processors do
+     * not keep stealing the cache line from the owner.
+     *
+     * Data also used by interrupt handlers must be locked with
+     * `lockAndDisableInterrupts`: a handler interrupting the owner of the
+     * lock on the same processor would wait forever.
+     *
+     * Example:
+     * \code
+     * uint32_t flags = lock_.lockAndDisableInterrupts();
+     * ...
+     * lock_.unlockAndRestoreInterrupts(flags);
+     * \endcode
+     */
+    class Spinlock
+    {
+    public:
+        /// Initialize an unlocked lock
+        constexpr Spinlock()
+            : isLocked_(0)
+        {
+        }
+
+        /// Wait until the lock is free and take it
+        void lock()
+        {
+            while (__atomic_exchange_n(&isLocked_, 1, __ATOMIC_ACQUIRE)) {
+                while (__atomic_load_n(&isLocked_, __ATOMIC_RELAXED)) {
+                    __asm__ volatile ("pause");
+                }
+            }
+        }
+
+        /// Take the lock if it is free
+        bool tryLock()
+        {
+            return !__atomic_exchange_n(&isLocked_, 1, __ATOMIC_ACQUIRE);
+        }
+
+        /// Release the lock
+        void unlock()
+        {
+            __atomic_store_n(&isLocked_, 0, __ATOMIC_RELEASE);
+        }
+
+        /// Disable interrupts, take the lock and return the previous state of
+        /// the flags register
+        uint32_t lockAndDisableInterrupts()
+        {
+            uint32_t flags = saveAndDisableInterrupts();
+            lock();
+            return flags;
+        }
+
+        /// Release the lock and restore the state of the interrupts saved by
+        /// `lockAndDisableInterrupts`
+        void unlockAndRestoreInterrupts(uint32_t flags)
+        {
+            unlock();
+            restoreInterrupts(flags);
+        }
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the lock is shared by address
+        Spinlock(Spinlock const&) = delete;
+        void operator=(Spinlock const&) = delete;
+
+    private:
+        /// 1 while the lock is taken, 0 otherwise
+        uint32_t isLocked_;
+    };
+}
@@ -0,0 +1,246 @@
+#include "Clock.hpp"
+#include "Hpet.hpp"
+#include "Pit.hpp"
+#include "Timer.hpp"
+#include "../interrupt.hpp"
+#include "../sync/Spinlock.hpp"
+
+namespace timer
+{
+    /// The number of measures of the frequency of the time stamp counter
+    const uint32_t CALIBRATION_RUNS = 5;
+    /// The duration of a measure in milliseconds
+    const uint32_t CALIBRATION_MILLISECONDS = 10;
+    /// The number of nanoseconds per second
+    const uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+    /// The number of ticks between two reads of the PIT clock (its count
+    /// wraps around every 55 ms)
+    const uint32_t PIT_REFRESH_TICKS = 20 * (TICK_FREQUENCY / 1000);
+
+    /// The conversion used by `nowNs`, set by `initializeClock`
+    ClockScale clockScale = {ClockSource::NONE, 0, 0, 0};
+
+    /// The result of the calibration
+    static ClockCalibration calibration = {};
+
+    /// Protect the PIT clock
+    static sync::Spinlock pitLock;
+    /// The count of channel 2 at the previous read
+    static uint16_t pitPreviousCount = 0;
+    /// The number of PIT ticks counted since the clock started
+    static uint64_t pitTicks = 0;
+    /// The timer reading the PIT clock before its count wraps around
+    static Timer pitRefreshTimer = {};
+
+    /**
+     * \brief Return true if the time stamp counter runs at a constant rate
+     *
+     * \return true if CPUID reports an invariant time stamp counter
+     */
+    static bool isTscInvariant()
+    {
+        if (!(cpu::cpuid(1).edx & cpu::CPUID_1_EDX_TSC) ||
+            cpu::cpuid(cpu::CPUID_EXTENDED).eax
+            < cpu::CPUID_POWER_MANAGEMENT) {
+            return false;
+        }
+
+        return cpu::cpuid(cpu::CPUID_POWER_MANAGEMENT).edx
+               & cpu::CPUID_80000007_EDX_INVARIANT_TSC;
+    }
+
+    /**
+     * \brief Measure the frequency of the time stamp counter with the HPET
+     *
+     * \return The number of cycles per second
+     */
+    static uint64_t measureTscWithHpet()
+    {
+        const uint32_t window = getHpetFrequency()
+                                * CALIBRATION_MILLISECONDS / 1000;
+        const uint32_t start = readHpetCounter();
+        const uint64_t tscStart = cpu::readTsc();
+
+        uint32_t elapsed;
+        uint64_t tscEnd;
+        do {
+            tscEnd = cpu::readTsc();
+            elapsed = readHpetCounter() - start;
+        } while (elapsed < window);
+
+        return (tscEnd - tscStart) * getHpetFrequency() / elapsed;
+    }
+
+    /**
+     * \brief Measure the frequency of the time stamp counter with the PIT
+     *
+     * \return The number of cycles per second
+     */
+    static uint64_t measureTscWithPit()
+    {
+        const uint16_t count = PIT_FREQUENCY * CALIBRATION_MILLISECONDS
+                               / 1000;
+        startPitCountdown(count);
+        const uint64_t start = cpu::readTsc();
+        while (!isPitCountdownOver())
+            ;
+        const uint64_t cycles = cpu::readTsc() - start;
+        stopPitCountdown();
+
+        return cycles * PIT_FREQUENCY / count;
+    }
+
+    /**
+     * \brief Compute the multiplier and the shift of a counter frequency
+     *
+     * The shift is the largest one that keeps the multiplier in 32 bits, for
+     * the best precision.
+     *
+     * \param frequency The frequency of the counter in Hz
+     */
+    static void setClockScale(uint64_t frequency)
+    {
+        uint32_t shift = 32;
+        while (shift > 0 &&
+               (NANOSECONDS_PER_SECOND << shift) / frequency > UINT32_MAX) {
+            --shift;
+        }
+
+        clockScale.multiplier = (NANOSECONDS_PER_SECOND << shift) / frequency;
+        clockScale.shift = shift;
+    }
+
+    /**
+     * \brief Read the PIT clock and program the next read
+     *
+     * \param context Unused
+     */
+    static void refreshPitClock(void* context)
+    {
+        (void) context;
+
+        readSlowClock();
+        addTimer(pitRefreshTimer, PIT_REFRESH_TICKS, refreshPitClock,
+                 nullptr);
+    }
+
+    /**
+     * \brief Calibrate the clock and choose its counter
+     *
+     * With an invariant time stamp counter, its frequency is measured
+     * `CALIBRATION_RUNS` times with interrupts disabled, and the median is
+     * kept. Otherwise channel 2 of the PIT becomes the counter of the clock.
+     * Must be called by the bootstrap processor once its tick runs, after
+     * `acpi::initialize` and once the other processors are started (they
+     * use the countdowns of channel 2).
+     *
+     * \return The result of the calibration
+     */
+    const ClockCalibration& initializeClock()
+    {
+        calibration.isTscInvariant = isTscInvariant();
+
+        if (!calibration.isTscInvariant) {
+            calibration.source = ClockSource::PIT;
+            calibration.frequency = PIT_FREQUENCY;
+
+            const uint32_t flags = pitLock.lockAndDisableInterrupts();
+            startPitFreeRunning();
+            pitPreviousCount = getPitFreeRunningCount();
+            setClockScale(PIT_FREQUENCY);
+            clockScale.source = ClockSource::PIT;
+            pitLock.unlockAndRestoreInterrupts(flags);
+
+            addTimer(pitRefreshTimer, PIT_REFRESH_TICKS, refreshPitClock,
+                     nullptr);
+            return calibration;
+        }
+
+        const bool hasHpet = initializeHpet();
+        calibration.reference = hasHpet ? "HPET" : "PIT";
+
+        uint64_t runs[CALIBRATION_RUNS];
+        for (uint32_t i = 0; i < CALIBRATION_RUNS; ++i) {
+            const uint32_t flags = saveAndDisableInterrupts();
+            const uint64_t frequency = hasHpet ? measureTscWithHpet()
+                                               : measureTscWithPit();
+            restoreInterrupts(flags);
+
+            // Insertion sort, for the median
+            uint32_t j = i;
+            for (; j > 0 && runs[j - 1] > frequency; --j) {
+                runs[j] = runs[j - 1];
+            }
+            runs[j] = frequency;
+        }
+
+        const uint64_t median = runs[CALIBRATION_RUNS / 2];
+        const uint64_t below = median - runs[0];
+        const uint64_t above = runs[CALIBRATION_RUNS - 1] - median;
+        calibration.source = ClockSource::TSC;
+        calibration.frequency = median;
+        calibration.errorPpm = (below > above ? below : above) * 1000000
+                               / median;
+
+        setClockScale(median);
+        clockScale.base = cpu::readTsc();
+        clockScale.source = ClockSource::TSC;
+        return calibration;
+    }
+
+    /**
+     * \brief Get the result of the calibration of the clock
+     *
+     * \return The calibration (its source is `ClockSource::NONE` before
+     * `initializeClock`)
+     */
+    const ClockCalibration& getClockCalibration()
+    {
+        return calibration;
+    }
+
+    /**
+     * \brief Get the name of a clock source
+     *
+     * \param source The source
+     * \return The name of the counter
+     */
+    const char* getClockSourceName(ClockSource source)
+    {
+        switch (source) {
+        case ClockSource::TSC:
+            return "TSC";
+        case ClockSource::PIT:
+            return "PIT";
+        default:
+            return "none";
+        }
+    }
+
+    /**
+     * \brief Read the clock when its counter is not the time stamp counter
+     *
+     * The count of channel 2 goes down and wraps around, so the 16-bit
+     * difference with the previous read is the number of PIT ticks elapsed
+     * meanwhile, as long as the reads are less than 55 ms apart.
+     *
+     * \return The number of nanoseconds since the clock was initialized, 0
+     * before `initializeClock`
+     */
+    uint64_t readSlowClock()
+    {
+        if (clockScale.source != ClockSource::PIT) {
+            return 0;
+        }
+
+        const uint32_t flags = pitLock.lockAndDisableInterrupts();
+        const uint16_t count = getPitFreeRunningCount();
+        pitTicks += (uint16_t) (pitPreviousCount - count);
+        pitPreviousCount = count;
+        const uint64_t ticks = pitTicks;
+        pitLock.unlockAndRestoreInterrupts(flags);
+
+        return scaleClockCount(ticks, clockScale.multiplier,
+                               clockScale.shift);
+    }
+}
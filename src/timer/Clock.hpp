@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../cpu/cpu.hpp"
+
+/**
+ * Timestamps in nanoseconds.
+ *
+ * The clock counts the nanoseconds since `initializeClock`. When the
+ * processor reports an invariant time stamp counter (it runs at the same rate
+ * in every power state), `nowNs` is `rdtsc`, a subtraction and two 32-bit
+ * multiplications: the counter is converted with a multiplier and a shift
+ * computed once from its frequency. The frequency is measured at boot against
+ * the HPET, or the PIT without HPET, over several runs; the spread of the
+ * runs is the calibration error.
+ *
+ * Otherwise, the clock reads channel 2 of the PIT, free-running and latched
+ * under a lock, which costs a few microseconds per read. A timer of the
+ * bootstrap processor reads it often enough to count each time the 16-bit
+ * count wraps around.
+ *
+ * Example:
+ * \code
+ * const uint64_t start = timer::nowNs();
+ * ...
+ * klog(LogLevel::DEBUG, "Done in {} ns", timer::nowNs() - start);
+ * \endcode
+ */
+namespace timer
+{
+    /// The counter read by the clock
+    enum class ClockSource : uint8_t
+    {
+        /// `initializeClock` was not called, the clock reads 0
+        NONE,
+        /// The time stamp counter of the calling processor
+        TSC,
+        /// The free-running channel 2 of the PIT
+        PIT
+    };
+
+    /// The conversion of the counter of the clock to nanoseconds
+    struct ClockScale
+    {
+        /// The counter read by `nowNs`
+        ClockSource source;
+        /// The nanoseconds per count, times 2^`shift`
+        uint32_t multiplier;
+        /// The number of fractional bits of `multiplier` (at most 32)
+        uint32_t shift;
+        /// The time stamp counter when the clock started
+        uint64_t base;
+    };
+
+    /// The result of the calibration of the clock
+    struct ClockCalibration
+    {
+        /// The counter read by `nowNs`
+        ClockSource source;
+        /// True if CPUID reports an invariant time stamp counter
+        bool isTscInvariant;
+        /// The timer the time stamp counter was measured against ("HPET" or
+        /// "PIT"), nullptr if it was not calibrated
+        const char* reference;
+        /// The frequency of the counter in Hz
+        uint64_t frequency;
+        /// The largest difference between a calibration run and
+        /// `frequency`, in parts per million
+        uint32_t errorPpm;
+    };
+
+    /// The conversion used by `nowNs`, set by `initializeClock`
+    extern ClockScale clockScale;
+
+    /// Calibrate the clock and choose its counter
+    const ClockCalibration& initializeClock();
+    /// Get the result of the calibration of the clock
+    const ClockCalibration& getClockCalibration();
+    /// Get the name of a clock source
+    const char* getClockSourceName(ClockSource source);
+    /// Read the clock when its counter is not the time stamp counter
+    uint64_t readSlowClock();
+
+    /// Convert a count to nanoseconds: `count * multiplier >> shift`, with
+    /// the 96-bit product done as two 32x32-bit ones
+    inline uint64_t scaleClockCount(uint64_t count, uint32_t multiplier,
+                                    uint32_t shift)
+    {
+        const uint32_t low = count;
+        const uint32_t high = count >> 32;
+        return (((uint64_t) low * multiplier) >> shift)
+               + (((uint64_t) high * multiplier) << (32 - shift));
+    }
+
+    /// Get the number of nanoseconds since the clock was initialized
+    inline uint64_t nowNs()
+    {
+        if (clockScale.source != ClockSource::TSC) {
+            return readSlowClock();
+        }
+
+        return scaleClockCount(cpu::readTsc() - clockScale.base,
+                               clockScale.multiplier, clockScale.shift);
+    }
+}
@@ -0,0 +1,91 @@
+#include "Hpet.hpp"
+#include "../acpi/Acpi.hpp"
+#include "../memory/AddressSpace.hpp"
+
+namespace timer
+{
+    /// The register offsets
+    const uint32_t REGISTER_CAPABILITIES_HIGH = 0x004;
+    const uint32_t REGISTER_CONFIGURATION     = 0x010;
+    const uint32_t REGISTER_MAIN_COUNTER      = 0x0F0;
+
+    /// The size of the registers
+    const size_t REGISTERS_SIZE = 0x400;
+    /// Configuration, the main counter runs
+    const uint32_t CONFIGURATION_ENABLE = 1 << 0;
+    /// The number of femtoseconds per second
+    const uint64_t FEMTOSECONDS_PER_SECOND = 1000000000000000ULL;
+    /// The longest period allowed by the specification (10 MHz), in
+    /// femtoseconds
+    const uint32_t MAX_PERIOD = 100000000;
+
+    /// The registers (nullptr until `initializeHpet` succeeded)
+    static volatile uint32_t* registers = nullptr;
+    /// The frequency of the main counter in Hz
+    static uint64_t frequency = 0;
+
+    /**
+     * \brief Map the registers of the HPET and start its main counter
+     *
+     * Must be called after `acpi::initialize`.
+     *
+     * \return false if ACPI describes no HPET or if its period is invalid
+     */
+    bool initializeHpet()
+    {
+        const memory::PhysicalAddress address = acpi::getHpetAddress();
+        if (address == 0) {
+            return false;
+        }
+
+        volatile uint32_t* hpet = (volatile uint32_t*)
+            memory::AddressSpace::mapDevice(address, REGISTERS_SIZE);
+        if (hpet == nullptr) {
+            return false;
+        }
+
+        // The period of the main counter in femtoseconds
+        const uint32_t period = hpet[REGISTER_CAPABILITIES_HIGH / 4];
+        if (period == 0 || period > MAX_PERIOD) {
+            return false;
+        }
+
+        hpet[REGISTER_CONFIGURATION / 4] |= CONFIGURATION_ENABLE;
+        frequency = FEMTOSECONDS_PER_SECOND / period;
+        registers = hpet;
+        return true;
+    }
+
+    /**
+     * \brief Return true once `initializeHpet` succeeded
+     *
+     * \return true if the main counter can be read
+     */
+    bool isHpetEnabled()
+    {
+        return registers != nullptr;
+    }
+
+    /**
+     * \brief Get the frequency of the main counter in Hz
+     *
+     * \return The number of counts per second (0 without HPET)
+     */
+    uint64_t getHpetFrequency()
+    {
+        return frequency;
+    }
+
+    /**
+     * \brief Read the low 32 bits of the main counter
+     *
+     * The counter may be 64-bit, but its low half wraps around after several
+     * minutes, which is enough to measure short durations.
+     *
+     * \return The low 32 bits of the counter
+     */
+    uint32_t readHpetCounter()
+    {
+        return registers[REGISTER_MAIN_COUNTER / 4];
+    }
+}
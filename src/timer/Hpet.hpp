@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * \brief Read the main counter of the high precision event timer
+ *
+ * The HPET is described by ACPI. Its main counter runs at a constant
+ * frequency (at least 10 MHz) given by the capabilities register, so it is a
+ * precise reference to calibrate the other timers. Only the main counter is
+ * used, none of the comparators.
+ */
+namespace timer
+{
+    /// Map the registers of the HPET and start its main counter
+    bool initializeHpet();
+    /// Return true once `initializeHpet` succeeded
+    bool isHpetEnabled();
+    /// Get the frequency of the main counter in Hz
+    uint64_t getHpetFrequency();
+    /// Read the low 32 bits of the main counter
+    uint32_t readHpetCounter();
+}
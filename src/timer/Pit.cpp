@@ -0,0 +1,210 @@
+#include "Pit.hpp"
+#include "Clock.hpp"
+#include "../io.hpp"
+
+namespace timer
+{
+    /// The data port of channel 0
+    const uint16_t CHANNEL0_PORT = 0x40;
+    /// The data port of channel 2
+    const uint16_t CHANNEL2_PORT = 0x42;
+    /// The mode/command port
+    const uint16_t COMMAND_PORT  = 0x43;
+    /// The port controlling the gate of channel 2 (bit 0) and the speaker
+    /// (bit 1), and reading the output of channel 2 (bit 5)
+    const uint16_t CONTROL_PORT  = 0x61;
+
+    /// Channel 2, low byte then high byte, mode 0 (interrupt on terminal
+    /// count: the output goes high when the count reaches 0)
+    const uint8_t CHANNEL2_ONE_SHOT = 0xB0;
+    /// Channel 2, low byte then high byte, mode 2 (rate generator: the count
+    /// is reloaded each time it reaches 1)
+    const uint8_t CHANNEL2_PERIODIC = 0xB4;
+    /// Channel 2, latch the count
+    const uint8_t CHANNEL2_LATCH    = 0x80;
+    /// Channel 0, low byte then high byte, mode 2 (rate generator: a pulse
+    /// every `count` ticks)
+    const uint8_t CHANNEL0_PERIODIC = 0x34;
+    /// Channel 0, low byte then high byte, mode 0 (IRQ0 is raised once, when
+    /// the count reaches 0)
+    const uint8_t CHANNEL0_ONE_SHOT = 0x30;
+    /// Channel 0, latch the count so both bytes are from the same instant
+    const uint8_t CHANNEL0_LATCH    = 0x00;
+    /// Read-back command, latch the status (not the count) of channel 0
+    const uint8_t CHANNEL0_READ_STATUS = 0xE2;
+    /// Read-back status, the output of the channel is high
+    const uint8_t STATUS_OUTPUT     = 0x80;
+    /// Control port, the gate of channel 2 is high
+    const uint8_t CONTROL_GATE     = 0x01;
+    /// Control port, the speaker is on
+    const uint8_t CONTROL_SPEAKER  = 0x02;
+    /// Control port, the output of channel 2 is high
+    const uint8_t CONTROL_OUTPUT   = 0x20;
+
+    /// The longest countdown (a 16-bit count), in microseconds
+    const uint32_t MAX_COUNTDOWN_MICROSECONDS = 50000;
+
+    /// True once channel 2 is a free-running counter
+    static bool isFreeRunning = false;
+
+    /**
+     * \brief Start counting down `count` PIT ticks on channel 2
+     *
+     * The gate is lowered while the count is loaded, then raised to start the
+     * countdown. The speaker stays off.
+     *
+     * \param count The number of ticks (at `PIT_FREQUENCY`)
+     */
+    void startPitCountdown(uint16_t count)
+    {
+        const uint8_t control = inb(CONTROL_PORT)
+                                & ~(CONTROL_GATE | CONTROL_SPEAKER);
+        outb(CONTROL_PORT, control);
+        outb(COMMAND_PORT, CHANNEL2_ONE_SHOT);
+        outb(CHANNEL2_PORT, count & 0xFF);
+        outb(CHANNEL2_PORT, count >> 8);
+        outb(CONTROL_PORT, control | CONTROL_GATE);
+    }
+
+    /**
+     * \brief Return true once the countdown started by `startPitCountdown` is
+     * over
+     *
+     * \return true if the count reached 0
+     */
+    bool isPitCountdownOver()
+    {
+        return inb(CONTROL_PORT) & CONTROL_OUTPUT;
+    }
+
+    /**
+     * \brief Stop the countdown of channel 2
+     */
+    void stopPitCountdown()
+    {
+        outb(CONTROL_PORT, inb(CONTROL_PORT) & ~CONTROL_GATE);
+    }
+
+    /**
+     * \brief Wait `microseconds` microseconds by polling the PIT
+     *
+     * Long waits are cut in countdowns that fit the 16-bit counter. Once
+     * channel 2 is free-running, the clock is polled instead.
+     *
+     * \param microseconds The duration to wait
+     */
+    void waitMicroseconds(uint32_t microseconds)
+    {
+        if (isFreeRunning) {
+            // Channel 2 is read by the clock, under its lock
+            const uint64_t end = nowNs() + microseconds * 1000ULL;
+            while (nowNs() < end)
+                ;
+            return;
+        }
+
+        while (microseconds > 0) {
+            uint32_t duration = microseconds < MAX_COUNTDOWN_MICROSECONDS
+                                ? microseconds : MAX_COUNTDOWN_MICROSECONDS;
+            // 1193 ticks per millisecond (0.02% short, without a 64-bit
+            // division)
+            uint32_t count = duration * (PIT_FREQUENCY / 1000) / 1000;
+
+            startPitCountdown(count > 0 ? count : 1);
+            while (!isPitCountdownOver())
+                ;
+            stopPitCountdown();
+
+            microseconds -= duration;
+        }
+    }
+
+    /**
+     * \brief Make channel 2 count down from 65536 over and over
+     *
+     * The count wraps around every 55 ms, its reader must look at it more
+     * often to count the wraps. The countdowns of `startPitCountdown` can no
+     * longer be used, `waitMicroseconds` polls the clock instead.
+     */
+    void startPitFreeRunning()
+    {
+        const uint8_t control = inb(CONTROL_PORT)
+                                & ~(CONTROL_GATE | CONTROL_SPEAKER);
+        outb(CONTROL_PORT, control);
+        outb(COMMAND_PORT, CHANNEL2_PERIODIC);
+        outb(CHANNEL2_PORT, 0);
+        outb(CHANNEL2_PORT, 0);
+        outb(CONTROL_PORT, control | CONTROL_GATE);
+        isFreeRunning = true;
+    }
+
+    /**
+     * \brief Get the current count of channel 2 once `startPitFreeRunning`
+     * was called
+     *
+     * \return The count, going down by `PIT_FREQUENCY` per second
+     */
+    uint16_t getPitFreeRunningCount()
+    {
+        outb(COMMAND_PORT, CHANNEL2_LATCH);
+        const uint8_t low = inb(CHANNEL2_PORT);
+        const uint8_t high = inb(CHANNEL2_PORT);
+        return low | (high << 8);
+    }
+
+    /**
+     * \brief Make channel 0 raise IRQ0 `frequency` times per second
+     *
+     * \param frequency The number of interrupts per second (at least 19, the
+     * count is 16-bit)
+     */
+    void startPitPeriodic(uint32_t frequency)
+    {
+        const uint32_t count = PIT_FREQUENCY / frequency;
+
+        outb(COMMAND_PORT, CHANNEL0_PERIODIC);
+        outb(CHANNEL0_PORT, count & 0xFF);
+        outb(CHANNEL0_PORT, (count >> 8) & 0xFF);
+    }
+
+    /**
+     * \brief Make channel 0 raise IRQ0 once, after `count` PIT ticks
+     *
+     * The output of channel 0 stays high once the count reached 0, until
+     * the channel is programmed again.
+     *
+     * \param count The number of ticks (at `PIT_FREQUENCY`)
+     */
+    void startPitOneShot(uint16_t count)
+    {
+        outb(COMMAND_PORT, CHANNEL0_ONE_SHOT);
+        outb(CHANNEL0_PORT, count & 0xFF);
+        outb(CHANNEL0_PORT, count >> 8);
+    }
+
+    /**
+     * \brief Get the number of PIT ticks left before channel 0 raises IRQ0
+     *
+     * \return The current count of channel 0 (meaningless once a one-shot
+     * countdown is over, the counter keeps going)
+     */
+    uint16_t getPitCount()
+    {
+        outb(COMMAND_PORT, CHANNEL0_LATCH);
+        const uint8_t low = inb(CHANNEL0_PORT);
+        const uint8_t high = inb(CHANNEL0_PORT);
+        return low | (high << 8);
+    }
+
+    /**
+     * \brief Return true once the countdown started by `startPitOneShot` is
+     * over
+     *
+     * \return true if the count of channel 0 reached 0
+     */
+    bool isPitOneShotOver()
+    {
+        outb(COMMAND_PORT, CHANNEL0_READ_STATUS);
+        return inb(CHANNEL0_PORT) & STATUS_OUTPUT;
+    }
+}
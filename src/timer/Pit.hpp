@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * \brief Measure short durations with the programmable interval timer
+ *
+ * The channel 2 of the PIT (normally wired to the PC speaker) is the only one
+ * whose gate can be controlled and whose output can be read, through port
+ * 0x61. It is used as a one-shot countdown to calibrate the other timers and
+ * to wait before they are calibrated. When the time stamp counter cannot be
+ * trusted, it becomes a free-running counter instead, read by the clock
+ * (`startPitFreeRunning`), and the waits poll the clock. Channel 0 (IRQ0)
+ * is the tick when there is no local APIC: periodic, or one-shot while the
+ * processor is idle.
+ */
+namespace timer
+{
+    /// The frequency of the PIT in Hz
+    const uint32_t PIT_FREQUENCY = 1193182;
+
+    /// Start counting down `count` PIT ticks on channel 2
+    void startPitCountdown(uint16_t count);
+    /// Return true once the countdown started by `startPitCountdown` is over
+    bool isPitCountdownOver();
+    /// Stop the countdown of channel 2
+    void stopPitCountdown();
+    /// Make channel 2 count down from 65536 over and over
+    void startPitFreeRunning();
+    /// Get the current count of channel 2 once `startPitFreeRunning` was
+    /// called
+    uint16_t getPitFreeRunningCount();
+    /// Wait `microseconds` microseconds by polling the PIT
+    void waitMicroseconds(uint32_t microseconds);
+    /// Make channel 0 raise IRQ0 `frequency` times per second
+    void startPitPeriodic(uint32_t frequency);
+    /// Make channel 0 raise IRQ0 once, after `count` PIT ticks
+    void startPitOneShot(uint16_t count);
+    /// Get the number of PIT ticks left before channel 0 raises IRQ0
+    uint16_t getPitCount();
+    /// Return true once the countdown started by `startPitOneShot` is over
+    bool isPitOneShotOver();
+}
@@ -0,0 +1,550 @@
+#include "Timer.hpp"
+#include "Pit.hpp"
+#include "../acpi/Acpi.hpp"
+#include "../apic/LocalApic.hpp"
+#include "../interrupt.hpp"
+#include "../sched/Scheduler.hpp"
+#include "../smp/smp.hpp"
+#include "../sync/Spinlock.hpp"
+
+namespace timer
+{
+    static_assert(TICK_FREQUENCY % 1000 == 0,
+                  "The tick period is a fraction of a millisecond");
+
+    /// The longest time the tick of an idle processor stays stopped, in
+    /// ticks, even without timers
+    const uint32_t MAX_STOPPED_TICKS = TICK_FREQUENCY;
+    /// The largest count of the PIT
+    const uint32_t MAX_PIT_COUNT = 0xFFFF;
+    /// The largest count of the local APIC timer
+    const uint32_t MAX_LOCAL_APIC_COUNT = 0xFFFFFFFF;
+
+    /**
+     * \brief The tick and the timers of a processor
+     */
+    struct TimerWheel
+    {
+        /// Protect the wheel (interrupts are disabled while it is taken)
+        sync::Spinlock lock;
+        /// The first timer of each slot of each level
+        Timer* slots[TIMER_LEVEL_COUNT][TIMER_SLOT_COUNT];
+        /// Bit `n` of a level is set when its slot `n` is not empty
+        uint64_t slotMasks[TIMER_LEVEL_COUNT];
+        /// The expired timers whose callback is not run yet
+        Timer* expired;
+
+        /// The number of ticks since the tick started
+        uint64_t ticks;
+        /// The last tick whose timers were expired (`ticks` or a few ticks
+        /// behind, until `runTimers` catches up)
+        uint64_t wheelTicks;
+
+        /// The count of the hardware timer for a tick
+        uint32_t countPerTick;
+        /// The longest number of ticks `stopTick` can program
+        uint32_t maxStoppedTicks;
+        /// The count programmed by `stopTick`
+        uint32_t stoppedCount;
+        /// The count elapsed while the tick was stopped, short of a tick
+        uint32_t residue;
+        /// The number of times `stopTick` stopped the tick
+        uint32_t stopCount;
+        /// True if the tick is the local APIC timer, false for the PIT
+        bool isLocalApic;
+        /// True once `startTick` was called
+        bool isStarted;
+        /// True while the tick is stopped by `stopTick`
+        bool isStopped;
+    };
+
+    /// The wheel of each processor
+    static TimerWheel wheels[acpi::MAX_CPUS];
+
+    /**
+     * \brief Get the wheel of the calling processor
+     *
+     * \return The wheel of the processor
+     */
+    static TimerWheel& getWheel()
+    {
+        return wheels[smp::getCurrentCpu()->index];
+    }
+
+    /**
+     * \brief Add a timer to the slot of its deadline
+     *
+     * The level is the first one whose slots cover the delay, the slot is
+     * given by the bits of the deadline for this level. A delay longer than
+     * `MAX_TIMER_DELAY` waits in the last level and is put back when it is
+     * cascaded.
+     *
+     * \param wheel The wheel (locked)
+     * \param timer The timer, not pending, with a deadline not before
+     * `wheel.wheelTicks`
+     */
+    static void insertTimer(TimerWheel& wheel, Timer* timer)
+    {
+        uint64_t delay = timer->deadline - wheel.wheelTicks;
+        if (delay > MAX_TIMER_DELAY) {
+            delay = MAX_TIMER_DELAY;
+        }
+        const uint64_t expiry = wheel.wheelTicks + delay;
+
+        uint32_t level = 0;
+        while (level + 1 < TIMER_LEVEL_COUNT &&
+               (delay >> ((level + 1) * TIMER_LEVEL_BITS)) != 0) {
+            ++level;
+        }
+        const uint32_t slot = (expiry >> (level * TIMER_LEVEL_BITS))
+                              % TIMER_SLOT_COUNT;
+
+        Timer** head = &wheel.slots[level][slot];
+        timer->next = *head;
+        if (timer->next != nullptr) {
+            timer->next->link = &timer->next;
+        }
+        timer->link = head;
+        *head = timer;
+        wheel.slotMasks[level] |= (uint64_t) 1 << slot;
+    }
+
+    /**
+     * \brief Remove a timer from its slot or from the expired timers
+     *
+     * \param wheel The wheel holding the timer (locked)
+     * \param timer The pending timer
+     */
+    static void unlinkTimer(TimerWheel& wheel, Timer* timer)
+    {
+        *timer->link = timer->next;
+        if (timer->next != nullptr) {
+            timer->next->link = timer->link;
+        }
+
+        // The timer was the last one of its slot (the link is then the head
+        // of the slot, not the `next` of another timer)
+        const size_t index = ((uintptr_t) timer->link
+                              - (uintptr_t) &wheel.slots[0][0])
+                             / sizeof(Timer*);
+        if (index < TIMER_LEVEL_COUNT * TIMER_SLOT_COUNT &&
+            *timer->link == nullptr) {
+            wheel.slotMasks[index / TIMER_SLOT_COUNT] &=
+                ~((uint64_t) 1 << (index % TIMER_SLOT_COUNT));
+        }
+
+        timer->next = nullptr;
+        timer->link = nullptr;
+    }
+
+    /**
+     * \brief Empty a slot
+     *
+     * \param wheel The wheel (locked)
+     * \param level The level of the slot
+     * \param slot The index of the slot in its level
+     * \return The timers of the slot, linked by `next`
+     */
+    static Timer* takeSlot(TimerWheel& wheel, uint32_t level, uint32_t slot)
+    {
+        Timer* timers = wheel.slots[level][slot];
+        wheel.slots[level][slot] = nullptr;
+        wheel.slotMasks[level] &= ~((uint64_t) 1 << slot);
+        return timers;
+    }
+
+    /**
+     * \brief Expire the timers of the next tick of the wheel
+     *
+     * When the first levels wrap around, the timers of the next slot of the
+     * level above are cascaded: they are added again, to a lower level since
+     * their deadline is closer now. The timers of the slot of the tick then
+     * become the expired timers.
+     *
+     * \param wheel The wheel (locked, with no expired timer)
+     */
+    static void advanceWheel(TimerWheel& wheel)
+    {
+        const uint64_t tick = ++wheel.wheelTicks;
+
+        for (uint32_t level = 1; level < TIMER_LEVEL_COUNT; ++level) {
+            const uint32_t shift = level * TIMER_LEVEL_BITS;
+            if ((tick & (((uint64_t) 1 << shift) - 1)) != 0) {
+                break;
+            }
+
+            Timer* timer = takeSlot(wheel, level,
+                                    (tick >> shift) % TIMER_SLOT_COUNT);
+            while (timer != nullptr) {
+                Timer* next = timer->next;
+                insertTimer(wheel, timer);
+                timer = next;
+            }
+        }
+
+        wheel.expired = takeSlot(wheel, 0, tick % TIMER_SLOT_COUNT);
+        if (wheel.expired != nullptr) {
+            wheel.expired->link = &wheel.expired;
+        }
+    }
+
+    /**
+     * \brief Get the next tick at which the wheel has work to do
+     *
+     * The first non-empty slot of each level is found with a bit scan of its
+     * mask, rotated to start after the current slot. For the first level, it
+     * is the tick of the next expiry; for the others, the tick at which the
+     * slot is cascaded, which is never after the deadlines of its timers.
+     *
+     * \param wheel The wheel (locked)
+     * \return The tick, UINT64_MAX if the wheel is empty
+     */
+    static uint64_t getNextWheelTick(const TimerWheel& wheel)
+    {
+        uint64_t nextTick = UINT64_MAX;
+        for (uint32_t level = 0; level < TIMER_LEVEL_COUNT; ++level) {
+            const uint64_t mask = wheel.slotMasks[level];
+            if (mask == 0) {
+                continue;
+            }
+
+            const uint32_t shift = level * TIMER_LEVEL_BITS;
+            const uint64_t nextSlot = (wheel.wheelTicks >> shift) + 1;
+            const uint32_t start = nextSlot % TIMER_SLOT_COUNT;
+            const uint64_t rotated =
+                start == 0 ? mask
+                           : (mask >> start)
+                             | (mask << (TIMER_SLOT_COUNT - start));
+            // Two 32-bit scans, i686 has no 64-bit one
+            const uint32_t low = rotated;
+            const uint32_t distance =
+                low != 0 ? __builtin_ctz(low)
+                         : 32 + __builtin_ctz((uint32_t) (rotated >> 32));
+            const uint64_t tick = (nextSlot + distance) << shift;
+            if (tick < nextTick) {
+                nextTick = tick;
+            }
+        }
+
+        return nextTick;
+    }
+
+    /**
+     * \brief Run the expired timers of a processor
+     *
+     * The wheel catches up with the ticks counted since the last call, one
+     * tick at a time. The callbacks are run one at a time without the lock,
+     * so they can add or cancel timers (including their own).
+     *
+     * \param wheel The wheel of the calling processor (interrupts disabled)
+     */
+    static void runTimers(TimerWheel& wheel)
+    {
+        wheel.lock.lock();
+        while (true) {
+            if (wheel.expired != nullptr) {
+                Timer* timer = wheel.expired;
+                unlinkTimer(wheel, timer);
+                const TimerCallback callback = timer->callback;
+                void* context = timer->context;
+
+                wheel.lock.unlock();
+                callback(context);
+                wheel.lock.lock();
+            }
+            else if (wheel.wheelTicks < wheel.ticks) {
+                advanceWheel(wheel);
+            }
+            else {
+                break;
+            }
+        }
+        wheel.lock.unlock();
+    }
+
+    /**
+     * \brief Count a tick on the calling processor
+     *
+     * The expired timers are run, then the scheduler counts the tick of the
+     * running thread.
+     *
+     * \param frame The state of the interrupted code (unused)
+     * \param context Unused
+     */
+    static void handleTick(InterruptFrame& frame, void* context)
+    {
+        (void) frame;
+        (void) context;
+
+        TimerWheel& wheel = getWheel();
+        wheel.lock.lock();
+        ++wheel.ticks;
+        wheel.lock.unlock();
+
+        runTimers(wheel);
+        sched::Scheduler::getInstance().handleTick();
+    }
+
+    /**
+     * \brief Make the hardware timer of a processor raise a tick periodically
+     *
+     * \param wheel The wheel of the calling processor
+     */
+    static void startPeriodicTimer(const TimerWheel& wheel)
+    {
+        if (wheel.isLocalApic) {
+            apic::LocalApic::getInstance().startTimer(
+                TICK_VECTOR, wheel.countPerTick, true);
+        }
+        else {
+            startPitPeriodic(TICK_FREQUENCY);
+        }
+    }
+
+    /**
+     * \brief Start the periodic tick of the calling processor
+     *
+     * The local APIC timer is used when it is calibrated, the PIT otherwise
+     * (then there is a single processor).
+     */
+    void startTick()
+    {
+        TimerWheel& wheel = getWheel();
+        apic::LocalApic& localApic = apic::LocalApic::getInstance();
+        const uint32_t flags = wheel.lock.lockAndDisableInterrupts();
+
+        wheel.isLocalApic = localApic.isEnabled()
+                            && localApic.getTimerFrequency() > 0;
+        uint32_t maxCount;
+        if (wheel.isLocalApic) {
+            wheel.countPerTick = localApic.getTimerFrequency()
+                                 / (TICK_FREQUENCY / 1000);
+            maxCount = MAX_LOCAL_APIC_COUNT;
+            registerInterruptHandler(TICK_VECTOR, handleTick, nullptr);
+        }
+        else {
+            wheel.countPerTick = PIT_FREQUENCY / TICK_FREQUENCY;
+            maxCount = MAX_PIT_COUNT;
+            registerIrqHandler(0, handleTick, nullptr);
+        }
+
+        // The residue is added to the count of the stopped tick
+        wheel.maxStoppedTicks = (maxCount - wheel.countPerTick)
+                                / wheel.countPerTick;
+        if (wheel.maxStoppedTicks > MAX_STOPPED_TICKS) {
+            wheel.maxStoppedTicks = MAX_STOPPED_TICKS;
+        }
+
+        wheel.isStarted = true;
+        startPeriodicTimer(wheel);
+
+        wheel.lock.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Stop the periodic tick of the calling processor until the first
+     * timer
+     *
+     * Called by an idle processor right before it halts, with interrupts
+     * disabled. The hardware timer is programmed once, for the next tick at
+     * which the wheel has work to do (at most `MAX_STOPPED_TICKS` ahead). The
+     * tick is restarted by the next interrupt, whichever it is. Nothing is
+     * done if the wheel has work to do at the next tick anyway.
+     */
+    void stopTick()
+    {
+        TimerWheel& wheel = getWheel();
+        wheel.lock.lock();
+
+        if (wheel.isStarted && !wheel.isStopped) {
+            const uint64_t nextTick = getNextWheelTick(wheel);
+            if (nextTick > wheel.ticks + 1) {
+                uint64_t ticks = nextTick - wheel.ticks;
+                if (ticks > wheel.maxStoppedTicks) {
+                    ticks = wheel.maxStoppedTicks;
+                }
+
+                wheel.stoppedCount = ticks * wheel.countPerTick;
+                wheel.isStopped = true;
+                ++wheel.stopCount;
+                if (wheel.isLocalApic) {
+                    apic::LocalApic::getInstance().startTimer(
+                        TICK_VECTOR, wheel.stoppedCount, false);
+                }
+                else {
+                    startPitOneShot(wheel.stoppedCount);
+                }
+            }
+        }
+
+        wheel.lock.unlock();
+    }
+
+    /**
+     * \brief Restart the periodic tick of the calling processor after
+     * `stopTick`
+     *
+     * Called by `cHandleInterrupt` before the handlers, with interrupts
+     * disabled, so they see the current tick. The ticks elapsed since
+     * `stopTick` are read from the hardware timer and counted, with the
+     * fraction of a tick left kept for the next time. If the timer already
+     * expired, its interrupt is pending and counts the last tick itself.
+     * Nothing is done if the tick is not stopped.
+     */
+    void restartTick()
+    {
+        TimerWheel& wheel = getWheel();
+        if (!wheel.isStopped) {
+            return;
+        }
+
+        wheel.lock.lock();
+
+        uint32_t count;
+        bool isOver;
+        if (wheel.isLocalApic) {
+            count = apic::LocalApic::getInstance().getTimerCount();
+            isOver = count == 0;
+        }
+        else {
+            isOver = isPitOneShotOver();
+            count = isOver ? 0 : getPitCount();
+            // The countdown ended between the two reads and wrapped around
+            if (count > wheel.stoppedCount) {
+                isOver = true;
+            }
+        }
+        if (isOver) {
+            count = wheel.countPerTick;
+        }
+
+        wheel.residue += wheel.stoppedCount - count;
+        wheel.ticks += wheel.residue / wheel.countPerTick;
+        wheel.residue %= wheel.countPerTick;
+        wheel.isStopped = false;
+        startPeriodicTimer(wheel);
+
+        wheel.lock.unlock();
+    }
+
+    /**
+     * \brief Get the number of ticks of the calling processor
+     *
+     * \return The number of ticks (`TICK_FREQUENCY` per second)
+     */
+    uint64_t getTicks()
+    {
+        const uint32_t flags = saveAndDisableInterrupts();
+        const uint64_t ticks = getTicks(smp::getCurrentCpu()->index);
+        restoreInterrupts(flags);
+        return ticks;
+    }
+
+    /**
+     * \brief Get the number of ticks of a processor since its tick started
+     *
+     * The count never goes backward. While the tick of the processor is
+     * stopped, the count is the one of the `stopTick` call.
+     *
+     * \param cpuIndex The index of the processor
+     * \return The number of ticks (`TICK_FREQUENCY` per second)
+     */
+    uint64_t getTicks(size_t cpuIndex)
+    {
+        TimerWheel& wheel = wheels[cpuIndex];
+        const uint32_t flags = wheel.lock.lockAndDisableInterrupts();
+        const uint64_t ticks = wheel.ticks;
+        wheel.lock.unlockAndRestoreInterrupts(flags);
+        return ticks;
+    }
+
+    /**
+     * \brief Get the number of times the tick of a processor was stopped
+     *
+     * \param cpuIndex The index of the processor
+     * \return The number of `stopTick` calls that stopped the tick
+     */
+    uint32_t getTickStops(size_t cpuIndex)
+    {
+        return __atomic_load_n(&wheels[cpuIndex].stopCount, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Return true while the tick of a processor is stopped
+     *
+     * \param cpuIndex The index of the processor
+     * \return true from `stopTick` to `restartTick`
+     */
+    bool isTickStopped(size_t cpuIndex)
+    {
+        return __atomic_load_n(&wheels[cpuIndex].isStopped, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Run a function in `ticks` ticks on the calling processor
+     *
+     * The callback is run by the tick interrupt of the processor, with
+     * interrupts disabled: it must be short, like an interrupt handler. A
+     * pending timer is cancelled first, so a timer can be pushed back by
+     * adding it again.
+     *
+     * \param timer The timer, valid until it expires or is cancelled
+     * \param ticks The delay (at least 1, at most `MAX_TIMER_DELAY`, longer
+     * delays wait in the last level)
+     * \param callback The function to run
+     * \param context The argument of `callback`
+     */
+    void addTimer(Timer& timer, uint32_t ticks, TimerCallback callback,
+                  void* context)
+    {
+        cancelTimer(timer);
+
+        const uint32_t flags = saveAndDisableInterrupts();
+        const size_t cpuIndex = smp::getCurrentCpu()->index;
+        TimerWheel& wheel = wheels[cpuIndex];
+        wheel.lock.lock();
+
+        timer.deadline = wheel.ticks + (ticks > 0 ? ticks : 1);
+        timer.callback = callback;
+        timer.context = context;
+        timer.cpuIndex = cpuIndex;
+        insertTimer(wheel, &timer);
+
+        wheel.lock.unlockAndRestoreInterrupts(flags);
+    }
+
+    /**
+     * \brief Remove a pending timer
+     *
+     * A timer can be cancelled from any processor, but it must not be added
+     * by another one at the same time.
+     *
+     * \param timer The timer
+     * \return true if the timer was pending, false if its callback already
+     * ran (or is running) or it was never added
+     */
+    bool cancelTimer(Timer& timer)
+    {
+        TimerWheel& wheel = wheels[timer.cpuIndex];
+        const uint32_t flags = wheel.lock.lockAndDisableInterrupts();
+
+        const bool isPending = timer.link != nullptr;
+        if (isPending) {
+            unlinkTimer(wheel, &timer);
+        }
+
+        wheel.lock.unlockAndRestoreInterrupts(flags);
+        return isPending;
+    }
+
+    /**
+     * \brief Return true if a timer is waiting to expire
+     *
+     * \param timer The timer
+     * \return true until the callback of the timer is run or it is cancelled
+     */
+    bool isTimerPending(const Timer& timer)
+    {
+        return __atomic_load_n(&timer.link, __ATOMIC_RELAXED) != nullptr;
+    }
+}
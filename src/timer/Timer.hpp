@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The tick of the processors and the timers run by it.
+ *
+ * Every processor counts its own ticks (the local APIC timer, or channel 0 of
+ * the PIT without APIC) and runs its own timers. The timers wait on a
+ * hierarchical timing wheel: `TIMER_LEVEL_COUNT` levels of `TIMER_SLOT_COUNT`
+ * lists, the slots of each level covering `TIMER_SLOT_COUNT` times more
+ * ticks than the slots of the level below. A timer is added to the list of
+ * the slot of its deadline, and cancelled by unlinking it from that list:
+ * both are O(1) whatever the number of timers. When the first level wraps
+ * around, the timers of the next slot of the level above are moved down
+ * (cascaded), so each timer is only moved once per level.
+ *
+ * An idle processor stops its periodic tick (`stopTick`): the timer is
+ * programmed once, for the first deadline of the wheel, and the ticks missed
+ * meanwhile are counted from the elapsed time when it is restarted
+ * (`restartTick`) by the next interrupt or context switch.
+ *
+ * Example:
+ * \code
+ * timer::Timer blink = {};
+ * timer::addTimer(blink, 500, toggleCursor, &terminal);
+ * ...
+ * timer::cancelTimer(blink);
+ * \endcode
+ */
+namespace timer
+{
+    /// The number of ticks per second
+    const uint32_t TICK_FREQUENCY = 1000;
+    /// The vector of the local APIC timer interrupt
+    const uint8_t TICK_VECTOR     = 0x40;
+
+    /// The number of bits of the deadline used by each level of the wheel
+    const uint32_t TIMER_LEVEL_BITS  = 6;
+    /// The number of slots of each level of the wheel
+    const uint32_t TIMER_SLOT_COUNT  = 1 << TIMER_LEVEL_BITS;
+    /// The number of levels of the wheel
+    const uint32_t TIMER_LEVEL_COUNT = 4;
+    /// The longest delay of a timer in ticks (about 4 hours and a half),
+    /// longer delays wait in the last level until they get shorter
+    const uint32_t MAX_TIMER_DELAY =
+        (1 << (TIMER_LEVEL_BITS * TIMER_LEVEL_COUNT)) - 1;
+
+    /// A function run when a timer expires, with the context given to
+    /// `addTimer`
+    typedef void (*TimerCallback)(void* context);
+
+    /**
+     * \brief A function to run at a given tick
+     *
+     * The timer is owned by the caller and linked in the wheel of a
+     * processor while it is pending, so it must stay valid until it expires
+     * or is cancelled. A zeroed timer is not pending.
+     */
+    struct Timer
+    {
+        /// The next timer of the same slot
+        Timer* next;
+        /// The pointer to this timer in its slot (nullptr when not pending)
+        Timer** link;
+        /// The tick of the processor at which the timer expires
+        uint64_t deadline;
+        /// The function run when the timer expires
+        TimerCallback callback;
+        /// The argument of `callback`
+        void* context;
+        /// The processor whose wheel holds the timer
+        size_t cpuIndex;
+    };
+
+    /// Start the periodic tick of the calling processor
+    void startTick();
+    /// Stop the periodic tick of the calling processor until the first timer
+    void stopTick();
+    /// Restart the periodic tick of the calling processor after `stopTick`
+    void restartTick();
+
+    /// Get the number of ticks of the calling processor
+    uint64_t getTicks();
+    /// Get the number of ticks of a processor since its tick started
+    uint64_t getTicks(size_t cpuIndex);
+    /// Get the number of times the tick of a processor was stopped
+    uint32_t getTickStops(size_t cpuIndex);
+    /// Return true while the tick of a processor is stopped
+    bool isTickStopped(size_t cpuIndex);
+
+    /// Run a function in `ticks` ticks on the calling processor
+    void addTimer(Timer& timer, uint32_t ticks, TimerCallback callback,
+                  void* context);
+    /// Remove a pending timer
+    bool cancelTimer(Timer& timer);
+    /// Return true if a timer is waiting to expire
+    bool isTimerPending(const Timer& timer);
+}
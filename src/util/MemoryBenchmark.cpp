@@ -0,0 +1,89 @@
+#include "MemoryBenchmark.hpp"
+#include "../cpu/cpu.hpp"
+
+namespace util
+{
+    /// The number of bytes copied or filled by a round of a measure
+    const size_t ROUND_BYTES = 256 * 1024;
+    /// The number of rounds of a measure (the fastest one is kept)
+    const size_t ROUND_COUNT = 4;
+
+    /**
+     * \brief Measure the cycles of a round of copies
+     *
+     * \param routine The routine
+     * \param buffer The buffer (the first half is copied to the second one)
+     * \param size The number of bytes of a copy
+     * \param iterations The number of copies
+     * \return The number of TSC cycles
+     */
+    static uint64_t measureCopies(MemoryRoutine routine, uint8_t* buffer,
+                                  size_t size, size_t iterations)
+    {
+        const uint64_t start = cpu::readTsc();
+        for (size_t i = 0; i < iterations; ++i) {
+            copyMemory(routine, buffer + size, buffer, size);
+        }
+
+        return cpu::readTsc() - start;
+    }
+
+    /**
+     * \brief Measure the cycles of a round of fills
+     *
+     * \param routine The routine
+     * \param buffer The buffer (its first half is filled)
+     * \param size The number of bytes of a fill
+     * \param iterations The number of fills
+     * \return The number of TSC cycles
+     */
+    static uint64_t measureFills(MemoryRoutine routine, uint8_t* buffer,
+                                 size_t size, size_t iterations)
+    {
+        const uint64_t start = cpu::readTsc();
+        for (size_t i = 0; i < iterations; ++i) {
+            fillMemory(routine, buffer, i, size);
+        }
+
+        return cpu::readTsc() - start;
+    }
+
+    /**
+     * \brief Measure the bytes per cycle of the copies and fills of a routine
+     *
+     * `ROUND_BYTES` are copied (then filled) per round, `size` at a time,
+     * after a first copy to warm the caches up. The fastest of `ROUND_COUNT`
+     * rounds is kept, so an interrupt in a round does not count.
+     *
+     * \param routine The routine, which must be supported by the processor
+     * \param buffer A buffer of `2 * size` bytes
+     * \param size The number of bytes of a copy or a fill
+     * \return The bytes per 100 cycles of the copies and the fills
+     */
+    MemoryBenchmarkResult benchmarkMemoryRoutine(MemoryRoutine routine,
+                                                 void* buffer, size_t size)
+    {
+        uint8_t* bytes = (uint8_t*) buffer;
+        const size_t iterations = size < ROUND_BYTES ? ROUND_BYTES / size
+                                                     : 1;
+        copyMemory(routine, bytes + size, bytes, size);
+
+        uint64_t copyCycles = UINT64_MAX;
+        uint64_t fillCycles = UINT64_MAX;
+        for (size_t i = 0; i < ROUND_COUNT; ++i) {
+            const uint64_t copy = measureCopies(routine, bytes, size,
+                                                iterations);
+            const uint64_t fill = measureFills(routine, bytes, size,
+                                               iterations);
+            copyCycles = copy < copyCycles ? copy : copyCycles;
+            fillCycles = fill < fillCycles ? fill : fillCycles;
+        }
+
+        const uint64_t totalBytes = (uint64_t) size * iterations * 100;
+        MemoryBenchmarkResult result;
+        result.copyRate = totalBytes / (copyCycles > 0 ? copyCycles : 1);
+        result.fillRate = totalBytes / (fillCycles > 0 ? fillCycles : 1);
+
+        return result;
+    }
+}
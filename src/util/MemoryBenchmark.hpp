@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "string.hpp"
+
+namespace util
+{
+    /// The result of `benchmarkMemoryRoutine`
+    struct MemoryBenchmarkResult
+    {
+        /// The bytes copied per 100 TSC cycles
+        uint32_t copyRate;
+        /// The bytes filled per 100 TSC cycles
+        uint32_t fillRate;
+    };
+
+    /// The sizes measured by the kernel at boot, from every size class
+    const size_t MEMORY_BENCHMARK_SIZES[] = {32, 512, 8192, 65536};
+    /// The number of `MEMORY_BENCHMARK_SIZES`
+    const size_t MEMORY_BENCHMARK_SIZE_COUNT = 4;
+
+    /// Measure the bytes per cycle of the copies and fills of a routine
+    MemoryBenchmarkResult benchmarkMemoryRoutine(MemoryRoutine routine,
+                                                 void* buffer, size_t size);
+}
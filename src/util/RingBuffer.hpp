@@ -0,0 +1,499 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace util
+{
+    /**
+     * \brief Lock-free queue with one producer and one consumer
+     *
+     * The buffer holds `N` elements, `N` being a power of two. The indexes
+     * grow freely and are masked when accessing the buffer, so the whole
+     * capacity can be used and the number of elements is simply the
+     * difference of the indexes.
+     *
+     * The producer (`push`, `pushN`) only writes the write index and the
+     * consumer (`pop`, `popN`) only writes the read index. Each side publishes
+     * its index with a release store and reads the index of the other side
+     * with an acquire load: the elements are written before the consumer can
+     * see them, and read before the producer can overwrite them. This holds
+     * between an interrupt handler and the code it interrupts, and between
+     * processors.
+     *
+     * A full buffer never overwrites elements: the push fails and is counted
+     * in the overflow counter. The high-water mark is the largest number of
+     * elements the buffer held.
+     *
+     * Example:
+     * \code
+     * util::RingBuffer<uint8_t, 256> scancodes;
+     * // In the interrupt handler
+     * scancodes.push(inb(0x60));
+     * // In the main loop
+     * uint8_t scancode;
+     * while (scancodes.pop(scancode)) {
+     *     ...
+     * }
+     * \endcode
+     */
+    template <typename T, uint32_t N>
+    class RingBuffer
+    {
+        static_assert(N > 0 && (N & (N - 1)) == 0,
+                      "The capacity must be a power of two");
+
+    public:
+        /// The number of elements the buffer can hold
+        static const uint32_t CAPACITY = N;
+
+        /// Initialize an empty buffer
+        RingBuffer()
+            : readIndex_(0), writeIndex_(0), overflowCount_(0), highWater_(0)
+        {
+        }
+
+        /// Add an element (producer side)
+        bool push(const T& element);
+        /// Add up to `count` elements (producer side)
+        uint32_t pushN(const T* elements, uint32_t count);
+        /// Remove the oldest element (consumer side)
+        bool pop(T& element);
+        /// Remove up to `count` elements (consumer side)
+        uint32_t popN(T* elements, uint32_t count);
+
+        /// Return true if the buffer is empty
+        bool isEmpty() const;
+        /// Get the number of elements in the buffer
+        uint32_t getSize() const;
+        /// Get the number of elements that did not fit in the buffer
+        uint32_t getOverflowCount() const;
+        /// Get the largest number of elements the buffer held
+        uint32_t getHighWater() const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the indexes are shared between the producer and the consumer
+        RingBuffer(RingBuffer const&) = delete;
+        void operator=(RingBuffer const&) = delete;
+
+    private:
+        /// Count the elements that did not fit and update the high-water mark
+        void updateCounters(uint32_t size, uint32_t dropped);
+
+        /// The index of the next element to read (only moved by the consumer)
+        uint32_t readIndex_;
+        /// The index where the next element is written (only moved by the
+        /// producer)
+        uint32_t writeIndex_;
+        /// The number of elements that did not fit in the buffer
+        uint32_t overflowCount_;
+        /// The largest number of elements the buffer held
+        uint32_t highWater_;
+        /// The elements
+        T buffer_[N];
+    };
+
+    /**
+     * \brief Lock-free queue with several producers and one consumer
+     *
+     * The buffer holds `N` elements, `N` being a power of two. Each slot has
+     * a sequence number telling whether it is free for the producer of a
+     * given position or filled for the consumer. Producers reserve a position
+     * with a compare-and-swap on the write index, fill the slot and then
+     * publish it with a release store of its sequence number, so a slow
+     * producer never lets the consumer read a slot that is being written.
+     *
+     * Producers can run on different processors or interrupt each other. A
+     * full buffer never overwrites elements: the push fails and is counted in
+     * the overflow counter.
+     */
+    template <typename T, uint32_t N>
+    class MpscRingBuffer
+    {
+        static_assert(N > 0 && (N & (N - 1)) == 0,
+                      "The capacity must be a power of two");
+
+    public:
+        /// The number of elements the buffer can hold
+        static const uint32_t CAPACITY = N;
+
+        /// Initialize an empty buffer
+        MpscRingBuffer();
+
+        /// Add an element (any producer)
+        bool push(const T& element);
+        /// Add up to `count` elements (any producer)
+        uint32_t pushN(const T* elements, uint32_t count);
+        /// Remove the oldest element (consumer side)
+        bool pop(T& element);
+        /// Remove up to `count` elements (consumer side)
+        uint32_t popN(T* elements, uint32_t count);
+
+        /// Return true if the buffer is empty
+        bool isEmpty() const;
+        /// Get the number of elements that did not fit in the buffer
+        uint32_t getOverflowCount() const;
+        /// Get the largest number of elements the buffer held
+        uint32_t getHighWater() const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the indexes are shared between the producers and the
+        /// consumer
+        MpscRingBuffer(MpscRingBuffer const&) = delete;
+        void operator=(MpscRingBuffer const&) = delete;
+
+    private:
+        /// A slot of the buffer
+        struct Slot
+        {
+            /// The position the slot is free for (equal to the position) or
+            /// filled for (position + 1)
+            uint32_t sequence;
+            /// The element
+            T element;
+        };
+
+        /// The index of the next element to read (only moved by the consumer)
+        uint32_t readIndex_;
+        /// The index of the next position to reserve by a producer
+        uint32_t writeIndex_;
+        /// The number of elements that did not fit in the buffer
+        uint32_t overflowCount_;
+        /// The largest number of elements the buffer held
+        uint32_t highWater_;
+        /// The slots
+        Slot slots_[N];
+    };
+
+    /**
+     * \brief Add an element (producer side)
+     *
+     * \param element The element to add
+     * \return false if the buffer is full (the element is counted in the
+     * overflow counter)
+     */
+    template <typename T, uint32_t N>
+    bool RingBuffer<T, N>::push(const T& element)
+    {
+        return pushN(&element, 1) == 1;
+    }
+
+    /**
+     * \brief Add up to `count` elements (producer side)
+     *
+     * The elements that fit are published at once. The others are counted in
+     * the overflow counter.
+     *
+     * \param elements A pointer to the elements to add
+     * \param count The number of elements to add
+     * \return The number of elements added
+     */
+    template <typename T, uint32_t N>
+    uint32_t RingBuffer<T, N>::pushN(const T* elements, uint32_t count)
+    {
+        const uint32_t writeIndex = __atomic_load_n(&writeIndex_,
+                                                    __ATOMIC_RELAXED);
+        // Acquire: the consumer is done with the slots it released
+        const uint32_t readIndex = __atomic_load_n(&readIndex_,
+                                                   __ATOMIC_ACQUIRE);
+        const uint32_t available = N - (writeIndex - readIndex);
+        const uint32_t pushed = count < available ? count : available;
+
+        for (uint32_t i = 0; i < pushed; ++i) {
+            buffer_[(writeIndex + i) & (N - 1)] = elements[i];
+        }
+        // Release: the elements are written before the consumer sees them
+        __atomic_store_n(&writeIndex_, writeIndex + pushed, __ATOMIC_RELEASE);
+
+        updateCounters(writeIndex + pushed - readIndex, count - pushed);
+
+        return pushed;
+    }
+
+    /**
+     * \brief Remove the oldest element (consumer side)
+     *
+     * \param element The removed element
+     * \return false if the buffer is empty
+     */
+    template <typename T, uint32_t N>
+    bool RingBuffer<T, N>::pop(T& element)
+    {
+        return popN(&element, 1) == 1;
+    }
+
+    /**
+     * \brief Remove up to `count` elements (consumer side)
+     *
+     * \param elements A pointer where to copy the removed elements
+     * \param count The maximum number of elements to remove
+     * \return The number of elements removed
+     */
+    template <typename T, uint32_t N>
+    uint32_t RingBuffer<T, N>::popN(T* elements, uint32_t count)
+    {
+        const uint32_t readIndex = __atomic_load_n(&readIndex_,
+                                                   __ATOMIC_RELAXED);
+        // Acquire: the elements published by the producer are visible
+        const uint32_t writeIndex = __atomic_load_n(&writeIndex_,
+                                                    __ATOMIC_ACQUIRE);
+        const uint32_t size = writeIndex - readIndex;
+        const uint32_t popped = count < size ? count : size;
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            elements[i] = buffer_[(readIndex + i) & (N - 1)];
+        }
+        // Release: the elements are read before the producer reuses the slots
+        __atomic_store_n(&readIndex_, readIndex + popped, __ATOMIC_RELEASE);
+
+        return popped;
+    }
+
+    /**
+     * \brief Return true if the buffer is empty
+     *
+     * \return true if the buffer is empty
+     */
+    template <typename T, uint32_t N>
+    bool RingBuffer<T, N>::isEmpty() const
+    {
+        return getSize() == 0;
+    }
+
+    /**
+     * \brief Get the number of elements in the buffer
+     *
+     * \return The number of elements in the buffer (it can change right after
+     * if the other side is running)
+     */
+    template <typename T, uint32_t N>
+    uint32_t RingBuffer<T, N>::getSize() const
+    {
+        return __atomic_load_n(&writeIndex_, __ATOMIC_ACQUIRE)
+               - __atomic_load_n(&readIndex_, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * \brief Get the number of elements that did not fit in the buffer
+     *
+     * \return The number of elements that did not fit in the buffer
+     */
+    template <typename T, uint32_t N>
+    uint32_t RingBuffer<T, N>::getOverflowCount() const
+    {
+        return __atomic_load_n(&overflowCount_, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Get the largest number of elements the buffer held
+     *
+     * \return The high-water mark of the buffer
+     */
+    template <typename T, uint32_t N>
+    uint32_t RingBuffer<T, N>::getHighWater() const
+    {
+        return __atomic_load_n(&highWater_, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Count the elements that did not fit and update the high-water
+     * mark
+     *
+     * Only the producer writes the counters, so plain read-modify-write is
+     * enough (the stores are atomic for the readers).
+     *
+     * \param size The number of elements in the buffer after a push
+     * \param dropped The number of elements that did not fit
+     */
+    template <typename T, uint32_t N>
+    void RingBuffer<T, N>::updateCounters(uint32_t size, uint32_t dropped)
+    {
+        if (dropped > 0) {
+            __atomic_store_n(&overflowCount_, overflowCount_ + dropped,
+                             __ATOMIC_RELAXED);
+        }
+        if (size > highWater_) {
+            __atomic_store_n(&highWater_, size, __ATOMIC_RELAXED);
+        }
+    }
+
+    /**
+     * \brief Initialize an empty buffer
+     *
+     * Every slot is free for the position of the same index.
+     */
+    template <typename T, uint32_t N>
+    MpscRingBuffer<T, N>::MpscRingBuffer()
+        : readIndex_(0), writeIndex_(0), overflowCount_(0), highWater_(0)
+    {
+        for (uint32_t i = 0; i < N; ++i) {
+            slots_[i].sequence = i;
+        }
+    }
+
+    /**
+     * \brief Add an element (any producer)
+     *
+     * \param element The element to add
+     * \return false if the buffer is full (the element is counted in the
+     * overflow counter)
+     */
+    template <typename T, uint32_t N>
+    bool MpscRingBuffer<T, N>::push(const T& element)
+    {
+        uint32_t position = __atomic_load_n(&writeIndex_, __ATOMIC_RELAXED);
+        Slot* slot;
+
+        while (true) {
+            slot = &slots_[position & (N - 1)];
+            // Acquire: the consumer is done with the slot if it is free
+            int32_t difference = (int32_t) (__atomic_load_n(&slot->sequence,
+                                                            __ATOMIC_ACQUIRE)
+                                            - position);
+
+            if (difference == 0) {
+                // The slot is free, reserve the position (on failure,
+                // `position` is updated with the current write index)
+                if (__atomic_compare_exchange_n(&writeIndex_, &position,
+                                                position + 1, true,
+                                                __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                // The slot still holds the element of the previous round: the
+                // buffer is full
+                __atomic_fetch_add(&overflowCount_, 1, __ATOMIC_RELAXED);
+                return false;
+            }
+            else {
+                // Another producer reserved the position
+                position = __atomic_load_n(&writeIndex_, __ATOMIC_RELAXED);
+            }
+        }
+
+        slot->element = element;
+        // Release: the element is written before the consumer sees the slot
+        __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+
+        // Update the high-water mark (approximate, the consumer may be
+        // running)
+        uint32_t size = position + 1 - __atomic_load_n(&readIndex_,
+                                                       __ATOMIC_RELAXED);
+        uint32_t highWater = __atomic_load_n(&highWater_, __ATOMIC_RELAXED);
+        while (size > highWater &&
+               !__atomic_compare_exchange_n(&highWater_, &highWater, size,
+                                            true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            ;
+
+        return true;
+    }
+
+    /**
+     * \brief Add up to `count` elements (any producer)
+     *
+     * The elements are reserved one by one, so elements from other producers
+     * can be interleaved with them.
+     *
+     * \param elements A pointer to the elements to add
+     * \param count The number of elements to add
+     * \return The number of elements added
+     */
+    template <typename T, uint32_t N>
+    uint32_t MpscRingBuffer<T, N>::pushN(const T* elements, uint32_t count)
+    {
+        uint32_t pushed = 0;
+        while (pushed < count && push(elements[pushed])) {
+            ++pushed;
+        }
+
+        if (pushed < count) {
+            // The first failed push was already counted
+            __atomic_fetch_add(&overflowCount_, count - pushed - 1,
+                               __ATOMIC_RELAXED);
+        }
+
+        return pushed;
+    }
+
+    /**
+     * \brief Remove the oldest element (consumer side)
+     *
+     * \param element The removed element
+     * \return false if the buffer is empty (or if the oldest element is still
+     * being written by its producer)
+     */
+    template <typename T, uint32_t N>
+    bool MpscRingBuffer<T, N>::pop(T& element)
+    {
+        const uint32_t position = readIndex_;
+        Slot& slot = slots_[position & (N - 1)];
+
+        // Acquire: the element written by the producer is visible
+        if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != position + 1) {
+            return false;
+        }
+
+        element = slot.element;
+        // Release: the element is read before a producer reuses the slot
+        __atomic_store_n(&slot.sequence, position + N, __ATOMIC_RELEASE);
+        __atomic_store_n(&readIndex_, position + 1, __ATOMIC_RELAXED);
+
+        return true;
+    }
+
+    /**
+     * \brief Remove up to `count` elements (consumer side)
+     *
+     * \param elements A pointer where to copy the removed elements
+     * \param count The maximum number of elements to remove
+     * \return The number of elements removed
+     */
+    template <typename T, uint32_t N>
+    uint32_t MpscRingBuffer<T, N>::popN(T* elements, uint32_t count)
+    {
+        uint32_t popped = 0;
+        while (popped < count && pop(elements[popped])) {
+            ++popped;
+        }
+
+        return popped;
+    }
+
+    /**
+     * \brief Return true if the buffer is empty
+     *
+     * \return true if no element is ready to be removed
+     */
+    template <typename T, uint32_t N>
+    bool MpscRingBuffer<T, N>::isEmpty() const
+    {
+        const uint32_t position = readIndex_;
+        return __atomic_load_n(&slots_[position & (N - 1)].sequence,
+                               __ATOMIC_ACQUIRE) != position + 1;
+    }
+
+    /**
+     * \brief Get the number of elements that did not fit in the buffer
+     *
+     * \return The number of elements that did not fit in the buffer
+     */
+    template <typename T, uint32_t N>
+    uint32_t MpscRingBuffer<T, N>::getOverflowCount() const
+    {
+        return __atomic_load_n(&overflowCount_, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Get the largest number of elements the buffer held
+     *
+     * \return The high-water mark of the buffer
+     */
+    template <typename T, uint32_t N>
+    uint32_t MpscRingBuffer<T, N>::getHighWater() const
+    {
+        return __atomic_load_n(&highWater_, __ATOMIC_RELAXED);
+    }
+}
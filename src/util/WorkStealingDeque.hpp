@@ -0,0 +1,181 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace util
+{
+    /**
+     * \brief Lock-free Chase-Lev work-stealing deque
+     *
+     * The owner pushes and pops elements at the bottom, like a stack, so it
+     * keeps working on the most recent (cache-hot) elements. Thieves take the
+     * oldest elements at the top. The owner only synchronizes with the
+     * thieves when the deque holds a single element: `pop` and `steal` then
+     * race with a compare-and-swap on the top index.
+     *
+     * The deque holds `N` elements, `N` being a power of two, and does not
+     * grow: `push` fails when it is full (the caller runs the work itself).
+     * The indexes grow freely and are compared through their signed
+     * difference.
+     *
+     * `push` and `pop` must not run concurrently: the owner is a single
+     * thread, or a single processor with interrupts disabled. `steal` can be
+     * called by any number of processors. A thief may read an element that
+     * the owner is overwriting, but then its compare-and-swap fails and the
+     * element is discarded, so `T` must be a plain copyable structure.
+     *
+     * Example:
+     * \code
+     * util::WorkStealingDeque<Task, 256> deque;
+     * // Owner
+     * deque.push(task);
+     * if (deque.pop(task)) { ... }
+     * // Any other processor
+     * if (deque.steal(task)) { ... }
+     * \endcode
+     */
+    template <typename T, uint32_t N>
+    class WorkStealingDeque
+    {
+        static_assert(N > 0 && (N & (N - 1)) == 0,
+                      "The capacity must be a power of two");
+
+    public:
+        /// The number of elements the deque can hold
+        static const uint32_t CAPACITY = N;
+
+        /// Initialize an empty deque
+        WorkStealingDeque()
+            : top_(0), bottom_(0)
+        {
+        }
+
+        /// Add an element at the bottom (owner side)
+        bool push(const T& element);
+        /// Remove the element at the bottom (owner side)
+        bool pop(T& element);
+        /// Remove the element at the top (any processor)
+        bool steal(T& element);
+
+        /// Get the number of elements (a snapshot)
+        uint32_t getSize() const;
+
+        /// The copy constructor and copy assignment operator are deleted
+        /// since the indexes are shared between the owner and the thieves
+        WorkStealingDeque(WorkStealingDeque const&) = delete;
+        void operator=(WorkStealingDeque const&) = delete;
+
+    private:
+        /// The index of the oldest element (moved by the thieves, and by the
+        /// owner taking the last element)
+        uint32_t top_;
+        /// The index after the newest element (only moved by the owner)
+        uint32_t bottom_;
+        /// The elements
+        T buffer_[N];
+    };
+
+    /**
+     * \brief Add an element at the bottom (owner side)
+     *
+     * \param element The element to add
+     * \return false if the deque is full
+     */
+    template <typename T, uint32_t N>
+    bool WorkStealingDeque<T, N>::push(const T& element)
+    {
+        const uint32_t bottom = __atomic_load_n(&bottom_, __ATOMIC_RELAXED);
+        const uint32_t top = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+        if ((int32_t) (bottom - top) >= (int32_t) N) {
+            return false;
+        }
+
+        buffer_[bottom & (N - 1)] = element;
+        // Release: the element is written before a thief can see it
+        __atomic_store_n(&bottom_, bottom + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+    /**
+     * \brief Remove the element at the bottom (owner side)
+     *
+     * The bottom index is decremented first, so that the thieves stop before
+     * the element, then the top index is read: if the element is the last
+     * one, the owner and the thieves race for it on the top index.
+     *
+     * \param element Set to the removed element
+     * \return false if the deque is empty (or a thief took the last element)
+     */
+    template <typename T, uint32_t N>
+    bool WorkStealingDeque<T, N>::pop(T& element)
+    {
+        const uint32_t bottom = __atomic_load_n(&bottom_, __ATOMIC_RELAXED)
+                                - 1;
+        __atomic_store_n(&bottom_, bottom, __ATOMIC_RELAXED);
+        // The store of the bottom index must be visible before the top index
+        // is read (a store-load ordering, which only a full fence gives)
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint32_t top = __atomic_load_n(&top_, __ATOMIC_RELAXED);
+
+        if ((int32_t) (bottom - top) < 0) {
+            // Empty
+            __atomic_store_n(&bottom_, bottom + 1, __ATOMIC_RELAXED);
+            return false;
+        }
+
+        element = buffer_[bottom & (N - 1)];
+        if (bottom != top) {
+            // More than one element, no thief can reach this one
+            return true;
+        }
+
+        // The last element, take it from the thieves
+        const bool isTaken = __atomic_compare_exchange_n(
+            &top_, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&bottom_, bottom + 1, __ATOMIC_RELAXED);
+
+        return isTaken;
+    }
+
+    /**
+     * \brief Remove the element at the top (any processor)
+     *
+     * \param element Set to the removed element
+     * \return false if the deque is empty or if another processor took the
+     * element first
+     */
+    template <typename T, uint32_t N>
+    bool WorkStealingDeque<T, N>::steal(T& element)
+    {
+        uint32_t top = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+        // The top index must be read before the bottom index (see `pop`)
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        const uint32_t bottom = __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE);
+
+        if ((int32_t) (bottom - top) <= 0) {
+            return false;
+        }
+
+        element = buffer_[top & (N - 1)];
+        return __atomic_compare_exchange_n(&top_, &top, top + 1, false,
+                                           __ATOMIC_SEQ_CST,
+                                           __ATOMIC_RELAXED);
+    }
+
+    /**
+     * \brief Get the number of elements
+     *
+     * \return The number of elements when the indexes were read (it may
+     * already be different)
+     */
+    template <typename T, uint32_t N>
+    uint32_t WorkStealingDeque<T, N>::getSize() const
+    {
+        const uint32_t bottom = __atomic_load_n(&bottom_, __ATOMIC_RELAXED);
+        const uint32_t top = __atomic_load_n(&top_, __ATOMIC_RELAXED);
+        const int32_t size = (int32_t) (bottom - top);
+        return size > 0 ? size : 0;
+    }
+}
@@ -0,0 +1,359 @@
+#include "format.hpp"
+
+namespace util
+{
+    /// The two digits of the numbers from 0 to 99
+    struct DigitPairs
+    {
+        char digits[200];
+    };
+
+    /**
+     * \brief Build the digits of the numbers from 0 to 99
+     *
+     * \return "00", "01", ... "99" without separators
+     */
+    static constexpr DigitPairs makeDigitPairs()
+    {
+        DigitPairs pairs = {};
+        for (size_t i = 0; i < 100; ++i) {
+            pairs.digits[2 * i] = '0' + i / 10;
+            pairs.digits[2 * i + 1] = '0' + i % 10;
+        }
+
+        return pairs;
+    }
+
+    /// The decimal numbers are written two digits per division
+    static constexpr DigitPairs DIGIT_PAIRS = makeDigitPairs();
+    static_assert(DIGIT_PAIRS.digits[0] == '0' &&
+                  DIGIT_PAIRS.digits[85] == '2' &&
+                  DIGIT_PAIRS.digits[199] == '9',
+                  "The digit pairs are wrong");
+
+    /// The hexadecimal digits in lowercase and uppercase
+    static const char LOWER_NIBBLES[] = "0123456789abcdef";
+    static const char UPPER_NIBBLES[] = "0123456789ABCDEF";
+
+    /// The largest number of characters of a number (a 64-bit decimal)
+    const size_t NUMBER_SIZE = 24;
+
+    /**
+     * \brief Write a number in decimal, from its last digit
+     *
+     * \param value The number
+     * \param end The character after the last digit
+     * \return The first digit
+     */
+    static char* writeDecimal(uint32_t value, char* end)
+    {
+        while (value >= 100) {
+            const uint32_t pair = (value % 100) * 2;
+            value /= 100;
+            *--end = DIGIT_PAIRS.digits[pair + 1];
+            *--end = DIGIT_PAIRS.digits[pair];
+        }
+
+        if (value >= 10) {
+            *--end = DIGIT_PAIRS.digits[value * 2 + 1];
+            *--end = DIGIT_PAIRS.digits[value * 2];
+        }
+        else {
+            *--end = '0' + value;
+        }
+
+        return end;
+    }
+
+    /**
+     * \brief Write a 64-bit number in decimal, from its last digit
+     *
+     * The number is divided by 10^8 until it fits 32 bits, so most of the
+     * divisions are the 32-bit ones of `writeDecimal`.
+     *
+     * \param value The number
+     * \param end The character after the last digit
+     * \return The first digit
+     */
+    static char* writeDecimal(uint64_t value, char* end)
+    {
+        while (value > 0xFFFFFFFF) {
+            const uint64_t quotient = value / 100000000;
+            uint32_t chunk = value - quotient * 100000000;
+            for (size_t i = 0; i < 4; ++i) {
+                const uint32_t pair = (chunk % 100) * 2;
+                chunk /= 100;
+                *--end = DIGIT_PAIRS.digits[pair + 1];
+                *--end = DIGIT_PAIRS.digits[pair];
+            }
+            value = quotient;
+        }
+
+        return writeDecimal((uint32_t) value, end);
+    }
+
+    /**
+     * \brief Write a number in hexadecimal, from its last digit
+     *
+     * \param value The number
+     * \param end The character after the last digit
+     * \param nibbles The digits (`LOWER_NIBBLES` or `UPPER_NIBBLES`)
+     * \return The first digit
+     */
+    static char* writeHexadecimal(uint64_t value, char* end,
+                                  const char* nibbles)
+    {
+        do {
+            *--end = nibbles[value & 0xF];
+            value >>= 4;
+        } while (value != 0);
+
+        return end;
+    }
+
+    /// The characters written by `formatArguments`
+    class FormatWriter
+    {
+    public:
+        /// Write into a buffer of `size` characters (at least 1)
+        FormatWriter(char* buffer, size_t size)
+            : position_(buffer), end_(buffer + size - 1)
+        {
+        }
+
+        /// Add a character if there is room
+        void put(char character)
+        {
+            if (position_ != end_) {
+                *position_++ = character;
+            }
+        }
+
+        /// Add characters, as many as there is room for
+        void put(const char* data, size_t size)
+        {
+            for (size_t i = 0; i < size && position_ != end_; ++i) {
+                *position_++ = data[i];
+            }
+        }
+
+        /// Add a character several times
+        void pad(char character, size_t count)
+        {
+            for (size_t i = 0; i < count && position_ != end_; ++i) {
+                *position_++ = character;
+            }
+        }
+
+        /// Add a null-terminated string, as much as there is room for
+        void putString(const char* string)
+        {
+            while (*string != '\0' && position_ != end_) {
+                *position_++ = *string++;
+            }
+        }
+
+        /// End the string and get the end of the text
+        char* finish()
+        {
+            *position_ = '\0';
+            return position_;
+        }
+
+    private:
+        char* position_;
+        char* const end_;
+    };
+
+    /**
+     * \brief Write an argument as specified by its replacement field
+     *
+     * The text of a number is built from its last digit in a small buffer,
+     * then copied with the padding; a string is copied directly.
+     *
+     * \param writer The output
+     * \param specification The specification of the field
+     * \param argument The argument (its conversion was checked)
+     */
+    static void formatArgument(FormatWriter& writer,
+                               const FormatSpecification& specification,
+                               const FormatArgument& argument)
+    {
+        char number[NUMBER_SIZE];
+        char* const numberEnd = number + NUMBER_SIZE;
+        const char* text = nullptr;
+        size_t length = 0;
+        const char* prefix = "";
+        size_t prefixLength = 0;
+
+        char conversion = specification.conversion;
+        if (conversion == '\0') {
+            switch (argument.type) {
+                case FormatType::CHAR:
+                    conversion = 'c';
+                    break;
+                case FormatType::BOOL:
+                case FormatType::STRING:
+                    conversion = 's';
+                    break;
+                case FormatType::POINTER:
+                    conversion = 'p';
+                    break;
+                default:
+                    conversion = 'd';
+                    break;
+            }
+        }
+
+        const bool is64Bit = argument.type == FormatType::SIGNED_64 ||
+                             argument.type == FormatType::UNSIGNED_64;
+        switch (conversion) {
+            case 'd':
+                if (argument.type == FormatType::SIGNED &&
+                    (int32_t) argument.value < 0) {
+                    text = writeDecimal(-argument.value, numberEnd);
+                    prefix = "-";
+                    prefixLength = 1;
+                }
+                else if (argument.type == FormatType::SIGNED_64 &&
+                           (int64_t) argument.value64 < 0) {
+                    text = writeDecimal(-argument.value64, numberEnd);
+                    prefix = "-";
+                    prefixLength = 1;
+                }
+                else if (is64Bit) {
+                    text = writeDecimal(argument.value64, numberEnd);
+                }
+                else {
+                    text = writeDecimal(argument.value, numberEnd);
+                }
+                length = numberEnd - text;
+                break;
+            case 'x':
+            case 'X': {
+                uint64_t value = argument.value;
+                if (is64Bit) {
+                    value = argument.value64;
+                }
+                else if (argument.type == FormatType::POINTER) {
+                    value = (uintptr_t) argument.pointer;
+                }
+                text = writeHexadecimal(value, numberEnd,
+                                        conversion == 'x' ? LOWER_NIBBLES
+                                                          : UPPER_NIBBLES);
+                length = numberEnd - text;
+                if (specification.hasPrefix) {
+                    prefix = "0x";
+                    prefixLength = 2;
+                }
+                break;
+            }
+            case 'p': {
+                const uintptr_t address =
+                    argument.type == FormatType::STRING
+                        ? (uintptr_t) argument.string
+                        : (uintptr_t) argument.pointer;
+                char* digits = writeHexadecimal(address, numberEnd,
+                                                LOWER_NIBBLES);
+                while (digits > numberEnd - 2 * sizeof(uintptr_t)) {
+                    *--digits = '0';
+                }
+                text = digits;
+                length = numberEnd - text;
+                prefix = "0x";
+                prefixLength = 2;
+                break;
+            }
+            case 'c':
+                number[0] = argument.value;
+                text = number;
+                length = 1;
+                break;
+            default:
+                if (argument.type == FormatType::BOOL) {
+                    text = argument.value ? "true" : "false";
+                    length = argument.value ? 4 : 5;
+                }
+                else {
+                    text = argument.string != nullptr ? argument.string
+                                                      : "(null)";
+                    if (specification.width == 0) {
+                        writer.putString(text);
+                        return;
+                    }
+                    while (text[length] != '\0') {
+                        ++length;
+                    }
+                }
+                break;
+        }
+
+        const size_t size = prefixLength + length;
+        const size_t padding = specification.width > size
+                                   ? specification.width - size
+                                   : 0;
+        if (specification.isLeftAligned) {
+            writer.put(prefix, prefixLength);
+            writer.put(text, length);
+            writer.pad(' ', padding);
+        }
+        else if (specification.fill == '0') {
+            writer.put(prefix, prefixLength);
+            writer.pad('0', padding);
+            writer.put(text, length);
+        }
+        else {
+            writer.pad(' ', padding);
+            writer.put(prefix, prefixLength);
+            writer.put(text, length);
+        }
+    }
+
+    /**
+     * \brief Write arguments with a format string already checked
+     *
+     * This is the engine behind `format`, for the callers that keep the
+     * arguments apart from the call (the records of `KernelLogger`). The
+     * string and the types of the arguments must pass `checkFormat`.
+     *
+     * \param buffer The buffer
+     * \param size The size of the buffer, at least 1 (the text is cut to
+     * `size - 1` characters and always null-terminated)
+     * \param format The format string
+     * \param arguments The arguments of the fields
+     * \param count The number of arguments
+     * \return The number of characters written (without the null character)
+     */
+    size_t formatArguments(char* buffer, size_t size, const char* format,
+                           const FormatArgument* arguments, size_t count)
+    {
+        FormatWriter writer(buffer, size);
+        size_t argument = 0;
+
+        for (size_t i = 0; format[i] != '\0'; ++i) {
+            const char character = format[i];
+            if ((character == '{' || character == '}') &&
+                format[i + 1] == character) {
+                writer.put(character);
+                ++i;
+                continue;
+            }
+            if (character != '{') {
+                writer.put(character);
+                continue;
+            }
+
+            FormatSpecification specification = {false, false, ' ', 0, '\0'};
+            const size_t end = parseFormatSpecification(format, i + 1,
+                                                        specification);
+            if (end == 0 || argument == count) {
+                break;
+            }
+
+            formatArgument(writer, specification, arguments[argument++]);
+            i = end;
+        }
+
+        return writer.finish() - buffer;
+    }
+}
@@ -0,0 +1,498 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Wrap a string literal so that `util::format` can check it at compile
+ * time
+ *
+ * The string becomes the result of a constexpr function of a new type, which
+ * the function templates taking it read in a `static_assert`.
+ */
+#define FORMAT(string)                                                      \
+    [] {                                                                    \
+        struct FormatString                                                 \
+        {                                                                   \
+            static constexpr const char* get() { return string; }          \
+        };                                                                  \
+        return FormatString();                                              \
+    }()
+
+/**
+ * The formatting of the kernel, used by the logger, the terminal and the
+ * statistics dumps.
+ *
+ * A format string is text with a replacement field `{}` per argument (`{{`
+ * and `}}` are literal braces). A field can have a specification after a
+ * colon: `{:[-][#][0][width][conversion]}`.
+ *
+ * - `-` aligns the value on the left of the width (on the right otherwise)
+ * - `#` adds 0x before a hexadecimal number
+ * - `0` pads with zeros after the sign or 0x instead of spaces on the left
+ * - `width` is the smallest number of characters of the field (at most 64)
+ * - `conversion` is `d` (decimal), `x` or `X` (hexadecimal), `c`
+ *   (character), `s` (string or boolean) or `p` (pointer, 0x and 8 digits)
+ *
+ * Without conversion, integers are decimal, booleans are true or false,
+ * characters and strings are copied and pointers use `p`.
+ *
+ * Example:
+ * \code
+ * char line[64];
+ * util::format(line, sizeof(line), FORMAT("{} frames at {:p}, flags {:#06x}"),
+ *              count, address, flags);
+ * \endcode
+ *
+ * The string is parsed at compile time against the types of the arguments:
+ * a wrong number of arguments, an unsupported type or a conversion that does
+ * not fit the type do not compile. The text is then written in a single pass
+ * over the format string into the buffer of the caller.
+ */
+namespace util
+{
+    /// The largest width of a replacement field
+    const size_t MAX_FORMAT_WIDTH = 64;
+
+    /// The type of an argument of `format`
+    enum class FormatType : uint8_t
+    {
+        NONE,
+        BOOL,
+        CHAR,
+        SIGNED,
+        UNSIGNED,
+        SIGNED_64,
+        UNSIGNED_64,
+        STRING,
+        POINTER
+    };
+
+    /// What is wrong with a format string
+    enum class FormatError : uint8_t
+    {
+        NONE,
+        UNMATCHED_BRACE,
+        INVALID_SPECIFICATION,
+        TOO_FEW_ARGUMENTS,
+        TOO_MANY_ARGUMENTS,
+        TYPE_MISMATCH
+    };
+
+    /// The specification of a replacement field
+    struct FormatSpecification
+    {
+        /// True to align the value on the left of the width
+        bool isLeftAligned;
+        /// True to write 0x before a hexadecimal number
+        bool hasPrefix;
+        /// The padding character on the left (space or 0)
+        char fill;
+        /// The smallest number of characters of the field
+        uint8_t width;
+        /// The conversion (d, x, X, c, s, p), 0 for the default one
+        char conversion;
+    };
+
+    /// An argument of `format`, with its type
+    struct FormatArgument
+    {
+        FormatType type;
+        union
+        {
+            uint32_t value;
+            uint64_t value64;
+            const char* string;
+            const void* pointer;
+        };
+    };
+
+    /**
+     * \brief Parse the specification of a replacement field
+     *
+     * \param format The format string
+     * \param index The index after the opening brace
+     * \param specification Set to the specification
+     * \return The index of the closing brace, 0 if the specification is
+     * invalid
+     */
+    constexpr size_t parseFormatSpecification(
+        const char* format, size_t index, FormatSpecification& specification)
+    {
+        specification = {false, false, ' ', 0, '\0'};
+        if (format[index] != ':') {
+            return format[index] == '}' ? index : 0;
+        }
+
+        ++index;
+        if (format[index] == '-') {
+            specification.isLeftAligned = true;
+            ++index;
+        }
+        if (format[index] == '#') {
+            specification.hasPrefix = true;
+            ++index;
+        }
+        if (format[index] == '0') {
+            if (specification.isLeftAligned) {
+                return 0;
+            }
+            specification.fill = '0';
+            ++index;
+        }
+
+        size_t width = 0;
+        while (format[index] >= '0' && format[index] <= '9') {
+            width = width * 10 + (format[index] - '0');
+            if (width > MAX_FORMAT_WIDTH) {
+                return 0;
+            }
+            ++index;
+        }
+        specification.width = width;
+
+        const char conversion = format[index];
+        if (conversion == 'd' || conversion == 'x' || conversion == 'X' ||
+            conversion == 'c' || conversion == 's' || conversion == 'p') {
+            specification.conversion = conversion;
+            ++index;
+        }
+        if (specification.hasPrefix && specification.conversion != 'x' &&
+            specification.conversion != 'X') {
+            return 0;
+        }
+
+        return format[index] == '}' ? index : 0;
+    }
+
+    /**
+     * \brief Return true if a type is an integer
+     *
+     * \param type The type
+     * \return true for the signed and unsigned types of 32 and 64 bits
+     */
+    constexpr bool isFormatInteger(FormatType type)
+    {
+        return type == FormatType::SIGNED || type == FormatType::UNSIGNED ||
+               type == FormatType::SIGNED_64 ||
+               type == FormatType::UNSIGNED_64;
+    }
+
+    /**
+     * \brief Return true if a conversion can be applied to a type
+     *
+     * \param conversion The conversion of the field (0 for the default one)
+     * \param type The type of the argument
+     * \return true if the argument can be written with the conversion
+     */
+    constexpr bool isFormatConversionAllowed(char conversion,
+                                             FormatType type)
+    {
+        switch (conversion) {
+            case '\0':
+                return type != FormatType::NONE;
+            case 'd':
+                return isFormatInteger(type) || type == FormatType::CHAR;
+            case 'x':
+            case 'X':
+                return isFormatInteger(type) || type == FormatType::CHAR ||
+                       type == FormatType::POINTER;
+            case 'c':
+                return type == FormatType::CHAR ||
+                       type == FormatType::SIGNED ||
+                       type == FormatType::UNSIGNED;
+            case 's':
+                return type == FormatType::STRING || type == FormatType::BOOL;
+            case 'p':
+                return type == FormatType::POINTER ||
+                       type == FormatType::STRING;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * \brief Check a format string against the types of its arguments
+     *
+     * \param format The format string
+     * \param types The type of each argument
+     * \param count The number of arguments
+     * \return `FormatError::NONE` if the string fits the arguments
+     */
+    constexpr FormatError checkFormat(const char* format,
+                                      const FormatType* types, size_t count)
+    {
+        size_t argument = 0;
+        for (size_t i = 0; format[i] != '\0'; ++i) {
+            if (format[i] == '}') {
+                if (format[i + 1] != '}') {
+                    return FormatError::UNMATCHED_BRACE;
+                }
+                ++i;
+                continue;
+            }
+            if (format[i] != '{') {
+                continue;
+            }
+            if (format[i + 1] == '{') {
+                ++i;
+                continue;
+            }
+
+            FormatSpecification specification = {false, false, ' ', 0, '\0'};
+            const size_t end = parseFormatSpecification(format, i + 1,
+                                                        specification);
+            if (end == 0) {
+                return FormatError::INVALID_SPECIFICATION;
+            }
+            if (argument == count) {
+                return FormatError::TOO_FEW_ARGUMENTS;
+            }
+            if (!isFormatConversionAllowed(specification.conversion,
+                                           types[argument])) {
+                return FormatError::TYPE_MISMATCH;
+            }
+
+            ++argument;
+            i = end;
+        }
+
+        return argument == count ? FormatError::NONE
+                                 : FormatError::TOO_MANY_ARGUMENTS;
+    }
+
+    /// Get the type of the arguments of a C++ type (there is no overload
+    /// for the types `format` does not support)
+    constexpr FormatType getFormatType(const bool*)
+    {
+        return FormatType::BOOL;
+    }
+    constexpr FormatType getFormatType(const char*)
+    {
+        return FormatType::CHAR;
+    }
+    constexpr FormatType getFormatType(const signed char*)
+    {
+        return FormatType::SIGNED;
+    }
+    constexpr FormatType getFormatType(const short*)
+    {
+        return FormatType::SIGNED;
+    }
+    constexpr FormatType getFormatType(const int*)
+    {
+        return FormatType::SIGNED;
+    }
+    constexpr FormatType getFormatType(const long*)
+    {
+        return sizeof(long) == 8 ? FormatType::SIGNED_64
+                                 : FormatType::SIGNED;
+    }
+    constexpr FormatType getFormatType(const long long*)
+    {
+        return FormatType::SIGNED_64;
+    }
+    constexpr FormatType getFormatType(const unsigned char*)
+    {
+        return FormatType::UNSIGNED;
+    }
+    constexpr FormatType getFormatType(const unsigned short*)
+    {
+        return FormatType::UNSIGNED;
+    }
+    constexpr FormatType getFormatType(const unsigned int*)
+    {
+        return FormatType::UNSIGNED;
+    }
+    constexpr FormatType getFormatType(const unsigned long*)
+    {
+        return sizeof(long) == 8 ? FormatType::UNSIGNED_64
+                                 : FormatType::UNSIGNED;
+    }
+    constexpr FormatType getFormatType(const unsigned long long*)
+    {
+        return FormatType::UNSIGNED_64;
+    }
+    constexpr FormatType getFormatType(const char* const*)
+    {
+        return FormatType::STRING;
+    }
+    constexpr FormatType getFormatType(char* const*)
+    {
+        return FormatType::STRING;
+    }
+    template <size_t N>
+    constexpr FormatType getFormatType(const char (*)[N])
+    {
+        return FormatType::STRING;
+    }
+    template <typename T>
+    constexpr FormatType getFormatType(T* const*)
+    {
+        return FormatType::POINTER;
+    }
+
+    /// Make the argument of a value (there is an overload for every type of
+    /// `getFormatType`)
+    inline FormatArgument makeFormatArgument(bool value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::BOOL;
+        argument.value = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(char value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::CHAR;
+        argument.value = (unsigned char) value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(long long value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::SIGNED_64;
+        argument.value64 = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(unsigned long long value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::UNSIGNED_64;
+        argument.value64 = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(long value)
+    {
+        if (sizeof(long) == 8) {
+            return makeFormatArgument((long long) value);
+        }
+
+        FormatArgument argument;
+        argument.type = FormatType::SIGNED;
+        argument.value = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(unsigned long value)
+    {
+        if (sizeof(long) == 8) {
+            return makeFormatArgument((unsigned long long) value);
+        }
+
+        FormatArgument argument;
+        argument.type = FormatType::UNSIGNED;
+        argument.value = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(int value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::SIGNED;
+        argument.value = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(signed char value)
+    {
+        return makeFormatArgument((int) value);
+    }
+    inline FormatArgument makeFormatArgument(short value)
+    {
+        return makeFormatArgument((int) value);
+    }
+    inline FormatArgument makeFormatArgument(unsigned int value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::UNSIGNED;
+        argument.value = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(unsigned char value)
+    {
+        return makeFormatArgument((unsigned int) value);
+    }
+    inline FormatArgument makeFormatArgument(unsigned short value)
+    {
+        return makeFormatArgument((unsigned int) value);
+    }
+    inline FormatArgument makeFormatArgument(const char* value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::STRING;
+        argument.string = value;
+        return argument;
+    }
+    inline FormatArgument makeFormatArgument(char* value)
+    {
+        return makeFormatArgument((const char*) value);
+    }
+    template <typename T>
+    inline FormatArgument makeFormatArgument(T* value)
+    {
+        FormatArgument argument;
+        argument.type = FormatType::POINTER;
+        argument.pointer = value;
+        return argument;
+    }
+
+    /// Write arguments with a format string already checked
+    size_t formatArguments(char* buffer, size_t size, const char* format,
+                           const FormatArgument* arguments, size_t count);
+
+    /**
+     * \brief Check a format string against the types of its arguments at
+     * compile time
+     *
+     * `Format` is the type made by `FORMAT`. Every error is a separate
+     * `static_assert`, so the compiler names it.
+     */
+    template <typename Format, typename... Args>
+    constexpr bool assertFormat()
+    {
+        constexpr FormatType types[] = {
+            getFormatType(static_cast<const Args*>(nullptr))...,
+            FormatType::NONE
+        };
+        constexpr FormatError error = checkFormat(Format::get(), types,
+                                                  sizeof...(Args));
+
+        static_assert(error != FormatError::UNMATCHED_BRACE,
+                      "A brace of the format string is not matched");
+        static_assert(error != FormatError::INVALID_SPECIFICATION,
+                      "A field of the format string is invalid");
+        static_assert(error != FormatError::TOO_FEW_ARGUMENTS,
+                      "The format string has more fields than arguments");
+        static_assert(error != FormatError::TOO_MANY_ARGUMENTS,
+                      "The format string has fewer fields than arguments");
+        static_assert(error != FormatError::TYPE_MISMATCH,
+                      "A conversion of the format string does not fit the "
+                      "type of its argument");
+
+        return error == FormatError::NONE;
+    }
+
+    /**
+     * \brief Write values into a buffer with a format string checked at
+     * compile time
+     *
+     * \param buffer The buffer
+     * \param size The size of the buffer (the text is cut to `size - 1`
+     * characters and always null-terminated)
+     * \param format The format string, wrapped in `FORMAT`
+     * \param arguments The values of the fields
+     * \return The number of characters written (without the null character)
+     */
+    template <typename Format, typename... Args>
+    size_t format(char* buffer, size_t size, Format format,
+                  const Args&... arguments)
+    {
+        (void) format;
+        static_assert(assertFormat<Format, Args...>(),
+                      "Invalid format string");
+
+        const FormatArgument values[] = {
+            makeFormatArgument(arguments)..., FormatArgument()
+        };
+        return formatArguments(buffer, size, Format::get(), values,
+                               sizeof...(Args));
+    }
+}
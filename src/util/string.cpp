@@ -0,0 +1,530 @@
+#include "string.hpp"
+#include "../cpu/Fpu.hpp"
+#include "../cpu/cpu.hpp"
+#include "../interrupt.hpp"
+
+/// Keep GCC from turning the loops of the routines into calls to the
+/// functions they implement
+#define NO_BUILTIN_LOOPS \
+    __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+namespace util
+{
+    /// A routine copying bytes
+    typedef void (*CopyFunction)(void* destination, const void* source,
+                                 size_t size);
+    /// A routine filling bytes
+    typedef void (*FillFunction)(void* destination, uint8_t value,
+                                 size_t size);
+
+    /// A word that can alias any object (to read strings a word at a time)
+    typedef uint32_t __attribute__((may_alias)) AliasingWord;
+
+    /// The number of 64-byte blocks the SSE2 routines handle with the
+    /// interrupts disabled
+    const size_t SSE_CHUNK_BLOCKS = 64;
+
+    /**
+     * \brief Copy bytes one at a time
+     *
+     * \param destination The first byte to write
+     * \param source The first byte to read
+     * \param size The number of bytes
+     */
+    NO_BUILTIN_LOOPS
+    static void copyBytes(void* destination, const void* source, size_t size)
+    {
+        uint8_t* output = (uint8_t*) destination;
+        const uint8_t* input = (const uint8_t*) source;
+        for (size_t i = 0; i < size; ++i) {
+            output[i] = input[i];
+        }
+    }
+
+    /**
+     * \brief Copy bytes with `rep movsd`, then `rep movsb` for the last ones
+     *
+     * \param destination The first byte to write
+     * \param source The first byte to read
+     * \param size The number of bytes
+     */
+    static void copyDwords(void* destination, const void* source, size_t size)
+    {
+        size_t dwords = size / 4;
+        size_t bytes = size % 4;
+        __asm__ volatile (
+            "rep movsl\n"
+            "mov %3, %%ecx\n"
+            "rep movsb"
+            : "+D"(destination), "+S"(source), "+c"(dwords)
+            : "r"(bytes)
+            : "memory"
+        );
+    }
+
+    /**
+     * \brief Copy bytes with `rep movsb`
+     *
+     * With ERMS, the processor moves whole cache lines for it, which is as
+     * fast as the widest registers for the medium and large sizes.
+     *
+     * \param destination The first byte to write
+     * \param source The first byte to read
+     * \param size The number of bytes
+     */
+    static void copyErms(void* destination, const void* source, size_t size)
+    {
+        __asm__ volatile (
+            "rep movsb"
+            : "+D"(destination), "+S"(source), "+c"(size)
+            :
+            : "memory"
+        );
+    }
+
+    /**
+     * \brief Copy bytes 64 at a time with the SSE registers
+     *
+     * The first bytes are copied with `copyDwords` until the destination is
+     * aligned on 16 bytes, so the stores are aligned; the loads are aligned
+     * too if the source has the same alignment. The blocks are copied with
+     * the interrupts disabled, `SSE_CHUNK_BLOCKS` at a time, inside
+     * `cpu::kernelFpuBegin`: it saves the registers of the thread owning them
+     * at once, and `memcpy` never allocates the save area of the caller. The
+     * kernel is built without SSE, so the compiler never keeps values in them
+     * and they are not declared as clobbered.
+     *
+     * \param destination The first byte to write
+     * \param source The first byte to read
+     * \param size The number of bytes
+     */
+    static void copySse2(void* destination, const void* source, size_t size)
+    {
+        if (size < MEDIUM_MEMORY_SIZE) {
+            copyDwords(destination, source, size);
+            return;
+        }
+
+        uint8_t* output = (uint8_t*) destination;
+        const uint8_t* input = (const uint8_t*) source;
+
+        const size_t head = -(uintptr_t) output % 16;
+        copyDwords(output, input, head);
+        output += head;
+        input += head;
+        size -= head;
+
+        const bool isSourceAligned = (uintptr_t) input % 16 == 0;
+        size_t blocks = size / 64;
+        while (blocks > 0) {
+            size_t count = blocks < SSE_CHUNK_BLOCKS ? blocks
+                                                     : SSE_CHUNK_BLOCKS;
+            blocks -= count;
+
+            const uint32_t flags = saveAndDisableInterrupts();
+            cpu::kernelFpuBegin();
+            if (isSourceAligned) {
+                __asm__ volatile (
+                    "1:\n"
+                    "movdqa (%1), %%xmm0\n"
+                    "movdqa 16(%1), %%xmm1\n"
+                    "movdqa 32(%1), %%xmm2\n"
+                    "movdqa 48(%1), %%xmm3\n"
+                    "movdqa %%xmm0, (%0)\n"
+                    "movdqa %%xmm1, 16(%0)\n"
+                    "movdqa %%xmm2, 32(%0)\n"
+                    "movdqa %%xmm3, 48(%0)\n"
+                    "add $64, %1\n"
+                    "add $64, %0\n"
+                    "dec %2\n"
+                    "jnz 1b"
+                    : "+r"(output), "+r"(input), "+r"(count)
+                    :
+                    : "memory"
+                );
+            }
+            else {
+                __asm__ volatile (
+                    "1:\n"
+                    "movdqu (%1), %%xmm0\n"
+                    "movdqu 16(%1), %%xmm1\n"
+                    "movdqu 32(%1), %%xmm2\n"
+                    "movdqu 48(%1), %%xmm3\n"
+                    "movdqa %%xmm0, (%0)\n"
+                    "movdqa %%xmm1, 16(%0)\n"
+                    "movdqa %%xmm2, 32(%0)\n"
+                    "movdqa %%xmm3, 48(%0)\n"
+                    "add $64, %1\n"
+                    "add $64, %0\n"
+                    "dec %2\n"
+                    "jnz 1b"
+                    : "+r"(output), "+r"(input), "+r"(count)
+                    :
+                    : "memory"
+                );
+            }
+            cpu::kernelFpuEnd();
+            restoreInterrupts(flags);
+        }
+
+        copyDwords(output, input, size % 64);
+    }
+
+    /**
+     * \brief Fill bytes one at a time
+     *
+     * \param destination The first byte to write
+     * \param value The value of the bytes
+     * \param size The number of bytes
+     */
+    NO_BUILTIN_LOOPS
+    static void fillBytes(void* destination, uint8_t value, size_t size)
+    {
+        uint8_t* output = (uint8_t*) destination;
+        for (size_t i = 0; i < size; ++i) {
+            output[i] = value;
+        }
+    }
+
+    /**
+     * \brief Fill bytes with `rep stosd`, then `rep stosb` for the last ones
+     *
+     * \param destination The first byte to write
+     * \param value The value of the bytes
+     * \param size The number of bytes
+     */
+    static void fillDwords(void* destination, uint8_t value, size_t size)
+    {
+        size_t dwords = size / 4;
+        size_t bytes = size % 4;
+        __asm__ volatile (
+            "rep stosl\n"
+            "mov %2, %%ecx\n"
+            "rep stosb"
+            : "+D"(destination), "+c"(dwords)
+            : "r"(bytes), "a"(value * 0x01010101u)
+            : "memory"
+        );
+    }
+
+    /**
+     * \brief Fill bytes with `rep stosb`
+     *
+     * \param destination The first byte to write
+     * \param value The value of the bytes
+     * \param size The number of bytes
+     */
+    static void fillErms(void* destination, uint8_t value, size_t size)
+    {
+        __asm__ volatile (
+            "rep stosb"
+            : "+D"(destination), "+c"(size)
+            : "a"(value)
+            : "memory"
+        );
+    }
+
+    /**
+     * \brief Fill bytes 64 at a time with the SSE registers
+     *
+     * As `copySse2`, the destination is aligned with `fillDwords` first and
+     * the blocks are written with the interrupts disabled.
+     *
+     * \param destination The first byte to write
+     * \param value The value of the bytes
+     * \param size The number of bytes
+     */
+    static void fillSse2(void* destination, uint8_t value, size_t size)
+    {
+        if (size < MEDIUM_MEMORY_SIZE) {
+            fillDwords(destination, value, size);
+            return;
+        }
+
+        uint8_t* output = (uint8_t*) destination;
+
+        const size_t head = -(uintptr_t) output % 16;
+        fillDwords(output, value, head);
+        output += head;
+        size -= head;
+
+        const uint32_t pattern = value * 0x01010101u;
+        size_t blocks = size / 64;
+        while (blocks > 0) {
+            size_t count = blocks < SSE_CHUNK_BLOCKS ? blocks
+                                                     : SSE_CHUNK_BLOCKS;
+            blocks -= count;
+
+            const uint32_t flags = saveAndDisableInterrupts();
+            cpu::kernelFpuBegin();
+            __asm__ volatile (
+                "movd %2, %%xmm0\n"
+                "pshufd $0, %%xmm0, %%xmm0\n"
+                "1:\n"
+                "movdqa %%xmm0, (%0)\n"
+                "movdqa %%xmm0, 16(%0)\n"
+                "movdqa %%xmm0, 32(%0)\n"
+                "movdqa %%xmm0, 48(%0)\n"
+                "add $64, %0\n"
+                "dec %1\n"
+                "jnz 1b"
+                : "+r"(output), "+r"(count)
+                : "r"(pattern)
+                : "memory"
+            );
+            cpu::kernelFpuEnd();
+            restoreInterrupts(flags);
+        }
+
+        fillDwords(output, value, size % 64);
+    }
+
+    /// The copy routine of each `MemoryRoutine`
+    static const CopyFunction COPY_ROUTINES[MEMORY_ROUTINE_COUNT] = {
+        copyBytes, copyDwords, copyErms, copySse2
+    };
+    /// The fill routine of each `MemoryRoutine`
+    static const FillFunction FILL_ROUTINES[MEMORY_ROUTINE_COUNT] = {
+        fillBytes, fillDwords, fillErms, fillSse2
+    };
+    /// The name of each `MemoryRoutine`
+    static const char* const ROUTINE_NAMES[MEMORY_ROUTINE_COUNT] = {
+        "bytes", "dwords", "erms", "sse2"
+    };
+
+    /// The routine of each `MemorySizeClass`, the portable ones until
+    /// `initializeMemoryRoutines`
+    static MemoryRoutine routines[MEMORY_SIZE_CLASS_COUNT] = {
+        MemoryRoutine::BYTES, MemoryRoutine::DWORDS, MemoryRoutine::DWORDS
+    };
+    /// The copy routine of each `MemorySizeClass`
+    static CopyFunction copyRoutines[MEMORY_SIZE_CLASS_COUNT] = {
+        copyBytes, copyDwords, copyDwords
+    };
+    /// The fill routine of each `MemorySizeClass`
+    static FillFunction fillRoutines[MEMORY_SIZE_CLASS_COUNT] = {
+        fillBytes, fillDwords, fillDwords
+    };
+
+    /**
+     * \brief Get the size class of a copy or a fill
+     *
+     * \param size The number of bytes
+     * \return The index of the `MemorySizeClass`
+     */
+    static inline size_t getSizeClass(size_t size)
+    {
+        if (size < MEDIUM_MEMORY_SIZE) {
+            return (size_t) MemorySizeClass::SMALL;
+        }
+        if (size < LARGE_MEMORY_SIZE) {
+            return (size_t) MemorySizeClass::MEDIUM;
+        }
+        return (size_t) MemorySizeClass::LARGE;
+    }
+
+    /**
+     * \brief Choose the routine of each size class from the processor
+     * features
+     *
+     * The small sizes are always copied a byte at a time. With ERMS, the
+     * medium and large sizes use `rep movsb` and `rep stosb`. Otherwise, the
+     * medium sizes use `rep movsd` and `rep stosd`, and the large ones the
+     * SSE registers if they are enabled (CR4.OSFXSR), or `rep movsd` and
+     * `rep stosd` too.
+     *
+     * This is called once at boot on the bootstrap processor, before the
+     * other processors start, since they all share the table.
+     */
+    void initializeMemoryRoutines()
+    {
+        MemoryRoutine medium = MemoryRoutine::DWORDS;
+        MemoryRoutine large = MemoryRoutine::DWORDS;
+        if (isMemoryRoutineSupported(MemoryRoutine::ERMS)) {
+            medium = MemoryRoutine::ERMS;
+            large = MemoryRoutine::ERMS;
+        }
+        else if (isMemoryRoutineSupported(MemoryRoutine::SSE2)) {
+            large = MemoryRoutine::SSE2;
+        }
+
+        routines[(size_t) MemorySizeClass::MEDIUM] = medium;
+        routines[(size_t) MemorySizeClass::LARGE] = large;
+        for (size_t i = 0; i < MEMORY_SIZE_CLASS_COUNT; ++i) {
+            copyRoutines[i] = COPY_ROUTINES[(size_t) routines[i]];
+            fillRoutines[i] = FILL_ROUTINES[(size_t) routines[i]];
+        }
+    }
+
+    /**
+     * \brief Return true if the processor can run a routine
+     *
+     * \param routine The routine
+     * \return false for ERMS if CPUID does not report it, and for SSE2 if
+     * CPUID does not report it or the SSE registers are not enabled
+     */
+    bool isMemoryRoutineSupported(MemoryRoutine routine)
+    {
+        switch (routine) {
+            case MemoryRoutine::ERMS:
+                return cpu::cpuid(0).eax >= 7 &&
+                       (cpu::cpuid(7).ebx & cpu::CPUID_7_EBX_ERMS);
+            case MemoryRoutine::SSE2:
+                return (cpu::cpuid(1).edx & cpu::CPUID_1_EDX_SSE2) &&
+                       (cpu::readCr4() & cpu::CR4_OSFXSR);
+            default:
+                return true;
+        }
+    }
+
+    /**
+     * \brief Get the routine used for the copies and fills of a size class
+     *
+     * \param sizeClass The size class
+     * \return The routine chosen by `initializeMemoryRoutines`
+     */
+    MemoryRoutine getMemoryRoutine(MemorySizeClass sizeClass)
+    {
+        return routines[(size_t) sizeClass];
+    }
+
+    /**
+     * \brief Get the name of a routine
+     *
+     * \param routine The routine
+     * \return A string literal
+     */
+    const char* getMemoryRoutineName(MemoryRoutine routine)
+    {
+        return ROUTINE_NAMES[(size_t) routine];
+    }
+
+    /**
+     * \brief Copy bytes with a given routine
+     *
+     * \param routine The routine, which must be supported
+     * \param destination The first byte to write
+     * \param source The first byte to read (the buffers must not overlap)
+     * \param size The number of bytes
+     */
+    void copyMemory(MemoryRoutine routine, void* destination,
+                    const void* source, size_t size)
+    {
+        COPY_ROUTINES[(size_t) routine](destination, source, size);
+    }
+
+    /**
+     * \brief Fill bytes with a given routine
+     *
+     * \param routine The routine, which must be supported
+     * \param destination The first byte to write
+     * \param value The value of the bytes
+     * \param size The number of bytes
+     */
+    void fillMemory(MemoryRoutine routine, void* destination, uint8_t value,
+                    size_t size)
+    {
+        FILL_ROUTINES[(size_t) routine](destination, value, size);
+    }
+}
+
+/**
+ * \brief Copy bytes between buffers that do not overlap
+ *
+ * \param destination The first byte to write
+ * \param source The first byte to read
+ * \param size The number of bytes
+ * \return destination
+ */
+void* memcpy(void* destination, const void* source, size_t size)
+{
+    util::copyRoutines[util::getSizeClass(size)](destination, source, size);
+    return destination;
+}
+
+/**
+ * \brief Copy bytes between buffers that can overlap
+ *
+ * When the destination is before the source or after its end, the routines
+ * of `memcpy` are correct: they read every byte before writing over it.
+ * Otherwise the bytes are copied from the end with the direction flag set.
+ *
+ * \param destination The first byte to write
+ * \param source The first byte to read
+ * \param size The number of bytes
+ * \return destination
+ */
+void* memmove(void* destination, const void* source, size_t size)
+{
+    if ((uintptr_t) destination - (uintptr_t) source >= size) {
+        return memcpy(destination, source, size);
+    }
+
+    // Copy the last bytes, then the dwords, from the end
+    uint8_t* output = (uint8_t*) destination + size - 1;
+    const uint8_t* input = (const uint8_t*) source + size - 1;
+    size_t bytes = size % 4;
+    __asm__ volatile (
+        "std\n"
+        "rep movsb\n"
+        "sub $3, %%edi\n"
+        "sub $3, %%esi\n"
+        "mov %3, %%ecx\n"
+        "rep movsl\n"
+        "cld"
+        : "+D"(output), "+S"(input), "+c"(bytes)
+        : "r"(size / 4)
+        : "memory"
+    );
+
+    return destination;
+}
+
+/**
+ * \brief Fill bytes with a value
+ *
+ * \param destination The first byte to write
+ * \param value The value of the bytes (converted to `uint8_t`)
+ * \param size The number of bytes
+ * \return destination
+ */
+void* memset(void* destination, int value, size_t size)
+{
+    util::fillRoutines[util::getSizeClass(size)](destination, value, size);
+    return destination;
+}
+
+/**
+ * \brief Get the number of characters of a null-terminated string
+ *
+ * The string is read a word at a time once its address is aligned: an
+ * aligned word never crosses a page, so reading past the end is safe. A
+ * word holds a null character if subtracting 1 from each byte borrows into a
+ * byte that was below 0x80.
+ *
+ * \param string The string
+ * \return The number of characters before the null character
+ */
+NO_BUILTIN_LOOPS
+size_t strlen(const char* string)
+{
+    const char* character = string;
+    while ((uintptr_t) character % sizeof(util::AliasingWord) != 0) {
+        if (*character == '\0') {
+            return character - string;
+        }
+        ++character;
+    }
+
+    const util::AliasingWord* word = (const util::AliasingWord*) character;
+    while (((*word - 0x01010101u) & ~*word & 0x80808080u) == 0) {
+        ++word;
+    }
+
+    character = (const char*) word;
+    while (*character != '\0') {
+        ++character;
+    }
+
+    return character - string;
+}
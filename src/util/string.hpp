@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The memory and string functions of the C library. The compiler calls
+ * `memcpy`, `memmove` and `memset` for the copies and fills it generates
+ * (structure assignments, array initializations), so they must exist even in
+ * a freestanding kernel.
+ *
+ * The copies and fills choose an implementation from the size, through a
+ * table filled once at boot by `util::initializeMemoryRoutines` from what
+ * CPUID reports. Until then, the portable implementations are used.
+ */
+extern "C"
+{
+    /// Copy bytes between buffers that do not overlap
+    void* memcpy(void* destination, const void* source, size_t size);
+    /// Copy bytes between buffers that can overlap
+    void* memmove(void* destination, const void* source, size_t size);
+    /// Fill bytes with a value
+    void* memset(void* destination, int value, size_t size);
+    /// Get the number of characters of a null-terminated string
+    size_t strlen(const char* string);
+}
+
+namespace util
+{
+    /// An implementation of the copies and fills of memory
+    enum class MemoryRoutine : uint8_t
+    {
+        /// A byte per iteration, for the sizes where the setup of the string
+        /// instructions costs more than the work
+        BYTES,
+        /// `rep movsd` and `rep stosd`, then the last bytes
+        DWORDS,
+        /// `rep movsb` and `rep stosb`, fast on the processors with ERMS
+        ERMS,
+        /// 64 bytes per iteration with the SSE registers, on a destination
+        /// aligned on 16 bytes
+        SSE2
+    };
+
+    /// The number of `MemoryRoutine`
+    const size_t MEMORY_ROUTINE_COUNT = 4;
+
+    /// The size classes of the dispatch, each with its `MemoryRoutine`
+    enum class MemorySizeClass : uint8_t
+    {
+        SMALL,
+        MEDIUM,
+        LARGE
+    };
+
+    /// The number of `MemorySizeClass`
+    const size_t MEMORY_SIZE_CLASS_COUNT = 3;
+    /// The smallest size of `MemorySizeClass::MEDIUM`
+    const size_t MEDIUM_MEMORY_SIZE = 64;
+    /// The smallest size of `MemorySizeClass::LARGE`
+    const size_t LARGE_MEMORY_SIZE = 2048;
+
+    /// Choose the routine of each size class from the processor features
+    void initializeMemoryRoutines();
+    /// Return true if the processor can run a routine
+    bool isMemoryRoutineSupported(MemoryRoutine routine);
+    /// Get the routine used for the copies and fills of a size class
+    MemoryRoutine getMemoryRoutine(MemorySizeClass sizeClass);
+    /// Get the name of a routine
+    const char* getMemoryRoutineName(MemoryRoutine routine);
+
+    /// Copy bytes with a given routine
+    void copyMemory(MemoryRoutine routine, void* destination,
+                    const void* source, size_t size);
+    /// Fill bytes with a given routine
+    void fillMemory(MemoryRoutine routine, void* destination, uint8_t value,
+                    size_t size);
+}
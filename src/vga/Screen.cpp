@@ -1,5 +1,6 @@
 #include "Screen.hpp"
 #include "../io.hpp"
+#include "../util/string.hpp"
 
 namespace vga
 {
@@ -7,10 +8,10 @@ namespace vga
      * \brief Initialize the screen object
      *
      * The constructor initializes the `buffer_` pointer to the starting
-     * address of the memory-mapped I/O of the framebuffer.
+     * address of the memory-mapped I/O of the framebuffer (`getTextMemory`).
      */
     Screen::Screen()
-        : buffer_((uint16_t*) 0xB8000)
+        : buffer_(getTextMemory())
     {
     }
 
@@ -24,7 +25,7 @@ namespace vga
      * \param x The displacement from the left side of the screen (in terms of
      * characters), between 0 and WIDTH - 1
      * \param y The displacement from the top of the screen (in terms of
-     * characters), between 0 and HEIGHT - 1
+     * characters), between 0 and MEMORY_HEIGHT - 1
      * \return The formatted character expected by VGA (character, foreground
      * and background colors)
      */
@@ -46,7 +47,7 @@ namespace vga
      * \param x The displacement from the left side of the screen (in terms of
      * characters), between 0 and WIDTH - 1
      * \param y The displacement from the top of the screen (in terms of
-     * characters), between 0 and HEIGHT - 1
+     * characters), between 0 and MEMORY_HEIGHT - 1
      */
     uint16_t Screen::putEntryAt(uint16_t entry, size_t x, size_t y)
     {
@@ -65,7 +66,7 @@ namespace vga
      * \param x The displacement from the left side of the screen (in terms of
      * characters), between 0 and WIDTH - 1
      * \param y The displacement from the top of the screen (in terms of
-     * characters), between 0 and HEIGHT - 1
+     * characters), between 0 and MEMORY_HEIGHT - 1
      */
     void Screen::putCursorAt(size_t x, size_t y)
     {
@@ -80,13 +81,120 @@ namespace vga
         outb(CURSOR_DATA_PORT,    lowByte);
     }
 
+    /**
+     * \brief Put several characters on a row with a foreground and background
+     * color, starting at a specified position
+     *
+     * The characters are written two at a time with 32-bit stores. They must
+     * all fit on the row: `x + count` is at most WIDTH.
+     *
+     * \param characters The characters to put on the screen
+     * \param count The number of characters
+     * \param foregroundColor The color of the characters
+     * \param backgroundColor The background color of the characters
+     * \param x The displacement from the left side of the screen of the first
+     * character (in terms of characters), between 0 and WIDTH - 1
+     * \param y The row (in terms of characters), between 0 and
+     * MEMORY_HEIGHT - 1
+     */
+    void Screen::putRow(const char* characters, size_t count,
+                        Color foregroundColor, Color backgroundColor,
+                        size_t x, size_t y)
+    {
+        const uint16_t color = makeColor(foregroundColor, backgroundColor) << 8;
+        uint16_t* entries = buffer_ + convertPositionToIndex(x, y);
+        size_t i = 0;
+
+        // Write one character first if the row is not aligned on 32 bits
+        if (count > 0 && ((uintptr_t) entries & 2)) {
+            entries[0] = (uint8_t) characters[0] | color;
+            i = 1;
+        }
+
+        // Then write two characters with each store
+        const uint32_t colors = color | (uint32_t) color << 16;
+        for (; i + 1 < count; i += 2) {
+            uint32_t pair = (uint8_t) characters[i]
+                            | (uint32_t) (uint8_t) characters[i + 1] << 16;
+            *(uint32_t*) (entries + i) = colors | pair;
+        }
+
+        // And the last character if any
+        if (i < count) {
+            entries[i] = (uint8_t) characters[i] | color;
+        }
+    }
+
+    /**
+     * \brief Fill a row with a character
+     *
+     * \param character The character to put on the row
+     * \param foregroundColor The color of the character
+     * \param backgroundColor The background color of the character
+     * \param y The row (in terms of characters), between 0 and
+     * MEMORY_HEIGHT - 1
+     */
+    void Screen::fillRow(char character, Color foregroundColor,
+                         Color backgroundColor, size_t y)
+    {
+        const uint16_t entry = makeEntry(character, foregroundColor,
+                                         backgroundColor);
+        const uint32_t entries = entry | (uint32_t) entry << 16;
+        // Rows are WIDTH * 2 bytes long, so they are aligned on 32 bits
+        uint32_t* row = (uint32_t*) (buffer_ + convertPositionToIndex(0, y));
+
+        for (size_t x = 0; x < WIDTH / 2; ++x) {
+            row[x] = entries;
+        }
+    }
+
+    /**
+     * \brief Copy rows to other rows of the text memory
+     *
+     * The rows are copied with `memmove`, so the destination can overlap the
+     * source.
+     *
+     * \param sourceY The first row to copy, between 0 and MEMORY_HEIGHT - 1
+     * \param destinationY The row to copy the first row to, between 0 and
+     * MEMORY_HEIGHT - 1
+     * \param count The number of rows to copy
+     */
+    void Screen::copyRows(size_t sourceY, size_t destinationY, size_t count)
+    {
+        memmove(buffer_ + convertPositionToIndex(0, destinationY),
+                buffer_ + convertPositionToIndex(0, sourceY),
+                count * WIDTH * sizeof(uint16_t));
+    }
+
+    /**
+     * \brief Display the screen starting at the specified row
+     *
+     * The CRTC start address register is set to the first character of the
+     * row: the `HEIGHT` rows starting there are displayed.
+     *
+     * \param y The first row to display, between 0 and
+     * MEMORY_HEIGHT - HEIGHT
+     */
+    void Screen::setStartRow(size_t y)
+    {
+        size_t index = convertPositionToIndex(0, y);
+        uint8_t lowByte  = index & 0xFF,
+                highByte = (index >> 8) & 0xFF;
+
+        // Send the start address: the 8 highest bits, then the 8 lowest bits
+        outb(CURSOR_COMMAND_PORT, START_HIGH_BYTE_COMMAND);
+        outb(CURSOR_DATA_PORT,    highByte);
+        outb(CURSOR_COMMAND_PORT, START_LOW_BYTE_COMMAND);
+        outb(CURSOR_DATA_PORT,    lowByte);
+    }
+
     /**
      * \brief Convert a position on the screen in terms of x and y to an index
      *
      * \param x The displacement from the left side of the screen (in terms of
      * characters), between 0 and WIDTH - 1
      * \param y The displacement from the top of the screen (in terms of
-     * characters), between 0 and HEIGHT - 1
+     * characters), between 0 and MEMORY_HEIGHT - 1
      * \return The memory displacement to access the entry at (x,y)
      */
     size_t Screen::convertPositionToIndex(size_t x, size_t y) const
@@ -16,6 +16,15 @@ namespace vga
      * will return the resulting formatted character, as expected by VGA. This
      * result can be saved and then given later to `putEntryAt` to implement
      * scrolling, for example.
+     *
+     * `putRow` and `fillRow` write many characters at once with 32-bit stores
+     * (two characters each), which is much faster than calling `putEntryAt`
+     * for every character on the memory-mapped framebuffer.
+     *
+     * Positions are given in the whole text memory, which holds
+     * `MEMORY_HEIGHT` rows. The screen displays `HEIGHT` of them starting at
+     * the row given to `setStartRow`, so scrolling only needs to change the
+     * start row instead of moving every character.
      */
     class Screen
     {
@@ -33,6 +42,19 @@ namespace vga
         /// Put the cursor at the specified position
         void putCursorAt(size_t x, size_t y);
 
+        /// Put several characters on a row with a foreground and background
+        /// color, starting at a specified position
+        void putRow(const char* characters, size_t count,
+                    Color foregroundColor, Color backgroundColor,
+                    size_t x, size_t y);
+        /// Fill a row with a character
+        void fillRow(char character, Color foregroundColor,
+                     Color backgroundColor, size_t y);
+        /// Copy rows to other rows of the text memory
+        void copyRows(size_t sourceY, size_t destinationY, size_t count);
+        /// Display the screen starting at the specified row
+        void setStartRow(size_t y);
+
     private:
         /// Convert a position on the screen in terms of x and y to an index
         size_t convertPositionToIndex(size_t x, size_t y) const;
@@ -58,5 +80,12 @@ namespace vga
         /// Tell the framebuffer that the next byte will be the lowest 8 bits of
         /// the cursor position
         const uint8_t CURSOR_LOW_BYTE_COMMAND  = 15;
+
+        /// Tell the framebuffer that the next byte will be the highest 8 bits
+        /// of the start address of the screen
+        const uint8_t START_HIGH_BYTE_COMMAND = 12;
+        /// Tell the framebuffer that the next byte will be the lowest 8 bits of
+        /// the start address of the screen
+        const uint8_t START_LOW_BYTE_COMMAND  = 13;
     };
 }
\ No newline at end of file
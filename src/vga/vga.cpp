@@ -0,0 +1,16 @@
+#include "vga.hpp"
+#include "../memory/memory.hpp"
+
+namespace vga
+{
+    /**
+     * \brief Get the text memory (`MEMORY_HEIGHT` rows of `WIDTH` characters)
+     *
+     * \return The text memory at `TEXT_MEMORY_ADDRESS`, accessed through the
+     * direct map
+     */
+    uint16_t* getTextMemory()
+    {
+        return (uint16_t*) memory::physicalToVirtual(TEXT_MEMORY_ADDRESS);
+    }
+}
@@ -40,4 +40,12 @@ namespace vga
     const size_t WIDTH  = 80;
     /// Maximum height of the screen
     const size_t HEIGHT = 25;
+    /// Number of rows of WIDTH characters that fit in the 32 KiB of text
+    /// memory (the screen displays HEIGHT of them)
+    const size_t MEMORY_HEIGHT = 0x8000 / (2 * WIDTH);
+    /// The physical address of the text memory
+    const uintptr_t TEXT_MEMORY_ADDRESS = 0xB8000;
+
+    /// Get the text memory (`MEMORY_HEIGHT` rows of `WIDTH` characters)
+    uint16_t* getTextMemory();
 }
\ No newline at end of file
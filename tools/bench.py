@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Run the BrapOS benchmark image in QEMU and collect its results.
+
+The image writes one line per benchmark to COM1 (see
+src/bench/BenchmarkRunner.hpp):
+
+    bench-begin count=6 overhead=24
+    bench name=convert-hexa batch=100 samples=1000 min=31 median=32 p99=40
+    bench-end
+
+COM1 is QEMU's standard output, COM2 is discarded (it is written by the
+serial port benchmark). The results are printed as a table, and can be saved
+as JSON to compare two runs. With --host, the program of the host build
+(host/Makefile) is run instead, it writes the same lines to its standard
+output.
+
+Usage: tools/bench.py brapos-bench.bin [--json results.json]
+       tools/bench.py --host host/build/brapos-host-bench
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+import threading
+
+
+def parse_fields(line):
+    """Return the key=value fields of a result line as a dict."""
+    fields = {}
+    for token in line.split()[1:]:
+        key, _, value = token.partition("=")
+        fields[key] = int(value) if value.isdigit() else value
+    return fields
+
+
+class Results:
+    """The results read so far: the header, the benchmarks, and whether
+    bench-end was read."""
+
+    def __init__(self):
+        self.header = {}
+        self.results = []
+        self.complete = False
+
+
+def collect(lines, results):
+    """Read result lines into results until bench-end."""
+    for line in lines:
+        line = line.strip()
+        if line.startswith("bench-begin"):
+            results.header = parse_fields(line)
+        elif line.startswith("bench-end") and results.header:
+            results.complete = True
+            return
+        elif line.startswith("bench "):
+            results.results.append(parse_fields(line))
+
+
+def run(command, timeout):
+    """Run the benchmarks and return the results written to stdout.
+
+    The output is read by a thread, so a program that hangs before bench-end
+    (a fault in the image for instance) is killed after timeout seconds, with
+    the results read until then.
+    """
+    process = subprocess.Popen(command, stdout=subprocess.PIPE,
+                               universal_newlines=True, errors="replace")
+    results = Results()
+    reader = threading.Thread(target=collect, args=(process.stdout, results))
+    reader.daemon = True
+    reader.start()
+    reader.join(timeout)
+
+    try:
+        process.wait(timeout=0 if reader.is_alive() else 5)
+    except subprocess.TimeoutExpired:
+        process.kill()
+        process.wait()
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("kernel", help="the benchmark image")
+    parser.add_argument("--host", action="store_true",
+                        help="the argument is the program of the host build")
+    parser.add_argument("--qemu", default="qemu-system-i386",
+                        help="the QEMU binary")
+    parser.add_argument("--json", help="save the results in this file")
+    parser.add_argument("--timeout", type=float, default=120,
+                        help="seconds to wait for the results")
+    arguments = parser.parse_args()
+
+    if arguments.host:
+        command = [arguments.kernel]
+    else:
+        command = [
+            arguments.qemu, "-kernel", arguments.kernel, "-display", "none",
+            "-serial", "stdio", "-serial", "null",
+            "-device", "isa-debug-exit,iobase=0xf4,iosize=0x04",
+        ]
+    run_results = run(command, arguments.timeout)
+    header, results = run_results.header, run_results.results
+    if not run_results.complete:
+        print("error: no bench-end after {} seconds, {} results read".format(
+            arguments.timeout, len(results)), file=sys.stderr)
+
+    print("TSC read overhead: {} cycles".format(header.get("overhead")))
+    print("{:<24} {:>7} {:>10} {:>10} {:>10}".format(
+        "benchmark", "batch", "min", "median", "p99"))
+    for result in results:
+        print("{:<24} {:>7} {:>10} {:>10} {:>10}".format(
+            result["name"], result["batch"], result["min"],
+            result["median"], result["p99"]))
+
+    if arguments.json:
+        with open(arguments.json, "w") as output:
+            json.dump({"overhead": header.get("overhead"),
+                       "results": results}, output, indent=2)
+
+    if not run_results.complete:
+        return 1
+    return 0 if len(results) == header.get("count") else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())